@@ -211,12 +211,23 @@ struct lttng_event_function_attr {
 	char padding[LTTNG_EVENT_FUNCTION_PADDING1];
 };
 
+/*
+ * Static estimate of the worst-case cost of an evaluation of an event filter
+ * by the traced application, as if no logical operator short-circuited. All
+ * zero if the event has no filter.
+ */
+struct lttng_event_filter_cost {
+	uint16_t nr_insns;		/* Bytecode instructions. */
+	uint16_t nr_string_compares;	/* String comparisons. */
+	uint16_t nr_field_loads;	/* Field and context loads. */
+};
+
 /*
  * Generic lttng event
  *
  * The structures should be initialized to zero before use.
  */
-#define LTTNG_EVENT_PADDING1               10
+#define LTTNG_EVENT_PADDING1               4
 #define LTTNG_EVENT_PADDING2               LTTNG_SYMBOL_NAME_LEN + 32
 struct lttng_event {
 	enum lttng_event_type type;
@@ -233,6 +244,9 @@ struct lttng_event {
 	/* Event flag, from 2.6 and above. */
 	enum lttng_event_flag flags;
 
+	/* Filter cost estimate, from 2.7 and above. */
+	struct lttng_event_filter_cost filter_cost;
+
 	char padding[LTTNG_EVENT_PADDING1];
 
 	/* Per event type configuration */
@@ -390,6 +404,38 @@ int lttng_disable_event_ext(struct lttng_handle *handle,
 		struct lttng_event *ev, const char *channel_name,
 		const char *filter_expression);
 
+/*
+ * Create or enable many events of a channel in a single command.
+ *
+ * Each event is handled as by lttng_enable_event_with_exclusions() but the
+ * session daemon applies the whole batch at once: each registered
+ * application is updated a single time. Events already enabled are skipped.
+ *
+ * The filter_expressions, exclusion_counts and exclusion_names arrays are
+ * indexed like events and can be NULL if no event has a filter or exclusions.
+ * If channel_name is NULL, the default channel is used (channel0) and created
+ * if not found.
+ *
+ * Return 0 on success else a negative LTTng error code. On error, the other
+ * events of the batch were still processed.
+ */
+extern int lttng_enable_events(struct lttng_handle *handle,
+		struct lttng_event *events, unsigned int count,
+		const char *channel_name, const char **filter_expressions,
+		const int *exclusion_counts, char ***exclusion_names);
+
+/*
+ * Disable many events of a channel, by name, in a single command.
+ *
+ * Each registered application is updated a single time for the whole batch.
+ * If channel_name is NULL, the default channel is used (channel0).
+ *
+ * Return 0 on success else a negative LTTng error code. On error, the other
+ * events of the batch were still processed.
+ */
+extern int lttng_disable_events(struct lttng_handle *handle,
+		const char **names, unsigned int count, const char *channel_name);
+
 #ifdef __cplusplus
 }
 #endif
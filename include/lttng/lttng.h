@@ -70,6 +70,16 @@ extern int lttng_session_daemon_alive(void);
  */
 extern int lttng_set_tracing_group(const char *name);
 
+/*
+ * Keep the connection to the session daemon open across calls instead of
+ * connecting for each call. Useful to issue many calls in a row.
+ *
+ * The connection is not shared with forked processes.
+ *
+ * Return 0 on success else a negative LTTng error code.
+ */
+extern int lttng_set_persistent_connection(int enable);
+
 /*
  * This call registers an "outside consumer" for a session and an lttng domain.
  * No consumer will be spawned and all fds/commands will go through the socket
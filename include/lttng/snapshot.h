@@ -138,6 +138,21 @@ void lttng_snapshot_output_list_destroy(struct lttng_snapshot_output_list *list)
 int lttng_snapshot_record(const char *session_name,
 		struct lttng_snapshot_output *output, int wait);
 
+/*
+ * Snapshot only the part of the trace produced since the previous snapshot of
+ * the given session.
+ *
+ * Same as lttng_snapshot_record() except that, for every stream, only the
+ * packets that were not captured by the previous snapshot are recorded. For a
+ * local output, an index file is written along each stream so the resulting
+ * pieces can be put back together. The first incremental snapshot of a
+ * session captures everything.
+ *
+ * Return 0 on success or else a negative LTTNG_ERR value.
+ */
+int lttng_snapshot_record_incremental(const char *session_name,
+		struct lttng_snapshot_output *output, int wait);
+
 #ifdef __cplusplus
 }
 #endif
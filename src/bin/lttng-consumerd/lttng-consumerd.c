@@ -461,10 +461,10 @@ int main(int argc, char **argv)
 	lttng_consumer_set_error_sock(ctx, ret);
 
 	/*
-	 * Block RT signals used for UST periodical metadata flush and the live
-	 * timer in main, and create a dedicated thread to handle these signals.
+	 * Create the timer wheel used for UST periodical metadata flush and the
+	 * live timer. A dedicated thread drives it.
 	 */
-	if (consumer_signal_init()) {
+	if (consumer_timer_init()) {
 		retval = -1;
 		goto exit_init_data;
 	}
@@ -612,6 +612,7 @@ exit_health_pipe:
 exit_init_data:
 	lttng_consumer_destroy(ctx);
 	lttng_consumer_cleanup();
+	run_as_destroy_workers();
 
 	if (health_consumerd) {
 		health_app_destroy(health_consumerd);
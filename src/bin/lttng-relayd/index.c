@@ -22,12 +22,15 @@
 
 #include <common/common.h>
 #include <common/utils.h>
+#include <common/hashtable/rcu-batch.h>
 
 #include "lttng-relayd.h"
 #include "index.h"
+#include "stream.h"
 
 /*
- * Deferred free of a relay index object. MUST only be called by a call RCU.
+ * Deferred free of a relay index object. MUST only be called by a call RCU,
+ * directly or through a batch of lttng_rcu_batch_call().
  */
 static void deferred_free_relay_index(struct rcu_head *head)
 {
@@ -47,18 +50,55 @@ static void deferred_free_relay_index(struct rcu_head *head)
 }
 
 /*
- * Allocate a new relay index object using the given stream ID and sequence
- * number as the hash table key.
+ * Return the ring slot of the given sequence number in the stream.
+ */
+static struct relay_index *ring_slot(struct relay_stream *stream,
+		uint64_t net_seq_num)
+{
+	return &stream->index_ring[net_seq_num % DEFAULT_RELAYD_INDEX_RING_SIZE];
+}
+
+/*
+ * Release a ring slot, closing the fd to close if one.
+ */
+static void release_ring_slot(struct relay_index *index)
+{
+	assert(index->in_ring);
+
+	if (index->to_close_fd >= 0) {
+		int ret;
+
+		ret = close(index->to_close_fd);
+		if (ret < 0) {
+			PERROR("Relay index to close fd %d", index->to_close_fd);
+		}
+		index->to_close_fd = -1;
+	}
+	index->in_use = 0;
+}
+
+/*
+ * Create a relay index object for the given stream and sequence number. The
+ * free ring slot of the sequence number is used if possible, else the object
+ * is allocated and relay_index_add() adds it to the indexes hash table.
  *
- * Return allocated object or else NULL on error.
+ * Return the index object or else NULL on error.
  */
-struct relay_index *relay_index_create(uint64_t stream_id,
+struct relay_index *relay_index_create(struct relay_stream *stream,
 		uint64_t net_seq_num)
 {
 	struct relay_index *index;
 
 	DBG2("Creating relay index with stream id %" PRIu64 " and seqnum %" PRIu64,
-			stream_id, net_seq_num);
+			stream->stream_handle, net_seq_num);
+
+	index = ring_slot(stream, net_seq_num);
+	if (!index->in_use) {
+		memset(index, 0, sizeof(*index));
+		index->in_ring = 1;
+		index->in_use = 1;
+		goto init;
+	}
 
 	index = zmalloc(sizeof(*index));
 	if (index == NULL) {
@@ -66,32 +106,46 @@ struct relay_index *relay_index_create(uint64_t stream_id,
 		goto error;
 	}
 
+init:
 	index->to_close_fd = -1;
-	lttng_ht_node_init_two_u64(&index->index_n, stream_id, net_seq_num);
+	lttng_ht_node_init_two_u64(&index->index_n, stream->stream_handle,
+			net_seq_num);
 
 error:
 	return index;
 }
 
 /*
- * Find a relayd index in the given hash table.
+ * Find the relay index of the given stream and sequence number, in the ring of
+ * the stream or else in the indexes hash table.
+ *
+ * RCU read side lock MUST be acquired.
  *
  * Return index object or else NULL on error.
  */
-struct relay_index *relay_index_find(uint64_t stream_id, uint64_t net_seq_num)
+struct relay_index *relay_index_find(struct relay_stream *stream,
+		uint64_t net_seq_num)
 {
 	struct lttng_ht_node_two_u64 *node;
 	struct lttng_ht_iter iter;
-	struct lttng_ht_two_u64 key;
-	struct relay_index *index = NULL;
+	struct relay_index *index;
 
 	DBG3("Finding index for stream id %" PRIu64 " and seq_num %" PRIu64,
-			stream_id, net_seq_num);
+			stream->stream_handle, net_seq_num);
 
-	key.key1 = stream_id;
-	key.key2 = net_seq_num;
+	index = ring_slot(stream, net_seq_num);
+	if (index->in_use && index->index_n.key.key2 == net_seq_num) {
+		goto end;
+	}
+	index = NULL;
 
-	lttng_ht_lookup(indexes_ht, (void *)(&key), &iter);
+	/* Only indexes colliding with a ring slot in use are hashed. */
+	if (!stream->nr_hashed_indexes) {
+		goto end;
+	}
+
+	lttng_ht_lookup_two_u64(indexes_ht, stream->stream_handle, net_seq_num,
+			&iter);
 	node = lttng_ht_iter_get_node_two_u64(&iter);
 	if (node == NULL) {
 		goto end;
@@ -99,23 +153,32 @@ struct relay_index *relay_index_find(uint64_t stream_id, uint64_t net_seq_num)
 	index = caa_container_of(node, struct relay_index, index_n);
 
 end:
-	DBG2("Index %sfound in HT for stream ID %" PRIu64 " and seqnum %" PRIu64,
-			(index == NULL) ? "NOT " : "", stream_id, net_seq_num);
+	DBG2("Index %sfound for stream ID %" PRIu64 " and seqnum %" PRIu64,
+			(index == NULL) ? "NOT " : "", stream->stream_handle,
+			net_seq_num);
 	return index;
 }
 
 /*
- * Add unique relay index to the given hash table. In case of a collision, the
- * already existing object is put in the given _index variable.
+ * Add unique relay index to the indexes hash table unless it is a ring slot.
+ * In case of a collision, the already existing object is put in the given
+ * _index variable.
  *
  * RCU read side lock MUST be acquired.
  */
-void relay_index_add(struct relay_index *index, struct relay_index **_index)
+void relay_index_add(struct relay_stream *stream, struct relay_index *index,
+		struct relay_index **_index)
 {
 	struct cds_lfht_node *node_ptr;
 
+	assert(stream);
 	assert(index);
 
+	if (index->in_ring) {
+		/* The slot is claimed on creation. */
+		return;
+	}
+
 	DBG2("Adding relay index with stream id %" PRIu64 " and seqnum %" PRIu64,
 			index->index_n.key.key1, index->index_n.key.key2);
 
@@ -125,18 +188,21 @@ void relay_index_add(struct relay_index *index, struct relay_index **_index)
 			&index->index_n.node);
 	if (node_ptr != &index->index_n.node) {
 		*_index = caa_container_of(node_ptr, struct relay_index, index_n.node);
+	} else {
+		stream->nr_hashed_indexes++;
 	}
 }
 
 /*
- * Write index on disk to the given fd. Once done error or not, it is removed
- * from the hash table and destroy the object.
+ * Write index on disk to the given fd. Once done error or not, its ring slot
+ * is released or it is removed from the hash table and destroy the object.
  *
  * MUST be called with a RCU read side lock held.
  *
  * Return 0 on success else a negative value.
  */
-int relay_index_write(int fd, struct relay_index *index)
+int relay_index_write(struct relay_stream *stream, int fd,
+		struct relay_index *index)
 {
 	int ret;
 	struct lttng_ht_iter iter;
@@ -145,11 +211,19 @@ int relay_index_write(int fd, struct relay_index *index)
 			" on fd %d", index->index_n.key.key1,
 			index->index_n.key.key2, fd);
 
+	if (index->in_ring) {
+		ret = index_write(fd, &index->index_data, sizeof(index->index_data));
+		release_ring_slot(index);
+		return ret;
+	}
+
 	/* Delete index from hash table. */
 	iter.iter.node = &index->index_n.node;
 	ret = lttng_ht_del(indexes_ht, &iter);
 	assert(!ret);
-	call_rcu(&index->rcu_node, deferred_free_relay_index);
+	assert(stream->nr_hashed_indexes > 0);
+	stream->nr_hashed_indexes--;
+	lttng_rcu_batch_call(&index->rcu_node, deferred_free_relay_index);
 
 	return index_write(fd, &index->index_data, sizeof(index->index_data));
 }
@@ -163,7 +237,9 @@ void relay_index_free(struct relay_index *index)
 }
 
 /*
- * Safely free the given index using a call RCU.
+ * Safely free the given index, which is not in the indexes hash table, using a
+ * batched call RCU or release its ring slot. The caller MUST flush the batch
+ * with lttng_rcu_batch_flush() before blocking.
  */
 void relay_index_free_safe(struct relay_index *index)
 {
@@ -171,7 +247,12 @@ void relay_index_free_safe(struct relay_index *index)
 		return;
 	}
 
-	call_rcu(&index->rcu_node, deferred_free_relay_index);
+	if (index->in_ring) {
+		release_ring_slot(index);
+		return;
+	}
+
+	lttng_rcu_batch_call(&index->rcu_node, deferred_free_relay_index);
 }
 
 /*
@@ -195,19 +276,33 @@ void relay_index_delete(struct relay_index *index)
 }
 
 /*
- * Destroy every relay index with the given stream id as part of the key.
+ * Destroy every relay index of the given stream.
  */
-void relay_index_destroy_by_stream_id(uint64_t stream_id)
+void relay_index_destroy_by_stream(struct relay_stream *stream)
 {
+	unsigned int i;
 	struct lttng_ht_iter iter;
 	struct relay_index *index;
 
+	for (i = 0; i < DEFAULT_RELAYD_INDEX_RING_SIZE; i++) {
+		index = &stream->index_ring[i];
+		if (index->in_use) {
+			relay_index_free_safe(index);
+		}
+	}
+
+	if (!stream->nr_hashed_indexes) {
+		return;
+	}
+
 	rcu_read_lock();
 	cds_lfht_for_each_entry(indexes_ht->ht, &iter.iter, index, index_n.node) {
-		if (index->index_n.key.key1 == stream_id) {
+		if (index->index_n.key.key1 == stream->stream_handle) {
 			relay_index_delete(index);
 			relay_index_free_safe(index);
 		}
 	}
 	rcu_read_unlock();
+	stream->nr_hashed_indexes = 0;
+	lttng_rcu_batch_flush();
 }
@@ -42,16 +42,29 @@ struct relay_index {
 	struct lttng_ht_node_two_u64 index_n;
 	struct rcu_head rcu_node;
 	pthread_mutex_t mutex;
+
+	/*
+	 * Set when this index is a slot of the index ring of its stream, in
+	 * which case it is never added to the indexes hash table nor freed.
+	 */
+	unsigned int in_ring:1;
+	/* Set when this ring slot holds an index in flight. */
+	unsigned int in_use:1;
 };
 
-struct relay_index *relay_index_create(uint64_t stream_id,
+struct relay_stream;
+
+struct relay_index *relay_index_create(struct relay_stream *stream,
+		uint64_t net_seq_num);
+struct relay_index *relay_index_find(struct relay_stream *stream,
 		uint64_t net_seq_num);
-struct relay_index *relay_index_find(uint64_t stream_id, uint64_t net_seq_num);
-void relay_index_add(struct relay_index *index, struct relay_index **_index);
-int relay_index_write(int fd, struct relay_index *index);
+void relay_index_add(struct relay_stream *stream, struct relay_index *index,
+		struct relay_index **_index);
+int relay_index_write(struct relay_stream *stream, int fd,
+		struct relay_index *index);
 void relay_index_free(struct relay_index *index);
 void relay_index_free_safe(struct relay_index *index);
 void relay_index_delete(struct relay_index *index);
-void relay_index_destroy_by_stream_id(uint64_t stream_id);
+void relay_index_destroy_by_stream(struct relay_stream *stream);
 
 #endif /* _RELAY_INDEX_H */
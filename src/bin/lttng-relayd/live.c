@@ -681,7 +681,7 @@ int viewer_connect(struct relay_connection *conn)
 
 	memset(&reply, 0, sizeof(reply));
 	reply.major = RELAYD_VERSION_COMM_MAJOR;
-	reply.minor = RELAYD_VERSION_COMM_MINOR;
+	reply.minor = RELAYD_LIVE_VERSION_COMM_MINOR;
 
 	/* Major versions must be the same */
 	if (reply.major != be32toh(msg.major)) {
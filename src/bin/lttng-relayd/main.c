@@ -49,6 +49,7 @@
 #include <common/defaults.h>
 #include <common/daemonize.h>
 #include <common/futex.h>
+#include <common/hashtable/rcu-batch.h>
 #include <common/sessiond-comm/sessiond-comm.h>
 #include <common/sessiond-comm/inet.h>
 #include <common/sessiond-comm/relayd.h>
@@ -1933,76 +1934,60 @@ end_no_session:
 }
 
 /*
- * Receive an index for a specific stream.
+ * Handle an index received for a specific stream, either a live beacon or
+ * the index of a data packet.
  *
  * Return 0 on success else a negative value.
  */
 static
-int relay_recv_index(struct lttcomm_relayd_hdr *recv_hdr,
-		struct relay_connection *conn)
+int relay_process_index(struct lttcomm_relayd_index *index_info)
 {
-	int ret, send_ret, index_created = 0;
-	struct relay_session *session = conn->session;
-	struct lttcomm_relayd_index index_info;
+	int ret = 0, index_created = 0;
 	struct relay_index *index, *wr_index = NULL;
-	struct lttcomm_relayd_generic_reply reply;
 	struct relay_stream *stream;
 	uint64_t net_seq_num;
 
-	assert(conn);
-
-	DBG("Relay receiving index");
-
-	if (!session || conn->version_check_done == 0) {
-		ERR("Trying to close a stream before version check");
-		ret = -1;
-		goto end_no_session;
-	}
-
-	ret = conn->sock->ops->recvmsg(conn->sock, &index_info,
-			sizeof(index_info), 0);
-	if (ret < sizeof(index_info)) {
-		if (ret == 0) {
-			/* Orderly shutdown. Not necessary to print an error. */
-			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
-		} else {
-			ERR("Relay didn't receive valid index struct size : %d", ret);
-		}
-		ret = -1;
-		goto end_no_session;
-	}
-
-	net_seq_num = be64toh(index_info.net_seq_num);
+	net_seq_num = be64toh(index_info->net_seq_num);
 
 	rcu_read_lock();
 	stream = stream_find_by_id(relay_streams_ht,
-			be64toh(index_info.relay_stream_id));
+			be64toh(index_info->relay_stream_id));
 	if (!stream) {
 		ret = -1;
 		goto end_rcu_unlock;
 	}
 
 	/* Live beacon handling */
-	if (index_info.packet_size == 0) {
+	if (index_info->packet_size == 0) {
 		DBG("Received live beacon for stream %" PRIu64, stream->stream_handle);
 
+		/*
+		 * Ignore a beacon sent before data that was already received. The
+		 * consumer batches beacons so one can be overtaken by a packet.
+		 */
+		if (stream->prev_seq != -1ULL &&
+				((int64_t) (stream->prev_seq - net_seq_num)) > 0) {
+			DBG("Stale live beacon for stream %" PRIu64,
+					stream->stream_handle);
+			goto end_rcu_unlock;
+		}
+
 		/*
 		 * Only flag a stream inactive when it has already received data
 		 * and no indexes are in flight.
 		 */
 		if (stream->total_index_received > 0 && stream->indexes_in_flight == 0) {
-			stream->beacon_ts_end = be64toh(index_info.timestamp_end);
+			stream->beacon_ts_end = be64toh(index_info->timestamp_end);
 		}
-		ret = 0;
 		goto end_rcu_unlock;
 	} else {
 		stream->beacon_ts_end = -1ULL;
 	}
 
-	index = relay_index_find(stream->stream_handle, net_seq_num);
+	index = relay_index_find(stream, net_seq_num);
 	if (!index) {
-		/* A successful creation will add the object to the HT. */
-		index = relay_index_create(stream->stream_handle, net_seq_num);
+		/* Use the ring slot of the stream or add the object to the HT. */
+		index = relay_index_create(stream, net_seq_num);
 		if (!index) {
 			goto end_rcu_unlock;
 		}
@@ -2010,9 +1995,9 @@ int relay_recv_index(struct lttcomm_relayd_hdr *recv_hdr,
 		stream->indexes_in_flight++;
 	}
 
-	copy_index_control_data(index, &index_info);
+	copy_index_control_data(index, index_info);
 	if (stream->ctf_stream_id == -1ULL) {
-		stream->ctf_stream_id = be64toh(index_info.stream_id);
+		stream->ctf_stream_id = be64toh(index_info->stream_id);
 	}
 
 	if (index_created) {
@@ -2021,9 +2006,9 @@ int relay_recv_index(struct lttcomm_relayd_hdr *recv_hdr,
 		 * already exist, destroy back the index created, set the data in this
 		 * object and write it on disk.
 		 */
-		relay_index_add(index, &wr_index);
+		relay_index_add(stream, index, &wr_index);
 		if (wr_index) {
-			copy_index_control_data(wr_index, &index_info);
+			copy_index_control_data(wr_index, index_info);
 			free(index);
 		}
 	} else {
@@ -2033,7 +2018,7 @@ int relay_recv_index(struct lttcomm_relayd_hdr *recv_hdr,
 
 	/* Do we have a writable ready index to write on disk. */
 	if (wr_index) {
-		ret = relay_index_write(wr_index->fd, wr_index);
+		ret = relay_index_write(stream, wr_index->fd, wr_index);
 		if (ret < 0) {
 			goto end_rcu_unlock;
 		}
@@ -2044,6 +2029,47 @@ int relay_recv_index(struct lttcomm_relayd_hdr *recv_hdr,
 
 end_rcu_unlock:
 	rcu_read_unlock();
+	return ret;
+}
+
+/*
+ * Receive an index for a specific stream.
+ *
+ * Return 0 on success else a negative value.
+ */
+static
+int relay_recv_index(struct lttcomm_relayd_hdr *recv_hdr,
+		struct relay_connection *conn)
+{
+	int ret, send_ret;
+	struct relay_session *session = conn->session;
+	struct lttcomm_relayd_index index_info;
+	struct lttcomm_relayd_generic_reply reply;
+
+	assert(conn);
+
+	DBG("Relay receiving index");
+
+	if (!session || conn->version_check_done == 0) {
+		ERR("Trying to close a stream before version check");
+		ret = -1;
+		goto end_no_session;
+	}
+
+	ret = conn->sock->ops->recvmsg(conn->sock, &index_info,
+			sizeof(index_info), 0);
+	if (ret < sizeof(index_info)) {
+		if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+		} else {
+			ERR("Relay didn't receive valid index struct size : %d", ret);
+		}
+		ret = -1;
+		goto end_no_session;
+	}
+
+	ret = relay_process_index(&index_info);
 
 	memset(&reply, 0, sizeof(reply));
 	if (ret < 0) {
@@ -2061,6 +2087,100 @@ end_no_session:
 	return ret;
 }
 
+/*
+ * Receive a batch of indexes, usually the live beacons of every stream of a
+ * channel, and reply once for the whole batch.
+ *
+ * Return 0 on success else a negative value.
+ */
+static
+int relay_recv_index_batch(struct lttcomm_relayd_hdr *recv_hdr,
+		struct relay_connection *conn)
+{
+	int ret, send_ret;
+	uint32_t i, count;
+	size_t size;
+	struct relay_session *session = conn->session;
+	struct lttcomm_relayd_index_batch batch;
+	struct lttcomm_relayd_index *indexes = NULL;
+	struct lttcomm_relayd_generic_reply reply;
+
+	assert(conn);
+
+	DBG("Relay receiving index batch");
+
+	if (!session || conn->version_check_done == 0) {
+		ERR("Trying to send indexes before version check");
+		ret = -1;
+		goto end_no_session;
+	}
+
+	ret = conn->sock->ops->recvmsg(conn->sock, &batch, sizeof(batch), 0);
+	if (ret < sizeof(batch)) {
+		if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+		} else {
+			ERR("Relay didn't receive valid index batch size : %d", ret);
+		}
+		ret = -1;
+		goto end_no_session;
+	}
+
+	count = be32toh(batch.count);
+	if (count == 0 || count > LTTCOMM_RELAYD_INDEX_BATCH_MAX) {
+		ERR("Relay received invalid index batch count %" PRIu32, count);
+		ret = -1;
+		goto end_no_session;
+	}
+
+	size = count * sizeof(*indexes);
+	indexes = zmalloc(size);
+	if (!indexes) {
+		PERROR("zmalloc index batch");
+		ret = -1;
+		goto end_no_session;
+	}
+
+	ret = conn->sock->ops->recvmsg(conn->sock, indexes, size, 0);
+	if (ret < (ssize_t) size) {
+		if (ret == 0) {
+			/* Orderly shutdown. Not necessary to print an error. */
+			DBG("Socket %d did an orderly shutdown", conn->sock->fd);
+		} else {
+			ERR("Relay didn't receive the %" PRIu32 " indexes of the batch",
+					count);
+		}
+		ret = -1;
+		goto end_free;
+	}
+
+	ret = 0;
+	for (i = 0; i < count; i++) {
+		/* Process every index even if one fails. */
+		if (relay_process_index(&indexes[i]) < 0) {
+			ret = -1;
+		}
+	}
+
+	memset(&reply, 0, sizeof(reply));
+	if (ret < 0) {
+		reply.ret_code = htobe32(LTTNG_ERR_UNK);
+	} else {
+		reply.ret_code = htobe32(LTTNG_OK);
+	}
+	send_ret = conn->sock->ops->sendmsg(conn->sock, &reply, sizeof(reply), 0);
+	if (send_ret < 0) {
+		ERR("Relay sending index batch reply");
+		ret = send_ret;
+	}
+
+end_free:
+	free(indexes);
+end_no_session:
+	return ret;
+}
+
 /*
  * Receive the streams_sent message.
  *
@@ -2157,6 +2277,9 @@ int relay_process_control(struct lttcomm_relayd_hdr *recv_hdr,
 	case RELAYD_STREAMS_SENT:
 		ret = relay_streams_sent(recv_hdr, conn);
 		break;
+	case RELAYD_SEND_INDEX_BATCH:
+		ret = relay_recv_index_batch(recv_hdr, conn);
+		break;
 	case RELAYD_UPDATE_SYNC_INFO:
 	default:
 		ERR("Received unknown command (%u)", be32toh(recv_hdr->cmd));
@@ -2180,12 +2303,11 @@ static int handle_index_data(struct relay_stream *stream, uint64_t net_seq_num,
 		int rotate_index)
 {
 	int ret = 0, index_created = 0;
-	uint64_t stream_id, data_offset;
+	uint64_t data_offset;
 	struct relay_index *index, *wr_index = NULL;
 
 	assert(stream);
 
-	stream_id = stream->stream_handle;
 	/* Get data offset because we are about to update the index. */
 	data_offset = htobe64(stream->tracefile_size_current);
 
@@ -2194,10 +2316,10 @@ static int handle_index_data(struct relay_stream *stream, uint64_t net_seq_num,
 	 * exists, the control thread already received the data for it thus we need
 	 * to write it on disk.
 	 */
-	index = relay_index_find(stream_id, net_seq_num);
+	index = relay_index_find(stream, net_seq_num);
 	if (!index) {
-		/* A successful creation will add the object to the HT. */
-		index = relay_index_create(stream_id, net_seq_num);
+		/* Use the ring slot of the stream or add the object to the HT. */
+		index = relay_index_create(stream, net_seq_num);
 		if (!index) {
 			ret = -1;
 			goto error;
@@ -2226,7 +2348,7 @@ static int handle_index_data(struct relay_stream *stream, uint64_t net_seq_num,
 		 * Try to add the relay index object to the hash table. If an object
 		 * already exist, destroy back the index created and set the data.
 		 */
-		relay_index_add(index, &wr_index);
+		relay_index_add(stream, index, &wr_index);
 		if (wr_index) {
 			/* Copy back data from the created index. */
 			wr_index->fd = index->fd;
@@ -2241,7 +2363,7 @@ static int handle_index_data(struct relay_stream *stream, uint64_t net_seq_num,
 
 	/* Do we have a writable ready index to write on disk. */
 	if (wr_index) {
-		ret = relay_index_write(wr_index->fd, wr_index);
+		ret = relay_index_write(stream, wr_index->fd, wr_index);
 		if (ret < 0) {
 			goto error;
 		}
@@ -2512,6 +2634,9 @@ restart:
 
 		health_code_update();
 
+		/* Reclaim the indexes written so far before blocking. */
+		lttng_rcu_batch_flush();
+
 		/* Infinite blocking call, waiting for transmission */
 		DBG3("Relayd worker thread polling...");
 		health_poll_entry();
@@ -2719,6 +2844,7 @@ error_poll_create:
 		relay_index_free_safe(index);
 	}
 	rcu_read_unlock();
+	lttng_rcu_batch_flush();
 	lttng_ht_destroy(indexes_ht);
 indexes_ht_error:
 	lttng_ht_destroy(relay_connections_ht);
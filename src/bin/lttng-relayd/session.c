@@ -80,7 +80,7 @@ struct relay_session *session_find_by_id(struct lttng_ht *ht, uint64_t id)
 
 	assert(ht);
 
-	lttng_ht_lookup(ht, &id, &iter);
+	lttng_ht_lookup_u64(ht, id, &iter);
 	node = lttng_ht_iter_get_node_u64(&iter);
 	if (!node) {
 		DBG("Session find by ID %" PRIu64 " id NOT found", id);
@@ -49,7 +49,7 @@ struct relay_stream *stream_find_by_id(struct lttng_ht *ht,
 
 	assert(ht);
 
-	lttng_ht_lookup(ht, &stream_id, &iter);
+	lttng_ht_lookup_u64(ht, stream_id, &iter);
 	node = lttng_ht_iter_get_node_u64(&iter);
 	if (node == NULL) {
 		DBG("Relay stream %" PRIu64 " not found", stream_id);
@@ -116,7 +116,7 @@ int stream_close(struct relay_session *session, struct relay_stream *stream)
 	}
 
 	/* Cleanup index of that stream. */
-	relay_index_destroy_by_stream_id(stream->stream_handle);
+	relay_index_destroy_by_stream(stream);
 
 	ctf_trace = ctf_trace_find_by_path(session->ctf_traces_ht,
 			stream->path_name);
@@ -24,8 +24,10 @@
 #include <pthread.h>
 #include <urcu/list.h>
 
+#include <common/defaults.h>
 #include <common/hashtable/hashtable.h>
 
+#include "index.h"
 #include "session.h"
 
 /*
@@ -82,6 +84,16 @@ struct relay_stream {
 	 * transit.
 	 */
 	int indexes_in_flight;
+	/*
+	 * Preallocated indexes in flight, an index using the slot of its
+	 * net_seq_num modulo DEFAULT_RELAYD_INDEX_RING_SIZE. Since the indexes of
+	 * a stream arrive nearly in order, the global indexes hash table only
+	 * holds the ones colliding with a slot in use. Only used by the worker
+	 * thread.
+	 */
+	struct relay_index index_ring[DEFAULT_RELAYD_INDEX_RING_SIZE];
+	/* Number of indexes of this stream in the global indexes hash table. */
+	unsigned int nr_hashed_indexes;
 	/*
 	 * CTF stream ID, -1ULL when unset.
 	 */
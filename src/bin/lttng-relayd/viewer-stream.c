@@ -190,7 +190,7 @@ struct relay_viewer_stream *viewer_stream_find_by_id(uint64_t id)
 	struct lttng_ht_iter iter;
 	struct relay_viewer_stream *stream = NULL;
 
-	lttng_ht_lookup(viewer_streams_ht, &id, &iter);
+	lttng_ht_lookup_u64(viewer_streams_ht, id, &iter);
 	node = lttng_ht_iter_get_node_u64(&iter);
 	if (!node) {
 		DBG("Relay viewer stream %" PRIu64 " not found", id);
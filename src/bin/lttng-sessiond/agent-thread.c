@@ -18,6 +18,7 @@
 #define _GNU_SOURCE
 #define _LGPL_SOURCE
 #include <assert.h>
+#include <poll.h>
 
 #include <common/common.h>
 #include <common/sessiond-comm/sessiond-comm.h>
@@ -41,14 +42,16 @@ static const char *default_reg_uri =
 	"tcp://" DEFAULT_NETWORK_VIEWER_BIND_ADDRESS;
 
 /*
- * Update agent application using the given socket. This is done just after
- * registration was successful.
+ * Update the given newly registered agent applications. This is done just
+ * after registration was successful, for every application registered at once
+ * so they are configured concurrently.
  *
  * This is a quite heavy call in terms of locking since the session list lock
  * AND session lock are acquired.
  */
-static void update_agent_app(struct agent_app *app)
+static void update_agent_apps(struct agent_app **apps, unsigned int nr_apps)
 {
+	unsigned int i, j;
 	struct ltt_session *session, *stmp;
 	struct ltt_session_list *list;
 
@@ -59,12 +62,25 @@ static void update_agent_app(struct agent_app *app)
 	cds_list_for_each_entry_safe(session, stmp, &list->head, list) {
 		session_lock(session);
 		if (session->ust_session) {
-			struct agent *agt;
-
 			rcu_read_lock();
-			agt = trace_ust_find_agent(session->ust_session, app->domain);
-			if (agt) {
-				agent_update(agt, app->sock->fd);
+			for (i = 0; i < nr_apps; i++) {
+				struct agent *agt;
+
+				/* Update each domain once, with all its applications. */
+				for (j = 0; j < i; j++) {
+					if (apps[j]->domain == apps[i]->domain) {
+						break;
+					}
+				}
+				if (j < i) {
+					continue;
+				}
+
+				agt = trace_ust_find_agent(session->ust_session,
+						apps[i]->domain);
+				if (agt) {
+					agent_update_apps(agt, apps, nr_apps);
+				}
 			}
 			rcu_read_unlock();
 		}
@@ -73,6 +89,25 @@ static void update_agent_app(struct agent_app *app)
 	session_unlock_list();
 }
 
+/*
+ * Return 1 if a registration is pending on the given socket, else 0.
+ */
+static int registration_pending(struct lttcomm_sock *reg_sock)
+{
+	int ret;
+	struct pollfd pfd;
+
+	pfd.fd = reg_sock->fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	do {
+		ret = poll(&pfd, 1, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret > 0 && (pfd.revents & POLLIN);
+}
+
 /*
  * Destroy a agent application by socket.
  */
@@ -226,20 +261,24 @@ static int handle_registration(struct lttcomm_sock *reg_sock,
 	major_version = be32toh(msg.major_version);
 	minor_version = be32toh(msg.minor_version);
 
-	/* Test communication protocol version of the registring agent. */
+	/*
+	 * Test communication protocol version of the registring agent. Older
+	 * minor versions are only sent the commands they support.
+	 */
 	if (major_version != AGENT_MAJOR_VERSION) {
 		ret = -EINVAL;
 		goto error_socket;
 	}
-	if (minor_version != AGENT_MINOR_VERSION) {
+	if (minor_version > AGENT_MINOR_VERSION) {
 		ret = -EINVAL;
 		goto error_socket;
 	}
 
-	DBG2("[agent-thread] New registration for pid %d domain %d on socket %d",
-			pid, domain, new_sock->fd);
+	DBG2("[agent-thread] New registration for pid %d domain %d version "
+			"%" PRIu32 ".%" PRIu32 " on socket %d", pid, domain,
+			major_version, minor_version, new_sock->fd);
 
-	app = agent_create_app(pid, domain, new_sock);
+	app = agent_create_app(pid, domain, minor_version, new_sock);
 	if (!app) {
 		ret = -ENOMEM;
 		goto error_socket;
@@ -355,34 +394,52 @@ restart:
 
 				destroy_agent_app(pollfd);
 			} else if (revents & (LPOLLIN)) {
-				int new_fd;
-				struct agent_app *app = NULL;
+				unsigned int j, nr_apps = 0;
+				struct agent_app *apps[DEFAULT_AGENT_REG_BATCH_SIZE];
 
 				/* Pollin event of agent app socket should NEVER happen. */
 				assert(pollfd == reg_sock->fd);
 
-				new_fd = handle_registration(reg_sock, &app);
-				if (new_fd < 0) {
-					WARN("[agent-thread] agent registration failed. Ignoring.");
-					/* Somehow the communication failed. Just continue. */
+				/*
+				 * Accept every pending registration, up to a batch, so the
+				 * agents registering at once are updated together.
+				 */
+				do {
+					int new_fd;
+					struct agent_app *app = NULL;
+
+					new_fd = handle_registration(reg_sock, &app);
+					if (new_fd < 0) {
+						WARN("[agent-thread] agent registration failed. Ignoring.");
+						/* Somehow the communication failed. Just continue. */
+						continue;
+					}
+					/* Should not have a NULL app on success. */
+					assert(app);
+
+					/* Only add poll error event to only detect shutdown. */
+					ret = lttng_poll_add(&events, new_fd,
+							LPOLLERR | LPOLLHUP | LPOLLRDHUP);
+					if (ret < 0) {
+						destroy_agent_app(new_fd);
+						continue;
+					}
+
+					apps[nr_apps++] = app;
+				} while (nr_apps < DEFAULT_AGENT_REG_BATCH_SIZE &&
+						registration_pending(reg_sock));
+
+				if (!nr_apps) {
 					continue;
 				}
-				/* Should not have a NULL app on success. */
-				assert(app);
 
-				/* Only add poll error event to only detect shutdown. */
-				ret = lttng_poll_add(&events, new_fd,
-						LPOLLERR | LPOLLHUP | LPOLLRDHUP);
-				if (ret < 0) {
-					destroy_agent_app(new_fd);
-					continue;
-				}
+				/* Update newly registered apps. */
+				update_agent_apps(apps, nr_apps);
 
-				/* Update newly registered app. */
-				update_agent_app(app);
-
-				/* On failure, the poll will detect it and clean it up. */
-				(void) agent_send_registration_done(app);
+				for (j = 0; j < nr_apps; j++) {
+					/* On failure, the poll will detect it and clean it up. */
+					(void) agent_send_registration_done(apps[j]);
+				}
 			} else {
 				ERR("Unknown poll events %u for sock %d", revents, pollfd);
 				continue;
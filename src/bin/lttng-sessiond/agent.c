@@ -21,9 +21,11 @@
 #include <urcu/uatomic.h>
 
 #include <common/common.h>
+#include <common/hashtable/rcu-batch.h>
 #include <common/sessiond-comm/agent.h>
 
 #include <common/compat/endian.h>
+#include <lib/lttng-ctl/filter/filter-bytecode.h>
 
 #include "agent.h"
 #include "ust-app.h"
@@ -311,127 +313,386 @@ error:
 }
 
 /*
- * Internal enable agent event on a agent application. This function
- * communicates with the agent to enable a given event.
+ * Return the LTTNG_ERR* code of the given agent return code.
+ */
+static int agent_ret_code_to_lttng(uint32_t ret_code)
+{
+	int ret;
+
+	switch (ret_code) {
+	case AGENT_RET_CODE_SUCCESS:
+		ret = LTTNG_OK;
+		break;
+	case AGENT_RET_CODE_UNKNOWN_NAME:
+		ret = LTTNG_ERR_UST_EVENT_NOT_FOUND;
+		break;
+	default:
+		ERR("Agent returned an unknown code: %" PRIu32, ret_code);
+		ret = LTTNG_ERR_FATAL;
+		break;
+	}
+
+	return ret;
+}
+
+/*
+ * Send the enable or disable command of an event to an agent application. Its
+ * reply MUST then be received with recv_event_reply().
  *
  * Return LTTNG_OK on success or else a LTTNG_ERR* code.
  */
-static int enable_event(struct agent_app *app, struct agent_event *event)
+static int send_event_command(struct agent_app *app, struct agent_event *event,
+		int enable)
 {
 	int ret;
-	uint64_t data_size;
-	struct lttcomm_agent_enable msg;
-	struct lttcomm_agent_generic_reply reply;
+	struct lttcomm_agent_enable enable_msg;
+	struct lttcomm_agent_disable disable_msg;
+	void *msg;
+	size_t size;
 
 	assert(app);
 	assert(app->sock);
 	assert(event);
 
-	DBG2("Agent enabling event %s for app pid: %d and socket %d", event->name,
-			app->pid, app->sock->fd);
-
-	data_size = sizeof(msg);
+	DBG2("Agent %s event %s for app pid: %d and socket %d",
+			enable ? "enabling" : "disabling", event->name, app->pid,
+			app->sock->fd);
 
-	ret = send_header(app->sock, data_size, AGENT_CMD_ENABLE, 0);
-	if (ret < 0) {
-		goto error_io;
+	if (enable) {
+		memset(&enable_msg, 0, sizeof(enable_msg));
+		enable_msg.loglevel = event->loglevel;
+		enable_msg.loglevel_type = event->loglevel_type;
+		strncpy(enable_msg.name, event->name, sizeof(enable_msg.name));
+		msg = &enable_msg;
+		size = sizeof(enable_msg);
+	} else {
+		memset(&disable_msg, 0, sizeof(disable_msg));
+		strncpy(disable_msg.name, event->name, sizeof(disable_msg.name));
+		msg = &disable_msg;
+		size = sizeof(disable_msg);
 	}
 
-	memset(&msg, 0, sizeof(msg));
-	msg.loglevel = event->loglevel;
-	msg.loglevel_type = event->loglevel_type;
-	strncpy(msg.name, event->name, sizeof(msg.name));
-	ret = send_payload(app->sock, &msg, sizeof(msg));
+	ret = send_header(app->sock, size,
+			enable ? AGENT_CMD_ENABLE : AGENT_CMD_DISABLE, 0);
 	if (ret < 0) {
 		goto error_io;
 	}
 
-	ret = recv_reply(app->sock, &reply, sizeof(reply));
+	ret = send_payload(app->sock, msg, size);
 	if (ret < 0) {
 		goto error_io;
 	}
 
-	switch (be32toh(reply.ret_code)) {
-	case AGENT_RET_CODE_SUCCESS:
-		break;
-	case AGENT_RET_CODE_UNKNOWN_NAME:
-		ret = LTTNG_ERR_UST_EVENT_NOT_FOUND;
-		goto error;
-	default:
-		ERR("Agent returned an unknown code: %" PRIu32,
-				be32toh(reply.ret_code));
-		ret = LTTNG_ERR_FATAL;
-		goto error;
-	}
-
 	return LTTNG_OK;
 
 error_io:
-	ret = LTTNG_ERR_UST_ENABLE_FAIL;
-error:
-	return ret;
+	return enable ? LTTNG_ERR_UST_ENABLE_FAIL : LTTNG_ERR_UST_DISABLE_FAIL;
 }
 
 /*
- * Internal disable agent event call on a agent application. This function
- * communicates with the agent to disable a given event.
+ * Receive the reply of an enable or disable command of an event.
  *
  * Return LTTNG_OK on success or else a LTTNG_ERR* code.
  */
-static int disable_event(struct agent_app *app, struct agent_event *event)
+static int recv_event_reply(struct agent_app *app, int enable)
 {
 	int ret;
-	uint64_t data_size;
-	struct lttcomm_agent_disable msg;
 	struct lttcomm_agent_generic_reply reply;
 
-	assert(app);
-	assert(app->sock);
-	assert(event);
+	ret = recv_reply(app->sock, &reply, sizeof(reply));
+	if (ret < 0) {
+		return enable ? LTTNG_ERR_UST_ENABLE_FAIL : LTTNG_ERR_UST_DISABLE_FAIL;
+	}
 
-	DBG2("Agent disabling event %s for app pid: %d and socket %d", event->name,
-			app->pid, app->sock->fd);
+	return agent_ret_code_to_lttng(be32toh(reply.ret_code));
+}
 
-	data_size = sizeof(msg);
+/*
+ * Build the payload of a batched enable or disable command of the given
+ * events. On success, the caller is responsible for freeing the payload.
+ *
+ * Return LTTNG_OK on success or else a LTTNG_ERR* code.
+ */
+static int build_batch(struct agent_event **events, unsigned int nb_event,
+		int enable, char **payload, size_t *size)
+{
+	unsigned int i;
+	size_t entry_size;
+	char *buf;
+	struct lttcomm_agent_batch hdr;
+
+	entry_size = enable ? sizeof(struct lttcomm_agent_enable) :
+		sizeof(struct lttcomm_agent_disable);
+	buf = zmalloc(sizeof(hdr) + nb_event * entry_size);
+	if (!buf) {
+		PERROR("zmalloc agent batch");
+		return LTTNG_ERR_NOMEM;
+	}
 
-	ret = send_header(app->sock, data_size, AGENT_CMD_DISABLE, 0);
-	if (ret < 0) {
-		goto error_io;
+	hdr.nb_event = htobe32(nb_event);
+	memcpy(buf, &hdr, sizeof(hdr));
+
+	for (i = 0; i < nb_event; i++) {
+		char *entry = buf + sizeof(hdr) + i * entry_size;
+
+		if (enable) {
+			struct lttcomm_agent_enable *msg = (void *) entry;
+
+			msg->loglevel = events[i]->loglevel;
+			msg->loglevel_type = events[i]->loglevel_type;
+			strncpy(msg->name, events[i]->name, sizeof(msg->name));
+		} else {
+			struct lttcomm_agent_disable *msg = (void *) entry;
+
+			strncpy(msg->name, events[i]->name, sizeof(msg->name));
+		}
 	}
 
-	memset(&msg, 0, sizeof(msg));
-	strncpy(msg.name, event->name, sizeof(msg.name));
-	ret = send_payload(app->sock, &msg, sizeof(msg));
+	*payload = buf;
+	*size = sizeof(hdr) + nb_event * entry_size;
+	return LTTNG_OK;
+}
+
+/*
+ * Receive the reply of a batched enable or disable command of the given
+ * events.
+ *
+ * Return LTTNG_OK if every event succeeded or else the first LTTNG_ERR* code.
+ */
+static int recv_batch_reply(struct agent_app *app, struct agent_event **events,
+		unsigned int nb_event, int enable)
+{
+	int ret, event_ret;
+	unsigned int i;
+	uint32_t *codes = NULL;
+	struct lttcomm_agent_batch_reply_hdr hdr;
+
+	ret = recv_reply(app->sock, &hdr, sizeof(hdr));
 	if (ret < 0) {
 		goto error_io;
 	}
 
-	ret = recv_reply(app->sock, &reply, sizeof(reply));
+	ret = agent_ret_code_to_lttng(be32toh(hdr.ret_code));
+	if (ret != LTTNG_OK) {
+		goto end;
+	}
+	if (be32toh(hdr.nb_event) != nb_event) {
+		ERR("Agent replied %" PRIu32 " codes to a batch of %u events",
+				be32toh(hdr.nb_event), nb_event);
+		ret = LTTNG_ERR_FATAL;
+		goto end;
+	}
+
+	codes = zmalloc(nb_event * sizeof(*codes));
+	if (!codes) {
+		PERROR("zmalloc agent batch reply");
+		ret = LTTNG_ERR_NOMEM;
+		goto end;
+	}
+	ret = recv_reply(app->sock, codes, nb_event * sizeof(*codes));
 	if (ret < 0) {
 		goto error_io;
 	}
 
-	switch (be32toh(reply.ret_code)) {
-	case AGENT_RET_CODE_SUCCESS:
-		break;
-	case AGENT_RET_CODE_UNKNOWN_NAME:
-		ret = LTTNG_ERR_UST_EVENT_NOT_FOUND;
-		goto error;
-	default:
-		ERR("Agent returned an unknown code: %" PRIu32,
-				be32toh(reply.ret_code));
-		ret = LTTNG_ERR_FATAL;
-		goto error;
+	ret = LTTNG_OK;
+	for (i = 0; i < nb_event; i++) {
+		event_ret = agent_ret_code_to_lttng(be32toh(codes[i]));
+		if (event_ret == LTTNG_OK) {
+			continue;
+		}
+		DBG2("Agent unable to %s event %s on app pid: %d sock %d",
+				enable ? "enable" : "disable", events[i]->name,
+				app->pid, app->sock->fd);
+		if (ret == LTTNG_OK) {
+			ret = event_ret;
+		}
 	}
 
-	return LTTNG_OK;
+end:
+	free(codes);
+	return ret;
 
 error_io:
-	ret = LTTNG_ERR_UST_DISABLE_FAIL;
-error:
+	ret = enable ? LTTNG_ERR_UST_ENABLE_FAIL : LTTNG_ERR_UST_DISABLE_FAIL;
+	goto end;
+}
+
+/*
+ * Enable or disable the given events on the given agent applications.
+ *
+ * Every command is sent before any reply is received so the applications
+ * process them concurrently instead of one round trip at a time. The events
+ * are sent in a single batched command to the applications supporting it. The
+ * older ones get a command per event, in a round trip each if there are many
+ * so their replies can not pile up.
+ *
+ * Return LTTNG_OK on success or else the first LTTNG_ERR* code.
+ */
+static int command_apps(struct agent_app **apps, unsigned int nr_apps,
+		struct agent_event **events, unsigned int nb_event, int enable)
+{
+	int ret, app_ret = LTTNG_OK;
+	unsigned int i, j;
+	char *pending = NULL, *payload = NULL;
+	size_t payload_size = 0;
+
+	if (!nr_apps || !nb_event) {
+		return LTTNG_OK;
+	}
+
+	/* Applications whose replies are pending, by kind of command sent. */
+	pending = zmalloc(nr_apps);
+	if (!pending) {
+		PERROR("zmalloc agent pending replies");
+		ret = LTTNG_ERR_NOMEM;
+		goto end;
+	}
+
+	if (nb_event > 1) {
+		ret = build_batch(events, nb_event, enable, &payload, &payload_size);
+		if (ret != LTTNG_OK) {
+			goto end;
+		}
+	}
+
+	for (i = 0; i < nr_apps; i++) {
+		struct agent_app *app = apps[i];
+
+		if (nb_event == 1) {
+			ret = send_event_command(app, events[0], enable);
+			pending[i] = ret == LTTNG_OK;
+		} else if (app->minor_version >= AGENT_BATCH_MINOR_VERSION) {
+			ret = send_header(app->sock, payload_size, enable ?
+					AGENT_CMD_ENABLE_BATCH : AGENT_CMD_DISABLE_BATCH, 0);
+			if (ret == 0) {
+				ret = send_payload(app->sock, payload, payload_size);
+			}
+			if (ret < 0) {
+				ret = enable ? LTTNG_ERR_UST_ENABLE_FAIL :
+					LTTNG_ERR_UST_DISABLE_FAIL;
+			} else {
+				ret = LTTNG_OK;
+				pending[i] = 2;
+			}
+		} else {
+			for (j = 0; j < nb_event; j++) {
+				ret = send_event_command(app, events[j], enable);
+				if (ret == LTTNG_OK) {
+					ret = recv_event_reply(app, enable);
+				}
+				if (ret != LTTNG_OK && app_ret == LTTNG_OK) {
+					app_ret = ret;
+				}
+			}
+			ret = LTTNG_OK;
+		}
+		if (ret != LTTNG_OK && app_ret == LTTNG_OK) {
+			app_ret = ret;
+		}
+	}
+
+	for (i = 0; i < nr_apps; i++) {
+		switch (pending[i]) {
+		case 1:
+			ret = recv_event_reply(apps[i], enable);
+			break;
+		case 2:
+			ret = recv_batch_reply(apps[i], events, nb_event, enable);
+			break;
+		default:
+			continue;
+		}
+		if (ret != LTTNG_OK && app_ret == LTTNG_OK) {
+			app_ret = ret;
+		}
+	}
+	ret = app_ret;
+
+end:
+	free(payload);
+	free(pending);
 	return ret;
 }
 
+/*
+ * Get the agent applications of the given domain. On success, the caller is
+ * responsible for freeing the array.
+ *
+ * RCU read side lock MUST be acquired.
+ *
+ * Return the number of applications or else a negative value.
+ */
+static int get_domain_apps(enum lttng_domain_type domain,
+		struct agent_app ***apps)
+{
+	unsigned int nbmem = 0, count = 0;
+	struct agent_app *app, **tmp_apps = NULL;
+	struct lttng_ht_iter iter;
+
+	cds_lfht_for_each_entry(agent_apps_ht_by_sock->ht, &iter.iter, app,
+			node.node) {
+		if (app->domain != domain) {
+			continue;
+		}
+
+		if (count == nbmem) {
+			struct agent_app **new_apps;
+
+			nbmem = nbmem ? nbmem << 1 : 16;
+			new_apps = realloc(tmp_apps, nbmem * sizeof(*new_apps));
+			if (!new_apps) {
+				PERROR("realloc agent apps");
+				free(tmp_apps);
+				return -ENOMEM;
+			}
+			tmp_apps = new_apps;
+		}
+		tmp_apps[count++] = app;
+	}
+
+	*apps = tmp_apps;
+	return count;
+}
+
+/*
+ * Get the events of the given agent, only the enabled ones if enabled_only is
+ * set. On success, the caller is responsible for freeing the array.
+ *
+ * RCU read side lock MUST be acquired.
+ *
+ * Return the number of events or else a negative value.
+ */
+static int get_agent_events(struct agent *agt, int enabled_only,
+		struct agent_event ***events)
+{
+	unsigned int nbmem = 0, count = 0;
+	struct agent_event *event, **tmp_events = NULL;
+	struct lttng_ht_iter iter;
+
+	cds_lfht_for_each_entry(agt->events->ht, &iter.iter, event, node.node) {
+		if (enabled_only && !event->enabled) {
+			continue;
+		}
+
+		if (count == nbmem) {
+			struct agent_event **new_events;
+
+			nbmem = nbmem ? nbmem << 1 : 16;
+			new_events = realloc(tmp_events, nbmem * sizeof(*new_events));
+			if (!new_events) {
+				PERROR("realloc agent events");
+				free(tmp_events);
+				return -ENOMEM;
+			}
+			tmp_events = new_events;
+		}
+		tmp_events[count++] = event;
+	}
+
+	*events = tmp_events;
+	return count;
+}
+
 /*
  * Send back the registration DONE command to a given agent application.
  *
@@ -457,24 +718,22 @@ int agent_enable_event(struct agent_event *event,
 		enum lttng_domain_type domain)
 {
 	int ret;
-	struct agent_app *app;
-	struct lttng_ht_iter iter;
+	struct agent_app **apps = NULL;
 
 	assert(event);
 
 	rcu_read_lock();
 
-	cds_lfht_for_each_entry(agent_apps_ht_by_sock->ht, &iter.iter, app,
-			node.node) {
-		if (app->domain != domain) {
-			continue;
-		}
+	ret = get_domain_apps(domain, &apps);
+	if (ret < 0) {
+		ret = LTTNG_ERR_NOMEM;
+		goto error;
+	}
 
-		/* Enable event on agent application through TCP socket. */
-		ret = enable_event(app, event);
-		if (ret != LTTNG_OK) {
-			goto error;
-		}
+	/* Enable event on agent applications through TCP socket. */
+	ret = command_apps(apps, ret, &event, 1, 1);
+	if (ret != LTTNG_OK) {
+		goto error;
 	}
 
 	event->enabled = 1;
@@ -482,6 +741,7 @@ int agent_enable_event(struct agent_event *event,
 
 error:
 	rcu_read_unlock();
+	free(apps);
 	return ret;
 }
 
@@ -495,24 +755,22 @@ int agent_disable_event(struct agent_event *event,
 		enum lttng_domain_type domain)
 {
 	int ret;
-	struct agent_app *app;
-	struct lttng_ht_iter iter;
+	struct agent_app **apps = NULL;
 
 	assert(event);
 
 	rcu_read_lock();
 
-	cds_lfht_for_each_entry(agent_apps_ht_by_sock->ht, &iter.iter, app,
-			node.node) {
-		if (app->domain != domain) {
-			continue;
-		}
+	ret = get_domain_apps(domain, &apps);
+	if (ret < 0) {
+		ret = LTTNG_ERR_NOMEM;
+		goto error;
+	}
 
-		/* Enable event on agent application through TCP socket. */
-		ret = disable_event(app, event);
-		if (ret != LTTNG_OK) {
-			goto error;
-		}
+	/* Disable event on agent applications through TCP socket. */
+	ret = command_apps(apps, ret, &event, 1, 0);
+	if (ret != LTTNG_OK) {
+		goto error;
 	}
 
 	event->enabled = 0;
@@ -520,6 +778,7 @@ int agent_disable_event(struct agent_event *event,
 
 error:
 	rcu_read_unlock();
+	free(apps);
 	return ret;
 }
 
@@ -613,7 +872,7 @@ error:
  * Return newly allocated object or else NULL on error.
  */
 struct agent_app *agent_create_app(pid_t pid, enum lttng_domain_type domain,
-		struct lttcomm_sock *sock)
+		uint32_t minor_version, struct lttcomm_sock *sock)
 {
 	struct agent_app *app;
 
@@ -627,6 +886,7 @@ struct agent_app *agent_create_app(pid_t pid, enum lttng_domain_type domain,
 
 	app->pid = pid;
 	app->domain = domain;
+	app->minor_version = minor_version;
 	app->sock = sock;
 	lttng_ht_node_init_ulong(&app->node, (unsigned long) app->sock->fd);
 
@@ -806,6 +1066,10 @@ struct agent_event *agent_create_event(const char *name,
 
 	if (filter) {
 		event->filter = filter;
+		if (filter_bytecode_cost(filter, &event->filter_cost) < 0) {
+			DBG("Unable to estimate the filter cost of agent event %s",
+					event->name);
+		}
 	}
 
 error:
@@ -923,8 +1187,11 @@ void agent_destroy_event(struct agent_event *event)
  */
 void agent_destroy(struct agent *agt)
 {
+	int nb_event, nr_apps;
 	struct lttng_ht_node_str *node;
 	struct lttng_ht_iter iter;
+	struct agent_event **events = NULL;
+	struct agent_app **apps = NULL;
 
 	assert(agt);
 
@@ -939,23 +1206,29 @@ void agent_destroy(struct agent *agt)
 	}
 
 	rcu_read_lock();
+
+	/*
+	 * When destroying the events, we have to try to disable them on the agent
+	 * side so they stop generating data, all at once. The return value is not
+	 * important since we have to continue anyway destroying the objects.
+	 */
+	nb_event = get_agent_events(agt, 0, &events);
+	nr_apps = get_domain_apps(agt->domain, &apps);
+	if (nb_event > 0 && nr_apps > 0) {
+		(void) command_apps(apps, nr_apps, events, nb_event, 0);
+	}
+	free(events);
+	free(apps);
+
 	cds_lfht_for_each_entry(agt->events->ht, &iter.iter, node, node) {
 		int ret;
-		struct agent_event *event;
-
-		/*
-		 * When destroying an event, we have to try to disable it on the agent
-		 * side so the event stops generating data. The return value is not
-		 * important since we have to continue anyway destroying the object.
-		 */
-		event = caa_container_of(node, struct agent_event, node);
-		(void) agent_disable_event(event, agt->domain);
 
 		ret = lttng_ht_del(agt->events, &iter);
 		assert(!ret);
-		call_rcu(&node->head, destroy_event_agent_rcu);
+		lttng_rcu_batch_call(&node->head, destroy_event_agent_rcu);
 	}
 	rcu_read_unlock();
+	lttng_rcu_batch_flush();
 
 	ht_cleanup_push(agt->events);
 }
@@ -974,44 +1247,50 @@ int agent_setup(void)
 }
 
 /*
- * Update a agent application (given socket) using the given agent.
+ * Update the given newly registered agent applications with the enabled events
+ * of the given agent. Applications of another domain are skipped. Each
+ * application supporting the batched commands is configured in a single round
+ * trip, all of them concurrently.
  *
  * Note that this function is most likely to be used with a tracing session
  * thus the caller should make sure to hold the appropriate lock(s).
  */
-void agent_update(struct agent *agt, int sock)
+void agent_update_apps(struct agent *agt, struct agent_app **apps,
+		unsigned int nr_apps)
 {
-	int ret;
-	struct agent_app *app;
-	struct agent_event *event;
-	struct lttng_ht_iter iter;
+	int ret, nb_event;
+	unsigned int i, nr_domain_apps = 0;
+	struct agent_event **events = NULL;
+	struct agent_app **domain_apps = NULL;
 
 	assert(agt);
-	assert(sock >= 0);
+	assert(apps);
 
-	DBG("Agent updating app socket %d", sock);
+	DBG("Agent updating %u app(s)", nr_apps);
 
-	rcu_read_lock();
-	cds_lfht_for_each_entry(agt->events->ht, &iter.iter, event, node.node) {
-		/* Skip event if disabled. */
-		if (!event->enabled) {
-			continue;
+	domain_apps = zmalloc(nr_apps * sizeof(*domain_apps));
+	if (!domain_apps) {
+		PERROR("zmalloc agent update apps");
+		goto end;
+	}
+	for (i = 0; i < nr_apps; i++) {
+		if (apps[i]->domain == agt->domain) {
+			domain_apps[nr_domain_apps++] = apps[i];
 		}
+	}
 
-		app = agent_find_app_by_sock(sock);
-		/*
-		 * We are in the registration path thus if the application is gone,
-		 * there is a serious code flow error.
-		 */
-		assert(app);
-
-		ret = enable_event(app, event);
+	rcu_read_lock();
+	nb_event = get_agent_events(agt, 1, &events);
+	if (nb_event > 0) {
+		ret = command_apps(domain_apps, nr_domain_apps, events, nb_event, 1);
 		if (ret != LTTNG_OK) {
-			DBG2("Agent update unable to enable event %s on app pid: %d sock %d",
-					event->name, app->pid, app->sock->fd);
-			/* Let's try the others here and don't assume the app is dead. */
-			continue;
+			/* Don't assume the apps are dead, the poll will tell. */
+			DBG2("Agent update unable to enable every event (%d)", ret);
 		}
 	}
 	rcu_read_unlock();
+
+end:
+	free(events);
+	free(domain_apps);
 }
@@ -24,9 +24,15 @@
 #include <common/hashtable/hashtable.h>
 #include <lttng/lttng.h>
 
-/* Agent protocol version that is verified during the agent registration. */
+/*
+ * Agent protocol version that is verified during the agent registration. Agents
+ * of an older minor version are accepted and only sent the commands they know.
+ */
 #define AGENT_MAJOR_VERSION		1
-#define AGENT_MINOR_VERSION		0
+#define AGENT_MINOR_VERSION		1
+
+/* First minor version supporting the batched enable and disable commands. */
+#define AGENT_BATCH_MINOR_VERSION	1
 
 /*
  * Hash table that contains the agent app created upon registration indexed by
@@ -65,6 +71,9 @@ struct agent_app {
 	/* Domain of the application. */
 	enum lttng_domain_type domain;
 
+	/* Protocol minor version sent during registration. */
+	uint32_t minor_version;
+
 	/*
 	 * AGENT TCP socket that was created upon registration.
 	 */
@@ -93,6 +102,8 @@ struct agent_event {
 
 	/* Bytecode filter associated with the event . NULL if none. */
 	struct lttng_filter_bytecode *filter;
+	/* Cost estimate of the filter, reported when listing the event. */
+	struct lttng_event_filter_cost filter_cost;
 };
 
 /*
@@ -140,7 +151,7 @@ void agent_destroy_event(struct agent_event *event);
 
 /* Agent app API. */
 struct agent_app *agent_create_app(pid_t pid, enum lttng_domain_type domain,
-		struct lttcomm_sock *sock);
+		uint32_t minor_version, struct lttcomm_sock *sock);
 void agent_add_app(struct agent_app *app);
 void agent_delete_app(struct agent_app *app);
 struct agent_app *agent_find_app_by_sock(int sock);
@@ -152,7 +163,8 @@ int agent_enable_event(struct agent_event *event,
 		enum lttng_domain_type domain);
 int agent_disable_event(struct agent_event *event,
 		enum lttng_domain_type domain);
-void agent_update(struct agent *agt, int sock);
+void agent_update_apps(struct agent *agt, struct agent_app **apps,
+		unsigned int nr_apps);
 int agent_list_events(struct lttng_event **events,
 		enum lttng_domain_type domain);
 
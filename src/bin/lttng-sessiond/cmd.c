@@ -243,6 +243,10 @@ static int list_lttng_agent_events(struct agent *agt,
 		tmp_events[i].enabled = event->enabled;
 		tmp_events[i].loglevel = event->loglevel;
 		tmp_events[i].loglevel_type = event->loglevel_type;
+		if (event->filter) {
+			tmp_events[i].filter = 1;
+			tmp_events[i].filter_cost = event->filter_cost;
+		}
 		i++;
 	}
 	rcu_read_unlock();
@@ -328,6 +332,7 @@ static int list_lttng_ust_global_events(char *channel_name,
 		}
 		if (uevent->filter) {
 			tmp[i].filter = 1;
+			tmp[i].filter_cost = uevent->filter_cost;
 		}
 		if (uevent->exclusion) {
 			tmp[i].exclusion = 1;
@@ -1203,6 +1208,77 @@ error:
 	return ret;
 }
 
+/*
+ * Command LTTNG_DISABLE_EVENTS processed by the client thread.
+ *
+ * For the UST domain, every registered application is updated once with the
+ * whole batch. The other domains disable the events one by one.
+ */
+int cmd_disable_events(struct ltt_session *session, int domain,
+		char *channel_name, struct event_batch_entry *entries,
+		unsigned int count)
+{
+	int ret = LTTNG_OK;
+	unsigned int i;
+
+	DBG("Disable events command for %u events", count);
+
+	if (domain != LTTNG_DOMAIN_UST) {
+		for (i = 0; i < count; i++) {
+			int event_ret;
+
+			event_ret = cmd_disable_event(session, domain, channel_name,
+					&entries[i].event);
+			if (event_ret != LTTNG_OK && ret == LTTNG_OK) {
+				ret = event_ret;
+			}
+		}
+		goto end;
+	}
+
+	/* Error out on unhandled search criteria before doing anything. */
+	for (i = 0; i < count; i++) {
+		struct lttng_event *event = &entries[i].event;
+
+		if (event->loglevel_type || event->loglevel != -1 || event->enabled
+				|| event->pid || event->filter || event->exclusion
+				|| event->type != LTTNG_EVENT_ALL) {
+			ret = LTTNG_ERR_UNK;
+			goto end;
+		}
+	}
+
+	rcu_read_lock();
+	{
+		struct ltt_ust_channel *uchan;
+		struct ltt_ust_session *usess = session->ust_session;
+
+		/*
+		 * If a non-default channel has been created in the
+		 * session, explicitely require that -c chan_name needs
+		 * to be provided.
+		 */
+		if (usess->has_non_default_channel && channel_name[0] == '\0') {
+			ret = LTTNG_ERR_NEED_CHANNEL_NAME;
+			goto error;
+		}
+
+		uchan = trace_ust_find_channel_by_name(usess->domain_global.channels,
+				channel_name);
+		if (uchan == NULL) {
+			ret = LTTNG_ERR_UST_CHAN_NOT_FOUND;
+			goto error;
+		}
+
+		ret = event_ust_disable_tracepoints(usess, uchan, entries, count);
+	}
+
+error:
+	rcu_read_unlock();
+end:
+	return ret;
+}
+
 /*
  * Command LTTNG_DISABLE_EVENT for event "*" processed by the client thread.
  */
@@ -1681,6 +1757,124 @@ error:
 	return ret;
 }
 
+/*
+ * Command LTTNG_ENABLE_EVENTS processed by the client thread.
+ *
+ * For the UST domain, the events are added to the channel and every
+ * registered application is then updated once with the whole batch. The
+ * other domains enable the events one by one. Events already enabled are
+ * skipped.
+ *
+ * We own the filter expressions, filters and exclusions of the entries.
+ */
+int cmd_enable_events(struct ltt_session *session, struct lttng_domain *domain,
+		char *channel_name, struct event_batch_entry *entries,
+		unsigned int count, int wpipe)
+{
+	int ret = LTTNG_OK;
+	unsigned int i;
+	struct lttng_channel *attr;
+
+	assert(session);
+	assert(entries);
+	assert(channel_name);
+
+	DBG("Enable events command for %u events", count);
+
+	if (domain->type != LTTNG_DOMAIN_UST) {
+		for (i = 0; i < count; i++) {
+			int event_ret;
+
+			event_ret = cmd_enable_event(session, domain, channel_name,
+					&entries[i].event, entries[i].filter_expression,
+					entries[i].filter, entries[i].exclusion, wpipe);
+			/* We have passed ownership */
+			entries[i].filter_expression = NULL;
+			entries[i].filter = NULL;
+			entries[i].exclusion = NULL;
+			switch (event_ret) {
+			case LTTNG_OK:
+			case LTTNG_ERR_KERN_EVENT_EXIST:
+			case LTTNG_ERR_UST_EVENT_ENABLED:
+				break;
+			default:
+				if (ret == LTTNG_OK) {
+					ret = event_ret;
+				}
+				break;
+			}
+		}
+		goto end;
+	}
+
+	/* An invalid event rejects the whole batch. */
+	for (i = 0; i < count; i++) {
+		ret = validate_event_name(entries[i].event.name);
+		if (ret) {
+			goto end;
+		}
+	}
+
+	rcu_read_lock();
+	{
+		struct ltt_ust_channel *uchan;
+		struct ltt_ust_session *usess = session->ust_session;
+
+		assert(usess);
+
+		/*
+		 * If a non-default channel has been created in the
+		 * session, explicitely require that -c chan_name needs
+		 * to be provided.
+		 */
+		if (usess->has_non_default_channel && channel_name[0] == '\0') {
+			ret = LTTNG_ERR_NEED_CHANNEL_NAME;
+			goto error;
+		}
+
+		/* Get channel from global UST domain */
+		uchan = trace_ust_find_channel_by_name(usess->domain_global.channels,
+				channel_name);
+		if (uchan == NULL) {
+			/* Create default channel */
+			attr = channel_new_default_attr(LTTNG_DOMAIN_UST,
+					usess->buffer_type);
+			if (attr == NULL) {
+				ret = LTTNG_ERR_FATAL;
+				goto error;
+			}
+			strncpy(attr->name, channel_name, sizeof(attr->name));
+
+			ret = cmd_enable_channel(session, domain, attr, wpipe);
+			if (ret != LTTNG_OK) {
+				free(attr);
+				goto error;
+			}
+			free(attr);
+
+			/* Get the newly created channel reference back */
+			uchan = trace_ust_find_channel_by_name(
+					usess->domain_global.channels, channel_name);
+			assert(uchan);
+		}
+
+		ret = event_ust_enable_tracepoints(usess, uchan, entries, count);
+	}
+
+error:
+	rcu_read_unlock();
+end:
+	for (i = 0; i < count; i++) {
+		free(entries[i].filter_expression);
+		free(entries[i].filter);
+		free(entries[i].exclusion);
+		entries[i].filter_expression = NULL;
+		entries[i].filter = NULL;
+		entries[i].exclusion = NULL;
+	}
+	return ret;
+}
+
 /*
  * Command LTTNG_ENABLE_EVENT for event "*" processed by the client thread.
  */
@@ -3123,10 +3317,14 @@ static unsigned int get_session_nb_streams(struct ltt_session *session)
  * The wait parameter is ignored so this call always wait for the snapshot to
  * complete before returning.
  *
+ * If incremental is set, the consumers only record the packets that were not
+ * captured by the previous snapshot of each stream.
+ *
  * Return LTTNG_OK on success or else a LTTNG_ERR code.
  */
 int cmd_snapshot_record(struct ltt_session *session,
-		struct lttng_snapshot_output *output, int wait)
+		struct lttng_snapshot_output *output, int wait,
+		unsigned int incremental)
 {
 	int ret = LTTNG_OK;
 	unsigned int use_tmp_output = 0;
@@ -3169,6 +3367,7 @@ int cmd_snapshot_record(struct ltt_session *session,
 		}
 		/* Use the global session count for the temporary snapshot. */
 		tmp_output.nb_snapshot = session->snapshot.nb_snapshot;
+		tmp_output.incremental = incremental;
 		use_tmp_output = 1;
 	}
 
@@ -3247,6 +3446,7 @@ int cmd_snapshot_record(struct ltt_session *session,
 				}
 
 				tmp_output.nb_snapshot = session->snapshot.nb_snapshot;
+				tmp_output.incremental = incremental;
 
 				ret = record_kernel_snapshot(ksess, &tmp_output,
 						session, wait, max_stream_size);
@@ -3303,6 +3503,7 @@ int cmd_snapshot_record(struct ltt_session *session,
 				}
 
 				tmp_output.nb_snapshot = session->snapshot.nb_snapshot;
+				tmp_output.incremental = incremental;
 
 				ret = record_ust_snapshot(usess, &tmp_output, session,
 						wait, max_stream_size);
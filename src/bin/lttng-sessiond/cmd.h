@@ -19,6 +19,7 @@
 #define CMD_H
 
 #include "context.h"
+#include "event.h"
 #include "session.h"
 
 /*
@@ -56,6 +57,12 @@ int cmd_enable_event(struct ltt_session *session, struct lttng_domain *domain,
 		struct lttng_filter_bytecode *filter,
 		struct lttng_event_exclusion *exclusion,
 		int wpipe);
+int cmd_enable_events(struct ltt_session *session, struct lttng_domain *domain,
+		char *channel_name, struct event_batch_entry *entries,
+		unsigned int count, int wpipe);
+int cmd_disable_events(struct ltt_session *session, int domain,
+		char *channel_name, struct event_batch_entry *entries,
+		unsigned int count);
 
 /* Trace session action commands */
 int cmd_start_trace(struct ltt_session *session);
@@ -95,6 +102,7 @@ int cmd_snapshot_add_output(struct ltt_session *session,
 int cmd_snapshot_del_output(struct ltt_session *session,
 		struct lttng_snapshot_output *output);
 int cmd_snapshot_record(struct ltt_session *session,
-		struct lttng_snapshot_output *output, int wait);
+		struct lttng_snapshot_output *output, int wait,
+		unsigned int incremental);
 
 #endif /* CMD_H */
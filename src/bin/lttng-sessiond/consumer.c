@@ -1293,6 +1293,8 @@ int consumer_snapshot_channel(struct consumer_socket *socket, uint64_t key,
 	msg.u.snapshot_channel.key = key;
 	msg.u.snapshot_channel.max_stream_size = max_stream_size;
 	msg.u.snapshot_channel.metadata = metadata;
+	msg.u.snapshot_channel.incremental = output->incremental;
+	msg.u.snapshot_channel.output_key = output->key;
 
 	if (output->consumer->type == CONSUMER_DST_NET) {
 		msg.u.snapshot_channel.relayd_id = output->consumer->net_seq_index;
@@ -572,6 +572,180 @@ error:
 	return ret;
 }
 
+/*
+ * Enable a batch of UST tracepoint events for a channel from a UST session.
+ * Every registered application is updated once with all the events.
+ *
+ * Events already enabled are skipped. The processing goes on when an event
+ * fails so the first error is returned once every event was handled.
+ *
+ * We own the filter expressions, filters and exclusions of the entries.
+ */
+int event_ust_enable_tracepoints(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan, struct event_batch_entry *entries,
+		unsigned int count)
+{
+	int ret = LTTNG_OK;
+	unsigned int i, nb_uevents = 0;
+	struct ltt_ust_event *uevent, **uevents;
+
+	assert(usess);
+	assert(uchan);
+	assert(entries);
+
+	uevents = zmalloc(count * sizeof(*uevents));
+	if (!uevents) {
+		PERROR("zmalloc UST event batch");
+		ret = LTTNG_ERR_NOMEM;
+		goto free_entries;
+	}
+
+	rcu_read_lock();
+
+	for (i = 0; i < count; i++) {
+		struct event_batch_entry *entry = &entries[i];
+
+		uevent = trace_ust_find_event(uchan->events, entry->event.name,
+				entry->filter, entry->event.loglevel, entry->exclusion);
+		if (uevent == NULL) {
+			uevent = trace_ust_create_event(&entry->event,
+					entry->filter_expression, entry->filter,
+					entry->exclusion);
+			/* We have passed ownership */
+			entry->filter_expression = NULL;
+			entry->filter = NULL;
+			entry->exclusion = NULL;
+			if (uevent == NULL) {
+				if (ret == LTTNG_OK) {
+					ret = LTTNG_ERR_UST_ENABLE_FAIL;
+				}
+				continue;
+			}
+
+			/*
+			 * Added right away so a duplicate in the batch is found as
+			 * enabled below.
+			 */
+			add_unique_ust_event(uchan->events, uevent);
+		} else if (uevent->enabled) {
+			/* It's already enabled so everything is OK */
+			continue;
+		}
+
+		uevent->enabled = 1;
+		uevents[nb_uevents++] = uevent;
+	}
+
+	/*
+	 * Unlike a single enable, the events stay in the channel if the
+	 * applications can't be updated, which only happens on ENOMEM.
+	 */
+	if (ust_app_enable_events_glb(usess, uchan, uevents, nb_uevents) < 0) {
+		ret = LTTNG_ERR_UST_ENABLE_FAIL;
+	}
+
+	DBG("Event UST batch of %u events, %u enabled in channel %s", count,
+			nb_uevents, uchan->name);
+
+	rcu_read_unlock();
+	free(uevents);
+
+free_entries:
+	for (i = 0; i < count; i++) {
+		free(entries[i].filter_expression);
+		free(entries[i].filter);
+		free(entries[i].exclusion);
+		entries[i].filter_expression = NULL;
+		entries[i].filter = NULL;
+		entries[i].exclusion = NULL;
+	}
+	return ret;
+}
+
+/*
+ * Disable a batch of UST tracepoints of a channel from a UST session, by
+ * name. Every registered application is updated once with all the events.
+ *
+ * The processing goes on when an event is not found so the first error is
+ * returned once every event was handled.
+ */
+int event_ust_disable_tracepoints(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan, struct event_batch_entry *entries,
+		unsigned int count)
+{
+	int ret = LTTNG_OK;
+	unsigned int i, nb_uevents = 0;
+	unsigned long max_uevents;
+	struct ltt_ust_event *uevent, **uevents = NULL;
+	struct lttng_ht_node_str *node;
+	struct lttng_ht_iter iter;
+	struct lttng_ht *ht;
+
+	assert(usess);
+	assert(uchan);
+	assert(entries);
+
+	ht = uchan->events;
+
+	rcu_read_lock();
+
+	max_uevents = lttng_ht_get_count(ht);
+	if (max_uevents == 0) {
+		ret = LTTNG_ERR_UST_EVENT_NOT_FOUND;
+		goto end;
+	}
+
+	uevents = zmalloc(max_uevents * sizeof(*uevents));
+	if (!uevents) {
+		PERROR("zmalloc UST event batch");
+		ret = LTTNG_ERR_NOMEM;
+		goto end;
+	}
+
+	for (i = 0; i < count; i++) {
+		char *event_name = entries[i].event.name;
+
+		cds_lfht_lookup(ht->ht, ht->hash_fct((void *) event_name,
+					lttng_ht_seed),
+				trace_ust_ht_match_event_by_name, event_name, &iter.iter);
+		node = lttng_ht_iter_get_node_str(&iter);
+		if (node == NULL) {
+			DBG2("Trace UST event NOT found by name %s", event_name);
+			if (ret == LTTNG_OK) {
+				ret = LTTNG_ERR_UST_EVENT_NOT_FOUND;
+			}
+			continue;
+		}
+
+		do {
+			uevent = caa_container_of(node, struct ltt_ust_event, node);
+
+			/* Disabled right away so a duplicate name is skipped. */
+			if (uevent->enabled && nb_uevents < max_uevents) {
+				uevent->enabled = 0;
+				uevents[nb_uevents++] = uevent;
+			}
+
+			/* Get next duplicate event by name. */
+			cds_lfht_next_duplicate(ht->ht, trace_ust_ht_match_event_by_name,
+					event_name, &iter.iter);
+			node = lttng_ht_iter_get_node_str(&iter);
+		} while (node);
+	}
+
+	if (ust_app_disable_events_glb(usess, uchan, uevents, nb_uevents) < 0) {
+		ret = LTTNG_ERR_UST_DISABLE_FAIL;
+	}
+
+	DBG("Event UST batch of %u events, %u disabled in channel %s", count,
+			nb_uevents, uchan->name);
+
+end:
+	rcu_read_unlock();
+	free(uevents);
+	return ret;
+}
+
 /*
  * Disable all UST tracepoints for a channel from a UST session.
  */
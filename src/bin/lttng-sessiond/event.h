@@ -21,6 +21,17 @@
 #include "agent.h"
 #include "trace-kernel.h"
 
+/*
+ * Event of a bulk enable or disable command. The filter expression, bytecode
+ * and exclusions are owned by the entry.
+ */
+struct event_batch_entry {
+	struct lttng_event event;
+	char *filter_expression;
+	struct lttng_filter_bytecode *filter;
+	struct lttng_event_exclusion *exclusion;
+};
+
 int event_kernel_disable_tracepoint(struct ltt_kernel_channel *kchan,
 		char *event_name);
 int event_kernel_disable_syscall(struct ltt_kernel_channel *kchan,
@@ -44,6 +55,12 @@ int event_ust_enable_tracepoint(struct ltt_ust_session *usess,
 		struct lttng_event_exclusion *exclusion);
 int event_ust_disable_tracepoint(struct ltt_ust_session *usess,
 		struct ltt_ust_channel *uchan, char *event_name);
+int event_ust_enable_tracepoints(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan, struct event_batch_entry *entries,
+		unsigned int count);
+int event_ust_disable_tracepoints(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan, struct event_batch_entry *entries,
+		unsigned int count);
 
 int event_ust_enable_all_tracepoints(struct ltt_ust_session *usess,
 		struct ltt_ust_channel *uchan,
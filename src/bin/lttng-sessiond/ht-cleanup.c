@@ -21,6 +21,7 @@
 
 #include <common/hashtable/hashtable.h>
 #include <common/common.h>
+#include <common/defaults.h>
 #include <common/utils.h>
 
 #include "lttng-sessiond.h"
@@ -86,7 +87,8 @@ restart:
 		nb_fd = ret;
 
 		for (i = 0; i < nb_fd; i++) {
-			struct lttng_ht *ht;
+			struct lttng_ht *hts[DEFAULT_HT_CLEANUP_BATCH_SIZE];
+			unsigned int j, nr_hts;
 
 			health_code_update();
 
@@ -112,23 +114,44 @@ restart:
 				goto error;
 			}
 
-			/* Get socket from dispatch thread. */
-			size_ret = lttng_read(ht_cleanup_pipe[0], &ht,
-					sizeof(ht));
-			if (size_ret < sizeof(ht)) {
+			/*
+			 * Get every pending hash table, up to a batch, in a single
+			 * read since a bulk teardown pushes many of them at once.
+			 */
+			do {
+				size_ret = read(ht_cleanup_pipe[0], hts, sizeof(hts));
+			} while (size_ret < 0 && errno == EINTR);
+			if (size_ret <= 0) {
 				PERROR("ht cleanup notify pipe");
 				goto error;
 			}
+			if (size_ret % sizeof(hts[0])) {
+				/* Pointer writes are atomic but complete a partial read. */
+				size_t missing = sizeof(hts[0]) - (size_ret % sizeof(hts[0]));
+				ssize_t read_ret;
+
+				read_ret = lttng_read(ht_cleanup_pipe[0],
+						(char *) hts + size_ret, missing);
+				if (read_ret < missing) {
+					PERROR("ht cleanup notify pipe");
+					goto error;
+				}
+				size_ret += read_ret;
+			}
+			nr_hts = size_ret / sizeof(hts[0]);
 			health_code_update();
-			/*
-			 * The whole point of this thread is to call
-			 * lttng_ht_destroy from a context that is NOT:
-			 * 1) a read-side RCU lock,
-			 * 2) a call_rcu thread.
-			 */
-			lttng_ht_destroy(ht);
 
-			health_code_update();
+			for (j = 0; j < nr_hts; j++) {
+				/*
+				 * The whole point of this thread is to call
+				 * lttng_ht_destroy from a context that is NOT:
+				 * 1) a read-side RCU lock,
+				 * 2) a call_rcu thread.
+				 */
+				lttng_ht_destroy(hts[j]);
+
+				health_code_update();
+			}
 		}
 
 		for (i = 0; i < nb_fd; i++) {
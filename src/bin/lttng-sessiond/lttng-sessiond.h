@@ -19,6 +19,7 @@
 #ifndef _LTT_SESSIOND_H
 #define _LTT_SESSIOND_H
 
+#include <pthread.h>
 #include <urcu.h>
 #include <urcu/wfcqueue.h>
 
@@ -78,13 +79,52 @@ struct ust_reg_wait_queue {
 
 /*
  * Use by the dispatch registration to queue UST command socket to wait for the
- * notify socket.
+ * notify socket. Once paired, the node is moved to the registration work queue.
  */
 struct ust_reg_wait_node {
 	struct ust_app *app;
 	struct cds_list_head head;
 };
 
+/*
+ * Queue of applications paired with their notify socket, waiting to be set up
+ * by one of the registration worker threads. Filled by the dispatch thread.
+ */
+struct ust_reg_work_queue {
+	/* List of ust_reg_wait_node. */
+	struct cds_list_head head;
+	/* Set when the workers must exit. */
+	int exit;
+	/* Protects the whole structure. */
+	pthread_mutex_t lock;
+	/* Signaled when a node is queued or the workers must exit. */
+	pthread_cond_t cond;
+};
+
+/*
+ * Client connection accepted by the client thread, waiting for a command
+ * worker to receive and process its command.
+ */
+struct client_cmd_node {
+	int sock;
+	struct cds_list_head head;
+};
+
+/*
+ * Queue of accepted client connections. Filled by the client thread which
+ * owns the command workers.
+ */
+struct client_cmd_queue {
+	/* List of client_cmd_node. */
+	struct cds_list_head head;
+	/* Set when the workers must exit. */
+	int exit;
+	/* Protects the whole structure. */
+	pthread_mutex_t lock;
+	/* Signaled when a node is queued or the workers must exit. */
+	pthread_cond_t cond;
+};
+
 /*
  * This pipe is used to inform the thread managing application notify
  * communication that a command is queued and ready to be processed.
@@ -23,6 +23,7 @@
 #include <grp.h>
 #include <limits.h>
 #include <paths.h>
+#include <poll.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
@@ -197,6 +198,13 @@ static int ht_cleanup_quit_pipe[2] = { -1, -1 };
  */
 static int apps_cmd_pipe[2] = { -1, -1 };
 
+/*
+ * Pipe used by the command workers to give the client connections back to the
+ * client thread once their command is answered. Clients can thus keep their
+ * connection open and send several commands over it.
+ */
+static int client_sock_pipe[2] = { -1, -1 };
+
 int apps_cmd_notify_pipe[2] = { -1, -1 };
 
 /* Pthread, Mutexes and Semaphores */
@@ -222,6 +230,33 @@ static pthread_t load_session_thread;
  */
 static struct ust_cmd_queue ust_cmd_queue;
 
+/*
+ * Applications paired with their notify socket by the dispatch thread, waiting
+ * to be set up by a registration worker. The dispatch thread owns the workers.
+ */
+static struct ust_reg_work_queue ust_reg_work_queue = {
+	.head = CDS_LIST_HEAD_INIT(ust_reg_work_queue.head),
+	.exit = 0,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/*
+ * Client connections waiting for a command worker.
+ */
+static struct client_cmd_queue client_cmd_queue = {
+	.head = CDS_LIST_HEAD_INIT(client_cmd_queue.head),
+	.exit = 0,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/*
+ * Serializes the client commands that are not safe to run concurrently, see
+ * client_cmd_is_concurrent().
+ */
+static pthread_mutex_t client_cmd_serial_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*
  * Pointer initialized before thread creation.
  *
@@ -287,6 +322,12 @@ static enum consumerd_state kernel_consumerd_state;
  */
 static int app_socket_timeout;
 
+/* Number of application registration workers. */
+static int app_reg_workers;
+
+/* Number of client command workers. */
+static int client_cmd_workers;
+
 /* Set in main() with the current page size. */
 long page_size;
 
@@ -666,7 +707,7 @@ static void sessiond_cleanup(void)
 
 	/* Destroy session list mutex */
 	if (session_list_ptr != NULL) {
-		pthread_mutex_destroy(&session_list_ptr->lock);
+		pthread_rwlock_destroy(&session_list_ptr->lock);
 
 		/* Cleanup ALL session */
 		cds_list_for_each_entry_safe(sess, stmp,
@@ -679,6 +720,9 @@ static void sessiond_cleanup(void)
 	ust_app_clean_list();
 	buffer_reg_destroy_registries();
 
+	DBG("Stopping run as workers");
+	run_as_destroy_workers();
+
 	if (is_root && !opt_no_kernel) {
 		DBG2("Closing kernel fd");
 		if (kernel_tracer_fd >= 0) {
@@ -979,7 +1023,11 @@ error:
 
 /*
  * For each tracing session, update newly registered apps. The session list
- * lock MUST be acquired before calling this.
+ * lock MUST be acquired before calling this, shared mode being enough.
+ *
+ * Each session is only locked in shared mode so registration workers can
+ * update their application concurrently. Commands modifying a session take
+ * it exclusively and are thus never interleaved with an update.
  */
 static void update_ust_app(int app_sock)
 {
@@ -993,7 +1041,7 @@ static void update_ust_app(int app_sock)
 
 	/* For all tracing session(s) */
 	cds_list_for_each_entry_safe(sess, stmp, &session_list_ptr->head, list) {
-		session_lock(sess);
+		session_lock_shared(sess);
 		if (sess->ust_session) {
 			ust_app_global_update(sess->ust_session, app_sock);
 		}
@@ -1773,13 +1821,177 @@ error_create:
 	return;
 }
 
+/*
+ * Set up an application paired with its notify socket. It is added to the
+ * global hash table, updated with every tracing session and its sockets are
+ * handed to the application management threads.
+ *
+ * Return 0 on success or else a negative value meaning that one of the
+ * application management threads is gone.
+ */
+static int setup_ust_app(struct ust_app *app)
+{
+	int ret;
+
+	/*
+	 * @session_lock_list
+	 *
+	 * Lock the global session list so from the register up to the
+	 * registration done message, no command can see the application and
+	 * change its state. The lock is shared with the other registration
+	 * workers which are setting up their own application.
+	 */
+	session_lock_list_shared();
+	rcu_read_lock();
+
+	/*
+	 * Add application to the global hash table. This needs to be done before
+	 * the update to the UST registry can locate the application.
+	 */
+	ust_app_add(app);
+
+	/* Set app version. This call will print an error if needed. */
+	(void) ust_app_version(app);
+
+	/* Send notify socket through the notify pipe. */
+	ret = send_socket_to_thread(apps_cmd_notify_pipe[1], app->notify_sock);
+	if (ret < 0) {
+		goto end;
+	}
+
+	/*
+	 * Update newly registered application with the tracing registry info
+	 * already enabled information.
+	 */
+	update_ust_app(app->sock);
+
+	/*
+	 * Don't care about return value. Let the manage apps threads handle app
+	 * unregistration upon socket close.
+	 */
+	(void) ust_app_register_done(app->sock);
+
+	/*
+	 * Even if the application socket has been closed, send the app to the
+	 * thread and unregistration will take place at that place.
+	 */
+	ret = send_socket_to_thread(apps_cmd_pipe[1], app->sock);
+
+end:
+	rcu_read_unlock();
+	session_unlock_list();
+	return ret;
+}
+
+/*
+ * Queue a paired application for a registration worker.
+ */
+static void queue_ust_app_setup(struct ust_reg_wait_node *wait_node)
+{
+	pthread_mutex_lock(&ust_reg_work_queue.lock);
+	cds_list_add_tail(&wait_node->head, &ust_reg_work_queue.head);
+	pthread_cond_signal(&ust_reg_work_queue.cond);
+	pthread_mutex_unlock(&ust_reg_work_queue.lock);
+}
+
+/*
+ * Registration worker. Sets up the applications queued by the dispatch
+ * thread, concurrently with the other workers.
+ */
+static void *thread_ust_reg_worker(void *data)
+{
+	int ret;
+	struct ust_reg_wait_node *wait_node;
+
+	DBG("[thread] UST registration worker started");
+
+	rcu_register_thread();
+
+	health_register(health_sessiond, HEALTH_SESSIOND_TYPE_APP_REG_DISPATCH);
+
+	health_code_update();
+
+	for (;;) {
+		pthread_mutex_lock(&ust_reg_work_queue.lock);
+		while (cds_list_empty(&ust_reg_work_queue.head) &&
+				!ust_reg_work_queue.exit) {
+			health_poll_entry();
+			pthread_cond_wait(&ust_reg_work_queue.cond,
+					&ust_reg_work_queue.lock);
+			health_poll_exit();
+		}
+		if (ust_reg_work_queue.exit) {
+			pthread_mutex_unlock(&ust_reg_work_queue.lock);
+			break;
+		}
+		wait_node = cds_list_entry(ust_reg_work_queue.head.next,
+				struct ust_reg_wait_node, head);
+		cds_list_del(&wait_node->head);
+		pthread_mutex_unlock(&ust_reg_work_queue.lock);
+
+		health_code_update();
+
+		ret = setup_ust_app(wait_node->app);
+		free(wait_node);
+		if (ret < 0) {
+			/*
+			 * No apps. or notify thread, stop the UST tracing. However,
+			 * this is not an internal error of this thread thus the
+			 * dispatch thread is asked to exit normally.
+			 */
+			CMM_STORE_SHARED(dispatch_thread_exit, 1);
+			futex_nto1_wake(&ust_cmd_queue.futex);
+			break;
+		}
+	}
+
+	DBG("UST registration worker dying");
+	health_unregister(health_sessiond);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/*
+ * Ask the registration workers to exit and wait for them. Applications still
+ * queued are dropped.
+ */
+static void stop_ust_reg_workers(pthread_t *workers, int nb_workers)
+{
+	int i, ret;
+	struct ust_reg_wait_node *wait_node, *tmp_wait_node;
+
+	pthread_mutex_lock(&ust_reg_work_queue.lock);
+	ust_reg_work_queue.exit = 1;
+	pthread_cond_broadcast(&ust_reg_work_queue.cond);
+	pthread_mutex_unlock(&ust_reg_work_queue.lock);
+
+	for (i = 0; i < nb_workers; i++) {
+		ret = pthread_join(workers[i], NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join registration worker");
+		}
+	}
+
+	cds_list_for_each_entry_safe(wait_node, tmp_wait_node,
+			&ust_reg_work_queue.head, head) {
+		cds_list_del(&wait_node->head);
+		free(wait_node);
+	}
+}
+
 /*
  * Dispatch request from the registration threads to the application
  * communication thread.
+ *
+ * Applications are paired with their notify socket here and then set up by a
+ * pool of registration workers so a burst of registrations is not serialized
+ * on the round trips each setup does with its application.
  */
 static void *thread_dispatch_ust_registration(void *data)
 {
-	int ret, err = -1;
+	int ret, err = -1, i, nb_workers = 0;
+	pthread_t *workers = NULL;
 	struct cds_wfcq_node *node;
 	struct ust_command *ust_cmd = NULL;
 	struct ust_reg_wait_node *wait_node = NULL, *tmp_wait_node;
@@ -1797,6 +2009,23 @@ static void *thread_dispatch_ust_registration(void *data)
 
 	CDS_INIT_LIST_HEAD(&wait_queue.head);
 
+	workers = zmalloc(sizeof(*workers) * app_reg_workers);
+	if (!workers) {
+		PERROR("zmalloc registration workers");
+		goto error;
+	}
+	for (i = 0; i < app_reg_workers; i++) {
+		ret = pthread_create(&workers[i], NULL, thread_ust_reg_worker,
+				(void *) NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create registration worker");
+			goto error;
+		}
+		nb_workers++;
+	}
+	DBG("Dispatching UST registrations to %d workers", nb_workers);
+
 	DBG("[thread] Dispatch UST command started");
 
 	while (!CMM_LOAD_SHARED(dispatch_thread_exit)) {
@@ -1888,8 +2117,9 @@ static void *thread_dispatch_ust_registration(void *data)
 						cds_list_del(&wait_node->head);
 						wait_queue.count--;
 						app = wait_node->app;
-						free(wait_node);
 						DBG3("UST app notify socket %d is set", ust_cmd->sock);
+						/* Hand the application to a worker. */
+						queue_ust_app_setup(wait_node);
 						break;
 					}
 				}
@@ -1908,76 +2138,6 @@ static void *thread_dispatch_ust_registration(void *data)
 				}
 				free(ust_cmd);
 			}
-
-			if (app) {
-				/*
-				 * @session_lock_list
-				 *
-				 * Lock the global session list so from the register up to the
-				 * registration done message, no thread can see the application
-				 * and change its state.
-				 */
-				session_lock_list();
-				rcu_read_lock();
-
-				/*
-				 * Add application to the global hash table. This needs to be
-				 * done before the update to the UST registry can locate the
-				 * application.
-				 */
-				ust_app_add(app);
-
-				/* Set app version. This call will print an error if needed. */
-				(void) ust_app_version(app);
-
-				/* Send notify socket through the notify pipe. */
-				ret = send_socket_to_thread(apps_cmd_notify_pipe[1],
-						app->notify_sock);
-				if (ret < 0) {
-					rcu_read_unlock();
-					session_unlock_list();
-					/*
-					 * No notify thread, stop the UST tracing. However, this is
-					 * not an internal error of the this thread thus setting
-					 * the health error code to a normal exit.
-					 */
-					err = 0;
-					goto error;
-				}
-
-				/*
-				 * Update newly registered application with the tracing
-				 * registry info already enabled information.
-				 */
-				update_ust_app(app->sock);
-
-				/*
-				 * Don't care about return value. Let the manage apps threads
-				 * handle app unregistration upon socket close.
-				 */
-				(void) ust_app_register_done(app->sock);
-
-				/*
-				 * Even if the application socket has been closed, send the app
-				 * to the thread and unregistration will take place at that
-				 * place.
-				 */
-				ret = send_socket_to_thread(apps_cmd_pipe[1], app->sock);
-				if (ret < 0) {
-					rcu_read_unlock();
-					session_unlock_list();
-					/*
-					 * No apps. thread, stop the UST tracing. However, this is
-					 * not an internal error of the this thread thus setting
-					 * the health error code to a normal exit.
-					 */
-					err = 0;
-					goto error;
-				}
-
-				rcu_read_unlock();
-				session_unlock_list();
-			}
 		} while (node != NULL);
 
 		health_poll_entry();
@@ -1989,6 +2149,11 @@ static void *thread_dispatch_ust_registration(void *data)
 	err = 0;
 
 error:
+	if (workers) {
+		stop_ust_reg_workers(workers, nb_workers);
+		free(workers);
+	}
+
 	/* Clean up wait queue. */
 	cds_list_for_each_entry_safe(wait_node, tmp_wait_node,
 			&wait_queue.head, head) {
@@ -2852,6 +3017,205 @@ static unsigned int lttng_sessions_count(uid_t uid, gid_t gid)
 	return i;
 }
 
+/*
+ * Free the entries of an event batch along with their filters and exclusions.
+ */
+static void free_event_batch(struct event_batch_entry *entries,
+		unsigned int count)
+{
+	unsigned int i;
+
+	if (!entries) {
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		free(entries[i].filter_expression);
+		free(entries[i].filter);
+		free(entries[i].exclusion);
+	}
+	free(entries);
+}
+
+/*
+ * Receive and validate the payload of a LTTNG_ENABLE_EVENTS or
+ * LTTNG_DISABLE_EVENTS command. On success, the entries are returned in
+ * entriesp and must be freed with free_event_batch().
+ *
+ * Return LTTNG_OK on success or else a LTTng error code.
+ */
+static int recv_event_batch(struct lttcomm_session_msg *lsm, int sock,
+		int *sock_error, struct event_batch_entry **entriesp)
+{
+	int ret;
+	ssize_t len;
+	size_t offset = 0;
+	unsigned int i, count = lsm->u.events.count;
+	size_t payload_len = lsm->u.events.payload_len;
+	char *payload = NULL;
+	struct event_batch_entry *entries = NULL;
+
+	if (count == 0 || payload_len > LTTNG_EVENT_BATCH_MAX_LEN ||
+			payload_len / sizeof(struct lttcomm_event_batch_entry) < count) {
+		/* The payload is left unread, the client can't be trusted anymore. */
+		*sock_error = 1;
+		ret = LTTNG_ERR_INVALID;
+		goto error;
+	}
+
+	payload = zmalloc(payload_len);
+	entries = zmalloc(count * sizeof(*entries));
+	if (!payload || !entries) {
+		ret = LTTNG_ERR_NOMEM;
+		goto error;
+	}
+
+	DBG("Receiving var len event batch of %u events from client ...", count);
+	len = lttcomm_recv_unix_sock(sock, payload, payload_len);
+	if (len <= 0) {
+		DBG("Nothing recv() from client var len data... continuing");
+		*sock_error = 1;
+		ret = LTTNG_ERR_INVALID;
+		goto error;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct lttcomm_event_batch_entry hdr;
+		struct event_batch_entry *entry = &entries[i];
+		size_t remaining;
+
+		if (payload_len - offset < sizeof(hdr)) {
+			ret = LTTNG_ERR_INVALID;
+			goto error;
+		}
+		memcpy(&hdr, payload + offset, sizeof(hdr));
+		offset += sizeof(hdr);
+		remaining = payload_len - offset;
+
+		/* FIXME: copying packed struct to non-packed struct. */
+		memcpy(&entry->event, &hdr.event, sizeof(entry->event));
+		entry->event.name[sizeof(entry->event.name) - 1] = '\0';
+
+		if (lsm->cmd_type == LTTNG_DISABLE_EVENTS &&
+				(hdr.exclusion_count || hdr.expression_len ||
+					hdr.bytecode_len)) {
+			ret = LTTNG_ERR_INVALID;
+			goto error;
+		}
+
+		if (hdr.exclusion_count > remaining / LTTNG_SYMBOL_NAME_LEN ||
+				hdr.expression_len > LTTNG_FILTER_MAX_LEN ||
+				hdr.bytecode_len > LTTNG_FILTER_MAX_LEN ||
+				(size_t) hdr.exclusion_count * LTTNG_SYMBOL_NAME_LEN +
+					hdr.expression_len + hdr.bytecode_len > remaining) {
+			ret = LTTNG_ERR_INVALID;
+			goto error;
+		}
+
+		if (hdr.exclusion_count > 0) {
+			size_t names_len = hdr.exclusion_count * LTTNG_SYMBOL_NAME_LEN;
+
+			entry->exclusion = zmalloc(sizeof(struct lttng_event_exclusion) +
+					names_len);
+			if (!entry->exclusion) {
+				ret = LTTNG_ERR_EXCLUSION_NOMEM;
+				goto error;
+			}
+			entry->exclusion->count = hdr.exclusion_count;
+			memcpy(entry->exclusion->names, payload + offset, names_len);
+			offset += names_len;
+		}
+
+		if (hdr.expression_len > 0) {
+			entry->filter_expression = zmalloc(hdr.expression_len);
+			if (!entry->filter_expression) {
+				ret = LTTNG_ERR_FILTER_NOMEM;
+				goto error;
+			}
+			memcpy(entry->filter_expression, payload + offset,
+					hdr.expression_len);
+			entry->filter_expression[hdr.expression_len - 1] = '\0';
+			offset += hdr.expression_len;
+		}
+
+		if (hdr.bytecode_len > 0) {
+			if (hdr.bytecode_len < sizeof(struct lttng_filter_bytecode)) {
+				ret = LTTNG_ERR_FILTER_INVAL;
+				goto error;
+			}
+			entry->filter = zmalloc(hdr.bytecode_len);
+			if (!entry->filter) {
+				ret = LTTNG_ERR_FILTER_NOMEM;
+				goto error;
+			}
+			memcpy(entry->filter, payload + offset, hdr.bytecode_len);
+			if (entry->filter->len + sizeof(*entry->filter) !=
+					hdr.bytecode_len) {
+				ret = LTTNG_ERR_FILTER_INVAL;
+				goto error;
+			}
+			offset += hdr.bytecode_len;
+		}
+	}
+
+	if (offset != payload_len) {
+		ret = LTTNG_ERR_INVALID;
+		goto error;
+	}
+
+	free(payload);
+	*entriesp = entries;
+	return LTTNG_OK;
+
+error:
+	free(payload);
+	free_event_batch(entries, count);
+	return ret;
+}
+
+/*
+ * Return 1 if the client command only reads the sessions. Such commands never
+ * create a domain session nor spawn a consumer and lock the sessions in
+ * shared mode.
+ */
+static int client_cmd_is_read_only(uint32_t cmd_type)
+{
+	switch (cmd_type) {
+	case LTTNG_LIST_SESSIONS:
+	case LTTNG_LIST_DOMAINS:
+	case LTTNG_LIST_CHANNELS:
+	case LTTNG_LIST_EVENTS:
+	case LTTNG_SNAPSHOT_LIST_OUTPUT:
+	case LTTNG_DATA_PENDING:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Return 1 if the client command can run concurrently with the other
+ * concurrent commands. On top of the read-only commands, this is the case of
+ * the commands only talking to the consumers: they take their session
+ * exclusively but the session list in shared mode.
+ *
+ * Every other command is serialized and takes the session list exclusively
+ * so it never runs along a concurrent command of the same session.
+ */
+static int client_cmd_is_concurrent(uint32_t cmd_type)
+{
+	if (client_cmd_is_read_only(cmd_type)) {
+		return 1;
+	}
+
+	switch (cmd_type) {
+	case LTTNG_SNAPSHOT_RECORD:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
 /*
  * Process the command requested by the lttng client within the command
  * context structure. This function make sure that the return structure (llm)
@@ -2869,9 +3233,13 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 	int ret = LTTNG_OK;
 	int need_tracing_session = 1;
 	int need_domain;
+	int read_only, concurrent;
 
 	DBG("Processing client command %d", cmd_ctx->lsm->cmd_type);
 
+	read_only = client_cmd_is_read_only(cmd_ctx->lsm->cmd_type);
+	concurrent = client_cmd_is_concurrent(cmd_ctx->lsm->cmd_type);
+
 	*sock_error = 0;
 
 	switch (cmd_ctx->lsm->cmd_type) {
@@ -2905,6 +3273,14 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 		goto error;
 	}
 
+	/*
+	 * Listing a domain does not need its domain session nor its consumer,
+	 * skip the domain setup which would modify the session.
+	 */
+	if (read_only) {
+		need_domain = 0;
+	}
+
 	/* Deny register consumer if we already have a spawned consumer. */
 	if (cmd_ctx->lsm->cmd_type == LTTNG_REGISTER_CONSUMER) {
 		pthread_mutex_lock(&kconsumer_data.pid_mutex);
@@ -2957,16 +3333,25 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 		/*
 		 * We keep the session list lock across _all_ commands
 		 * for now, because the per-session lock does not
-		 * handle teardown properly.
+		 * handle teardown properly. Concurrent commands hold it
+		 * in shared mode, which still prevents the teardown.
 		 */
-		session_lock_list();
+		if (concurrent) {
+			session_lock_list_shared();
+		} else {
+			session_lock_list();
+		}
 		cmd_ctx->session = session_find_by_name(cmd_ctx->lsm->session.name);
 		if (cmd_ctx->session == NULL) {
 			ret = LTTNG_ERR_SESS_NOT_FOUND;
 			goto error;
 		} else {
 			/* Acquire lock for the session */
-			session_lock(cmd_ctx->session);
+			if (read_only) {
+				session_lock_shared(cmd_ctx->session);
+			} else {
+				session_lock(cmd_ctx->session);
+			}
 		}
 		break;
 	}
@@ -2980,6 +3365,7 @@ static int process_client_msg(struct command_ctx *cmd_ctx, int sock,
 	switch (cmd_ctx->lsm->cmd_type) {
 	case LTTNG_DISABLE_CHANNEL:
 	case LTTNG_DISABLE_EVENT:
+	case LTTNG_DISABLE_EVENTS:
 		switch (cmd_ctx->lsm->domain.type) {
 		case LTTNG_DOMAIN_KERNEL:
 			if (!cmd_ctx->session->kernel_session) {
@@ -3351,6 +3737,36 @@ skip_domain:
 				kernel_poll_pipe[1]);
 		break;
 	}
+	case LTTNG_ENABLE_EVENTS:
+	{
+		struct event_batch_entry *entries;
+
+		ret = recv_event_batch(cmd_ctx->lsm, sock, sock_error, &entries);
+		if (ret != LTTNG_OK) {
+			goto error;
+		}
+
+		ret = cmd_enable_events(cmd_ctx->session, &cmd_ctx->lsm->domain,
+				cmd_ctx->lsm->u.events.channel_name, entries,
+				cmd_ctx->lsm->u.events.count, kernel_poll_pipe[1]);
+		free_event_batch(entries, cmd_ctx->lsm->u.events.count);
+		break;
+	}
+	case LTTNG_DISABLE_EVENTS:
+	{
+		struct event_batch_entry *entries;
+
+		ret = recv_event_batch(cmd_ctx->lsm, sock, sock_error, &entries);
+		if (ret != LTTNG_OK) {
+			goto error;
+		}
+
+		ret = cmd_disable_events(cmd_ctx->session, cmd_ctx->lsm->domain.type,
+				cmd_ctx->lsm->u.events.channel_name, entries,
+				cmd_ctx->lsm->u.events.count);
+		free_event_batch(entries, cmd_ctx->lsm->u.events.count);
+		break;
+	}
 	case LTTNG_LIST_TRACEPOINTS:
 	{
 		struct lttng_event *events;
@@ -3635,7 +4051,7 @@ skip_domain:
 	{
 		unsigned int nr_sessions;
 
-		session_lock_list();
+		session_lock_list_shared();
 		nr_sessions = lttng_sessions_count(
 				LTTNG_SOCK_GET_UID_CRED(&cmd_ctx->creds),
 				LTTNG_SOCK_GET_GID_CRED(&cmd_ctx->creds));
@@ -3742,7 +4158,9 @@ skip_domain:
 	{
 		ret = cmd_snapshot_record(cmd_ctx->session,
 				&cmd_ctx->lsm->u.snapshot_record.output,
-				cmd_ctx->lsm->u.snapshot_record.wait);
+				cmd_ctx->lsm->u.snapshot_record.wait,
+				!!(cmd_ctx->lsm->u.snapshot_record.wait &
+					LTTNG_SNAPSHOT_RECORD_INCREMENTAL));
 		break;
 	}
 	case LTTNG_CREATE_SESSION_SNAPSHOT:
@@ -4044,16 +4462,261 @@ error:
 	return NULL;
 }
 
+/*
+ * Receive, process and reply to the command of a client connection, then
+ * close it.
+ */
+static void handle_client_cmd(int sock)
+{
+	int ret, sock_error, serial;
+	struct command_ctx *cmd_ctx = NULL;
+
+	/* Allocate context command to process the client request */
+	cmd_ctx = zmalloc(sizeof(struct command_ctx));
+	if (cmd_ctx == NULL) {
+		PERROR("zmalloc cmd_ctx");
+		goto end;
+	}
+
+	/* Allocate data buffer for reception */
+	cmd_ctx->lsm = zmalloc(sizeof(struct lttcomm_session_msg));
+	if (cmd_ctx->lsm == NULL) {
+		PERROR("zmalloc cmd_ctx->lsm");
+		goto end;
+	}
+
+	cmd_ctx->llm = NULL;
+	cmd_ctx->session = NULL;
+
+	health_code_update();
+
+	/*
+	 * Data is received from the lttng client. The struct
+	 * lttcomm_session_msg (lsm) contains the command and data request of
+	 * the client.
+	 */
+	DBG("Receiving data from client ...");
+	ret = lttcomm_recv_creds_unix_sock(sock, cmd_ctx->lsm,
+			sizeof(struct lttcomm_session_msg), &cmd_ctx->creds);
+	if (ret <= 0) {
+		DBG("Nothing recv() from client... continuing");
+		goto end;
+	}
+
+	health_code_update();
+
+	// TODO: Validate cmd_ctx including sanity check for
+	// security purpose.
+
+	serial = !client_cmd_is_concurrent(cmd_ctx->lsm->cmd_type);
+	if (serial) {
+		pthread_mutex_lock(&client_cmd_serial_lock);
+	}
+	rcu_thread_online();
+	/*
+	 * This function dispatch the work to the kernel or userspace tracer
+	 * libs and fill the lttcomm_lttng_msg data structure of all the needed
+	 * informations for the client. The command context struct contains
+	 * everything this function may needs.
+	 */
+	ret = process_client_msg(cmd_ctx, sock, &sock_error);
+	rcu_thread_offline();
+	if (serial) {
+		pthread_mutex_unlock(&client_cmd_serial_lock);
+	}
+	if (ret < 0) {
+		/*
+		 * TODO: Inform client somehow of the fatal error. At
+		 * this point, ret < 0 means that a zmalloc failed
+		 * (ENOMEM). Error detected but still accept
+		 * command, unless a socket error has been
+		 * detected.
+		 */
+		goto end;
+	}
+
+	health_code_update();
+
+	DBG("Sending response (size: %d, retcode: %s)",
+			cmd_ctx->lttng_msg_size,
+			lttng_strerror(-cmd_ctx->llm->ret_code));
+	ret = send_unix_sock(sock, cmd_ctx->llm, cmd_ctx->lttng_msg_size);
+	if (ret < 0) {
+		ERR("Failed to send data back to client");
+		goto end;
+	}
+
+	/*
+	 * A failed command may have left variable-length data unread on the
+	 * socket. Close the connection so the client starts over on a clean one.
+	 */
+	if (sock_error || cmd_ctx->llm->ret_code != LTTNG_OK) {
+		goto end;
+	}
+
+	/*
+	 * Wait for the next command of this client from the client thread. A
+	 * client closing its connection after each command is detected there.
+	 */
+	ret = send_socket_to_thread(client_sock_pipe[1], sock);
+	if (ret < 0) {
+		goto end;
+	}
+	sock = -1;
+
+end:
+	if (sock >= 0) {
+		/* End of transmission */
+		ret = close(sock);
+		if (ret) {
+			PERROR("close");
+		}
+	}
+	clean_command_ctx(&cmd_ctx);
+}
+
+/*
+ * Check if a client already sent its next command, or closed its end, on a
+ * connection given back by a command worker.
+ *
+ * Return 1 if so, else 0.
+ */
+static int client_sock_pending(int sock)
+{
+	int ret;
+	struct pollfd pfd;
+
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	do {
+		ret = poll(&pfd, 1, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret != 0;
+}
+
+/*
+ * Queue an accepted client connection for a command worker.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static int queue_client_cmd(int sock)
+{
+	struct client_cmd_node *node;
+
+	node = zmalloc(sizeof(*node));
+	if (!node) {
+		PERROR("zmalloc client command node");
+		return -ENOMEM;
+	}
+	node->sock = sock;
+
+	pthread_mutex_lock(&client_cmd_queue.lock);
+	cds_list_add_tail(&node->head, &client_cmd_queue.head);
+	pthread_cond_signal(&client_cmd_queue.cond);
+	pthread_mutex_unlock(&client_cmd_queue.lock);
+
+	return 0;
+}
+
+/*
+ * Command worker. Processes the client connections accepted by the client
+ * thread, concurrently with the other workers so a long command does not
+ * block the others.
+ */
+static void *thread_client_cmd_worker(void *data)
+{
+	struct client_cmd_node *node;
+
+	DBG("[thread] Client command worker started");
+
+	rcu_register_thread();
+
+	health_register(health_sessiond, HEALTH_SESSIOND_TYPE_CMD);
+
+	health_code_update();
+
+	rcu_thread_offline();
+
+	for (;;) {
+		pthread_mutex_lock(&client_cmd_queue.lock);
+		while (cds_list_empty(&client_cmd_queue.head) &&
+				!client_cmd_queue.exit) {
+			health_poll_entry();
+			pthread_cond_wait(&client_cmd_queue.cond,
+					&client_cmd_queue.lock);
+			health_poll_exit();
+		}
+		if (client_cmd_queue.exit) {
+			pthread_mutex_unlock(&client_cmd_queue.lock);
+			break;
+		}
+		node = cds_list_entry(client_cmd_queue.head.next,
+				struct client_cmd_node, head);
+		cds_list_del(&node->head);
+		pthread_mutex_unlock(&client_cmd_queue.lock);
+
+		health_code_update();
+
+		handle_client_cmd(node->sock);
+		free(node);
+
+		health_code_update();
+	}
+
+	rcu_thread_online();
+
+	DBG("Client command worker dying");
+	health_unregister(health_sessiond);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/*
+ * Ask the command workers to exit and wait for them. Connections still
+ * queued are closed without being processed.
+ */
+static void stop_client_cmd_workers(pthread_t *workers, int nb_workers)
+{
+	int i, ret;
+	struct client_cmd_node *node, *tmp_node;
+
+	pthread_mutex_lock(&client_cmd_queue.lock);
+	client_cmd_queue.exit = 1;
+	pthread_cond_broadcast(&client_cmd_queue.cond);
+	pthread_mutex_unlock(&client_cmd_queue.lock);
+
+	for (i = 0; i < nb_workers; i++) {
+		ret = pthread_join(workers[i], NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join client command worker");
+		}
+	}
+
+	cds_list_for_each_entry_safe(node, tmp_node, &client_cmd_queue.head,
+			head) {
+		cds_list_del(&node->head);
+		ret = close(node->sock);
+		if (ret) {
+			PERROR("close");
+		}
+		free(node);
+	}
+}
+
 /*
  * This thread manage all clients request using the unix client socket for
  * communication.
  */
 static void *thread_manage_clients(void *data)
 {
-	int sock = -1, ret, i, pollfd, err = -1;
-	int sock_error;
+	int sock = -1, ret, i, pollfd, err = -1, nb_workers = 0;
+	unsigned int nb_idle = 0;
 	uint32_t revents, nb_fd;
-	struct command_ctx *cmd_ctx = NULL;
+	pthread_t *workers = NULL;
 	struct lttng_poll_event events;
 
 	DBG("[thread] Manage client started");
@@ -4070,10 +4733,11 @@ static void *thread_manage_clients(void *data)
 	}
 
 	/*
-	 * Pass 2 as size here for the thread quit pipe and client_sock. Nothing
-	 * more will be added to this poll set.
+	 * Pass 3 as size here for the thread quit pipe, client_sock and the
+	 * client socket pipe. The idle client connections are added to this
+	 * poll set as they are given back by the command workers.
 	 */
-	ret = sessiond_set_thread_pollset(&events, 2);
+	ret = sessiond_set_thread_pollset(&events, 3);
 	if (ret < 0) {
 		goto error_create_poll;
 	}
@@ -4084,6 +4748,28 @@ static void *thread_manage_clients(void *data)
 		goto error;
 	}
 
+	ret = lttng_poll_add(&events, client_sock_pipe[0], LPOLLIN | LPOLLRDHUP);
+	if (ret < 0) {
+		goto error;
+	}
+
+	workers = zmalloc(sizeof(*workers) * client_cmd_workers);
+	if (!workers) {
+		PERROR("zmalloc client command workers");
+		goto error;
+	}
+	for (i = 0; i < client_cmd_workers; i++) {
+		ret = pthread_create(&workers[i], NULL, thread_client_cmd_worker,
+				(void *) NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create client command worker");
+			goto error;
+		}
+		nb_workers++;
+	}
+	DBG("Processing client commands with %d workers", nb_workers);
+
 	sessiond_notify_ready();
 	ret = sem_post(&load_info->message_thread_ready);
 	if (ret) {
@@ -4147,119 +4833,105 @@ static void *thread_manage_clients(void *data)
 					ERR("Client socket poll error");
 					goto error;
 				}
-			}
-		}
 
-		DBG("Wait for client response");
-
-		health_code_update();
-
-		sock = lttcomm_accept_unix_sock(client_sock);
-		if (sock < 0) {
-			goto error;
-		}
+				DBG("Wait for client response");
 
-		/*
-		 * Set the CLOEXEC flag. Return code is useless because either way, the
-		 * show must go on.
-		 */
-		(void) utils_set_fd_cloexec(sock);
+				health_code_update();
 
-		/* Set socket option for credentials retrieval */
-		ret = lttcomm_setsockopt_creds_unix_sock(sock);
-		if (ret < 0) {
-			goto error;
-		}
+				sock = lttcomm_accept_unix_sock(client_sock);
+				if (sock < 0) {
+					goto error;
+				}
 
-		/* Allocate context command to process the client request */
-		cmd_ctx = zmalloc(sizeof(struct command_ctx));
-		if (cmd_ctx == NULL) {
-			PERROR("zmalloc cmd_ctx");
-			goto error;
-		}
+				/*
+				 * Set the CLOEXEC flag. Return code is useless because
+				 * either way, the show must go on.
+				 */
+				(void) utils_set_fd_cloexec(sock);
 
-		/* Allocate data buffer for reception */
-		cmd_ctx->lsm = zmalloc(sizeof(struct lttcomm_session_msg));
-		if (cmd_ctx->lsm == NULL) {
-			PERROR("zmalloc cmd_ctx->lsm");
-			goto error;
-		}
+				/* Set socket option for credentials retrieval */
+				ret = lttcomm_setsockopt_creds_unix_sock(sock);
+				if (ret < 0) {
+					goto error;
+				}
+			} else if (pollfd == client_sock_pipe[0]) {
+				ssize_t size_ret;
 
-		cmd_ctx->llm = NULL;
-		cmd_ctx->session = NULL;
+				if (revents & (LPOLLERR | LPOLLHUP | LPOLLRDHUP)) {
+					ERR("Client socket pipe error");
+					goto error;
+				}
 
-		health_code_update();
+				/* Connection given back by a command worker. */
+				size_ret = lttng_read(client_sock_pipe[0], &sock,
+						sizeof(sock));
+				if (size_ret < sizeof(sock)) {
+					PERROR("read client socket pipe");
+					goto error;
+				}
 
-		/*
-		 * Data is received from the lttng client. The struct
-		 * lttcomm_session_msg (lsm) contains the command and data request of
-		 * the client.
-		 */
-		DBG("Receiving data from client ...");
-		ret = lttcomm_recv_creds_unix_sock(sock, cmd_ctx->lsm,
-				sizeof(struct lttcomm_session_msg), &cmd_ctx->creds);
-		if (ret <= 0) {
-			DBG("Nothing recv() from client... continuing");
-			ret = close(sock);
-			if (ret) {
-				PERROR("close");
+				if (nb_idle >= DEFAULT_CLIENT_MAX_IDLE_CONNECTIONS) {
+					/*
+					 * Don't let persistent clients grow the poll set
+					 * without bound. A client already waiting on its
+					 * next command is served right away, the others
+					 * reconnect on their next command.
+					 */
+					if (!client_sock_pending(sock)) {
+						DBG("Too many idle clients, closing sock %d",
+								sock);
+						ret = close(sock);
+						if (ret) {
+							PERROR("close");
+						}
+						sock = -1;
+						continue;
+					}
+				} else {
+					ret = lttng_poll_add(&events, sock,
+							LPOLLIN | LPOLLPRI);
+					if (ret < 0) {
+						goto error;
+					}
+					nb_idle++;
+					DBG("Client with sock %d waiting for a command",
+							sock);
+					sock = -1;
+					continue;
+				}
+			} else {
+				/* Next command, or close, of an idle connection. */
+				sock = pollfd;
+				ret = lttng_poll_del(&events, sock);
+				if (ret < 0) {
+					goto error;
+				}
+				nb_idle--;
+
+				if (!(revents & (LPOLLIN | LPOLLPRI))) {
+					DBG("Client with sock %d closed its connection",
+							sock);
+					ret = close(sock);
+					if (ret) {
+						PERROR("close");
+					}
+					sock = -1;
+					continue;
+				}
 			}
-			sock = -1;
-			clean_command_ctx(&cmd_ctx);
-			continue;
-		}
 
-		health_code_update();
-
-		// TODO: Validate cmd_ctx including sanity check for
-		// security purpose.
-
-		rcu_thread_online();
-		/*
-		 * This function dispatch the work to the kernel or userspace tracer
-		 * libs and fill the lttcomm_lttng_msg data structure of all the needed
-		 * informations for the client. The command context struct contains
-		 * everything this function may needs.
-		 */
-		ret = process_client_msg(cmd_ctx, sock, &sock_error);
-		rcu_thread_offline();
-		if (ret < 0) {
-			ret = close(sock);
-			if (ret) {
-				PERROR("close");
+			/* Hand the connection to a command worker. */
+			ret = queue_client_cmd(sock);
+			if (ret < 0) {
+				ret = close(sock);
+				if (ret) {
+					PERROR("close");
+				}
 			}
 			sock = -1;
-			/*
-			 * TODO: Inform client somehow of the fatal error. At
-			 * this point, ret < 0 means that a zmalloc failed
-			 * (ENOMEM). Error detected but still accept
-			 * command, unless a socket error has been
-			 * detected.
-			 */
-			clean_command_ctx(&cmd_ctx);
-			continue;
-		}
 
-		health_code_update();
-
-		DBG("Sending response (size: %d, retcode: %s)",
-				cmd_ctx->lttng_msg_size,
-				lttng_strerror(-cmd_ctx->llm->ret_code));
-		ret = send_unix_sock(sock, cmd_ctx->llm, cmd_ctx->lttng_msg_size);
-		if (ret < 0) {
-			ERR("Failed to send data back to client");
-		}
-
-		/* End of transmission */
-		ret = close(sock);
-		if (ret) {
-			PERROR("close");
+			health_code_update();
 		}
-		sock = -1;
-
-		clean_command_ctx(&cmd_ctx);
-
-		health_code_update();
 	}
 
 exit:
@@ -4272,7 +4944,13 @@ error:
 	}
 
 	lttng_poll_clean(&events);
-	clean_command_ctx(&cmd_ctx);
+
+	if (workers) {
+		stop_client_cmd_workers(workers, nb_workers);
+		free(workers);
+	}
+	utils_close_pipe(client_sock_pipe);
+	client_sock_pipe[0] = client_sock_pipe[1] = -1;
 
 error_listen:
 error_create_poll:
@@ -5127,7 +5805,8 @@ int main(int argc, char **argv)
 {
 	int ret = 0, retval = 0;
 	void *status;
-	const char *home_path, *env_app_timeout;
+	const char *home_path, *env_app_timeout, *env_app_reg_workers;
+	const char *env_client_cmd_workers;
 
 	init_kernel_workarounds();
 
@@ -5530,6 +6209,12 @@ int main(int argc, char **argv)
 		goto exit_init_data;
 	}
 
+	/* Setup the client thread socket pipe. */
+	if (utils_create_pipe_cloexec(client_sock_pipe)) {
+		retval = -1;
+		goto exit_init_data;
+	}
+
 	/* Setup the thread apps notify communication pipe. */
 	if (utils_create_pipe_cloexec(apps_cmd_notify_pipe)) {
 		retval = -1;
@@ -5559,6 +6244,24 @@ int main(int argc, char **argv)
 		app_socket_timeout = DEFAULT_APP_SOCKET_RW_TIMEOUT;
 	}
 
+	/* Check for the application registration workers env variable. */
+	env_app_reg_workers = getenv(DEFAULT_APP_REG_WORKERS_ENV);
+	if (env_app_reg_workers) {
+		app_reg_workers = atoi(env_app_reg_workers);
+	}
+	if (app_reg_workers <= 0) {
+		app_reg_workers = DEFAULT_APP_REG_WORKERS;
+	}
+
+	/* Check for the client command workers env variable. */
+	env_client_cmd_workers = getenv(DEFAULT_CLIENT_CMD_WORKERS_ENV);
+	if (env_client_cmd_workers) {
+		client_cmd_workers = atoi(env_client_cmd_workers);
+	}
+	if (client_cmd_workers <= 0) {
+		client_cmd_workers = DEFAULT_CLIENT_CMD_WORKERS;
+	}
+
 	ret = write_pidfile();
 	if (ret) {
 		ERR("Error in write_pidfile");
@@ -46,7 +46,7 @@
  */
 static struct ltt_session_list ltt_session_list = {
 	.head = CDS_LIST_HEAD_INIT(ltt_session_list.head),
-	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.lock = PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP,
 	.next_uuid = 0,
 };
 
@@ -125,7 +125,16 @@ struct ltt_session_list *session_get_list(void)
  */
 void session_lock_list(void)
 {
-	pthread_mutex_lock(&ltt_session_list.lock);
+	pthread_rwlock_wrlock(&ltt_session_list.lock);
+}
+
+/*
+ * Acquire session list lock in shared mode. The caller MUST NOT modify the
+ * list. Released with session_unlock_list().
+ */
+void session_lock_list_shared(void)
+{
+	pthread_rwlock_rdlock(&ltt_session_list.lock);
 }
 
 /*
@@ -133,7 +142,7 @@ void session_lock_list(void)
  */
 void session_unlock_list(void)
 {
-	pthread_mutex_unlock(&ltt_session_list.lock);
+	pthread_rwlock_unlock(&ltt_session_list.lock);
 }
 
 /*
@@ -143,7 +152,18 @@ void session_lock(struct ltt_session *session)
 {
 	assert(session);
 
-	pthread_mutex_lock(&session->lock);
+	pthread_rwlock_wrlock(&session->lock);
+}
+
+/*
+ * Acquire session lock in shared mode. The caller MUST NOT modify the session
+ * configuration. Released with session_unlock().
+ */
+void session_lock_shared(struct ltt_session *session)
+{
+	assert(session);
+
+	pthread_rwlock_rdlock(&session->lock);
 }
 
 /*
@@ -153,7 +173,7 @@ void session_unlock(struct ltt_session *session)
 {
 	assert(session);
 
-	pthread_mutex_unlock(&session->lock);
+	pthread_rwlock_unlock(&session->lock);
 }
 
 /*
@@ -194,7 +214,7 @@ int session_destroy(struct ltt_session *session)
 
 	DBG("Destroying session %s", session->name);
 	del_session_list(session);
-	pthread_mutex_destroy(&session->lock);
+	pthread_rwlock_destroy(&session->lock);
 
 	consumer_destroy_output(session->consumer);
 	snapshot_destroy(&session->snapshot);
@@ -210,6 +230,7 @@ int session_create(char *name, uid_t uid, gid_t gid)
 {
 	int ret;
 	struct ltt_session *new_session;
+	pthread_rwlockattr_t lock_attr;
 
 	/* Allocate session data structure */
 	new_session = zmalloc(sizeof(struct ltt_session));
@@ -251,8 +272,12 @@ int session_create(char *name, uid_t uid, gid_t gid)
 	new_session->kernel_session = NULL;
 	new_session->ust_session = NULL;
 
-	/* Init lock */
-	pthread_mutex_init(&new_session->lock, NULL);
+	/* Init lock, preferring writers like the session list lock. */
+	pthread_rwlockattr_init(&lock_attr);
+	pthread_rwlockattr_setkind_np(&lock_attr,
+			PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	pthread_rwlock_init(&new_session->lock, &lock_attr);
+	pthread_rwlockattr_destroy(&lock_attr);
 
 	new_session->uid = uid;
 	new_session->gid = gid;
@@ -41,8 +41,13 @@ struct ltt_session_list {
 	 * lock and release it before returning. If none of those
 	 * functions are used, the lock MUST be acquired in order to
 	 * iterate or/and do any actions on that list.
+	 *
+	 * The UST application registration workers only iterate on the list
+	 * and take it shared with session_lock_list_shared() so applications
+	 * can be set up concurrently. Writers are preferred so commands are
+	 * not starved by a registration storm.
 	 */
-	pthread_mutex_t lock;
+	pthread_rwlock_t lock;
 
 	/*
 	 * Session unique ID generator. The session list lock MUST be
@@ -67,8 +72,11 @@ struct ltt_session {
 	 * Protect any read/write on this session data structure. This lock must be
 	 * acquired *before* using any public functions declared below. Use
 	 * session_lock() and session_unlock() for that.
+	 *
+	 * Taken shared by the UST application registration workers with
+	 * session_lock_shared(), which only read the session configuration.
 	 */
-	pthread_mutex_t lock;
+	pthread_rwlock_t lock;
 	struct cds_list_head list;
 	uint64_t id;		/* session unique identifier */
 	/* UID/GID of the user owning the session */
@@ -116,7 +124,9 @@ int session_create(char *name, uid_t uid, gid_t gid);
 int session_destroy(struct ltt_session *session);
 
 void session_lock(struct ltt_session *session);
+void session_lock_shared(struct ltt_session *session);
 void session_lock_list(void);
+void session_lock_list_shared(void);
 void session_unlock(struct ltt_session *session);
 void session_unlock_list(void);
 
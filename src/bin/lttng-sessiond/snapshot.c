@@ -27,6 +27,9 @@
 #include "snapshot.h"
 #include "utils.h"
 
+/* Next key given to a snapshot output. */
+static unsigned long next_output_key;
+
 /*
  * Return the atomically incremented value of next_output_id.
  */
@@ -60,6 +63,7 @@ static int output_init(uint64_t max_size, const char *name,
 		output->id = get_next_output_id(snapshot);
 	}
 	lttng_ht_node_init_ulong(&output->node, (unsigned long) output->id);
+	output->key = uatomic_add_return(&next_output_key, 1);
 
 	if (name && name[0] != '\0') {
 		strncpy(output->name, name, sizeof(output->name));
@@ -31,6 +31,12 @@ struct consumer_output;
 
 struct snapshot_output {
 	uint32_t id;
+	/*
+	 * Unique among all the outputs of the session daemon, temporary ones
+	 * included. Lets the consumers tell outputs apart for incremental
+	 * snapshots.
+	 */
+	uint64_t key;
 	uint64_t max_size;
 	/* Number of snapshot taken with that output. */
 	uint64_t nb_snapshot;
@@ -44,6 +50,11 @@ struct snapshot_output {
 	 * for the directory output.
 	 */
 	char datetime[16];
+	/*
+	 * Set for the duration of an incremental snapshot record so that only
+	 * the data not captured by the previous snapshot is recorded.
+	 */
+	unsigned int incremental;
 
 	/* Indexed by ID. */
 	struct lttng_ht_node_ulong node;
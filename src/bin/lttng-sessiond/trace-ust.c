@@ -22,14 +22,26 @@
 #include <string.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <urcu/uatomic.h>
 
 #include <common/common.h>
 #include <common/defaults.h>
+#include <common/hashtable/rcu-batch.h>
+#include <common/hashtable/utils.h>
+#include <lib/lttng-ctl/filter/filter-bytecode.h>
 
 #include "buffer-registry.h"
 #include "trace-ust.h"
 #include "utils.h"
 
+/*
+ * Event templates of every session, by content, so a filter applied to many
+ * events is stored and prepared once. Lookups, insertions and removals are
+ * serialized by the lock.
+ */
+static struct lttng_ht *event_templates;
+static pthread_mutex_t event_templates_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*
  * Match function for the events hash table lookup.
  *
@@ -271,6 +283,7 @@ struct ltt_ust_session *trace_ust_create_session(uint64_t session_id)
 	lus->buffer_type_changed = 0;
 	/* Init it in case it get used after allocation. */
 	CDS_INIT_LIST_HEAD(&lus->buffer_reg_uid_list);
+	pthread_mutex_init(&lus->buffer_reg_uid_lock, NULL);
 
 	/* Alloc UST global domain channels' HT */
 	lus->domain_global.channels = lttng_ht_new(0, LTTNG_HT_TYPE_STRING);
@@ -364,6 +377,112 @@ error:
 	return luc;
 }
 
+/*
+ * Hash of the content of an event template.
+ */
+static
+unsigned long event_template_hash(const struct ltt_ust_event_template *tmpl)
+{
+	unsigned long hash = lttng_ht_seed;
+
+	if (tmpl->filter) {
+		hash = hash_key_buf(tmpl->filter->data, tmpl->filter->len, hash);
+	}
+	if (tmpl->exclusion) {
+		hash = hash_key_buf(tmpl->exclusion->names,
+				tmpl->exclusion->count * LTTNG_SYMBOL_NAME_LEN, hash);
+	}
+	return hash;
+}
+
+/*
+ * Match function for the event templates table lookup, by content.
+ */
+static
+int match_event_template(struct cds_lfht_node *node, const void *_key)
+{
+	const struct ltt_ust_event_template *tmpl, *key = _key;
+
+	tmpl = caa_container_of(node, struct ltt_ust_event_template, node);
+
+	if (!tmpl->filter != !key->filter || !tmpl->exclusion != !key->exclusion) {
+		return 0;
+	}
+	if (tmpl->filter && (tmpl->filter->len != key->filter->len ||
+			tmpl->filter->reloc_offset !=
+				key->filter->reloc_offset ||
+			memcmp(tmpl->filter->data, key->filter->data,
+				tmpl->filter->len))) {
+		return 0;
+	}
+	if (tmpl->exclusion && (tmpl->exclusion->count != key->exclusion->count ||
+			memcmp(tmpl->exclusion->names, key->exclusion->names,
+				tmpl->exclusion->count * LTTNG_SYMBOL_NAME_LEN))) {
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Get a reference on the event template with the given filter and
+ * exclusions, creating it if no event uses them yet. We own filter and
+ * exclusion on success, they are freed if an identical template exists.
+ *
+ * Return the template or NULL on error.
+ */
+static
+struct ltt_ust_event_template *event_template_get_or_create(
+		struct lttng_filter_bytecode *filter,
+		struct lttng_event_exclusion *exclusion)
+{
+	struct ltt_ust_event_template key, *tmpl = NULL;
+	struct cds_lfht_node *node;
+	struct cds_lfht_iter iter;
+
+	/* Same layout. */
+	key.filter = (struct lttng_ust_filter_bytecode *) filter;
+	key.exclusion = exclusion;
+	key.hash = event_template_hash(&key);
+
+	pthread_mutex_lock(&event_templates_lock);
+	if (!event_templates) {
+		event_templates = lttng_ht_new(0, LTTNG_HT_TYPE_ULONG);
+		if (!event_templates) {
+			goto end;
+		}
+	}
+
+	rcu_read_lock();
+	cds_lfht_lookup(event_templates->ht, key.hash, match_event_template,
+			&key, &iter);
+	node = cds_lfht_iter_get_node(&iter);
+	if (node) {
+		tmpl = caa_container_of(node, struct ltt_ust_event_template, node);
+		uatomic_inc(&tmpl->refcount);
+		free(filter);
+		free(exclusion);
+		DBG3("Sharing UST event template of %ld events", tmpl->refcount);
+		goto end_unlock;
+	}
+
+	tmpl = zmalloc(sizeof(*tmpl));
+	if (!tmpl) {
+		PERROR("ust event template zmalloc");
+		goto end_unlock;
+	}
+	tmpl->refcount = 1;
+	tmpl->hash = key.hash;
+	tmpl->filter = key.filter;
+	tmpl->exclusion = exclusion;
+	cds_lfht_add(event_templates->ht, tmpl->hash, &tmpl->node);
+
+end_unlock:
+	rcu_read_unlock();
+end:
+	pthread_mutex_unlock(&event_templates_lock);
+	return tmpl;
+}
+
 /*
  * Allocate and initialize a ust event. Set name and event type.
  * We own filter_expression, filter, and exclusion.
@@ -425,10 +544,25 @@ struct ltt_ust_event *trace_ust_create_event(struct lttng_event *ev,
 		goto error_free_event;
 	}
 
-	/* Same layout. */
+	if (filter || exclusion) {
+		lue->tmpl = event_template_get_or_create(filter, exclusion);
+		if (!lue->tmpl) {
+			goto error_free_event;
+		}
+		lue->filter = lue->tmpl->filter;
+		lue->exclusion = lue->tmpl->exclusion;
+	}
+	if (lue->filter) {
+		/* Same layout. The tracer rejects the filter if it is invalid. */
+		if (filter_bytecode_cost(
+				(struct lttng_filter_bytecode *) lue->filter,
+				&lue->filter_cost) < 0) {
+			DBG("Unable to estimate the filter cost of UST event %s",
+					lue->attr.name);
+		}
+	}
+
 	lue->filter_expression = filter_expression;
-	lue->filter = (struct lttng_ust_filter_bytecode *) filter;
-	lue->exclusion = (struct lttng_event_exclusion *) exclusion;
 
 	/* Init node */
 	lttng_ht_node_init_str(&lue->node, lue->attr.name);
@@ -600,10 +734,11 @@ static void destroy_contexts(struct lttng_ht *ht)
 		/* Remove from channel's hash table. */
 		ret = lttng_ht_del(ht, &iter);
 		if (!ret) {
-			call_rcu(&node->head, destroy_context_rcu);
+			lttng_rcu_batch_call(&node->head, destroy_context_rcu);
 		}
 	}
 	rcu_read_unlock();
+	lttng_rcu_batch_flush();
 
 	ht_cleanup_push(ht);
 }
@@ -617,11 +752,59 @@ void trace_ust_destroy_event(struct ltt_ust_event *event)
 
 	DBG2("Trace destroy UST event %s", event->attr.name);
 	free(event->filter_expression);
-	free(event->filter);
-	free(event->exclusion);
+	if (event->tmpl) {
+		trace_ust_event_template_put(event->tmpl);
+	}
 	free(event);
 }
 
+/*
+ * Get a reference on an event template for an application event.
+ */
+struct ltt_ust_event_template *trace_ust_event_template_get(
+		struct ltt_ust_event_template *tmpl)
+{
+	assert(tmpl);
+
+	uatomic_inc(&tmpl->refcount);
+	return tmpl;
+}
+
+/*
+ * URCU intermediate call to free an event template.
+ */
+static void destroy_event_template_rcu(struct rcu_head *head)
+{
+	struct ltt_ust_event_template *tmpl =
+		caa_container_of(head, struct ltt_ust_event_template, rcu_head);
+
+	free(tmpl->filter);
+	free(tmpl->exclusion);
+	free(tmpl);
+}
+
+/*
+ * Put a reference on an event template, freeing it with its filter and
+ * exclusions on the last one.
+ */
+void trace_ust_event_template_put(struct ltt_ust_event_template *tmpl)
+{
+	assert(tmpl);
+
+	/* Serialized with the lookups, which must not find a dying template. */
+	pthread_mutex_lock(&event_templates_lock);
+	if (uatomic_sub_return(&tmpl->refcount, 1)) {
+		goto end;
+	}
+
+	rcu_read_lock();
+	cds_lfht_del(event_templates->ht, &tmpl->node);
+	rcu_read_unlock();
+	call_rcu(&tmpl->rcu_head, destroy_event_template_rcu);
+end:
+	pthread_mutex_unlock(&event_templates_lock);
+}
+
 /*
  * URCU intermediate call to complete destroy event.
  */
@@ -650,9 +833,10 @@ static void destroy_events(struct lttng_ht *events)
 	cds_lfht_for_each_entry(events->ht, &iter.iter, node, node) {
 		ret = lttng_ht_del(events, &iter);
 		assert(!ret);
-		call_rcu(&node->head, destroy_event_rcu);
+		lttng_rcu_batch_call(&node->head, destroy_event_rcu);
 	}
 	rcu_read_unlock();
+	lttng_rcu_batch_flush();
 
 	ht_cleanup_push(events);
 }
@@ -781,6 +965,8 @@ void trace_ust_destroy_session(struct ltt_ust_session *session)
 		buffer_reg_uid_destroy(reg, session->consumer);
 	}
 
+	pthread_mutex_destroy(&session->buffer_reg_uid_lock);
+
 	consumer_destroy_output(session->consumer);
 	consumer_destroy_output(session->tmp_consumer);
 
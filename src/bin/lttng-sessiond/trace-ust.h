@@ -20,6 +20,7 @@
 
 #include <config.h>
 #include <limits.h>
+#include <pthread.h>
 #include <urcu/list.h>
 
 #include <lttng/lttng.h>
@@ -44,14 +45,37 @@ struct ltt_ust_context {
 	struct cds_list_head list;
 };
 
+/*
+ * Filter bytecode and exclusions of a UST event. They are immutable once the
+ * event is created so they are allocated once and shared by the event and its
+ * copy in every application session instead of being duplicated per app.
+ * Events of any session having the same filter and exclusions share the same
+ * template.
+ */
+struct ltt_ust_event_template {
+	/* References held by the events and the application events. */
+	long refcount;
+	/* Hash of the filter and exclusions, node of the templates table. */
+	unsigned long hash;
+	struct cds_lfht_node node;
+	struct rcu_head rcu_head;
+	struct lttng_ust_filter_bytecode *filter;
+	struct lttng_event_exclusion *exclusion;
+};
+
 /* UST event */
 struct ltt_ust_event {
 	unsigned int enabled;
 	struct lttng_ust_event attr;
 	struct lttng_ht_node_str node;
 	char *filter_expression;
+	/* Point to the template data, NULL if there are none. */
 	struct lttng_ust_filter_bytecode *filter;
 	struct lttng_event_exclusion *exclusion;
+	/* NULL if the event has neither a filter nor exclusions. */
+	struct ltt_ust_event_template *tmpl;
+	/* Cost estimate of the filter, reported when listing the event. */
+	struct lttng_event_filter_cost filter_cost;
 };
 
 /* UST channel */
@@ -101,6 +125,14 @@ struct ltt_ust_session {
 	int buffer_type_changed;
 	/* For per UID buffer, every buffer reg object is kept of this session */
 	struct cds_list_head buffer_reg_uid_list;
+	/*
+	 * Serializes the creation of the per UID buffer registries, of their
+	 * channels and of their metadata since applications of the same UID can
+	 * be set up concurrently by the registration workers.
+	 *
+	 * Nested inside the session lock and the UST app session lock.
+	 */
+	pthread_mutex_t buffer_reg_uid_lock;
 	/* Next channel ID available for a newly registered channel. */
 	uint64_t next_channel_id;
 	/* Once this value reaches UINT32_MAX, no more id can be allocated. */
@@ -185,6 +217,10 @@ void trace_ust_destroy_session(struct ltt_ust_session *session);
 void trace_ust_destroy_channel(struct ltt_ust_channel *channel);
 void trace_ust_destroy_event(struct ltt_ust_event *event);
 
+struct ltt_ust_event_template *trace_ust_event_template_get(
+		struct ltt_ust_event_template *tmpl);
+void trace_ust_event_template_put(struct ltt_ust_event_template *tmpl);
+
 #else /* HAVE_LIBLTTNG_UST_CTL */
 
 static inline int trace_ust_ht_match_event(struct cds_lfht_node *node,
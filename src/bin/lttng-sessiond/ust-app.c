@@ -31,6 +31,7 @@
 #include <signal.h>
 
 #include <common/common.h>
+#include <common/hashtable/rcu-batch.h>
 #include <common/sessiond-comm/sessiond-comm.h>
 
 #include "buffer-registry.h"
@@ -135,7 +136,8 @@ static int ht_match_ust_app_event(struct cds_lfht_node *node, const void *_key)
 		goto no_match;
 	}
 
-	if (key->filter && event->filter) {
+	/* Events sharing a template have the same filter. */
+	if (key->filter && event->filter && key->filter != event->filter) {
 		/* Both filters exists, check length followed by the bytecode. */
 		if (event->filter->len != key->filter->len ||
 				memcmp(event->filter->data, key->filter->data,
@@ -149,7 +151,8 @@ static int ht_match_ust_app_event(struct cds_lfht_node *node, const void *_key)
 		goto no_match;
 	}
 
-	if (key->exclusion && event->exclusion) {
+	if (key->exclusion && event->exclusion &&
+			key->exclusion != event->exclusion) {
 		/* Both exclusions exists, check count followed by the names. */
 		if (event->exclusion->count != key->exclusion->count ||
 				memcmp(event->exclusion->names, key->exclusion->names,
@@ -290,9 +293,9 @@ void delete_ust_app_event(int sock, struct ust_app_event *ua_event)
 
 	assert(ua_event);
 
-	free(ua_event->filter);
-	if (ua_event->exclusion != NULL)
-		free(ua_event->exclusion);
+	if (ua_event->tmpl) {
+		trace_ust_event_template_put(ua_event->tmpl);
+	}
 	if (ua_event->obj != NULL) {
 		ret = ustctl_release_object(sock, ua_event->obj);
 		if (ret < 0 && ret != -EPIPE && ret != -LTTNG_UST_ERR_EXITING) {
@@ -361,6 +364,9 @@ void delete_ust_app_channel_rcu(struct rcu_head *head)
 /*
  * Delete ust app channel safely. RCU read lock must be held before calling
  * this function.
+ *
+ * The channel is queued for a batched reclamation, so the caller MUST call
+ * lttng_rcu_batch_flush() once done deleting channels.
  */
 static
 void delete_ust_app_channel(int sock, struct ust_app_channel *ua_chan,
@@ -420,7 +426,7 @@ void delete_ust_app_channel(int sock, struct ust_app_channel *ua_chan,
 		lttng_fd_put(LTTNG_FD_APPS, 1);
 		free(ua_chan->obj);
 	}
-	call_rcu(&ua_chan->rcu_head, delete_ust_app_channel_rcu);
+	lttng_rcu_batch_call(&ua_chan->rcu_head, delete_ust_app_channel_rcu);
 }
 
 /*
@@ -463,28 +469,27 @@ ssize_t ust_app_push_metadata(struct ust_registry_session *registry,
 		DBG3("No metadata to push for metadata key %" PRIu64,
 				registry->metadata_key);
 		ret_val = len;
-		if (send_zero_data) {
-			DBG("No metadata to push");
-			goto push_data;
+		if (!send_zero_data) {
+			goto end;
 		}
-		goto end;
-	}
-
-	/* Allocate only what we have to send. */
-	metadata_str = zmalloc(len);
-	if (!metadata_str) {
-		PERROR("zmalloc ust app metadata string");
-		ret_val = -ENOMEM;
-		goto error;
+		DBG("No metadata to push");
+	} else {
+		/*
+		 * Send what we haven't sent out straight from the registry
+		 * buffer. The range is never modified once written and the buffer
+		 * is kept alive until the push is released, so the lock is not
+		 * needed while sending.
+		 */
+		metadata_str = registry->metadata + offset;
 	}
-	/* Copy what we haven't send out. */
-	memcpy(metadata_str, registry->metadata + offset, len);
+	registry->metadata_push_inflight++;
 	registry->metadata_len_sent += len;
 
-push_data:
 	pthread_mutex_unlock(&registry->lock);
 	ret = consumer_push_metadata(socket, registry->metadata_key,
 			metadata_str, len, offset);
+	pthread_mutex_lock(&registry->lock);
+	ust_registry_metadata_push_put(registry);
 	if (ret < 0) {
 		/*
 		 * There is an acceptable race here between the registry metadata key
@@ -502,21 +507,14 @@ push_data:
 		}
 
 		/* Update back the actual metadata len sent since it failed here. */
-		pthread_mutex_lock(&registry->lock);
 		registry->metadata_len_sent -= len;
-		pthread_mutex_unlock(&registry->lock);
 		ret_val = ret;
-		goto error_push;
+		goto end;
 	}
-
-	free(metadata_str);
-	return len;
+	ret_val = len;
 
 end:
-error:
 	pthread_mutex_unlock(&registry->lock);
-error_push:
-	free(metadata_str);
 	return ret_val;
 }
 
@@ -716,7 +714,9 @@ void delete_ust_app_session(int sock, struct ust_app_session *ua_sess,
 	}
 	pthread_mutex_unlock(&ua_sess->lock);
 
-	call_rcu(&ua_sess->rcu_head, delete_ust_app_session_rcu);
+	/* Reclaim the session and all its channels with a single callback. */
+	lttng_rcu_batch_call(&ua_sess->rcu_head, delete_ust_app_session_rcu);
+	lttng_rcu_batch_flush();
 }
 
 /*
@@ -930,16 +930,16 @@ struct ust_app_event *alloc_ust_app_event(char *name,
 	}
 
 	ua_event->enabled = 1;
-	strncpy(ua_event->name, name, sizeof(ua_event->name));
-	ua_event->name[sizeof(ua_event->name) - 1] = '\0';
-	lttng_ht_node_init_str(&ua_event->node, ua_event->name);
 
 	/* Copy attributes */
 	if (attr) {
 		memcpy(&ua_event->attr, attr, sizeof(ua_event->attr));
 	}
+	strncpy(ua_event->attr.name, name, sizeof(ua_event->attr.name));
+	ua_event->attr.name[sizeof(ua_event->attr.name) - 1] = '\0';
+	lttng_ht_node_init_str(&ua_event->node, ua_event->attr.name);
 
-	DBG3("UST app event %s allocated", ua_event->name);
+	DBG3("UST app event %s allocated", ua_event->attr.name);
 
 	return ua_event;
 
@@ -972,29 +972,6 @@ error:
 	return ua_ctx;
 }
 
-/*
- * Allocate a filter and copy the given original filter.
- *
- * Return allocated filter or NULL on error.
- */
-static struct lttng_ust_filter_bytecode *alloc_copy_ust_app_filter(
-		struct lttng_ust_filter_bytecode *orig_f)
-{
-	struct lttng_ust_filter_bytecode *filter = NULL;
-
-	/* Copy filter bytecode */
-	filter = zmalloc(sizeof(*filter) + orig_f->len);
-	if (!filter) {
-		PERROR("zmalloc alloc ust app filter");
-		goto error;
-	}
-
-	memcpy(filter, orig_f, sizeof(*filter) + orig_f->len);
-
-error:
-	return filter;
-}
-
 /*
  * Find an ust_app using the sock and return it. RCU read side lock must be
  * held before calling this helper function.
@@ -1154,7 +1131,7 @@ int set_ust_event_filter(struct ust_app_event *ua_event,
 		goto error;
 	}
 
-	DBG2("UST filter set successfully for event %s", ua_event->name);
+	DBG2("UST filter set successfully for event %s", ua_event->attr.name);
 
 error:
 	health_code_update();
@@ -1195,7 +1172,7 @@ int set_ust_event_exclusion(struct ust_app_event *ua_event,
 		goto error;
 	}
 
-	DBG2("UST exclusion set successfully for event %s", ua_event->name);
+	DBG2("UST exclusion set successfully for event %s", ua_event->attr.name);
 
 error:
 	health_code_update();
@@ -1488,33 +1465,18 @@ error:
 static void shadow_copy_event(struct ust_app_event *ua_event,
 		struct ltt_ust_event *uevent)
 {
-	size_t exclusion_alloc_size;
-
-	strncpy(ua_event->name, uevent->attr.name, sizeof(ua_event->name));
-	ua_event->name[sizeof(ua_event->name) - 1] = '\0';
-
 	ua_event->enabled = uevent->enabled;
 
 	/* Copy event attributes */
 	memcpy(&ua_event->attr, &uevent->attr, sizeof(ua_event->attr));
 
-	/* Copy filter bytecode */
-	if (uevent->filter) {
-		ua_event->filter = alloc_copy_ust_app_filter(uevent->filter);
-		/* Filter might be NULL here in case of ENONEM. */
-	}
-
-	/* Copy exclusion data */
-	if (uevent->exclusion) {
-		exclusion_alloc_size = sizeof(struct lttng_ust_event_exclusion) +
-				LTTNG_UST_SYM_NAME_LEN * uevent->exclusion->count;
-		ua_event->exclusion = zmalloc(exclusion_alloc_size);
-		if (ua_event->exclusion == NULL) {
-			PERROR("malloc");
-		} else {
-			memcpy(ua_event->exclusion, uevent->exclusion,
-					exclusion_alloc_size);
-		}
+	/* Share the filter bytecode and exclusions, they are immutable. */
+	if (uevent->tmpl) {
+		ua_event->tmpl = trace_ust_event_template_get(uevent->tmpl);
+		ua_event->filter = uevent->filter;
+		/* Same layout. */
+		ua_event->exclusion =
+			(struct lttng_ust_event_exclusion *) uevent->exclusion;
 	}
 }
 
@@ -1787,6 +1749,7 @@ static int setup_buffer_reg_uid(struct ltt_ust_session *usess,
 	assert(app);
 
 	rcu_read_lock();
+	pthread_mutex_lock(&usess->buffer_reg_uid_lock);
 
 	reg_uid = buffer_reg_uid_find(usess->id, app->bits_per_long, app->uid);
 	if (!reg_uid) {
@@ -1831,6 +1794,7 @@ end:
 		*regp = reg_uid;
 	}
 error:
+	pthread_mutex_unlock(&usess->buffer_reg_uid_lock);
 	rcu_read_unlock();
 	return ret;
 }
@@ -2535,6 +2499,11 @@ static int create_channel_per_uid(struct ust_app *app,
 	 */
 	assert(reg_uid);
 
+	/*
+	 * Only the first application of the UID creates the channel buffers,
+	 * the others wait for them to be set up before duplicating them.
+	 */
+	pthread_mutex_lock(&usess->buffer_reg_uid_lock);
 	reg_chan = buffer_reg_channel_find(ua_chan->tracing_channel_id,
 			reg_uid);
 	if (!reg_chan) {
@@ -2543,7 +2512,7 @@ static int create_channel_per_uid(struct ust_app *app,
 		if (ret < 0) {
 			ERR("Error creating the UST channel \"%s\" registry instance",
 				ua_chan->name);
-			goto error;
+			goto error_unlock;
 		}
 		assert(reg_chan);
 
@@ -2565,7 +2534,7 @@ static int create_channel_per_uid(struct ust_app *app,
 					ua_chan->tracing_channel_id);
 			buffer_reg_channel_remove(reg_uid->registry, reg_chan);
 			buffer_reg_channel_destroy(reg_chan, LTTNG_DOMAIN_UST);
-			goto error;
+			goto error_unlock;
 		}
 
 		/*
@@ -2575,10 +2544,11 @@ static int create_channel_per_uid(struct ust_app *app,
 		if (ret < 0) {
 			ERR("Error setting up UST channel \"%s\"",
 				ua_chan->name);
-			goto error;
+			goto error_unlock;
 		}
 
 	}
+	pthread_mutex_unlock(&usess->buffer_reg_uid_lock);
 
 	/* Send buffers to the application. */
 	ret = send_channel_uid_to_ust(reg_chan, app, ua_sess, ua_chan);
@@ -2592,6 +2562,10 @@ static int create_channel_per_uid(struct ust_app *app,
 
 error:
 	return ret;
+
+error_unlock:
+	pthread_mutex_unlock(&usess->buffer_reg_uid_lock);
+	return ret;
 }
 
 /*
@@ -2765,6 +2739,7 @@ end:
 
 error:
 	delete_ust_app_channel(ua_chan->is_sent ? app->sock : -1, ua_chan, app);
+	lttng_rcu_batch_flush();
 error_alloc:
 	return ret;
 }
@@ -2809,7 +2784,7 @@ int create_ust_app_event(struct ust_app_session *ua_sess,
 
 	add_unique_ust_app_event(ua_chan, ua_event);
 
-	DBG2("UST app create event %s for PID %d completed", ua_event->name,
+	DBG2("UST app create event %s for PID %d completed", ua_event->attr.name,
 			app->pid);
 
 end:
@@ -2821,6 +2796,49 @@ error:
 	return ret;
 }
 
+/*
+ * Create or enable a batch of UST app events on the tracer side.
+ *
+ * Called with ust app session mutex held.
+ */
+static
+int enable_ust_app_events(struct ust_app_session *ua_sess,
+		struct ust_app_channel *ua_chan, struct ltt_ust_event **uevents,
+		unsigned int count, struct ust_app *app)
+{
+	int ret = 0;
+	unsigned int i, nb_new = 0;
+	struct ust_app_event *ua_event;
+
+	for (i = 0; i < count; i++) {
+		struct ltt_ust_event *uevent = uevents[i];
+
+		ua_event = find_ust_app_event(ua_chan->events, uevent->attr.name,
+				uevent->filter, uevent->attr.loglevel, uevent->exclusion);
+		if (ua_event) {
+			if (ua_event->enabled || !uevent->enabled) {
+				continue;
+			}
+			ret = enable_ust_app_event(ua_sess, ua_event, app);
+			if (ret < 0) {
+				goto end;
+			}
+			continue;
+		}
+
+		ret = create_ust_app_event(ua_sess, ua_chan, uevent, app);
+		if (ret < 0) {
+			goto end;
+		}
+		nb_new++;
+	}
+
+	DBG2("UST app enable of %u events (%u created) for PID %d completed",
+			count, nb_new, app->pid);
+end:
+	return ret;
+}
+
 /*
  * Create UST metadata and open it on the tracer side.
  *
@@ -2912,6 +2930,7 @@ static int create_ust_app_metadata(struct ust_app_session *ua_sess,
 error_consumer:
 	lttng_fd_put(LTTNG_FD_APPS, 1);
 	delete_ust_app_channel(-1, metadata, app);
+	lttng_rcu_batch_flush();
 error:
 	return ret;
 }
@@ -3870,6 +3889,149 @@ int ust_app_create_event_glb(struct ltt_ust_session *usess,
 	return ret;
 }
 
+/*
+ * For a specific existing UST session and UST channel, create or enable a
+ * batch of events for all registered apps.
+ *
+ * Every application is updated once with all the events rather than once per
+ * event, its session lock being taken a single time.
+ */
+int ust_app_enable_events_glb(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan, struct ltt_ust_event **uevents,
+		unsigned int count)
+{
+	int ret = 0;
+	struct lttng_ht_iter iter, uiter;
+	struct lttng_ht_node_str *ua_chan_node;
+	struct ust_app *app;
+	struct ust_app_session *ua_sess;
+	struct ust_app_channel *ua_chan;
+
+	DBG("UST app enabling %u events for all apps for session id %" PRIu64,
+			count, usess->id);
+
+	if (count == 0) {
+		goto end;
+	}
+
+	rcu_read_lock();
+
+	/* For all registered applications */
+	cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
+		if (!app->compatible) {
+			/*
+			 * TODO: In time, we should notice the caller of this error by
+			 * telling him that this is a version error.
+			 */
+			continue;
+		}
+		ua_sess = lookup_session_by_app(usess, app);
+		if (!ua_sess) {
+			/* The application has problem or is probably dead. */
+			continue;
+		}
+
+		pthread_mutex_lock(&ua_sess->lock);
+		/* Lookup channel in the ust app session */
+		lttng_ht_lookup(ua_sess->channels, (void *)uchan->name, &uiter);
+		ua_chan_node = lttng_ht_iter_get_node_str(&uiter);
+		/* If the channel is not found, there is a code flow error */
+		assert(ua_chan_node);
+
+		ua_chan = caa_container_of(ua_chan_node, struct ust_app_channel, node);
+
+		ret = enable_ust_app_events(ua_sess, ua_chan, uevents, count, app);
+		pthread_mutex_unlock(&ua_sess->lock);
+		if (ret < 0) {
+			/* Possible value at this point: -ENOMEM. If so, we stop! */
+			break;
+		}
+	}
+
+	rcu_read_unlock();
+end:
+	return ret;
+}
+
+/*
+ * For a specific existing UST session and UST channel, disable a batch of
+ * events for all registered apps.
+ */
+int ust_app_disable_events_glb(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan, struct ltt_ust_event **uevents,
+		unsigned int count)
+{
+	int ret = 0;
+	unsigned int i;
+	struct lttng_ht_iter iter, uiter;
+	struct lttng_ht_node_str *ua_chan_node;
+	struct ust_app *app;
+	struct ust_app_session *ua_sess;
+	struct ust_app_channel *ua_chan;
+	struct ust_app_event *ua_event;
+
+	DBG("UST app disabling %u events for all apps in channel %s for "
+			"session id %" PRIu64, count, uchan->name, usess->id);
+
+	rcu_read_lock();
+
+	/* For all registered applications */
+	cds_lfht_for_each_entry(ust_app_ht->ht, &iter.iter, app, pid_n.node) {
+		if (!app->compatible) {
+			/*
+			 * TODO: In time, we should notice the caller of this error by
+			 * telling him that this is a version error.
+			 */
+			continue;
+		}
+		ua_sess = lookup_session_by_app(usess, app);
+		if (ua_sess == NULL) {
+			/* Next app */
+			continue;
+		}
+
+		pthread_mutex_lock(&ua_sess->lock);
+
+		/* Lookup channel in the ust app session */
+		lttng_ht_lookup(ua_sess->channels, (void *)uchan->name, &uiter);
+		ua_chan_node = lttng_ht_iter_get_node_str(&uiter);
+		if (ua_chan_node == NULL) {
+			DBG2("Channel %s not found in session id %" PRIu64 " for app pid %d."
+					"Skipping", uchan->name, usess->id, app->pid);
+			goto next_app;
+		}
+		ua_chan = caa_container_of(ua_chan_node, struct ust_app_channel, node);
+
+		for (i = 0; i < count; i++) {
+			struct ltt_ust_event *uevent = uevents[i];
+
+			ua_event = find_ust_app_event(ua_chan->events, uevent->attr.name,
+					uevent->filter, uevent->attr.loglevel,
+					uevent->exclusion);
+			if (ua_event == NULL || !ua_event->enabled) {
+				continue;
+			}
+
+			ret = disable_ust_app_event(ua_sess, ua_event, app);
+			if (ret < 0) {
+				if (ret == -EPIPE || ret == -LTTNG_UST_ERR_EXITING) {
+					/* The application is dead, skip its other events. */
+					ret = 0;
+					break;
+				}
+				/* XXX: Report error someday... */
+				continue;
+			}
+		}
+	next_app:
+		pthread_mutex_unlock(&ua_sess->lock);
+	}
+
+	rcu_read_unlock();
+
+	return ret;
+}
+
 /*
  * Start tracing for a specific UST session and app.
  */
@@ -3915,9 +4077,12 @@ int ust_app_start_trace(struct ltt_ust_session *usess, struct ust_app *app)
 
 	/*
 	 * Create the metadata for the application. This returns gracefully if a
-	 * metadata was already set for the session.
+	 * metadata was already set for the session. Applications sharing a per
+	 * UID registry can be started concurrently.
 	 */
+	pthread_mutex_lock(&usess->buffer_reg_uid_lock);
 	ret = create_ust_app_metadata(ua_sess, app, usess->consumer);
+	pthread_mutex_unlock(&usess->buffer_reg_uid_lock);
 	if (ret < 0) {
 		goto error_unlock;
 	}
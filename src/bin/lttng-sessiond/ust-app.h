@@ -112,9 +112,14 @@ struct ust_app_event {
 	int enabled;
 	int handle;
 	struct lttng_ust_object_data *obj;
+	/* Also holds the event name, the key of the node. */
 	struct lttng_ust_event attr;
-	char name[LTTNG_UST_SYM_NAME_LEN];
 	struct lttng_ht_node_str node;
+	/*
+	 * Filter and exclusions shared with the tracing session event through
+	 * a reference on its template. NULL if there are none.
+	 */
+	struct ltt_ust_event_template *tmpl;
 	struct lttng_ust_filter_bytecode *filter;
 	struct lttng_ust_event_exclusion *exclusion;
 };
@@ -308,6 +313,12 @@ int ust_app_enable_all_event_glb(struct ltt_ust_session *usess,
 		struct ltt_ust_channel *uchan);
 int ust_app_disable_event_glb(struct ltt_ust_session *usess,
 		struct ltt_ust_channel *uchan, struct ltt_ust_event *uevent);
+int ust_app_enable_events_glb(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan, struct ltt_ust_event **uevents,
+		unsigned int count);
+int ust_app_disable_events_glb(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan, struct ltt_ust_event **uevents,
+		unsigned int count);
 int ust_app_add_ctx_channel_glb(struct ltt_ust_session *usess,
 		struct ltt_ust_channel *uchan, struct ltt_ust_context *uctx);
 void ust_app_global_update(struct ltt_ust_session *usess, int sock);
@@ -460,6 +471,20 @@ int ust_app_enable_event_glb(struct ltt_ust_session *usess,
 	return 0;
 }
 static inline
+int ust_app_enable_events_glb(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan, struct ltt_ust_event **uevents,
+		unsigned int count)
+{
+	return 0;
+}
+static inline
+int ust_app_disable_events_glb(struct ltt_ust_session *usess,
+		struct ltt_ust_channel *uchan, struct ltt_ust_event **uevents,
+		unsigned int count)
+{
+	return 0;
+}
+static inline
 int ust_app_add_ctx_channel_glb(struct ltt_ust_session *usess,
 		struct ltt_ust_channel *uchan, struct ltt_ust_context *uctx)
 {
@@ -28,6 +28,7 @@
 #include <limits.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <urcu/tls-compat.h>
 #include <common/common.h>
 
 #include "ust-registry.h"
@@ -40,11 +41,46 @@
 
 #define NR_CLOCK_OFFSET_SAMPLES		10
 
+#define METADATA_INT_DECL_CACHE_SIZE	64
+#define METADATA_INT_DECL_LEN		128
+
 struct offset_sample {
 	uint64_t offset;		/* correlation offset */
 	uint64_t measure_delta;		/* lower is better */
 };
 
+/*
+ * Rendered integer type declaration. The fields of the events of an
+ * application mostly share a handful of integer types, so their declaration
+ * is formatted once and then copied in the metadata.
+ */
+struct metadata_int_decl {
+	/* Key of the entry. */
+	uint32_t size;
+	uint32_t signedness;
+	uint32_t base;
+	enum ustctl_string_encodings encoding;
+	uint16_t alignment;
+	const char *byte_order;
+	/* Length of decl, 0 for an empty entry. */
+	size_t len;
+	char decl[METADATA_INT_DECL_LEN];
+};
+
+/*
+ * Per thread since metadata is generated concurrently for different
+ * registries, each under its own lock.
+ */
+struct metadata_int_decl_cache {
+	struct metadata_int_decl entries[METADATA_INT_DECL_CACHE_SIZE];
+};
+
+static DEFINE_URCU_TLS(struct metadata_int_decl_cache, int_decl_cache);
+
+static const char bo_be[] = " byte_order = be;";
+static const char bo_le[] = " byte_order = le;";
+static const char bo_native[] = "";
+
 static inline
 int fls(unsigned int x)
 {
@@ -107,12 +143,32 @@ ssize_t metadata_reserve(struct ust_registry_session *session, size_t len)
 
 		new_alloc_len =
 			max_t(size_t, 1U << get_count_order(new_alloc_len), old_alloc_len << 1);
-		newptr = realloc(session->metadata, new_alloc_len);
-		if (!newptr)
-			return -ENOMEM;
+		if (session->metadata_push_inflight) {
+			struct ust_registry_metadata_retired *retired;
+
+			/*
+			 * A push is sending from the current buffer, it must
+			 * stay valid until the push completes.
+			 */
+			retired = zmalloc(sizeof(*retired));
+			if (!retired)
+				return -ENOMEM;
+			newptr = malloc(new_alloc_len);
+			if (!newptr) {
+				free(retired);
+				return -ENOMEM;
+			}
+			memcpy(newptr, session->metadata, session->metadata_len);
+			retired->metadata = session->metadata;
+			retired->next = session->metadata_retired;
+			session->metadata_retired = retired;
+		} else {
+			newptr = realloc(session->metadata, new_alloc_len);
+			if (!newptr)
+				return -ENOMEM;
+		}
 		session->metadata = newptr;
-		/* We zero directly the memory from start of allocation. */
-		memset(&session->metadata[old_alloc_len], 0, new_alloc_len - old_alloc_len);
+		/* Only [0, metadata_len) is ever read, no need to zero the rest. */
 		session->metadata_alloc_len = new_alloc_len;
 	}
 	ret = session->metadata_len;
@@ -120,40 +176,166 @@ ssize_t metadata_reserve(struct ust_registry_session *session, size_t len)
 	return ret;
 }
 
+/*
+ * Append len bytes of str to the metadata.
+ */
+static
+int metadata_append(struct ust_registry_session *session, const char *str,
+		size_t len)
+{
+	ssize_t offset;
+
+	offset = metadata_reserve(session, len);
+	if (offset < 0)
+		return offset;
+	memcpy(&session->metadata[offset], str, len);
+	return 0;
+}
+
 /*
  * We have exclusive access to our metadata buffer (protected by the
  * ust_lock), so we can do racy operations such as looking for
  * remaining space left in packet and write, since mutual exclusion
  * protects us from concurrent writes.
+ *
+ * The text is formatted straight in the free space of the metadata
+ * buffer. Only when it does not fit is the buffer grown and the text
+ * formatted again.
  */
+static
+int lttng_metadata_vprintf(struct ust_registry_session *session,
+		const char *fmt, va_list ap)
+{
+	size_t avail;
+	ssize_t offset;
+	va_list aq;
+	char *dst;
+	int len;
+
+	avail = session->metadata_alloc_len - session->metadata_len;
+	dst = avail ? &session->metadata[session->metadata_len] : NULL;
+
+	va_copy(aq, ap);
+	len = vsnprintf(dst, avail, fmt, aq);
+	va_end(aq);
+	if (len < 0)
+		return -ENOMEM;
+
+	if ((size_t) len >= avail) {
+		/* Reserve room for the terminating NUL written by vsnprintf. */
+		offset = metadata_reserve(session, len + 1);
+		if (offset < 0)
+			return offset;
+		session->metadata_len--;
+		dst = &session->metadata[offset];
+		(void) vsnprintf(dst, len + 1, fmt, ap);
+	} else {
+		session->metadata_len += len;
+	}
+
+	DBG3("Append to metadata: \"%.*s\"", len, dst);
+	return 0;
+}
+
 static
 int lttng_metadata_printf(struct ust_registry_session *session,
 		const char *fmt, ...)
 {
-	char *str = NULL;
-	size_t len;
 	va_list ap;
-	ssize_t offset;
 	int ret;
 
 	va_start(ap, fmt);
-	ret = vasprintf(&str, fmt, ap);
+	ret = lttng_metadata_vprintf(session, fmt, ap);
 	va_end(ap);
-	if (ret < 0)
-		return -ENOMEM;
+	return ret;
+}
 
-	len = strlen(str);
-	offset = metadata_reserve(session, len);
-	if (offset < 0) {
-		ret = offset;
-		goto end;
+static
+const char *int_encoding_name(enum ustctl_string_encodings encoding)
+{
+	switch (encoding) {
+	case ustctl_encode_none:
+		return "none";
+	case ustctl_encode_UTF8:
+		return "UTF8";
+	default:
+		return "ASCII";
 	}
-	memcpy(&session->metadata[offset], str, len);
-	DBG3("Append to metadata: \"%s\"", str);
-	ret = 0;
+}
 
-end:
-	free(str);
+/*
+ * Return the rendered declaration of an integer type from the cache of the
+ * calling thread, formatting it if it is not cached. Return NULL if the
+ * declaration does not fit in a cache entry.
+ */
+static
+const struct metadata_int_decl *get_int_decl(
+		const struct ustctl_integer_type *type, const char *byte_order)
+{
+	unsigned int slot;
+	struct metadata_int_decl *entry;
+	int len;
+
+	slot = (type->size ^ (type->alignment << 2) ^ (type->signedness << 7) ^
+			(type->base << 3) ^ ((unsigned int) type->encoding << 5) ^
+			(byte_order == bo_native ? 0 : (byte_order == bo_be ? 1 : 2)))
+		% METADATA_INT_DECL_CACHE_SIZE;
+	entry = &URCU_TLS(int_decl_cache).entries[slot];
+
+	if (entry->len && entry->size == type->size &&
+			entry->signedness == type->signedness &&
+			entry->base == type->base &&
+			entry->encoding == type->encoding &&
+			entry->alignment == type->alignment &&
+			entry->byte_order == byte_order) {
+		return entry;
+	}
+
+	len = snprintf(entry->decl, sizeof(entry->decl),
+		"		integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s }",
+		type->size,
+		(unsigned int) type->alignment,
+		type->signedness,
+		int_encoding_name(type->encoding),
+		type->base,
+		byte_order);
+	if (len < 0 || len >= sizeof(entry->decl)) {
+		entry->len = 0;
+		return NULL;
+	}
+	entry->size = type->size;
+	entry->signedness = type->signedness;
+	entry->base = type->base;
+	entry->encoding = type->encoding;
+	entry->alignment = type->alignment;
+	entry->byte_order = byte_order;
+	entry->len = len;
+	return entry;
+}
+
+/*
+ * Append an integer field: the declaration of its type followed by the
+ * formatted field name.
+ */
+static
+int lttng_metadata_int_printf(struct ust_registry_session *session,
+		const struct ustctl_integer_type *type, const char *byte_order,
+		const char *fmt, ...)
+{
+	const struct metadata_int_decl *decl;
+	va_list ap;
+	int ret;
+
+	decl = get_int_decl(type, byte_order);
+	if (!decl)
+		return -EINVAL;
+	ret = metadata_append(session, decl->decl, decl->len);
+	if (ret)
+		return ret;
+
+	va_start(ap, fmt);
+	ret = lttng_metadata_vprintf(session, fmt, ap);
+	va_end(ap);
 	return ret;
 }
 
@@ -162,9 +344,6 @@ int _lttng_field_statedump(struct ust_registry_session *session,
 		const struct ustctl_field *field)
 {
 	int ret = 0;
-	const char *bo_be = " byte_order = be;";
-	const char *bo_le = " byte_order = le;";
-	const char *bo_native = "";
 	const char *bo_reverse;
 
 	if (session->byte_order == BIG_ENDIAN)
@@ -174,20 +353,16 @@ int _lttng_field_statedump(struct ust_registry_session *session,
 
 	switch (field->type.atype) {
 	case ustctl_atype_integer:
-		ret = lttng_metadata_printf(session,
-			"		integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } _%s;\n",
-			field->type.u.basic.integer.size,
-			field->type.u.basic.integer.alignment,
-			field->type.u.basic.integer.signedness,
-			(field->type.u.basic.integer.encoding == ustctl_encode_none)
-				? "none"
-				: (field->type.u.basic.integer.encoding == ustctl_encode_UTF8)
-					? "UTF8"
-					: "ASCII",
-			field->type.u.basic.integer.base,
-			field->type.u.basic.integer.reverse_byte_order ? bo_reverse : bo_native,
+	{
+		const struct ustctl_integer_type *integer;
+
+		integer = &field->type.u.basic.integer;
+		ret = lttng_metadata_int_printf(session, integer,
+			integer->reverse_byte_order ? bo_reverse : bo_native,
+			" _%s;\n",
 			field->name);
 		break;
+	}
 	case ustctl_atype_float:
 		ret = lttng_metadata_printf(session,
 			"		floating_point { exp_dig = %u; mant_dig = %u; align = %u;%s } _%s;\n",
@@ -201,59 +376,32 @@ int _lttng_field_statedump(struct ust_registry_session *session,
 		return -EINVAL;
 	case ustctl_atype_array:
 	{
-		const struct ustctl_basic_type *elem_type;
+		const struct ustctl_integer_type *elem_type;
 
-		elem_type = &field->type.u.array.elem_type;
-		ret = lttng_metadata_printf(session,
-			"		integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } _%s[%u];\n",
-			elem_type->u.basic.integer.size,
-			elem_type->u.basic.integer.alignment,
-			elem_type->u.basic.integer.signedness,
-			(elem_type->u.basic.integer.encoding == ustctl_encode_none)
-				? "none"
-				: (elem_type->u.basic.integer.encoding == ustctl_encode_UTF8)
-					? "UTF8"
-					: "ASCII",
-			elem_type->u.basic.integer.base,
-			elem_type->u.basic.integer.reverse_byte_order ? bo_reverse : bo_native,
+		elem_type = &field->type.u.array.elem_type.u.basic.integer;
+		ret = lttng_metadata_int_printf(session, elem_type,
+			elem_type->reverse_byte_order ? bo_reverse : bo_native,
+			" _%s[%u];\n",
 			field->name, field->type.u.array.length);
 		break;
 	}
 	case ustctl_atype_sequence:
 	{
-		const struct ustctl_basic_type *elem_type;
-		const struct ustctl_basic_type *length_type;
-
-		elem_type = &field->type.u.sequence.elem_type;
-		length_type = &field->type.u.sequence.length_type;
-		ret = lttng_metadata_printf(session,
-			"		integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } __%s_length;\n",
-			length_type->u.basic.integer.size,
-			(unsigned int) length_type->u.basic.integer.alignment,
-			length_type->u.basic.integer.signedness,
-			(length_type->u.basic.integer.encoding == ustctl_encode_none)
-				? "none"
-				: ((length_type->u.basic.integer.encoding == ustctl_encode_UTF8)
-					? "UTF8"
-					: "ASCII"),
-			length_type->u.basic.integer.base,
-			length_type->u.basic.integer.reverse_byte_order ? bo_reverse : bo_native,
+		const struct ustctl_integer_type *elem_type;
+		const struct ustctl_integer_type *length_type;
+
+		elem_type = &field->type.u.sequence.elem_type.u.basic.integer;
+		length_type = &field->type.u.sequence.length_type.u.basic.integer;
+		ret = lttng_metadata_int_printf(session, length_type,
+			length_type->reverse_byte_order ? bo_reverse : bo_native,
+			" __%s_length;\n",
 			field->name);
 		if (ret)
 			return ret;
 
-		ret = lttng_metadata_printf(session,
-			"		integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } _%s[ __%s_length ];\n",
-			elem_type->u.basic.integer.size,
-			(unsigned int) elem_type->u.basic.integer.alignment,
-			elem_type->u.basic.integer.signedness,
-			(elem_type->u.basic.integer.encoding == ustctl_encode_none)
-				? "none"
-				: ((elem_type->u.basic.integer.encoding == ustctl_encode_UTF8)
-					? "UTF8"
-					: "ASCII"),
-			elem_type->u.basic.integer.base,
-			elem_type->u.basic.integer.reverse_byte_order ? bo_reverse : bo_native,
+		ret = lttng_metadata_int_printf(session, elem_type,
+			elem_type->reverse_byte_order ? bo_reverse : bo_native,
+			" _%s[ __%s_length ];\n",
 			field->name,
 			field->name);
 		break;
@@ -318,6 +466,8 @@ int ust_metadata_event_statedump(struct ust_registry_session *session,
 		struct ust_registry_event *event)
 {
 	int ret = 0;
+	size_t body_start;
+	struct ust_registry_event_text *text;
 
 	/* Don't dump metadata events */
 	if (chan->chan_id == -1U)
@@ -334,6 +484,23 @@ int ust_metadata_event_statedump(struct ust_registry_session *session,
 	if (ret)
 		goto end;
 
+	/*
+	 * The rest of the event metadata only depends on its declaration,
+	 * reuse it if another registry already rendered it.
+	 */
+	rcu_read_lock();
+	text = rcu_dereference(event->decl->text);
+	if (text) {
+		ret = metadata_append(session, text->data, text->len);
+		rcu_read_unlock();
+		if (ret)
+			goto end;
+		event->metadata_dumped = 1;
+		goto end;
+	}
+	rcu_read_unlock();
+	body_start = session->metadata_len;
+
 	ret = lttng_metadata_printf(session,
 		"	loglevel = %d;\n",
 		event->loglevel);
@@ -380,6 +547,9 @@ int ust_metadata_event_statedump(struct ust_registry_session *session,
 		"};\n\n");
 	if (ret)
 		goto end;
+	ust_registry_event_decl_set_text(event->decl,
+		&session->metadata[body_start],
+		session->metadata_len - body_start);
 	event->metadata_dumped = 1;
 
 end:
@@ -20,6 +20,7 @@
 #include <inttypes.h>
 
 #include <common/common.h>
+#include <common/hashtable/rcu-batch.h>
 #include <common/hashtable/utils.h>
 #include <lttng/lttng.h>
 
@@ -27,6 +28,14 @@
 #include "ust-app.h"
 #include "utils.h"
 
+/*
+ * Event declarations shared by every registry, see ust_registry_event_decl.
+ * Allocated on first use. The lock protects the table content and the
+ * declaration refcounts.
+ */
+static struct lttng_ht *event_decl_ht;
+static pthread_mutex_t event_decl_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*
  * Hash table match function for event in the registry.
  */
@@ -73,6 +82,229 @@ static unsigned long ht_hash_event(void *_key, unsigned long seed)
 	return hash_key_u64(&xored_key, seed);
 }
 
+/*
+ * Hash table match function for the shared event declarations. The whole
+ * declaration must be identical.
+ */
+static int ht_match_event_decl(struct cds_lfht_node *node, const void *_key)
+{
+	struct ust_registry_event_decl *decl;
+	const struct ust_registry_event_decl *key;
+
+	assert(node);
+	assert(_key);
+
+	decl = caa_container_of(node, struct ust_registry_event_decl, node.node);
+	key = _key;
+
+	if (decl->byte_order != key->byte_order ||
+			decl->loglevel != key->loglevel ||
+			decl->nr_fields != key->nr_fields) {
+		goto no_match;
+	}
+
+	if (strncmp(decl->name, key->name, sizeof(decl->name)) != 0 ||
+			strcmp(decl->signature, key->signature) != 0) {
+		goto no_match;
+	}
+
+	if (!decl->model_emf_uri != !key->model_emf_uri ||
+			(decl->model_emf_uri &&
+			strcmp(decl->model_emf_uri, key->model_emf_uri) != 0)) {
+		goto no_match;
+	}
+
+	if (memcmp(decl->fields, key->fields,
+			decl->nr_fields * sizeof(*decl->fields)) != 0) {
+		goto no_match;
+	}
+
+	/* Match */
+	return 1;
+
+no_match:
+	return 0;
+}
+
+static unsigned long ht_hash_event_decl(void *_key, unsigned long seed)
+{
+	uint64_t xored_key;
+	struct ust_registry_event_decl *key = _key;
+
+	assert(key);
+
+	xored_key = (uint64_t) (hash_key_str(key->name, seed) ^
+			hash_key_str(key->signature, seed)) ^
+			(uint64_t) key->byte_order;
+
+	return hash_key_u64(&xored_key, seed);
+}
+
+static void destroy_event_decl_rcu(struct rcu_head *head)
+{
+	struct lttng_ht_node_u64 *node =
+		caa_container_of(head, struct lttng_ht_node_u64, head);
+	struct ust_registry_event_decl *decl =
+		caa_container_of(node, struct ust_registry_event_decl, node);
+
+	free(decl->text);
+	free(decl->fields);
+	free(decl->model_emf_uri);
+	free(decl->signature);
+	free(decl);
+}
+
+/*
+ * Get a reference on the shared declaration matching the given one, adding
+ * it to the table if none exists. On success, the ownership of sig, fields
+ * and model_emf_uri is taken: they are either kept by the new declaration or
+ * freed since an identical one exists.
+ *
+ * Return the declaration or NULL on error, the ownership being left to the
+ * caller.
+ */
+static struct ust_registry_event_decl *get_event_decl(const char *name,
+		char *sig, size_t nr_fields, struct ustctl_field *fields,
+		int loglevel, char *model_emf_uri, int byte_order)
+{
+	struct cds_lfht_node *nptr;
+	struct ust_registry_event_decl *decl;
+
+	decl = zmalloc(sizeof(*decl));
+	if (!decl) {
+		PERROR("zmalloc ust registry event declaration");
+		return NULL;
+	}
+	strncpy(decl->name, name, sizeof(decl->name));
+	decl->name[sizeof(decl->name) - 1] = '\0';
+	decl->signature = sig;
+	decl->loglevel = loglevel;
+	decl->nr_fields = nr_fields;
+	decl->fields = fields;
+	decl->model_emf_uri = model_emf_uri;
+	decl->byte_order = byte_order;
+	decl->refcount = 1;
+	cds_lfht_node_init(&decl->node.node);
+
+	pthread_mutex_lock(&event_decl_lock);
+	if (!event_decl_ht) {
+		event_decl_ht = lttng_ht_new(0, LTTNG_HT_TYPE_U64);
+		if (!event_decl_ht) {
+			pthread_mutex_unlock(&event_decl_lock);
+			free(decl);
+			return NULL;
+		}
+		event_decl_ht->match_fct = ht_match_event_decl;
+		event_decl_ht->hash_fct = ht_hash_event_decl;
+	}
+
+	rcu_read_lock();
+	nptr = cds_lfht_add_unique(event_decl_ht->ht,
+			event_decl_ht->hash_fct(decl, lttng_ht_seed),
+			event_decl_ht->match_fct, decl, &decl->node.node);
+	rcu_read_unlock();
+	if (nptr != &decl->node.node) {
+		/* Identical declaration already registered, share it. */
+		free(decl);
+		decl = caa_container_of(nptr, struct ust_registry_event_decl,
+				node.node);
+		decl->refcount++;
+		free(sig);
+		free(fields);
+		free(model_emf_uri);
+		DBG3("UST registry sharing event declaration %s", decl->name);
+	}
+	pthread_mutex_unlock(&event_decl_lock);
+
+	return decl;
+}
+
+/*
+ * Put a reference on a shared event declaration, removing it from the table
+ * on the last one.
+ */
+static void put_event_decl(struct ust_registry_event_decl *decl)
+{
+	int ret;
+	struct lttng_ht_iter iter;
+
+	pthread_mutex_lock(&event_decl_lock);
+	if (--decl->refcount) {
+		pthread_mutex_unlock(&event_decl_lock);
+		return;
+	}
+
+	rcu_read_lock();
+	iter.iter.node = &decl->node.node;
+	ret = lttng_ht_del(event_decl_ht, &iter);
+	assert(!ret);
+	rcu_read_unlock();
+	pthread_mutex_unlock(&event_decl_lock);
+
+	call_rcu(&decl->node.head, destroy_event_decl_rcu);
+}
+
+/*
+ * Release a push started from the metadata buffer, freeing the buffers
+ * replaced in the meantime once no push uses them anymore.
+ *
+ * The registry lock MUST be acquired.
+ */
+void ust_registry_metadata_push_put(struct ust_registry_session *session)
+{
+	struct ust_registry_metadata_retired *retired, *next;
+
+	assert(session);
+	assert(session->metadata_push_inflight > 0);
+
+	if (--session->metadata_push_inflight) {
+		return;
+	}
+
+	for (retired = session->metadata_retired; retired; retired = next) {
+		next = retired->next;
+		free(retired->metadata);
+		free(retired);
+	}
+	session->metadata_retired = NULL;
+}
+
+/*
+ * Keep the rendered metadata of an event declaration so the next registries
+ * dumping it only copy it. Only the first text set is kept.
+ *
+ * Called with a reference held on the declaration.
+ */
+void ust_registry_event_decl_set_text(struct ust_registry_event_decl *decl,
+		const char *text, size_t len)
+{
+	struct ust_registry_event_text *decl_text;
+
+	assert(decl);
+
+	if (rcu_dereference(decl->text)) {
+		return;
+	}
+
+	decl_text = zmalloc(sizeof(*decl_text) + len);
+	if (!decl_text) {
+		/* Not fatal, the metadata will be rendered again. */
+		PERROR("zmalloc ust registry event text");
+		return;
+	}
+	decl_text->len = len;
+	memcpy(decl_text->data, text, len);
+
+	pthread_mutex_lock(&event_decl_lock);
+	if (!decl->text) {
+		rcu_assign_pointer(decl->text, decl_text);
+		decl_text = NULL;
+	}
+	pthread_mutex_unlock(&event_decl_lock);
+
+	free(decl_text);
+}
+
 /*
  * Return negative value on error, 0 if OK.
  *
@@ -131,12 +363,14 @@ int validate_event_fields(size_t nr_fields, struct ustctl_field *fields,
  * Allocate event and initialize it. This does NOT set a valid event id from a
  * registry.
  */
-static struct ust_registry_event *alloc_event(int session_objd,
+static struct ust_registry_event *alloc_event(
+		struct ust_registry_session *session, int session_objd,
 		int channel_objd, char *name, char *sig, size_t nr_fields,
 		struct ustctl_field *fields, int loglevel, char *model_emf_uri,
 		struct ust_app *app)
 {
 	struct ust_registry_event *event = NULL;
+	struct ust_registry_event_decl *decl;
 
 	/*
 	 * Ensure that the field content is valid.
@@ -151,14 +385,23 @@ static struct ust_registry_event *alloc_event(int session_objd,
 		goto error;
 	}
 
+	/* Allocated by ustctl, owned by the declaration on success. */
+	decl = get_event_decl(name, sig, nr_fields, fields, loglevel,
+			model_emf_uri, session->byte_order);
+	if (!decl) {
+		free(event);
+		event = NULL;
+		goto error;
+	}
+
 	event->session_objd = session_objd;
 	event->channel_objd = channel_objd;
-	/* Allocated by ustctl. */
-	event->signature = sig;
-	event->nr_fields = nr_fields;
-	event->fields = fields;
-	event->loglevel = loglevel;
-	event->model_emf_uri = model_emf_uri;
+	event->decl = decl;
+	event->signature = decl->signature;
+	event->nr_fields = decl->nr_fields;
+	event->fields = decl->fields;
+	event->loglevel = decl->loglevel;
+	event->model_emf_uri = decl->model_emf_uri;
 	if (name) {
 		/* Copy event name and force NULL byte. */
 		strncpy(event->name, name, sizeof(event->name));
@@ -181,9 +424,7 @@ static void destroy_event(struct ust_registry_event *event)
 		return;
 	}
 
-	free(event->fields);
-	free(event->model_emf_uri);
-	free(event->signature);
+	put_event_decl(event->decl);
 	free(event);
 }
 
@@ -286,8 +527,8 @@ int ust_registry_create_event(struct ust_registry_session *session,
 		goto error_free;
 	}
 
-	event = alloc_event(session_objd, channel_objd, name, sig, nr_fields,
-			fields, loglevel, model_emf_uri, app);
+	event = alloc_event(session, session_objd, channel_objd, name, sig,
+			nr_fields, fields, loglevel, model_emf_uri, app);
 	if (!event) {
 		ret = -ENOMEM;
 		goto error_free;
@@ -357,6 +598,9 @@ error_unlock:
 /*
  * For a given event in a registry, delete the entry and destroy the event.
  * This MUST be called within a RCU read side lock section.
+ *
+ * The event is queued for a batched reclamation, so the caller MUST call
+ * lttng_rcu_batch_flush() once done destroying events.
  */
 void ust_registry_destroy_event(struct ust_registry_channel *chan,
 		struct ust_registry_event *event)
@@ -372,7 +616,7 @@ void ust_registry_destroy_event(struct ust_registry_channel *chan,
 	ret = lttng_ht_del(chan->ht, &iter);
 	assert(!ret);
 
-	call_rcu(&event->node.head, destroy_event_rcu);
+	lttng_rcu_batch_call(&event->node.head, destroy_event_rcu);
 
 	return;
 }
@@ -415,7 +659,9 @@ static void destroy_channel(struct ust_registry_channel *chan)
 		ust_registry_destroy_event(chan, event);
 	}
 	rcu_read_unlock();
-	call_rcu(&chan->rcu_head, destroy_channel_rcu);
+	/* Reclaim the channel and all its events with a single callback. */
+	lttng_rcu_batch_call(&chan->rcu_head, destroy_channel_rcu);
+	lttng_rcu_batch_flush();
 }
 
 /*
@@ -630,5 +876,7 @@ void ust_registry_session_destroy(struct ust_registry_session *reg)
 		ht_cleanup_push(reg->channels);
 	}
 
+	assert(!reg->metadata_push_inflight);
+	assert(!reg->metadata_retired);
 	free(reg->metadata);
 }
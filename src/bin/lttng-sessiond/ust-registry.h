@@ -31,6 +31,14 @@
 
 struct ust_app;
 
+/*
+ * Metadata buffer replaced while a push was sending from it.
+ */
+struct ust_registry_metadata_retired {
+	char *metadata;
+	struct ust_registry_metadata_retired *next;
+};
+
 struct ust_registry_session {
 	/*
 	 * With multiple writers and readers, use this lock to access the registry.
@@ -62,6 +70,14 @@ struct ust_registry_session {
 	size_t metadata_len, metadata_alloc_len;
 	/* Length of bytes sent to the consumer. */
 	size_t metadata_len_sent;
+	/*
+	 * Number of pushes currently sending straight from the metadata buffer
+	 * without holding the registry lock. While non zero, the buffer is
+	 * never reallocated in place: a grown copy replaces it and the old one
+	 * is kept in the retired list until the last push completes.
+	 */
+	unsigned int metadata_push_inflight;
+	struct ust_registry_metadata_retired *metadata_retired;
 	/*
 	 * Hash table containing channels sent by the UST tracer. MUST be accessed
 	 * with a RCU read side lock acquired.
@@ -111,6 +127,40 @@ struct ust_registry_channel {
 	struct rcu_head rcu_head;
 };
 
+/*
+ * Rendered metadata of an event declaration, from its loglevel to its end.
+ */
+struct ust_registry_event_text {
+	size_t len;
+	char data[];
+};
+
+/*
+ * Declaration of an event as received from the tracer. Every instance of a
+ * same binary registers identical declarations, so they are shared, content
+ * addressed, by the events of every registry instead of being kept per
+ * registry. The rendered metadata of the declaration is kept along with it so
+ * it is only generated once.
+ */
+struct ust_registry_event_decl {
+	/* The whole declaration is the key. */
+	char name[LTTNG_UST_SYM_NAME_LEN];
+	char *signature;
+	int loglevel;
+	size_t nr_fields;
+	struct ustctl_field *fields;
+	char *model_emf_uri;
+	/* Byte order of the registry, the rendered metadata depends on it. */
+	int byte_order;
+
+	/* Published once by the first registry dumping the event. */
+	struct ust_registry_event_text *text;
+	/* References held by registry events, protected by the table lock. */
+	unsigned long refcount;
+	/* Node in the global declaration table. */
+	struct lttng_ht_node_u64 node;
+};
+
 /*
  * Event registered from a UST tracer sent to the session daemon. This is
  * indexed and matched by <event_name/signature>.
@@ -122,6 +172,8 @@ struct ust_registry_event {
 	int channel_objd;
 	/* Name of the event returned by the tracer. */
 	char name[LTTNG_UST_SYM_NAME_LEN];
+	/* Shared declaration, the members below point into it. */
+	struct ust_registry_event_decl *decl;
 	char *signature;
 	int loglevel;
 	size_t nr_fields;
@@ -231,6 +283,9 @@ struct ust_registry_event *ust_registry_find_event(
 		struct ust_registry_channel *chan, char *name, char *sig);
 void ust_registry_destroy_event(struct ust_registry_channel *chan,
 		struct ust_registry_event *event);
+void ust_registry_metadata_push_put(struct ust_registry_session *session);
+void ust_registry_event_decl_set_text(struct ust_registry_event_decl *decl,
+		const char *text, size_t len);
 
 /* app can be NULL for registry shared across applications. */
 int ust_metadata_session_statedump(struct ust_registry_session *session,
@@ -236,6 +236,12 @@ static void usage(FILE *ofp)
 	fprintf(ofp, "                           characters including an empty sub-string (match 0 or\n");
 	fprintf(ofp, "                           more characters).\n");
 	fprintf(ofp, "\n");
+	fprintf(ofp, "                           A field can be tested for membership in a set of\n");
+	fprintf(ofp, "                           integer or string constants, without wildcards,\n");
+	fprintf(ofp, "                           like a chain of == comparisons joined by ||:\n");
+	fprintf(ofp, "                           'intfield in { 12, 57, 63 }'\n");
+	fprintf(ofp, "                           '!($ctx.procname in { \"demo\", \"test\" })'\n");
+	fprintf(ofp, "\n");
 	fprintf(ofp, "                           Context information can be used for filtering. The\n");
 	fprintf(ofp, "                           examples below show usage of context filtering on\n");
 	fprintf(ofp, "                           process name (with a wildcard), process ID range, and\n");
@@ -679,6 +685,58 @@ end:
 	*exclusion_list_ptr = exclusion_list;
 	return ret;
 }
+
+/*
+ * Fetch the filter cost estimate of an event just enabled with a filter from
+ * the session daemon into ev, print it and warn if it is above a threshold.
+ * Events of the same name with other filters may exist, the most expensive
+ * estimate is reported.
+ */
+static
+void report_filter_cost(const char *channel_name, struct lttng_event *ev)
+{
+	int i, count;
+	struct lttng_event *events = NULL;
+	struct lttng_event_filter_cost *cost = &ev->filter_cost;
+
+	switch (handle->domain.type) {
+	case LTTNG_DOMAIN_JUL:
+	case LTTNG_DOMAIN_LOG4J:
+	case LTTNG_DOMAIN_PYTHON:
+		/* Agent events are listed without a channel. */
+		channel_name = "";
+		break;
+	default:
+		channel_name = print_channel_name(channel_name);
+		break;
+	}
+
+	count = lttng_list_events(handle, channel_name, &events);
+	if (count < 0) {
+		DBG("Unable to list events for the filter cost: %s",
+				lttng_strerror(count));
+		return;
+	}
+	memset(cost, 0, sizeof(*cost));
+	for (i = 0; i < count; i++) {
+		if (!events[i].filter || strcmp(events[i].name, ev->name) ||
+				events[i].filter_cost.nr_insns <= cost->nr_insns) {
+			continue;
+		}
+		*cost = events[i].filter_cost;
+	}
+	free(events);
+
+	/* None from older session daemons. */
+	if (cost->nr_insns == 0) {
+		return;
+	}
+	MSG("Event %s: Filter cost estimate: %u instructions, %u string "
+			"comparisons, %u field loads", ev->name, cost->nr_insns,
+			cost->nr_string_compares, cost->nr_field_loads);
+	check_filter_cost(ev->name, cost, 1);
+}
+
 /*
  * Enabling event using the lttng API.
  * Note: in case of error only the last error code will be return.
@@ -951,6 +1009,7 @@ static int enable_events(char *session_name)
 			} else {
 				ev.filter = 1;
 				MSG("Filter '%s' successfully set", opt_filter);
+				report_filter_cost(channel_name, &ev);
 			}
 		}
 
@@ -1273,6 +1332,7 @@ static int enable_events(char *session_name)
 				MSG("Event %s%s: Filter '%s' successfully set",
 						event_name, exclusion_string,
 						opt_filter);
+				report_filter_cost(channel_name, &ev);
 			}
 			free(exclusion_string);
 		}
@@ -225,6 +225,24 @@ static const char *bitness_event(enum lttng_event_flag flags)
 	}
 }
 
+/*
+ * Pretty print the filter cost estimate of an event, if it has one. Session
+ * daemons predating the estimate report none.
+ */
+static void print_filter_cost(struct lttng_event *event, const char *indent)
+{
+	const struct lttng_event_filter_cost *cost = &event->filter_cost;
+
+	if (!event->filter || cost->nr_insns == 0) {
+		return;
+	}
+	MSG("%sfilter cost: %u instructions, %u string comparisons, "
+			"%u field loads%s", indent, cost->nr_insns,
+			cost->nr_string_compares, cost->nr_field_loads,
+			check_filter_cost(event->name, cost, 0) ?
+				" [above warning threshold]" : "");
+}
+
 /*
  * Pretty print single event.
  */
@@ -251,6 +269,7 @@ static void print_events(struct lttng_event *event)
 				exclusion_string(event->exclusion),
 				filter_string(event->filter));
 		}
+		print_filter_cost(event, indent8);
 		break;
 	}
 	case LTTNG_EVENT_FUNCTION:
@@ -993,11 +1012,13 @@ static int list_session_agent_events(void)
 		}
 
 		for (i = 0; i < count; i++) {
-			MSG("%s- %s%s (loglevel%s %s)", indent4, events[i].name,
+			MSG("%s- %s%s (loglevel%s %s)%s", indent4, events[i].name,
 					enabled_string(events[i].enabled),
 					logleveltype_string(events[i].loglevel_type),
 					mi_lttng_loglevel_string(events[i].loglevel,
-						handle->domain.type));
+						handle->domain.type),
+					filter_string(events[i].filter));
+			print_filter_cost(&events[i], indent6);
 		}
 
 		MSG("");
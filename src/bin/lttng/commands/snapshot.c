@@ -40,6 +40,7 @@ static const char *opt_data_url;
 static const char *opt_ctrl_url;
 static const char *current_session_name;
 static uint64_t opt_max_size;
+static int opt_incremental;
 
 /* Stub for the cmd struct actions. */
 static int cmd_add_output(int argc, const char **argv);
@@ -66,6 +67,7 @@ static struct poptOption snapshot_opts[] = {
 	{"data-url",     'D', POPT_ARG_STRING, &opt_data_url, 0, 0, 0},
 	{"name",         'n', POPT_ARG_STRING, &opt_output_name, 0, 0, 0},
 	{"max-size",     'm', POPT_ARG_STRING, 0, OPT_MAX_SIZE, 0, 0},
+	{"incremental",    0, POPT_ARG_VAL, &opt_incremental, 1, 0, 0},
 	{"list-options",   0, POPT_ARG_NONE, NULL, OPT_LIST_OPTIONS, NULL, NULL},
 	{"list-commands",  0, POPT_ARG_NONE, NULL, OPT_LIST_COMMANDS},
 	{0, 0, 0, 0, 0, 0, 0}
@@ -96,12 +98,14 @@ static void usage(FILE *ofp)
 	fprintf(ofp, "   list-output [-s <NAME>]\n");
 	fprintf(ofp, "      List the output of a session.\n");
 	fprintf(ofp, "\n");
-	fprintf(ofp, "   record [-m <SIZE>] [-s <NAME>] [-n <NAME>] [<URL> | -C <URL> -D <URL>]\n");
+	fprintf(ofp, "   record [-m <SIZE>] [-s <NAME>] [-n <NAME>] [--incremental] [<URL> | -C <URL> -D <URL>]\n");
 	fprintf(ofp, "      Snapshot a session's buffer(s) for all domains. If an URL is\n");
 	fprintf(ofp, "      specified, it is used instead of a previously added output.\n");
 	fprintf(ofp, "      Specifying only a name or/a size will override the current output value.\n");
 	fprintf(ofp, "      For instance, you can record a snapshot with a custom maximum size\n");
 	fprintf(ofp, "      or with a different name.\n");
+	fprintf(ofp, "      With --incremental, only the packets produced since the previous\n");
+	fprintf(ofp, "      snapshot are recorded.\n");
 	fprintf(ofp, "\n");
 	fprintf(ofp, "Options:\n");
 	fprintf(ofp, "  -h, --help           Show this help\n");
@@ -111,6 +115,7 @@ static void usage(FILE *ofp)
 	fprintf(ofp, "  -m, --max-size SIZE  Maximum bytes size of the snapshot {+k,+M,+G}\n");
 	fprintf(ofp, "  -C, --ctrl-url URL   Set control path URL. (Must use -D also)\n");
 	fprintf(ofp, "  -D, --data-url URL   Set data path URL. (Must use -C also)\n");
+	fprintf(ofp, "      --incremental    Only record what changed since the previous snapshot\n");
 	fprintf(ofp, "\n");
 }
 
@@ -520,6 +525,19 @@ static int cmd_list_output(int argc, const char **argv)
 	return ret;
 }
 
+/*
+ * Record a snapshot of the current session to the given output, only with the
+ * new data if --incremental was given.
+ */
+static int record_output(struct lttng_snapshot_output *output)
+{
+	if (opt_incremental) {
+		return lttng_snapshot_record_incremental(current_session_name,
+				output, 0);
+	}
+	return lttng_snapshot_record(current_session_name, output, 0);
+}
+
 /*
  * Do a snapshot record with the URL if one is given (machine interface).
  */
@@ -534,7 +552,7 @@ static int mi_record(const char *url)
 		goto error;
 	}
 
-	ret = lttng_snapshot_record(current_session_name, output, 0);
+	ret = record_output(output);
 	if (ret < 0) {
 		ret = CMD_ERROR;
 		goto error;
@@ -565,7 +583,7 @@ static int record(const char *url)
 		goto error;
 	}
 
-	ret = lttng_snapshot_record(current_session_name, output, 0);
+	ret = record_output(output);
 	if (ret < 0) {
 		if (ret == -LTTNG_ERR_MAX_SIZE_INVALID) {
 			ERR("The minimum size of a snapshot is computed by multiplying "
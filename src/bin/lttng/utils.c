@@ -383,3 +383,73 @@ error:
 error_socket:
 	return ret;
 }
+
+/*
+ * Get a filter cost threshold from the environment, or its default value if
+ * unset or invalid.
+ */
+static
+unsigned long get_filter_cost_threshold(const char *env_name,
+		unsigned long default_value)
+{
+	const char *env;
+	char *end;
+	unsigned long value;
+
+	env = getenv(env_name);
+	if (!env) {
+		return default_value;
+	}
+	errno = 0;
+	value = strtoul(env, &end, 10);
+	if (errno || end == env || *end != '\0') {
+		WARN("Invalid %s value: %s", env_name, env);
+		return default_value;
+	}
+	return value;
+}
+
+/*
+ * Check each part of the filter cost estimate of an event against its
+ * threshold and warn about the ones above it if warn is set.
+ *
+ * Return the number of parts above their threshold.
+ */
+int check_filter_cost(const char *event_name,
+		const struct lttng_event_filter_cost *cost, int warn)
+{
+	int i, nr_above = 0;
+	const struct {
+		unsigned int value;
+		const char *env_name;
+		unsigned long default_threshold;
+		const char *label;
+	} parts[] = {
+		{ cost->nr_insns, DEFAULT_FILTER_COST_WARN_INSNS_ENV,
+			DEFAULT_FILTER_COST_WARN_INSNS, "instructions" },
+		{ cost->nr_string_compares,
+			DEFAULT_FILTER_COST_WARN_STRING_COMPARES_ENV,
+			DEFAULT_FILTER_COST_WARN_STRING_COMPARES,
+			"string comparisons" },
+		{ cost->nr_field_loads, DEFAULT_FILTER_COST_WARN_FIELD_LOADS_ENV,
+			DEFAULT_FILTER_COST_WARN_FIELD_LOADS, "field loads" },
+	};
+
+	for (i = 0; i < ARRAY_SIZE(parts); i++) {
+		unsigned long threshold;
+
+		threshold = get_filter_cost_threshold(parts[i].env_name,
+				parts[i].default_threshold);
+		if (threshold == 0 || parts[i].value <= threshold) {
+			continue;
+		}
+		nr_above++;
+		if (warn) {
+			WARN("Filter of event %s: up to %u %s per evaluation, "
+					"above the threshold of %lu (%s)", event_name,
+					parts[i].value, parts[i].label, threshold,
+					parts[i].env_name);
+		}
+	}
+	return nr_above;
+}
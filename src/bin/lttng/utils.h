@@ -60,4 +60,7 @@ void print_missing_domain(void)
 int spawn_relayd(const char *pathname, int port);
 int check_relayd(void);
 
+int check_filter_cost(const char *event_name,
+		const struct lttng_event_filter_cost *cost, int warn);
+
 #endif /* _LTTNG_UTILS_H */
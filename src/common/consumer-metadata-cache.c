@@ -72,36 +72,94 @@ end:
 }
 
 /*
- * Write metadata to the cache, extend the cache if necessary. We support
- * non-contiguous updates but not overlapping ones. If there is contiguous
- * metadata in the cache, we send it to the ring buffer. The metadata cache
- * lock MUST be acquired to write in the cache.
+ * Reserve the [offset, offset + len) range of the cache, extending it if
+ * necessary, so the caller can fill it in place before committing it with
+ * consumer_metadata_cache_commit() or giving it up with
+ * consumer_metadata_cache_cancel(). The metadata cache lock MUST be acquired
+ * to reserve, commit and cancel. It can be released while the range is being
+ * filled: the range is not visible to the readers before it is committed and
+ * the cache is not reallocated while a range is reserved.
  *
- * Return 0 on success, a negative value on error.
+ * Return the address of the range or NULL on error.
  */
-int consumer_metadata_cache_write(struct lttng_consumer_channel *channel,
-		unsigned int offset, unsigned int len, char *data)
+char *consumer_metadata_cache_reserve(struct lttng_consumer_channel *channel,
+		unsigned int offset, unsigned int len)
 {
-	int ret = 0;
-	int size_ret;
+	int ret;
 	struct consumer_metadata_cache *cache;
 
 	assert(channel);
 	assert(channel->metadata_cache);
 
 	cache = channel->metadata_cache;
-	DBG("Writing %u bytes from offset %u in metadata cache", len, offset);
 
+	if (offset + len > cache->cache_alloc_size) {
+		/* Ranges being filled point into the current allocation. */
+		while (cache->nr_reserved > 0) {
+			pthread_cond_wait(&cache->reserved_cond, &cache->lock);
+		}
+	}
+	/* The cache might have been extended while waiting. */
 	if (offset + len > cache->cache_alloc_size) {
 		ret = extend_metadata_cache(channel,
 				len - cache->cache_alloc_size + offset);
 		if (ret < 0) {
 			ERR("Extending metadata cache");
-			goto end;
+			return NULL;
 		}
 	}
+	cache->nr_reserved++;
+
+	return cache->data + offset;
+}
+
+/*
+ * Release a reservation of the cache. The metadata cache lock MUST be
+ * acquired.
+ */
+static void release_reservation(struct consumer_metadata_cache *cache)
+{
+	assert(cache->nr_reserved > 0);
+
+	cache->nr_reserved--;
+	if (cache->nr_reserved == 0) {
+		pthread_cond_broadcast(&cache->reserved_cond);
+	}
+}
 
-	memcpy(cache->data + offset, data, len);
+/*
+ * Give up a range reserved by consumer_metadata_cache_reserve() without
+ * making it visible. The metadata cache lock MUST be acquired.
+ */
+void consumer_metadata_cache_cancel(struct lttng_consumer_channel *channel)
+{
+	assert(channel);
+	assert(channel->metadata_cache);
+
+	release_reservation(channel->metadata_cache);
+}
+
+/*
+ * Account for a range filled after a consumer_metadata_cache_reserve(). We
+ * support non-contiguous updates but not overlapping ones. If there is
+ * contiguous metadata in the cache, we send it to the ring buffer. The
+ * metadata cache lock MUST be acquired.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+int consumer_metadata_cache_commit(struct lttng_consumer_channel *channel,
+		unsigned int offset, unsigned int len)
+{
+	int ret = 0;
+	int size_ret;
+	struct consumer_metadata_cache *cache;
+
+	assert(channel);
+	assert(channel->metadata_cache);
+
+	cache = channel->metadata_cache;
+
+	release_reservation(cache);
 	cache->total_bytes_written += len;
 	if (offset + len > cache->max_offset) {
 		cache->max_offset = offset + len;
@@ -126,6 +184,30 @@ end:
 	return ret;
 }
 
+/*
+ * Write metadata to the cache, extend the cache if necessary. We support
+ * non-contiguous updates but not overlapping ones. If there is contiguous
+ * metadata in the cache, we send it to the ring buffer. The metadata cache
+ * lock MUST be acquired to write in the cache.
+ *
+ * Return 0 on success, a negative value on error.
+ */
+int consumer_metadata_cache_write(struct lttng_consumer_channel *channel,
+		unsigned int offset, unsigned int len, char *data)
+{
+	char *dst;
+
+	DBG("Writing %u bytes from offset %u in metadata cache", len, offset);
+
+	dst = consumer_metadata_cache_reserve(channel, offset, len);
+	if (!dst) {
+		return -1;
+	}
+	memcpy(dst, data, len);
+
+	return consumer_metadata_cache_commit(channel, offset, len);
+}
+
 /*
  * Create the metadata cache, original allocated size: max_sb_size
  *
@@ -149,6 +231,11 @@ int consumer_metadata_cache_allocate(struct lttng_consumer_channel *channel)
 		PERROR("mutex init");
 		goto end_free_cache;
 	}
+	ret = pthread_cond_init(&channel->metadata_cache->reserved_cond, NULL);
+	if (ret != 0) {
+		PERROR("cond init");
+		goto end_free_mutex;
+	}
 
 	channel->metadata_cache->cache_alloc_size = DEFAULT_METADATA_CACHE_SIZE;
 	channel->metadata_cache->data = zmalloc(
@@ -156,7 +243,7 @@ int consumer_metadata_cache_allocate(struct lttng_consumer_channel *channel)
 	if (!channel->metadata_cache->data) {
 		PERROR("zmalloc metadata cache data");
 		ret = -1;
-		goto end_free_mutex;
+		goto end_free_cond;
 	}
 	DBG("Allocated metadata cache of %" PRIu64 " bytes",
 			channel->metadata_cache->cache_alloc_size);
@@ -164,6 +251,8 @@ int consumer_metadata_cache_allocate(struct lttng_consumer_channel *channel)
 	ret = 0;
 	goto end;
 
+end_free_cond:
+	pthread_cond_destroy(&channel->metadata_cache->reserved_cond);
 end_free_mutex:
 	pthread_mutex_destroy(&channel->metadata_cache->lock);
 end_free_cache:
@@ -183,6 +272,7 @@ void consumer_metadata_cache_destroy(struct lttng_consumer_channel *channel)
 
 	DBG("Destroying metadata cache");
 
+	pthread_cond_destroy(&channel->metadata_cache->reserved_cond);
 	pthread_mutex_destroy(&channel->metadata_cache->lock);
 	free(channel->metadata_cache->data);
 	free(channel->metadata_cache);
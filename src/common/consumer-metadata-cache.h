@@ -40,6 +40,14 @@ struct consumer_metadata_cache {
 	 * The metadata cache updates must not overlap.
 	 */
 	uint64_t max_offset;
+	/*
+	 * Number of ranges reserved but not committed yet. They are filled
+	 * without the lock held so the data is not reallocated until they are
+	 * all committed or cancelled.
+	 */
+	unsigned int nr_reserved;
+	/* Signaled, with the lock held, when nr_reserved drops to 0. */
+	pthread_cond_t reserved_cond;
 	/*
 	 * Lock to update the metadata cache and push into the ring_buffer
 	 * (ustctl_write_metadata_to_channel).
@@ -49,6 +57,11 @@ struct consumer_metadata_cache {
 	pthread_mutex_t lock;
 };
 
+char *consumer_metadata_cache_reserve(struct lttng_consumer_channel *channel,
+		unsigned int offset, unsigned int len);
+int consumer_metadata_cache_commit(struct lttng_consumer_channel *channel,
+		unsigned int offset, unsigned int len);
+void consumer_metadata_cache_cancel(struct lttng_consumer_channel *channel);
 int consumer_metadata_cache_write(struct lttng_consumer_channel *channel,
 		unsigned int offset, unsigned int len, char *data);
 int consumer_metadata_cache_allocate(struct lttng_consumer_channel *channel);
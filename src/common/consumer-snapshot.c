@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2015 - EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#define _LGPL_SOURCE
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <bin/lttng-consumerd/health-consumerd.h>
+#include <common/align.h>
+#include <common/common.h>
+#include <common/defaults.h>
+#include <common/utils.h>
+
+#include "consumer-snapshot.h"
+#include "consumer-stream.h"
+
+/*
+ * Header preceding every staged sub-buffer in the staging area.
+ */
+struct staged_subbuf {
+	struct lttng_consumer_stream *stream;
+	/* Length of the sub-buffer data. */
+	unsigned long len;
+	/* Padding following the data. */
+	unsigned long padding;
+	/* Bytes copied after this header (len or len + padding). */
+	unsigned long copied;
+	/* Index entry written along the sub-buffer if has_index is set. */
+	struct ctf_packet_index index;
+	unsigned int has_index;
+};
+
+static struct consumer_snapshot_staging staging = {
+	.base = NULL,
+	.size = DEFAULT_SNAPSHOT_STAGING_SIZE,
+	.used = 0,
+	.nb_subbuf = 0,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*
+ * Read the staging area size from the environment. The area itself is only
+ * allocated on the first snapshot so consumers that never record one don't
+ * pay for it.
+ *
+ * Return 0 on success or else a negative value.
+ */
+int consumer_snapshot_staging_init(void)
+{
+	int ret;
+	const char *env;
+	uint64_t size;
+
+	env = getenv(DEFAULT_SNAPSHOT_STAGING_SIZE_ENV);
+	if (!env) {
+		ret = 0;
+		goto end;
+	}
+
+	ret = utils_parse_size_suffix(env, &size);
+	if (ret < 0) {
+		ERR("Invalid %s value: %s", DEFAULT_SNAPSHOT_STAGING_SIZE_ENV, env);
+		goto end;
+	}
+	staging.size = PAGE_ALIGN((size_t) size);
+	DBG("Snapshot staging area size set to %zu bytes", staging.size);
+
+end:
+	return ret;
+}
+
+/*
+ * Release the staging area memory.
+ */
+void consumer_snapshot_staging_fini(void)
+{
+	int ret;
+
+	pthread_mutex_lock(&staging.lock);
+	if (staging.base) {
+		ret = munmap(staging.base, staging.size);
+		if (ret) {
+			PERROR("munmap snapshot staging area");
+		}
+		staging.base = NULL;
+	}
+	pthread_mutex_unlock(&staging.lock);
+}
+
+/*
+ * Acquire the staging area for a channel snapshot, allocating it if needed.
+ * The memory is populated once and then reused by every subsequent snapshot
+ * so the copy never faults.
+ *
+ * On allocation failure, staging is disabled and the snapshot is written
+ * directly from the ring buffer. Must be paired with
+ * consumer_snapshot_staging_end().
+ *
+ * Return 0 on success.
+ */
+int consumer_snapshot_staging_begin(void)
+{
+	void *base;
+
+	pthread_mutex_lock(&staging.lock);
+
+	assert(staging.used == 0);
+
+	if (staging.base || staging.size == 0) {
+		goto end;
+	}
+
+	base = mmap(NULL, staging.size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (base == MAP_FAILED) {
+		PERROR("mmap snapshot staging area of %zu bytes", staging.size);
+		staging.size = 0;
+		goto end;
+	}
+	staging.base = base;
+	DBG("Snapshot staging area of %zu bytes allocated", staging.size);
+
+end:
+	return 0;
+}
+
+/*
+ * Release the staging area. Anything still staged is discarded, which only
+ * happens on error since the caller drains the area on success.
+ */
+void consumer_snapshot_staging_end(void)
+{
+	if (staging.used) {
+		DBG("Discarding %u staged snapshot sub-buffers", staging.nb_subbuf);
+	}
+	staging.used = 0;
+	staging.nb_subbuf = 0;
+	pthread_mutex_unlock(&staging.lock);
+}
+
+/*
+ * Copy the sub-buffer currently held by the consumer for the given stream in
+ * the staging area. The caller can release the sub-buffer right after.
+ *
+ * If staging is disabled or if the sub-buffer is larger than the whole
+ * staging area, it is written directly to the stream output instead.
+ *
+ * If index is not NULL, it is written to the stream index once the
+ * sub-buffer is written out.
+ *
+ * The stream lock MUST be acquired and the staging area MUST be held.
+ *
+ * Return 0 on success, -ENOSPC if the staging area must be drained before
+ * retrying, or else a negative value.
+ */
+int consumer_snapshot_stage_subbuffer(struct lttng_consumer_local_data *ctx,
+		struct lttng_consumer_stream *stream, unsigned long len,
+		unsigned long padding, struct ctf_packet_index *index)
+{
+	int ret;
+	const char *src;
+	unsigned long copy_len;
+	size_t needed;
+	struct staged_subbuf *hdr;
+
+	assert(stream);
+
+	/* The relayd only receives the data, the padding is implicit. */
+	if (stream->net_seq_idx != (uint64_t) -1ULL) {
+		copy_len = len;
+	} else {
+		copy_len = len + padding;
+	}
+	needed = ALIGN(sizeof(*hdr) + copy_len, sizeof(void *));
+
+	if (!staging.base || needed > staging.size - staging.used) {
+		ssize_t written;
+
+		if (staging.used) {
+			/* Keep the sub-buffers ordered, drain before going direct. */
+			ret = -ENOSPC;
+			goto end;
+		}
+
+		written = lttng_consumer_on_read_subbuffer_mmap(ctx, stream, len,
+				padding, index);
+		if (written != (ssize_t) copy_len) {
+			ERR("Snapshot write of stream %s (ret: %zd != len: %lu)",
+					stream->name, written, copy_len);
+			ret = -EPERM;
+			goto end;
+		}
+		if (index) {
+			ret = consumer_stream_write_index(stream, index);
+		} else {
+			ret = 0;
+		}
+		goto end;
+	}
+
+	ret = lttng_consumer_get_subbuffer_addr(stream, &src);
+	if (ret < 0) {
+		goto end;
+	}
+
+	hdr = (struct staged_subbuf *) (staging.base + staging.used);
+	hdr->stream = stream;
+	hdr->len = len;
+	hdr->padding = padding;
+	hdr->copied = copy_len;
+	if (index) {
+		hdr->index = *index;
+		hdr->has_index = 1;
+	} else {
+		hdr->has_index = 0;
+	}
+	memcpy(hdr + 1, src, copy_len);
+
+	staging.used += needed;
+	staging.nb_subbuf++;
+
+end:
+	return ret;
+}
+
+/*
+ * Write every staged sub-buffer to its stream output, in the order they were
+ * staged, and empty the staging area.
+ *
+ * The staging area MUST be held and NO stream lock must be held by the
+ * caller since each stream is locked while its data is written.
+ *
+ * Return 0 on success or else a negative value.
+ */
+int consumer_snapshot_staging_drain(struct lttng_consumer_local_data *ctx)
+{
+	int ret = 0;
+	size_t offset = 0;
+	unsigned int nb_subbuf = 0;
+	struct lttng_consumer_stream *locked = NULL;
+
+	while (offset < staging.used) {
+		ssize_t written;
+		struct staged_subbuf *hdr;
+
+		hdr = (struct staged_subbuf *) (staging.base + offset);
+		if (hdr->stream != locked) {
+			if (locked) {
+				pthread_mutex_unlock(&locked->lock);
+			}
+			locked = hdr->stream;
+			pthread_mutex_lock(&locked->lock);
+		}
+
+		health_code_update();
+
+		written = lttng_consumer_write_subbuffer(ctx, hdr->stream,
+				(const char *) (hdr + 1), hdr->len, hdr->padding,
+				hdr->has_index ? &hdr->index : NULL);
+		if (written != (ssize_t) hdr->copied) {
+			ERR("Snapshot staged write of stream %s (ret: %zd != len: %lu)",
+					hdr->stream->name, written, hdr->copied);
+			ret = -EPERM;
+			break;
+		}
+		if (hdr->has_index) {
+			ret = consumer_stream_write_index(hdr->stream, &hdr->index);
+			if (ret < 0) {
+				ERR("Snapshot index write of stream %s", hdr->stream->name);
+				break;
+			}
+		}
+
+		offset += ALIGN(sizeof(*hdr) + hdr->copied, sizeof(void *));
+		nb_subbuf++;
+	}
+	if (locked) {
+		pthread_mutex_unlock(&locked->lock);
+	}
+
+	DBG("Snapshot staging drained %u of %u sub-buffers (%zu bytes)",
+			nb_subbuf, staging.nb_subbuf, offset);
+
+	staging.used = 0;
+	staging.nb_subbuf = 0;
+	return ret;
+}
+
+/*
+ * Return the ring buffer position from which a snapshot of the stream must
+ * start given the consumed and produced positions of the ring buffer.
+ *
+ * For an incremental snapshot, the packets captured by the previous snapshot
+ * of the stream are skipped if it was recorded to the same output. Otherwise,
+ * the output does not have them and the capture is complete. If some packets
+ * were overwritten since then, the capture starts at the oldest packet still
+ * available.
+ *
+ * The stream lock MUST be acquired.
+ */
+unsigned long consumer_snapshot_get_start_pos(
+		struct lttng_consumer_stream *stream, unsigned long consumed_pos,
+		unsigned long produced_pos, int incremental, uint64_t output_key)
+{
+	assert(stream);
+
+	if (!incremental || !stream->snapshot_pos_valid ||
+			stream->snapshot_last_pos > produced_pos) {
+		goto end;
+	}
+
+	if (stream->snapshot_output_key != output_key) {
+		DBG("Previous snapshot of stream %s was recorded to another output",
+				stream->name);
+		goto end;
+	}
+
+	if (stream->snapshot_last_pos < consumed_pos) {
+		DBG("Snapshot of stream %s lost %lu bytes since the previous one",
+				stream->name, consumed_pos - stream->snapshot_last_pos);
+		goto end;
+	}
+
+	DBG("Incremental snapshot of stream %s skips %lu bytes", stream->name,
+			stream->snapshot_last_pos - consumed_pos);
+	consumed_pos = stream->snapshot_last_pos;
+
+end:
+	return consumed_pos;
+}
+
+/*
+ * Remember that the stream was captured up to the given position to the
+ * given output so the next incremental snapshot to it starts from there.
+ *
+ * The stream lock MUST be acquired.
+ */
+void consumer_snapshot_set_captured(struct lttng_consumer_stream *stream,
+		unsigned long produced_pos, uint64_t output_key)
+{
+	assert(stream);
+
+	stream->snapshot_last_pos = produced_pos;
+	stream->snapshot_output_key = output_key;
+	stream->snapshot_pos_valid = 1;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2015 - EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CONSUMER_SNAPSHOT_H
+#define CONSUMER_SNAPSHOT_H
+
+#include <common/consumer.h>
+#include <common/index/ctf-index.h>
+
+/*
+ * Snapshot staging area.
+ *
+ * When recording a snapshot, the sub-buffers of every stream of a channel are
+ * first copied in this bounded memory area and only then written to the trace
+ * files or sent to the relayd. The ring buffers are thus released as soon as
+ * the copy is done and the captured window is not stretched by the I/O.
+ */
+struct consumer_snapshot_staging {
+	/* Anonymous mapping holding the staged sub-buffers. */
+	char *base;
+	/* Capacity of the mapping in bytes. 0 means staging is disabled. */
+	size_t size;
+	/* Bytes of the mapping currently in use. */
+	size_t used;
+	/* Number of sub-buffers currently staged. */
+	unsigned int nb_subbuf;
+	/*
+	 * Protects the staging area for the whole duration of a channel
+	 * snapshot (from begin to end).
+	 *
+	 * This is nested OUTSIDE the stream lock.
+	 */
+	pthread_mutex_t lock;
+};
+
+int consumer_snapshot_staging_init(void);
+void consumer_snapshot_staging_fini(void);
+int consumer_snapshot_staging_begin(void);
+void consumer_snapshot_staging_end(void);
+int consumer_snapshot_stage_subbuffer(struct lttng_consumer_local_data *ctx,
+		struct lttng_consumer_stream *stream, unsigned long len,
+		unsigned long padding, struct ctf_packet_index *index);
+int consumer_snapshot_staging_drain(struct lttng_consumer_local_data *ctx);
+
+unsigned long consumer_snapshot_get_start_pos(
+		struct lttng_consumer_stream *stream, unsigned long consumed_pos,
+		unsigned long produced_pos, int incremental, uint64_t output_key);
+void consumer_snapshot_set_captured(struct lttng_consumer_stream *stream,
+		unsigned long produced_pos, uint64_t output_key);
+
+#endif /* CONSUMER_SNAPSHOT_H */
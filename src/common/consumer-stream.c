@@ -32,6 +32,7 @@
 #include <common/utils.h>
 
 #include "consumer-stream.h"
+#include "consumer-tracefile.h"
 
 /*
  * RCU call to free stream. MUST only be used with call_rcu().
@@ -155,6 +156,8 @@ void consumer_stream_close(struct lttng_consumer_stream *stream)
 		assert(0);
 	}
 
+	consumer_tracefile_release(stream);
+
 	/* Close output fd. Could be a socket or local file at this point. */
 	if (stream->out_fd >= 0) {
 		ret = close(stream->out_fd);
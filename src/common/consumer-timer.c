@@ -20,51 +20,166 @@
 #define _LGPL_SOURCE
 #include <assert.h>
 #include <inttypes.h>
-#include <signal.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <bin/lttng-consumerd/health-consumerd.h>
 #include <common/common.h>
 #include <common/compat/endian.h>
+#include <common/defaults.h>
 #include <common/kernel-ctl/kernel-ctl.h>
 #include <common/kernel-consumer/kernel-consumer.h>
 #include <common/consumer-stream.h>
+#include <common/relayd/relayd.h>
 
 #include "consumer-timer.h"
 #include "consumer-testpoint.h"
 #include "ust-consumer/ust-consumer.h"
 
-static struct timer_signal_data timer_signal = {
-	.tid = 0,
-	.setup_done = 0,
-	.qs_done = 0,
+static struct consumer_timer_wheel wheel = {
+	.timerfd = -1,
+	.current_tick = 0,
+	.next_expiry = 0,
+	.running = NULL,
+	.tid_set = 0,
 	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
 };
 
 /*
- * Set custom signal mask to current thread.
+ * Return the current time in wheel ticks.
  */
-static void setmask(sigset_t *mask)
+static uint64_t get_current_tick(void)
 {
 	int ret;
+	struct timespec now;
 
-	ret = sigemptyset(mask);
-	if (ret) {
-		PERROR("sigemptyset");
+	ret = clock_gettime(CLOCKID, &now);
+	if (ret < 0) {
+		PERROR("clock_gettime timer wheel");
+		return wheel.current_tick;
 	}
-	ret = sigaddset(mask, LTTNG_CONSUMER_SIG_SWITCH);
-	if (ret) {
-		PERROR("sigaddset switch");
+	return ((uint64_t) now.tv_sec * 1000000ULL + now.tv_nsec / 1000) /
+		DEFAULT_CONSUMER_TIMER_WHEEL_TICK;
+}
+
+/*
+ * Program the timerfd to expire at the given tick. A zero tick disarms it.
+ *
+ * The wheel lock MUST be acquired.
+ */
+static void wheel_program(uint64_t tick)
+{
+	int ret;
+	uint64_t usec = tick * DEFAULT_CONSUMER_TIMER_WHEEL_TICK;
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = usec / 1000000ULL;
+	its.it_value.tv_nsec = (usec % 1000000ULL) * 1000;
+
+	ret = timerfd_settime(wheel.timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+	if (ret < 0) {
+		PERROR("timerfd_settime");
+		return;
 	}
-	ret = sigaddset(mask, LTTNG_CONSUMER_SIG_TEARDOWN);
-	if (ret) {
-		PERROR("sigaddset teardown");
+	wheel.next_expiry = tick;
+}
+
+/*
+ * Link a timer in the slot of its expiry tick and move the timerfd deadline
+ * earlier if needed.
+ *
+ * The wheel lock MUST be acquired.
+ */
+static void wheel_insert(struct consumer_timer *timer)
+{
+	struct cds_list_head *slot;
+
+	slot = &wheel.slots[timer->expiry % DEFAULT_CONSUMER_TIMER_WHEEL_SIZE];
+	cds_list_add_tail(&timer->node, slot);
+
+	if (wheel.next_expiry == 0 || timer->expiry < wheel.next_expiry) {
+		wheel_program(timer->expiry);
 	}
-	ret = sigaddset(mask, LTTNG_CONSUMER_SIG_LIVE);
-	if (ret) {
-		PERROR("sigaddset live");
+}
+
+/*
+ * Program the timerfd for the next tick at which a timer expires.
+ *
+ * Only one revolution of the wheel is looked at. If no timer expires within
+ * it, the wheel is woken up at the end of the revolution, which is cheap and
+ * bounds the cost of this lookup.
+ *
+ * The wheel lock MUST be acquired.
+ */
+static void wheel_program_next(void)
+{
+	int empty = 1;
+	uint64_t tick;
+	struct consumer_timer *timer;
+
+	for (tick = wheel.current_tick + 1;
+			tick <= wheel.current_tick + DEFAULT_CONSUMER_TIMER_WHEEL_SIZE;
+			tick++) {
+		struct cds_list_head *slot;
+
+		slot = &wheel.slots[tick % DEFAULT_CONSUMER_TIMER_WHEEL_SIZE];
+		cds_list_for_each_entry(timer, slot, node) {
+			empty = 0;
+			if (timer->expiry <= tick) {
+				wheel_program(tick);
+				return;
+			}
+		}
+	}
+
+	if (empty) {
+		wheel_program(0);
+	} else {
+		wheel_program(wheel.current_tick + DEFAULT_CONSUMER_TIMER_WHEEL_SIZE);
 	}
 }
 
+/*
+ * Arm a periodic timer of the given channel. The interval is in usec and is
+ * rounded up to the wheel resolution.
+ */
+static void timer_start(struct consumer_timer *timer,
+		enum consumer_timer_type type, unsigned int interval)
+{
+	timer->type = type;
+	timer->interval = (interval + DEFAULT_CONSUMER_TIMER_WHEEL_TICK - 1) /
+		DEFAULT_CONSUMER_TIMER_WHEEL_TICK;
+
+	pthread_mutex_lock(&wheel.lock);
+	CDS_INIT_LIST_HEAD(&timer->node);
+	timer->expiry = get_current_tick() + timer->interval;
+	timer->armed = 1;
+	wheel_insert(timer);
+	pthread_mutex_unlock(&wheel.lock);
+}
+
+/*
+ * Disarm a timer. Once this returns, the timer callback is guaranteed not to
+ * be running nor to be called again so the channel can be freed.
+ */
+static void timer_stop(struct consumer_timer *timer)
+{
+	pthread_mutex_lock(&wheel.lock);
+	timer->armed = 0;
+	cds_list_del_init(&timer->node);
+
+	/* A callback stopping its own timer must not wait for itself. */
+	if (!wheel.tid_set || !pthread_equal(wheel.tid, pthread_self())) {
+		while (wheel.running == timer) {
+			pthread_cond_wait(&wheel.cond, &wheel.lock);
+		}
+	}
+	pthread_mutex_unlock(&wheel.lock);
+}
+
 /*
  * Execute action on a timer switch.
  *
@@ -73,12 +188,10 @@ static void setmask(sigset_t *mask)
  * deadlocks.
  */
 static void metadata_switch_timer(struct lttng_consumer_local_data *ctx,
-		int sig, siginfo_t *si, void *uc)
+		struct lttng_consumer_channel *channel)
 {
 	int ret;
-	struct lttng_consumer_channel *channel;
 
-	channel = si->si_value.sival_ptr;
 	assert(channel);
 
 	if (channel->switch_timer_error) {
@@ -115,25 +228,124 @@ static void metadata_switch_timer(struct lttng_consumer_local_data *ctx,
 	}
 }
 
-static int send_empty_index(struct lttng_consumer_stream *stream, uint64_t ts,
+/*
+ * Live beacons of the streams of a channel, sent to the relayd in a single
+ * command once every stream was checked.
+ */
+struct live_beacons {
+	struct lttcomm_relayd_index *indexes;
+	uint32_t count;
+	uint32_t size;
+};
+
+/*
+ * Queue a live beacon for a stream streamed to a relayd.
+ *
+ * The stream lock MUST be acquired.
+ */
+static int queue_beacon(struct live_beacons *beacons,
+		struct lttng_consumer_stream *stream, uint64_t ts, uint64_t stream_id)
+{
+	int ret = 0;
+	struct lttcomm_relayd_index *index;
+
+	if (beacons->count == beacons->size) {
+		uint32_t new_size = beacons->size ? beacons->size << 1 : 64;
+		void *new_indexes;
+
+		new_indexes = realloc(beacons->indexes,
+				new_size * sizeof(*beacons->indexes));
+		if (!new_indexes) {
+			PERROR("realloc live beacons");
+			ret = -ENOMEM;
+			goto end;
+		}
+		beacons->indexes = new_indexes;
+		beacons->size = new_size;
+	}
+
+	index = &beacons->indexes[beacons->count++];
+	memset(index, 0, sizeof(*index));
+	index->relay_stream_id = htobe64(stream->relayd_stream_id);
+	index->net_seq_num = htobe64(stream->next_net_seq_num - 1);
+	index->timestamp_end = htobe64(ts);
+	index->stream_id = htobe64(stream_id);
+
+end:
+	return ret;
+}
+
+/*
+ * Send the live beacons queued for a channel to its relayd.
+ */
+static int send_beacons(struct lttng_consumer_channel *channel,
+		struct live_beacons *beacons)
+{
+	int ret = 0;
+	struct consumer_relayd_sock_pair *relayd;
+
+	if (beacons->count == 0) {
+		goto end;
+	}
+
+	relayd = consumer_find_relayd(channel->relayd_id);
+	if (!relayd) {
+		DBG("Relayd %" PRIu64 " gone, dropping %" PRIu32 " live beacons",
+				channel->relayd_id, beacons->count);
+		goto end;
+	}
+
+	DBG("Sending %" PRIu32 " live beacons for channel %" PRIu64,
+			beacons->count, channel->key);
+
+	pthread_mutex_lock(&relayd->ctrl_sock_mutex);
+	ret = relayd_send_index_batch(&relayd->control_sock, beacons->indexes,
+			beacons->count);
+	pthread_mutex_unlock(&relayd->ctrl_sock_mutex);
+
+end:
+	beacons->count = 0;
+	return ret;
+}
+
+/*
+ * Emit the live beacon of an empty stream. Beacons of streams sent to a
+ * relayd are queued to be sent in batch, the others are written to the
+ * local index right away.
+ *
+ * The stream lock MUST be acquired.
+ */
+static int emit_empty_index(struct live_beacons *beacons,
+		struct lttng_consumer_stream *stream, uint64_t ts,
 		uint64_t stream_id)
 {
 	int ret;
 	struct ctf_packet_index index;
 
+	if (stream->net_seq_idx != (uint64_t) -1ULL) {
+		/*
+		 * The relayd only considers beacons of streams for which it already
+		 * received a packet.
+		 */
+		if (stream->next_net_seq_num == 0) {
+			ret = 0;
+			goto end;
+		}
+		ret = queue_beacon(beacons, stream, ts, stream_id);
+		goto end;
+	}
+
 	memset(&index, 0, sizeof(index));
 	index.stream_id = htobe64(stream_id);
 	index.timestamp_end = htobe64(ts);
 	ret = consumer_stream_write_index(stream, &index);
-	if (ret < 0) {
-		goto error;
-	}
 
-error:
+end:
 	return ret;
 }
 
-static int check_kernel_stream(struct lttng_consumer_stream *stream)
+static int check_kernel_stream(struct lttng_consumer_stream *stream,
+		struct live_beacons *beacons)
 {
 	uint64_t ts, stream_id;
 	int ret;
@@ -169,7 +381,7 @@ static int check_kernel_stream(struct lttng_consumer_stream *stream)
 			goto error_unlock;
 		}
 		DBG("Stream %" PRIu64 " empty, sending beacon", stream->key);
-		ret = send_empty_index(stream, ts, stream_id);
+		ret = emit_empty_index(beacons, stream, ts, stream_id);
 		if (ret < 0) {
 			goto error_unlock;
 		}
@@ -181,7 +393,8 @@ error_unlock:
 	return ret;
 }
 
-static int check_ust_stream(struct lttng_consumer_stream *stream)
+static int check_ust_stream(struct lttng_consumer_stream *stream,
+		struct live_beacons *beacons)
 {
 	uint64_t ts, stream_id;
 	int ret;
@@ -220,7 +433,7 @@ static int check_ust_stream(struct lttng_consumer_stream *stream)
 			goto error_unlock;
 		}
 		DBG("Stream %" PRIu64 " empty, sending beacon", stream->key);
-		ret = send_empty_index(stream, ts, stream_id);
+		ret = emit_empty_index(beacons, stream, ts, stream_id);
 		if (ret < 0) {
 			goto error_unlock;
 		}
@@ -234,17 +447,20 @@ error_unlock:
 
 /*
  * Execute action on a live timer
+ *
+ * Every stream of the channel is flushed in one pass and the beacons of the
+ * empty ones are sent to the relayd in a single command.
  */
 static void live_timer(struct lttng_consumer_local_data *ctx,
-		int sig, siginfo_t *si, void *uc)
+		struct lttng_consumer_channel *channel)
 {
 	int ret;
-	struct lttng_consumer_channel *channel;
 	struct lttng_consumer_stream *stream;
 	struct lttng_ht *ht;
 	struct lttng_ht_iter iter;
+	/* Only used by the timer thread, kept across calls to reuse memory. */
+	static struct live_beacons beacons;
 
-	channel = si->si_value.sival_ptr;
 	assert(channel);
 
 	if (channel->switch_timer_error) {
@@ -262,7 +478,7 @@ static void live_timer(struct lttng_consumer_local_data *ctx,
 				ht->hash_fct(&channel->key, lttng_ht_seed),
 				ht->match_fct, &channel->key, &iter.iter,
 				stream, node_channel_id.node) {
-			ret = check_ust_stream(stream);
+			ret = check_ust_stream(stream, &beacons);
 			if (ret < 0) {
 				goto error_unlock;
 			}
@@ -273,7 +489,7 @@ static void live_timer(struct lttng_consumer_local_data *ctx,
 				ht->hash_fct(&channel->key, lttng_ht_seed),
 				ht->match_fct, &channel->key, &iter.iter,
 				stream, node_channel_id.node) {
-			ret = check_kernel_stream(stream);
+			ret = check_kernel_stream(stream, &beacons);
 			if (ret < 0) {
 				goto error_unlock;
 			}
@@ -285,73 +501,20 @@ static void live_timer(struct lttng_consumer_local_data *ctx,
 	}
 
 error_unlock:
+	/* Send what was gathered even if a stream failed. */
+	(void) send_beacons(channel, &beacons);
 	rcu_read_unlock();
 
 error:
 	return;
 }
 
-static
-void consumer_timer_signal_thread_qs(unsigned int signr)
-{
-	sigset_t pending_set;
-	int ret;
-
-	/*
-	 * We need to be the only thread interacting with the thread
-	 * that manages signals for teardown synchronization.
-	 */
-	pthread_mutex_lock(&timer_signal.lock);
-
-	/* Ensure we don't have any signal queued for this channel. */
-	for (;;) {
-		ret = sigemptyset(&pending_set);
-		if (ret == -1) {
-			PERROR("sigemptyset");
-		}
-		ret = sigpending(&pending_set);
-		if (ret == -1) {
-			PERROR("sigpending");
-		}
-		if (!sigismember(&pending_set, LTTNG_CONSUMER_SIG_SWITCH)) {
-			break;
-		}
-		caa_cpu_relax();
-	}
-
-	/*
-	 * From this point, no new signal handler will be fired that would try to
-	 * access "chan". However, we still need to wait for any currently
-	 * executing handler to complete.
-	 */
-	cmm_smp_mb();
-	CMM_STORE_SHARED(timer_signal.qs_done, 0);
-	cmm_smp_mb();
-
-	/*
-	 * Kill with LTTNG_CONSUMER_SIG_TEARDOWN, so signal management thread wakes
-	 * up.
-	 */
-	kill(getpid(), LTTNG_CONSUMER_SIG_TEARDOWN);
-
-	while (!CMM_LOAD_SHARED(timer_signal.qs_done)) {
-		caa_cpu_relax();
-	}
-	cmm_smp_mb();
-
-	pthread_mutex_unlock(&timer_signal.lock);
-}
-
 /*
  * Set the timer for periodical metadata flush.
  */
 void consumer_timer_switch_start(struct lttng_consumer_channel *channel,
 		unsigned int switch_timer_interval)
 {
-	int ret;
-	struct sigevent sev;
-	struct itimerspec its;
-
 	assert(channel);
 	assert(channel->key);
 
@@ -359,43 +522,19 @@ void consumer_timer_switch_start(struct lttng_consumer_channel *channel,
 		return;
 	}
 
-	sev.sigev_notify = SIGEV_SIGNAL;
-	sev.sigev_signo = LTTNG_CONSUMER_SIG_SWITCH;
-	sev.sigev_value.sival_ptr = channel;
-	ret = timer_create(CLOCKID, &sev, &channel->switch_timer);
-	if (ret == -1) {
-		PERROR("timer_create");
-	}
+	timer_start(&channel->switch_timer, CONSUMER_TIMER_SWITCH,
+			switch_timer_interval);
 	channel->switch_timer_enabled = 1;
-
-	its.it_value.tv_sec = switch_timer_interval / 1000000;
-	its.it_value.tv_nsec = switch_timer_interval % 1000000;
-	its.it_interval.tv_sec = its.it_value.tv_sec;
-	its.it_interval.tv_nsec = its.it_value.tv_nsec;
-
-	ret = timer_settime(channel->switch_timer, 0, &its, NULL);
-	if (ret == -1) {
-		PERROR("timer_settime");
-	}
 }
 
 /*
- * Stop and delete timer.
+ * Stop timer.
  */
 void consumer_timer_switch_stop(struct lttng_consumer_channel *channel)
 {
-	int ret;
-
 	assert(channel);
 
-	ret = timer_delete(channel->switch_timer);
-	if (ret == -1) {
-		PERROR("timer_delete");
-	}
-
-	consumer_timer_signal_thread_qs(LTTNG_CONSUMER_SIG_SWITCH);
-
-	channel->switch_timer = 0;
+	timer_stop(&channel->switch_timer);
 	channel->switch_timer_enabled = 0;
 }
 
@@ -405,10 +544,6 @@ void consumer_timer_switch_stop(struct lttng_consumer_channel *channel)
 void consumer_timer_live_start(struct lttng_consumer_channel *channel,
 		int live_timer_interval)
 {
-	int ret;
-	struct sigevent sev;
-	struct itimerspec its;
-
 	assert(channel);
 	assert(channel->key);
 
@@ -416,75 +551,137 @@ void consumer_timer_live_start(struct lttng_consumer_channel *channel,
 		return;
 	}
 
-	sev.sigev_notify = SIGEV_SIGNAL;
-	sev.sigev_signo = LTTNG_CONSUMER_SIG_LIVE;
-	sev.sigev_value.sival_ptr = channel;
-	ret = timer_create(CLOCKID, &sev, &channel->live_timer);
-	if (ret == -1) {
-		PERROR("timer_create");
-	}
+	timer_start(&channel->live_timer, CONSUMER_TIMER_LIVE,
+			live_timer_interval);
 	channel->live_timer_enabled = 1;
-
-	its.it_value.tv_sec = live_timer_interval / 1000000;
-	its.it_value.tv_nsec = live_timer_interval % 1000000;
-	its.it_interval.tv_sec = its.it_value.tv_sec;
-	its.it_interval.tv_nsec = its.it_value.tv_nsec;
-
-	ret = timer_settime(channel->live_timer, 0, &its, NULL);
-	if (ret == -1) {
-		PERROR("timer_settime");
-	}
 }
 
 /*
- * Stop and delete timer.
+ * Stop timer.
  */
 void consumer_timer_live_stop(struct lttng_consumer_channel *channel)
 {
-	int ret;
-
 	assert(channel);
 
-	ret = timer_delete(channel->live_timer);
-	if (ret == -1) {
-		PERROR("timer_delete");
-	}
-
-	consumer_timer_signal_thread_qs(LTTNG_CONSUMER_SIG_LIVE);
-
-	channel->live_timer = 0;
+	timer_stop(&channel->live_timer);
 	channel->live_timer_enabled = 0;
 }
 
 /*
- * Block the RT signals for the entire process. It must be called from the
- * consumer main before creating the threads
+ * Create the timerfd driving the timer wheel. It must be called from the
+ * consumer main before creating the threads.
  */
-int consumer_signal_init(void)
+int consumer_timer_init(void)
 {
-	int ret;
-	sigset_t mask;
+	int i;
 
-	/* Block signal for entire process, so only our thread processes it. */
-	setmask(&mask);
-	ret = pthread_sigmask(SIG_BLOCK, &mask, NULL);
-	if (ret) {
-		errno = ret;
-		PERROR("pthread_sigmask");
+	for (i = 0; i < DEFAULT_CONSUMER_TIMER_WHEEL_SIZE; i++) {
+		CDS_INIT_LIST_HEAD(&wheel.slots[i]);
+	}
+
+	wheel.timerfd = timerfd_create(CLOCKID, TFD_CLOEXEC);
+	if (wheel.timerfd < 0) {
+		PERROR("timerfd_create");
 		return -1;
 	}
+	wheel.current_tick = get_current_tick();
 	return 0;
 }
 
 /*
- * This thread is the sighandler for signals LTTNG_CONSUMER_SIG_SWITCH,
- * LTTNG_CONSUMER_SIG_TEARDOWN and LTTNG_CONSUMER_SIG_LIVE.
+ * Fire the given expired timer.
+ *
+ * The wheel lock MUST NOT be acquired.
+ */
+static void fire_timer(struct lttng_consumer_local_data *ctx,
+		struct consumer_timer *timer)
+{
+	switch (timer->type) {
+	case CONSUMER_TIMER_SWITCH:
+		metadata_switch_timer(ctx, caa_container_of(timer,
+				struct lttng_consumer_channel, switch_timer));
+		break;
+	case CONSUMER_TIMER_LIVE:
+		live_timer(ctx, caa_container_of(timer,
+				struct lttng_consumer_channel, live_timer));
+		break;
+	default:
+		assert(0);
+	}
+}
+
+/*
+ * Fire every timer expired up to now, re-arm them and program the timerfd for
+ * the next expiry.
+ *
+ * Each slot is visited once even if the thread was late by more than a whole
+ * revolution.
+ */
+static void wheel_process(struct lttng_consumer_local_data *ctx)
+{
+	uint64_t now, tick, last;
+	unsigned int nb_fired = 0;
+
+	pthread_mutex_lock(&wheel.lock);
+
+	now = get_current_tick();
+	last = now;
+	if (last - wheel.current_tick > DEFAULT_CONSUMER_TIMER_WHEEL_SIZE) {
+		last = wheel.current_tick + DEFAULT_CONSUMER_TIMER_WHEEL_SIZE;
+	}
+
+	for (tick = wheel.current_tick + 1; tick <= last; tick++) {
+		struct cds_list_head expired, *slot;
+		struct consumer_timer *timer, *tmp;
+
+		CDS_INIT_LIST_HEAD(&expired);
+		slot = &wheel.slots[tick % DEFAULT_CONSUMER_TIMER_WHEEL_SIZE];
+		cds_list_for_each_entry_safe(timer, tmp, slot, node) {
+			if (timer->expiry <= now) {
+				cds_list_del(&timer->node);
+				cds_list_add_tail(&timer->node, &expired);
+			}
+		}
+
+		while (!cds_list_empty(&expired)) {
+			timer = cds_list_first_entry(&expired, struct consumer_timer,
+					node);
+			cds_list_del_init(&timer->node);
+			wheel.running = timer;
+			pthread_mutex_unlock(&wheel.lock);
+
+			health_code_update();
+			fire_timer(ctx, timer);
+			nb_fired++;
+
+			pthread_mutex_lock(&wheel.lock);
+			wheel.running = NULL;
+			pthread_cond_broadcast(&wheel.cond);
+			if (timer->armed) {
+				/* Skip the periods missed if the thread was late. */
+				do {
+					timer->expiry += timer->interval;
+				} while (timer->expiry <= now);
+				wheel_insert(timer);
+			}
+		}
+	}
+
+	wheel.current_tick = now;
+	wheel_program_next();
+	pthread_mutex_unlock(&wheel.lock);
+
+	DBG3("Timer wheel fired %u timer(s) at tick %" PRIu64, nb_fired, now);
+}
+
+/*
+ * This thread drives the timer wheel and runs the periodical metadata flush
+ * and live timer callbacks of every channel.
  */
 void *consumer_timer_thread(void *data)
 {
-	int signr;
-	sigset_t mask;
-	siginfo_t info;
+	ssize_t ret;
+	uint64_t expirations;
 	struct lttng_consumer_local_data *ctx = data;
 
 	health_register(health_consumerd, HEALTH_CONSUMERD_TYPE_METADATA_TIMER);
@@ -495,33 +692,25 @@ void *consumer_timer_thread(void *data)
 
 	health_code_update();
 
-	/* Only self thread will receive signal mask. */
-	setmask(&mask);
-	CMM_STORE_SHARED(timer_signal.tid, pthread_self());
+	pthread_mutex_lock(&wheel.lock);
+	wheel.tid = pthread_self();
+	wheel.tid_set = 1;
+	pthread_mutex_unlock(&wheel.lock);
 
 	while (1) {
 		health_code_update();
 
 		health_poll_entry();
-		signr = sigwaitinfo(&mask, &info);
+		ret = read(wheel.timerfd, &expirations, sizeof(expirations));
 		health_poll_exit();
-		if (signr == -1) {
-			if (errno != EINTR) {
-				PERROR("sigwaitinfo");
+		if (ret < 0) {
+			if (errno != EINTR && errno != EAGAIN) {
+				PERROR("read timerfd");
 			}
 			continue;
-		} else if (signr == LTTNG_CONSUMER_SIG_SWITCH) {
-			metadata_switch_timer(ctx, info.si_signo, &info, NULL);
-		} else if (signr == LTTNG_CONSUMER_SIG_TEARDOWN) {
-			cmm_smp_mb();
-			CMM_STORE_SHARED(timer_signal.qs_done, 1);
-			cmm_smp_mb();
-			DBG("Signal timer metadata thread teardown");
-		} else if (signr == LTTNG_CONSUMER_SIG_LIVE) {
-			live_timer(ctx, info.si_signo, &info, NULL);
-		} else {
-			ERR("Unexpected signal %d\n", info.si_signo);
 		}
+
+		wheel_process(ctx);
 	}
 
 error_testpoint:
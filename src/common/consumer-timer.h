@@ -21,26 +21,37 @@
 #define CONSUMER_TIMER_H
 
 #include <pthread.h>
+#include <urcu/list.h>
 
-#include "consumer.h"
+#include <common/defaults.h>
 
-#define LTTNG_CONSUMER_SIG_SWITCH	SIGRTMIN + 10
-#define LTTNG_CONSUMER_SIG_TEARDOWN	SIGRTMIN + 11
-#define LTTNG_CONSUMER_SIG_LIVE		SIGRTMIN + 12
+#include "consumer.h"
 
 #define CLOCKID CLOCK_MONOTONIC
 
 /*
- * Handle timer teardown race wrt memory free of private data by consumer
- * signals are handled by a single thread, which permits a synchronization
- * point between handling of each signal. Internal lock ensures mutual
- * exclusion.
+ * Hashed timer wheel driving the switch and live timers of every channel from
+ * a single timerfd. A timer is linked in the slot of its expiry tick modulo
+ * the wheel size; the absolute expiry tells in which revolution it fires.
+ *
+ * Timers are run by the timer thread without the wheel lock held. The
+ * running pointer and condition let a stopping thread wait for a callback in
+ * progress on its channel.
  */
-struct timer_signal_data {
-	pthread_t tid;	/* thread id managing signals */
-	int setup_done;
-	int qs_done;
+struct consumer_timer_wheel {
+	struct cds_list_head slots[DEFAULT_CONSUMER_TIMER_WHEEL_SIZE];
+	int timerfd;
+	/* Last tick processed by the timer thread. */
+	uint64_t current_tick;
+	/* Tick programmed in the timerfd, 0 if disarmed. */
+	uint64_t next_expiry;
+	/* Timer whose callback is in progress, if any. */
+	struct consumer_timer *running;
+	/* Timer thread id. */
+	pthread_t tid;
+	int tid_set;
 	pthread_mutex_t lock;
+	pthread_cond_t cond;
 };
 
 void consumer_timer_switch_start(struct lttng_consumer_channel *channel,
@@ -50,6 +61,6 @@ void consumer_timer_live_start(struct lttng_consumer_channel *channel,
 		int live_timer_interval);
 void consumer_timer_live_stop(struct lttng_consumer_channel *channel);
 void *consumer_timer_thread(void *data);
-int consumer_signal_init(void);
+int consumer_timer_init(void);
 
 #endif /* CONSUMER_TIMER_H */
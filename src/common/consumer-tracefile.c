@@ -0,0 +1,393 @@
+/*
+ * Copyright (C) 2015 - EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <common/common.h>
+#include <common/utils.h>
+
+#include "consumer-tracefile.h"
+
+/*
+ * Tracefile preparation thread state. The lock protects the queue, the
+ * statistics and the shared fields of every consumer_tracefile_prep.
+ */
+static struct {
+	pthread_mutex_t lock;
+	/* Signaled when a file is queued or on quit. */
+	pthread_cond_t wake;
+	/* Broadcast when a queued file is done. */
+	pthread_cond_t done;
+	struct cds_list_head queue;
+	pthread_t thread;
+	unsigned int started:1;
+	unsigned int quit:1;
+	struct consumer_tracefile_stats stats;
+} prep_thread = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+	.queue = CDS_LIST_HEAD_INIT(prep_thread.queue),
+};
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+		PERROR("clock_gettime tracefile rotation");
+		return 0;
+	}
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Drop a reference on a prepared file. The last one closes the fd if it was
+ * never used and removes the file if it was created for nothing.
+ *
+ * The preparation lock MUST be acquired.
+ */
+static void put_prep(struct consumer_tracefile_prep *prep)
+{
+	int ret;
+	char path[PATH_MAX];
+
+	assert(prep->refcount > 0);
+
+	if (--prep->refcount > 0) {
+		return;
+	}
+
+	if (prep->fd >= 0) {
+		ret = close(prep->fd);
+		if (ret < 0) {
+			PERROR("close unused tracefile");
+		}
+		/* Files of a bounded tracefile count already existed, keep them. */
+		if (prep->count == 0 && !utils_stream_file_path(prep->path_name,
+					prep->file_name, prep->size, prep->index, NULL,
+					path, sizeof(path))) {
+			ret = unlink(path);
+			if (ret < 0) {
+				PERROR("unlink unused tracefile %s", path);
+			}
+		}
+	}
+	free(prep);
+}
+
+/*
+ * Open a queued tracefile. A new file is created and its blocks are reserved
+ * up front. A file reused by a bounded tracefile count is not truncated here
+ * since it still holds data; the truncation happens at rotation time.
+ */
+static int open_prep(struct consumer_tracefile_prep *prep)
+{
+	int fd, flags = O_WRONLY | O_CREAT;
+
+	if (prep->count == 0) {
+		flags |= O_TRUNC;
+	}
+
+	fd = utils_open_stream_file(prep->path_name, prep->file_name,
+			prep->size, prep->index, prep->uid, prep->gid, NULL, flags);
+	if (fd < 0) {
+		goto end;
+	}
+
+#ifdef FALLOC_FL_KEEP_SIZE
+	if (prep->count == 0 &&
+			fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, prep->size) < 0) {
+		/* Not supported by every filesystem, the file is still usable. */
+		DBG("fallocate of tracefile %s_%" PRIu64 " failed: %s",
+				prep->file_name, prep->index, strerror(errno));
+	}
+#endif
+
+end:
+	return fd;
+}
+
+static void *thread_prepare(void *data)
+{
+	struct consumer_tracefile_prep *prep;
+
+	pthread_mutex_lock(&prep_thread.lock);
+	while (1) {
+		int fd;
+
+		while (cds_list_empty(&prep_thread.queue) && !prep_thread.quit) {
+			pthread_cond_wait(&prep_thread.wake, &prep_thread.lock);
+		}
+		if (prep_thread.quit) {
+			break;
+		}
+
+		prep = cds_list_first_entry(&prep_thread.queue,
+				struct consumer_tracefile_prep, node);
+		cds_list_del(&prep->node);
+		pthread_mutex_unlock(&prep_thread.lock);
+
+		fd = open_prep(prep);
+		DBG("Tracefile %s/%s_%" PRIu64 " prepared (fd: %d)",
+				prep->path_name, prep->file_name, prep->index, fd);
+
+		pthread_mutex_lock(&prep_thread.lock);
+		prep->fd = fd;
+		prep->done = 1;
+		pthread_cond_broadcast(&prep_thread.done);
+		put_prep(prep);
+	}
+
+	/* Release the files that will never be prepared. */
+	while (!cds_list_empty(&prep_thread.queue)) {
+		prep = cds_list_first_entry(&prep_thread.queue,
+				struct consumer_tracefile_prep, node);
+		cds_list_del(&prep->node);
+		prep->done = 1;
+		put_prep(prep);
+	}
+	pthread_cond_broadcast(&prep_thread.done);
+	pthread_mutex_unlock(&prep_thread.lock);
+
+	return NULL;
+}
+
+/*
+ * Queue the preparation of the next tracefile of a stream once the current
+ * one is filled past the stream preparation threshold.
+ *
+ * Only the streams written to local tracefiles with a maximum size are
+ * concerned. On any error, the stream simply rotates synchronously.
+ *
+ * The stream lock MUST be acquired.
+ */
+void consumer_tracefile_check_prepare(struct lttng_consumer_stream *stream)
+{
+	int ret;
+	struct consumer_tracefile_prep *prep;
+	struct lttng_consumer_channel *chan = stream->chan;
+
+	if (!chan->monitor || chan->tracefile_size == 0 ||
+			stream->net_seq_idx != (uint64_t) -1ULL ||
+			stream->next_tracefile) {
+		return;
+	}
+
+	if (stream->tracefile_prepare_at == 0) {
+		/* Start half way, adjusted on each rotation. */
+		stream->tracefile_prepare_at = chan->tracefile_size / 2 ? : 1;
+	}
+	if (stream->tracefile_size_current < stream->tracefile_prepare_at) {
+		return;
+	}
+
+	prep = zmalloc(sizeof(*prep));
+	if (!prep) {
+		PERROR("zmalloc tracefile prep");
+		return;
+	}
+	strncpy(prep->path_name, chan->pathname, sizeof(prep->path_name));
+	prep->path_name[sizeof(prep->path_name) - 1] = '\0';
+	strncpy(prep->file_name, stream->name, sizeof(prep->file_name));
+	prep->file_name[sizeof(prep->file_name) - 1] = '\0';
+	prep->size = chan->tracefile_size;
+	prep->count = chan->tracefile_count;
+	if (prep->count > 0) {
+		prep->index = (stream->tracefile_count_current + 1) % prep->count;
+	} else {
+		prep->index = stream->tracefile_count_current + 1;
+	}
+	prep->uid = stream->uid;
+	prep->gid = stream->gid;
+	prep->fd = -1;
+	/* One for the stream, one for the preparation thread. */
+	prep->refcount = 2;
+
+	pthread_mutex_lock(&prep_thread.lock);
+	if (prep_thread.quit) {
+		goto error_unlock;
+	}
+	if (!prep_thread.started) {
+		ret = pthread_create(&prep_thread.thread, NULL, thread_prepare, NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_create tracefile preparation");
+			goto error_unlock;
+		}
+		prep_thread.started = 1;
+	}
+	cds_list_add_tail(&prep->node, &prep_thread.queue);
+	pthread_cond_signal(&prep_thread.wake);
+	pthread_mutex_unlock(&prep_thread.lock);
+
+	stream->next_tracefile = prep;
+	return;
+
+error_unlock:
+	pthread_mutex_unlock(&prep_thread.lock);
+	free(prep);
+}
+
+/*
+ * Switch the stream to its next tracefile.
+ *
+ * If the next tracefile was prepared, the file descriptors are simply
+ * swapped. If its preparation is still in progress, it is waited for and the
+ * stream starts preparing earlier for the next rotation. Otherwise, the
+ * tracefile is rotated synchronously.
+ *
+ * The stream lock MUST be acquired.
+ *
+ * Return 0 on success or else a negative value.
+ */
+int consumer_tracefile_rotate(struct lttng_consumer_stream *stream)
+{
+	int ret, fd = -1, waited = 0;
+	uint64_t start, duration, index = 0;
+	struct consumer_tracefile_prep *prep = stream->next_tracefile;
+	struct lttng_consumer_channel *chan = stream->chan;
+
+	start = get_time_ns();
+
+	if (prep) {
+		pthread_mutex_lock(&prep_thread.lock);
+		while (!prep->done) {
+			waited = 1;
+			pthread_cond_wait(&prep_thread.done, &prep_thread.lock);
+		}
+		fd = prep->fd;
+		prep->fd = -1;
+		index = prep->index;
+		put_prep(prep);
+		pthread_mutex_unlock(&prep_thread.lock);
+		stream->next_tracefile = NULL;
+	}
+
+	if (fd >= 0) {
+		if (chan->tracefile_count > 0) {
+			/* Reused file, drop its old content. */
+			ret = ftruncate(fd, 0);
+			if (ret < 0) {
+				PERROR("ftruncate prepared tracefile");
+				(void) close(fd);
+				goto end;
+			}
+		}
+		ret = close(stream->out_fd);
+		if (ret < 0) {
+			PERROR("Closing tracefile");
+			(void) close(fd);
+			goto end;
+		}
+		stream->out_fd = fd;
+		stream->tracefile_count_current = index;
+	} else {
+		ret = utils_rotate_stream_file(chan->pathname, stream->name,
+				chan->tracefile_size, chan->tracefile_count,
+				stream->uid, stream->gid, stream->out_fd,
+				&stream->tracefile_count_current, &stream->out_fd);
+		if (ret < 0) {
+			goto end;
+		}
+	}
+
+	if (waited && stream->tracefile_prepare_at > 1) {
+		/* The preparation was late, start it earlier next time. */
+		stream->tracefile_prepare_at >>= 1;
+	}
+
+	duration = get_time_ns() - start;
+
+	pthread_mutex_lock(&prep_thread.lock);
+	if (fd < 0) {
+		prep_thread.stats.nb_sync++;
+	} else if (waited) {
+		prep_thread.stats.nb_waited++;
+	} else {
+		prep_thread.stats.nb_prepared++;
+	}
+	prep_thread.stats.total_ns += duration;
+	if (duration > prep_thread.stats.max_ns) {
+		prep_thread.stats.max_ns = duration;
+	}
+	pthread_mutex_unlock(&prep_thread.lock);
+
+	DBG("Stream %s rotated to tracefile %" PRIu64 " in %" PRIu64 " ns "
+			"(prepared: %d, waited: %d)", stream->name,
+			stream->tracefile_count_current, duration, fd >= 0, waited);
+	ret = 0;
+
+end:
+	return ret;
+}
+
+/*
+ * Release the next tracefile prepared for a stream, if any.
+ *
+ * The stream lock MUST be acquired.
+ */
+void consumer_tracefile_release(struct lttng_consumer_stream *stream)
+{
+	if (!stream->next_tracefile) {
+		return;
+	}
+
+	pthread_mutex_lock(&prep_thread.lock);
+	put_prep(stream->next_tracefile);
+	pthread_mutex_unlock(&prep_thread.lock);
+	stream->next_tracefile = NULL;
+}
+
+/*
+ * Stop the tracefile preparation thread and report the rotation statistics.
+ */
+void consumer_tracefile_fini(void)
+{
+	int ret;
+	struct consumer_tracefile_stats stats;
+
+	pthread_mutex_lock(&prep_thread.lock);
+	prep_thread.quit = 1;
+	pthread_cond_signal(&prep_thread.wake);
+	pthread_mutex_unlock(&prep_thread.lock);
+
+	if (prep_thread.started) {
+		ret = pthread_join(prep_thread.thread, NULL);
+		if (ret) {
+			errno = ret;
+			PERROR("pthread_join tracefile preparation");
+		}
+	}
+
+	pthread_mutex_lock(&prep_thread.lock);
+	stats = prep_thread.stats;
+	pthread_mutex_unlock(&prep_thread.lock);
+
+	DBG("Tracefile rotations: %" PRIu64 " prepared, %" PRIu64 " waited, %"
+			PRIu64 " synchronous, %" PRIu64 " ns total, %" PRIu64
+			" ns max", stats.nb_prepared, stats.nb_waited, stats.nb_sync,
+			stats.total_ns, stats.max_ns);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2015 - EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CONSUMER_TRACEFILE_H
+#define CONSUMER_TRACEFILE_H
+
+#include <limits.h>
+#include <stdint.h>
+#include <urcu/list.h>
+
+#include <common/consumer.h>
+
+/*
+ * Next tracefile of a stream, opened ahead of time by the tracefile
+ * preparation thread so the data thread only swaps file descriptors when the
+ * current tracefile is full.
+ *
+ * Shared by the stream and the preparation thread. Every field after the
+ * parameters is protected by the preparation lock.
+ */
+struct consumer_tracefile_prep {
+	/* Parameters of the file to open, copied from the stream. */
+	char path_name[PATH_MAX];
+	char file_name[LTTNG_SYMBOL_NAME_LEN];
+	uint64_t size;
+	uint64_t count;
+	/* Tracefile count number of the prepared file. */
+	uint64_t index;
+	int uid;
+	int gid;
+
+	/* Prepared fd, -1 until done or if the preparation failed. */
+	int fd;
+	/* Set once the preparation thread is done with this file. */
+	unsigned int done:1;
+	/* References held by the stream and the preparation thread. */
+	unsigned int refcount;
+	/* Node in the preparation queue. */
+	struct cds_list_head node;
+};
+
+/*
+ * Tracefile rotation statistics, reported when the consumer exits.
+ */
+struct consumer_tracefile_stats {
+	/* Rotations done with a prepared file. */
+	uint64_t nb_prepared;
+	/* Rotations that had to wait for the preparation to complete. */
+	uint64_t nb_waited;
+	/* Rotations done synchronously because no file was prepared. */
+	uint64_t nb_sync;
+	/* Time spent rotating on the data path, in nsec. */
+	uint64_t total_ns;
+	uint64_t max_ns;
+};
+
+void consumer_tracefile_check_prepare(struct lttng_consumer_stream *stream);
+int consumer_tracefile_rotate(struct lttng_consumer_stream *stream);
+void consumer_tracefile_release(struct lttng_consumer_stream *stream);
+void consumer_tracefile_fini(void);
+
+#endif /* CONSUMER_TRACEFILE_H */
@@ -44,6 +44,8 @@
 #include <common/relayd/relayd.h>
 #include <common/ust-consumer/ust-consumer.h>
 #include <common/consumer-timer.h>
+#include <common/consumer-snapshot.h>
+#include <common/consumer-tracefile.h>
 
 #include "consumer.h"
 #include "consumer-stream.h"
@@ -197,7 +199,7 @@ static struct lttng_consumer_stream *find_stream(uint64_t key,
 
 	rcu_read_lock();
 
-	lttng_ht_lookup(ht, &key, &iter);
+	lttng_ht_lookup_u64(ht, key, &iter);
 	node = lttng_ht_iter_get_node_u64(&iter);
 	if (node != NULL) {
 		stream = caa_container_of(node, struct lttng_consumer_stream, node);
@@ -243,7 +245,7 @@ struct lttng_consumer_channel *consumer_find_channel(uint64_t key)
 		return NULL;
 	}
 
-	lttng_ht_lookup(consumer_data.channel_ht, &key, &iter);
+	lttng_ht_lookup_u64(consumer_data.channel_ht, key, &iter);
 	node = lttng_ht_iter_get_node_u64(&iter);
 	if (node != NULL) {
 		channel = caa_container_of(node, struct lttng_consumer_channel, node);
@@ -685,8 +687,8 @@ static int add_relayd(struct consumer_relayd_sock_pair *relayd)
 
 	assert(relayd);
 
-	lttng_ht_lookup(consumer_data.relayd_ht,
-			&relayd->net_seq_idx, &iter);
+	lttng_ht_lookup_u64(consumer_data.relayd_ht, relayd->net_seq_idx,
+			&iter);
 	node = lttng_ht_iter_get_node_u64(&iter);
 	if (node != NULL) {
 		goto end;
@@ -746,8 +748,7 @@ struct consumer_relayd_sock_pair *consumer_find_relayd(uint64_t key)
 		goto error;
 	}
 
-	lttng_ht_lookup(consumer_data.relayd_ht, &key,
-			&iter);
+	lttng_ht_lookup_u64(consumer_data.relayd_ht, key, &iter);
 	node = lttng_ht_iter_get_node_u64(&iter);
 	if (node != NULL) {
 		relayd = caa_container_of(node, struct consumer_relayd_sock_pair, node);
@@ -1188,6 +1189,9 @@ void lttng_consumer_cleanup(void)
 	 * it.
 	 */
 	lttng_ht_destroy(consumer_data.stream_list_ht);
+
+	consumer_snapshot_staging_fini();
+	consumer_tracefile_fini();
 }
 
 /*
@@ -1454,44 +1458,23 @@ end:
 }
 
 /*
- * Mmap the ring buffer, read it and write the data to the tracefile. This is a
- * core function for writing trace buffers to either the local filesystem or
- * the network.
+ * Get the address of the sub-buffer currently held by the consumer for the
+ * given stream, within the mmap-ed ring buffer.
  *
  * It must be called with the stream lock held.
  *
- * Careful review MUST be put if any changes occur!
- *
- * Returns the number of bytes written
+ * Return 0 on success and set addr, or else a negative errno value.
  */
-ssize_t lttng_consumer_on_read_subbuffer_mmap(
-		struct lttng_consumer_local_data *ctx,
-		struct lttng_consumer_stream *stream, unsigned long len,
-		unsigned long padding,
-		struct ctf_packet_index *index)
+int lttng_consumer_get_subbuffer_addr(struct lttng_consumer_stream *stream,
+		const char **addr)
 {
+	int ret;
 	unsigned long mmap_offset;
 	void *mmap_base;
-	ssize_t ret = 0;
-	off_t orig_offset = stream->out_fd_offset;
-	/* Default is on the disk */
-	int outfd = stream->out_fd;
-	struct consumer_relayd_sock_pair *relayd = NULL;
-	unsigned int relayd_hang_up = 0;
-
-	/* RCU lock for the relayd pointer */
-	rcu_read_lock();
 
-	/* Flag that the current stream if set for network streaming. */
-	if (stream->net_seq_idx != (uint64_t) -1ULL) {
-		relayd = consumer_find_relayd(stream->net_seq_idx);
-		if (relayd == NULL) {
-			ret = -EPIPE;
-			goto end;
-		}
-	}
+	assert(stream);
+	assert(addr);
 
-	/* get the offset inside the fd to mmap */
 	switch (consumer_data.type) {
 	case LTTNG_CONSUMER_KERNEL:
 		mmap_base = stream->mmap_base;
@@ -1520,6 +1503,81 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 	default:
 		ERR("Unknown consumer_data type");
 		assert(0);
+		ret = -EINVAL;
+		goto end;
+	}
+
+	*addr = (const char *) mmap_base + mmap_offset;
+	ret = 0;
+
+end:
+	return ret;
+}
+
+/*
+ * Mmap the ring buffer, read it and write the data to the tracefile. This is a
+ * core function for writing trace buffers to either the local filesystem or
+ * the network.
+ *
+ * It must be called with the stream lock held.
+ *
+ * Careful review MUST be put if any changes occur!
+ *
+ * Returns the number of bytes written
+ */
+ssize_t lttng_consumer_on_read_subbuffer_mmap(
+		struct lttng_consumer_local_data *ctx,
+		struct lttng_consumer_stream *stream, unsigned long len,
+		unsigned long padding,
+		struct ctf_packet_index *index)
+{
+	int ret;
+	const char *buf;
+
+	ret = lttng_consumer_get_subbuffer_addr(stream, &buf);
+	if (ret < 0) {
+		return ret;
+	}
+
+	return lttng_consumer_write_subbuffer(ctx, stream, buf, len, padding,
+			index);
+}
+
+/*
+ * Write a sub-buffer of len bytes (followed by padding bytes) located at buf
+ * to the stream output, either the local tracefile or the relayd. The buffer
+ * is either the mmap-ed ring buffer or a copy of it such as the one kept by
+ * the snapshot staging area.
+ *
+ * It must be called with the stream lock held.
+ *
+ * Careful review MUST be put if any changes occur!
+ *
+ * Returns the number of bytes written
+ */
+ssize_t lttng_consumer_write_subbuffer(
+		struct lttng_consumer_local_data *ctx,
+		struct lttng_consumer_stream *stream, const char *buf,
+		unsigned long len, unsigned long padding,
+		struct ctf_packet_index *index)
+{
+	ssize_t ret = 0;
+	off_t orig_offset = stream->out_fd_offset;
+	/* Default is on the disk */
+	int outfd = stream->out_fd;
+	struct consumer_relayd_sock_pair *relayd = NULL;
+	unsigned int relayd_hang_up = 0;
+
+	/* RCU lock for the relayd pointer */
+	rcu_read_lock();
+
+	/* Flag that the current stream if set for network streaming. */
+	if (stream->net_seq_idx != (uint64_t) -1ULL) {
+		relayd = consumer_find_relayd(stream->net_seq_idx);
+		if (relayd == NULL) {
+			ret = -EPIPE;
+			goto end;
+		}
 	}
 
 	/* Handle stream on the relayd if the output is on the network */
@@ -1562,11 +1620,7 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 		if (stream->chan->tracefile_size > 0 &&
 				(stream->tracefile_size_current + len) >
 				stream->chan->tracefile_size) {
-			ret = utils_rotate_stream_file(stream->chan->pathname,
-					stream->name, stream->chan->tracefile_size,
-					stream->chan->tracefile_count, stream->uid, stream->gid,
-					stream->out_fd, &(stream->tracefile_count_current),
-					&stream->out_fd);
+			ret = consumer_tracefile_rotate(stream);
 			if (ret < 0) {
 				ERR("Rotating output file");
 				goto end;
@@ -1590,6 +1644,7 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 			orig_offset = 0;
 		}
 		stream->tracefile_size_current += len;
+		consumer_tracefile_check_prepare(stream);
 		if (index) {
 			index->offset = htobe64(stream->out_fd_offset);
 		}
@@ -1599,7 +1654,7 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 	 * This call guarantee that len or less is returned. It's impossible to
 	 * receive a ret value that is bigger than len.
 	 */
-	ret = lttng_write(outfd, mmap_base + mmap_offset, len);
+	ret = lttng_write(outfd, buf, len);
 	DBG("Consumer mmap write() ret %zd (len %lu)", ret, len);
 	if (ret < 0 || ((size_t) ret != len)) {
 		/*
@@ -1744,11 +1799,7 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 		if (stream->chan->tracefile_size > 0 &&
 				(stream->tracefile_size_current + len) >
 				stream->chan->tracefile_size) {
-			ret = utils_rotate_stream_file(stream->chan->pathname,
-					stream->name, stream->chan->tracefile_size,
-					stream->chan->tracefile_count, stream->uid, stream->gid,
-					stream->out_fd, &(stream->tracefile_count_current),
-					&stream->out_fd);
+			ret = consumer_tracefile_rotate(stream);
 			if (ret < 0) {
 				written = ret;
 				ERR("Rotating output file");
@@ -1774,6 +1825,7 @@ ssize_t lttng_consumer_on_read_subbuffer_splice(
 			orig_offset = 0;
 		}
 		stream->tracefile_size_current += len;
+		consumer_tracefile_check_prepare(stream);
 		index->offset = htobe64(stream->out_fd_offset);
 	}
 
@@ -2046,7 +2098,7 @@ int consumer_add_metadata_stream(struct lttng_consumer_stream *stream)
 	 * Lookup the stream just to make sure it does not exist in our internal
 	 * state. This should NEVER happen.
 	 */
-	lttng_ht_lookup(ht, &stream->key, &iter);
+	lttng_ht_lookup_u64(ht, stream->key, &iter);
 	node = lttng_ht_iter_get_node_u64(&iter);
 	assert(!node);
 
@@ -2259,11 +2311,7 @@ restart:
 			}
 
 			rcu_read_lock();
-			{
-				uint64_t tmp_id = (uint64_t) pollfd;
-
-				lttng_ht_lookup(metadata_ht, &tmp_id, &iter);
-			}
+			lttng_ht_lookup_u64(metadata_ht, (uint64_t) pollfd, &iter);
 			node = lttng_ht_iter_get_node_u64(&iter);
 			assert(node);
 
@@ -2886,11 +2934,7 @@ restart:
 			}
 
 			rcu_read_lock();
-			{
-				uint64_t tmp_id = (uint64_t) pollfd;
-
-				lttng_ht_lookup(channel_ht, &tmp_id, &iter);
-			}
+			lttng_ht_lookup_u64(channel_ht, (uint64_t) pollfd, &iter);
 			node = lttng_ht_iter_get_node_u64(&iter);
 			assert(node);
 
@@ -3230,6 +3274,10 @@ int lttng_consumer_init(void)
 		goto error;
 	}
 
+	if (consumer_snapshot_staging_init()) {
+		goto error;
+	}
+
 	return 0;
 
 error:
@@ -96,8 +96,29 @@ struct stream_list {
 	unsigned int count;
 };
 
+enum consumer_timer_type {
+	CONSUMER_TIMER_SWITCH	= 0,
+	CONSUMER_TIMER_LIVE	= 1,
+};
+
+/*
+ * Periodic channel timer. Every armed timer is linked in the single consumer
+ * timer wheel (see consumer-timer.c) which is protected by its own lock.
+ */
+struct consumer_timer {
+	/* Node in a wheel slot, or in the expired list while being fired. */
+	struct cds_list_head node;
+	/* Absolute expiry and period, both in wheel ticks. */
+	uint64_t expiry;
+	uint64_t interval;
+	enum consumer_timer_type type;
+	/* Set while the timer must keep firing. */
+	unsigned int armed:1;
+};
+
 /* Stub. */
 struct consumer_metadata_cache;
+struct consumer_tracefile_prep;
 
 struct lttng_consumer_channel {
 	/* HT node used for consumer_data.channel_ht */
@@ -159,12 +180,12 @@ struct lttng_consumer_channel {
 	struct consumer_metadata_cache *metadata_cache;
 	/* For UST metadata periodical flush */
 	int switch_timer_enabled;
-	timer_t switch_timer;
+	struct consumer_timer switch_timer;
 	int switch_timer_error;
 
 	/* For the live mode */
 	int live_timer_enabled;
-	timer_t live_timer;
+	struct consumer_timer live_timer;
 	int live_timer_error;
 
 	/* On-disk circular buffer */
@@ -309,6 +330,13 @@ struct lttng_consumer_stream {
 	/* On-disk circular buffer */
 	uint64_t tracefile_size_current;
 	uint64_t tracefile_count_current;
+	/* Next tracefile opened ahead of the rotation, if any. */
+	struct consumer_tracefile_prep *next_tracefile;
+	/*
+	 * Amount of data written to the current tracefile after which the next
+	 * one is prepared. Lowered when the preparation ends up being late.
+	 */
+	uint64_t tracefile_prepare_at;
 	/*
 	 * Monitor or not the streams of this channel meaning this indicates if the
 	 * streams should be sent to the data/metadata thread or added to the no
@@ -349,6 +377,16 @@ struct lttng_consumer_stream {
 
 	/* Indicate if the stream still has some data to be read. */
 	unsigned int has_data:1;
+
+	/*
+	 * Ring buffer position up to which the previous snapshot captured this
+	 * stream, and the key of the output it was recorded to. Only valid if
+	 * snapshot_pos_valid is set. Used by incremental snapshots to the same
+	 * output to skip the packets already recorded.
+	 */
+	unsigned long snapshot_last_pos;
+	uint64_t snapshot_output_key;
+	unsigned int snapshot_pos_valid:1;
 };
 
 /*
@@ -633,6 +671,13 @@ ssize_t lttng_consumer_on_read_subbuffer_mmap(
 		struct lttng_consumer_stream *stream, unsigned long len,
 		unsigned long padding,
 		struct ctf_packet_index *index);
+ssize_t lttng_consumer_write_subbuffer(
+		struct lttng_consumer_local_data *ctx,
+		struct lttng_consumer_stream *stream, const char *buf,
+		unsigned long len, unsigned long padding,
+		struct ctf_packet_index *index);
+int lttng_consumer_get_subbuffer_addr(struct lttng_consumer_stream *stream,
+		const char **addr);
 ssize_t lttng_consumer_on_read_subbuffer_splice(
 		struct lttng_consumer_local_data *ctx,
 		struct lttng_consumer_stream *stream, unsigned long len,
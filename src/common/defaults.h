@@ -40,6 +40,12 @@
 /* Default size of a hash table */
 #define DEFAULT_HT_SIZE                         4
 
+/* Number of objects reclaimed by one batched RCU callback. */
+#define DEFAULT_RCU_BATCH_SIZE                  64
+
+/* Maximum number of hash tables destroyed per wakeup of the cleanup thread. */
+#define DEFAULT_HT_CLEANUP_BATCH_SIZE           64
+
 /* Default session daemon paths */
 #define DEFAULT_HOME_DIR						"/tmp"
 #define DEFAULT_UST_SOCK_DIR                    DEFAULT_HOME_DIR "/ust-app-socks"
@@ -257,6 +263,15 @@
 /* Agent registration TCP port. */
 #define DEFAULT_AGENT_TCP_PORT              5345
 
+/* Maximum number of pending agent registrations configured together. */
+#define DEFAULT_AGENT_REG_BATCH_SIZE        64
+
+/*
+ * Number of preallocated index slots per relay stream, indexed by sequence
+ * number. Indexes in flight that do not fit fall back to a hash table.
+ */
+#define DEFAULT_RELAYD_INDEX_RING_SIZE      16
+
 /*
  * If a thread stalls for this amount of time, it will be considered bogus (bad
  * health).
@@ -289,11 +304,48 @@
 #define DEFAULT_APP_SOCKET_RW_TIMEOUT       5  /* sec */
 #define DEFAULT_APP_SOCKET_TIMEOUT_ENV      "LTTNG_APP_SOCKET_TIMEOUT"
 
+/*
+ * Number of session daemon threads setting up newly registered applications
+ * concurrently.
+ */
+#define DEFAULT_APP_REG_WORKERS             4
+#define DEFAULT_APP_REG_WORKERS_ENV         "LTTNG_APP_REG_WORKERS"
+
+/*
+ * Number of session daemon threads processing client commands concurrently.
+ */
+#define DEFAULT_CLIENT_CMD_WORKERS          4
+#define DEFAULT_CLIENT_CMD_WORKERS_ENV      "LTTNG_CLIENT_CMD_WORKERS"
+
+/*
+ * Maximum number of idle persistent client connections polled by the session
+ * daemon. Connections given back past this limit are closed.
+ */
+#define DEFAULT_CLIENT_MAX_IDLE_CONNECTIONS 64
+
 #define DEFAULT_UST_STREAM_FD_NUM			2 /* Number of fd per UST stream. */
 
 #define DEFAULT_SNAPSHOT_NAME				"snapshot"
 #define DEFAULT_SNAPSHOT_MAX_SIZE			0 /* Unlimited. */
 
+/*
+ * Size of the consumer memory area in which snapshot sub-buffers are copied
+ * before being written out. 0 disables staging.
+ */
+#define DEFAULT_SNAPSHOT_STAGING_SIZE		(16 * 1024 * 1024) /* bytes */
+#define DEFAULT_SNAPSHOT_STAGING_SIZE_ENV	"LTTNG_SNAPSHOT_STAGING_SIZE"
+
+/*
+ * Filter cost estimates above which the lttng client warns that a filter is
+ * expensive to evaluate for the traced applications. 0 disables a warning.
+ */
+#define DEFAULT_FILTER_COST_WARN_INSNS			64
+#define DEFAULT_FILTER_COST_WARN_INSNS_ENV		"LTTNG_FILTER_COST_WARN_INSNS"
+#define DEFAULT_FILTER_COST_WARN_STRING_COMPARES	8
+#define DEFAULT_FILTER_COST_WARN_STRING_COMPARES_ENV	"LTTNG_FILTER_COST_WARN_STRING_COMPARES"
+#define DEFAULT_FILTER_COST_WARN_FIELD_LOADS		16
+#define DEFAULT_FILTER_COST_WARN_FIELD_LOADS_ENV	"LTTNG_FILTER_COST_WARN_FIELD_LOADS"
+
 /* Suffix of an index file. */
 #define DEFAULT_INDEX_FILE_SUFFIX			".idx"
 #define DEFAULT_INDEX_DIR					"index"
@@ -301,6 +353,14 @@
 /* Default lttng command live timer value in usec. */
 #define DEFAULT_LTTNG_LIVE_TIMER			1000000
 
+/*
+ * Resolution of the consumer timer wheel. Channel timers expiring within the
+ * same tick are fired together.
+ */
+#define DEFAULT_CONSUMER_TIMER_WHEEL_TICK	10000 /* usec */
+/* Number of slots of the consumer timer wheel. */
+#define DEFAULT_CONSUMER_TIMER_WHEEL_SIZE	256
+
 extern size_t default_channel_subbuf_size;
 extern size_t default_metadata_subbuf_size;
 extern size_t default_ust_pid_channel_subbuf_size;
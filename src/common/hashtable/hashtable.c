@@ -63,7 +63,7 @@ static int match_u64(struct cds_lfht_node *node, const void *key)
 	struct lttng_ht_node_u64 *match_node =
 		caa_container_of(node, struct lttng_ht_node_u64, node);
 
-	return hash_match_key_u64(&match_node->key, (void *) key);
+	return match_node->key == *(const uint64_t *) key;
 }
 
 /*
@@ -73,8 +73,28 @@ static int match_two_u64(struct cds_lfht_node *node, const void *key)
 {
 	struct lttng_ht_node_two_u64 *match_node =
 		caa_container_of(node, struct lttng_ht_node_two_u64, node);
+	const struct lttng_ht_two_u64 *k = key;
 
-	return hash_match_key_two_u64((void *) &match_node->key, (void *) key);
+	return match_node->key.key1 == k->key1 &&
+		match_node->key.key2 == k->key2;
+}
+
+/*
+ * Hash function for u64 node.
+ */
+static unsigned long hash_u64(void *key, unsigned long seed)
+{
+	return lttng_ht_hash_u64(*(uint64_t *) key, seed);
+}
+
+/*
+ * Hash function for two uint64_t node.
+ */
+static unsigned long hash_two_u64(void *_key, unsigned long seed)
+{
+	struct lttng_ht_two_u64 *key = _key;
+
+	return lttng_ht_hash_two_u64(key->key1, key->key2, seed);
 }
 
 /*
@@ -113,11 +133,11 @@ struct lttng_ht *lttng_ht_new(unsigned long size, int type)
 		break;
 	case LTTNG_HT_TYPE_U64:
 		ht->match_fct = match_u64;
-		ht->hash_fct = hash_key_u64;
+		ht->hash_fct = hash_u64;
 		break;
 	case LTTNG_HT_TYPE_TWO_U64:
 		ht->match_fct = match_two_u64;
-		ht->hash_fct = hash_key_two_u64;
+		ht->hash_fct = hash_two_u64;
 		break;
 	default:
 		ERR("Unknown lttng hashtable type %d", type);
@@ -242,6 +262,36 @@ void lttng_ht_lookup(struct lttng_ht *ht, void *key,
 			ht->match_fct, key, &iter->iter);
 }
 
+/*
+ * Lookup function in uint64_t hashtable.
+ */
+void lttng_ht_lookup_u64(struct lttng_ht *ht, uint64_t key,
+		struct lttng_ht_iter *iter)
+{
+	assert(ht);
+	assert(ht->ht);
+
+	cds_lfht_lookup(ht->ht, lttng_ht_hash_u64(key, lttng_ht_seed),
+			match_u64, &key, &iter->iter);
+}
+
+/*
+ * Lookup function in two uint64_t hashtable.
+ */
+void lttng_ht_lookup_two_u64(struct lttng_ht *ht, uint64_t key1,
+		uint64_t key2, struct lttng_ht_iter *iter)
+{
+	struct lttng_ht_two_u64 key;
+
+	assert(ht);
+	assert(ht->ht);
+
+	key.key1 = key1;
+	key.key2 = key2;
+	cds_lfht_lookup(ht->ht, lttng_ht_hash_two_u64(key1, key2, lttng_ht_seed),
+			match_two_u64, &key, &iter->iter);
+}
+
 /*
  * Add unique string node to hashtable.
  */
@@ -295,7 +345,7 @@ void lttng_ht_add_u64(struct lttng_ht *ht, struct lttng_ht_node_u64 *node)
 	assert(ht->ht);
 	assert(node);
 
-	cds_lfht_add(ht->ht, ht->hash_fct(&node->key, lttng_ht_seed),
+	cds_lfht_add(ht->ht, lttng_ht_hash_u64(node->key, lttng_ht_seed),
 			&node->node);
 }
 
@@ -328,7 +378,7 @@ void lttng_ht_add_unique_u64(struct lttng_ht *ht,
 	assert(node);
 
 	node_ptr = cds_lfht_add_unique(ht->ht,
-			ht->hash_fct(&node->key, lttng_ht_seed), ht->match_fct,
+			lttng_ht_hash_u64(node->key, lttng_ht_seed), match_u64,
 			&node->key, &node->node);
 	assert(node_ptr == &node->node);
 }
@@ -345,7 +395,8 @@ void lttng_ht_add_unique_two_u64(struct lttng_ht *ht,
 	assert(node);
 
 	node_ptr = cds_lfht_add_unique(ht->ht,
-			ht->hash_fct((void *) &node->key, lttng_ht_seed), ht->match_fct,
+			lttng_ht_hash_two_u64(node->key.key1, node->key.key2,
+				lttng_ht_seed), match_two_u64,
 			(void *) &node->key, &node->node);
 	assert(node_ptr == &node->node);
 }
@@ -384,7 +435,7 @@ struct lttng_ht_node_u64 *lttng_ht_add_replace_u64(struct lttng_ht *ht,
 	assert(node);
 
 	node_ptr = cds_lfht_add_replace(ht->ht,
-			ht->hash_fct(&node->key, lttng_ht_seed), ht->match_fct,
+			lttng_ht_hash_u64(node->key, lttng_ht_seed), match_u64,
 			&node->key, &node->node);
 	if (!node_ptr) {
 		return NULL;
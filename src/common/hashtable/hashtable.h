@@ -75,6 +75,33 @@ struct lttng_ht_node_two_u64 {
 	struct rcu_head head;
 };
 
+/*
+ * Hash of an integer key used by the LTTNG_HT_TYPE_U64 and
+ * LTTNG_HT_TYPE_TWO_U64 hash tables: the multiply-xorshift finalizer of
+ * MurmurHash3. It mixes every key bit into the low-order bits selecting a
+ * bucket for a fraction of the cost of the Jenkins hash of hash_key_u64().
+ */
+static inline
+unsigned long lttng_ht_hash_u64(uint64_t key, unsigned long seed)
+{
+	uint64_t h = key ^ (uint64_t) seed;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return (unsigned long) h;
+}
+
+/* Chained so that swapping the keys changes the hash. */
+static inline
+unsigned long lttng_ht_hash_two_u64(uint64_t key1, uint64_t key2,
+		unsigned long seed)
+{
+	return lttng_ht_hash_u64(key2 ^ lttng_ht_hash_u64(key1, seed), seed);
+}
+
 /* Hashtable new and destroy */
 extern struct lttng_ht *lttng_ht_new(unsigned long size, int type);
 extern void lttng_ht_destroy(struct lttng_ht *ht);
@@ -95,6 +122,17 @@ extern void lttng_ht_node_free_two_u64(struct lttng_ht_node_two_u64 *node);
 extern void lttng_ht_lookup(struct lttng_ht *ht, void *key,
 		struct lttng_ht_iter *iter);
 
+/*
+ * Specialized lookup functions, hashing and matching the key without going
+ * through the function pointers of the hash table. Like the other u64 and two
+ * u64 specialized functions, they only apply to the hash tables of these
+ * types.
+ */
+extern void lttng_ht_lookup_u64(struct lttng_ht *ht, uint64_t key,
+		struct lttng_ht_iter *iter);
+extern void lttng_ht_lookup_two_u64(struct lttng_ht *ht, uint64_t key1,
+		uint64_t key2, struct lttng_ht_iter *iter);
+
 /* Specialized add unique functions */
 extern void lttng_ht_add_unique_str(struct lttng_ht *ht,
 		struct lttng_ht_node_str *node);
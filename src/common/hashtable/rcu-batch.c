@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2015 - EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+#define _LGPL_SOURCE
+#include <assert.h>
+#include <urcu.h>
+#include <urcu/compiler.h>
+#include <urcu/tls-compat.h>
+
+#include <common/common.h>
+#include <common/defaults.h>
+
+#include "rcu-batch.h"
+
+/* Objects reclaimed by a single RCU callback. */
+struct rcu_batch {
+	struct rcu_head rcu_head;
+	unsigned int count;
+	struct rcu_head *heads[DEFAULT_RCU_BATCH_SIZE];
+};
+
+/* Batch being filled by the current thread, allocated on first use. */
+static DEFINE_URCU_TLS(struct rcu_batch *, thread_batch);
+
+/*
+ * Reclaim every object of a batch. MUST only be called by a call RCU.
+ */
+static void reclaim_batch_rcu(struct rcu_head *head)
+{
+	unsigned int i;
+	struct rcu_batch *batch =
+		caa_container_of(head, struct rcu_batch, rcu_head);
+
+	for (i = 0; i < batch->count; i++) {
+		batch->heads[i]->func(batch->heads[i]);
+	}
+	free(batch);
+}
+
+/*
+ * Queue the object of the given RCU head for reclamation by func after a grace
+ * period, like call_rcu().
+ */
+void lttng_rcu_batch_call(struct rcu_head *head,
+		void (*func)(struct rcu_head *head))
+{
+	struct rcu_batch *batch = URCU_TLS(thread_batch);
+
+	assert(head);
+	assert(func);
+
+	if (!batch) {
+		batch = zmalloc(sizeof(*batch));
+		if (!batch) {
+			/* Fallback on a callback for this object alone. */
+			call_rcu(head, func);
+			return;
+		}
+		URCU_TLS(thread_batch) = batch;
+	}
+
+	head->func = func;
+	batch->heads[batch->count++] = head;
+	if (batch->count == DEFAULT_RCU_BATCH_SIZE) {
+		lttng_rcu_batch_flush();
+	}
+}
+
+/*
+ * Hand the objects queued by the current thread to call_rcu().
+ */
+void lttng_rcu_batch_flush(void)
+{
+	struct rcu_batch *batch = URCU_TLS(thread_batch);
+
+	if (!batch) {
+		return;
+	}
+
+	URCU_TLS(thread_batch) = NULL;
+	call_rcu(&batch->rcu_head, reclaim_batch_rcu);
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2015 - EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _LTT_RCU_BATCH_H
+#define _LTT_RCU_BATCH_H
+
+#include <urcu.h>
+
+/*
+ * Batched deferred reclamation.
+ *
+ * Objects queued by a thread are accumulated in a per-thread batch which is
+ * handed to call_rcu() as a whole, so a single RCU callback reclaims up to
+ * DEFAULT_RCU_BATCH_SIZE objects after one grace period. The func callback of
+ * each object is called in the call_rcu thread, like with call_rcu().
+ *
+ * The batch is handed over once full or when flushed. A thread queuing objects
+ * MUST flush its batch at the end of a bulk teardown, before blocking for an
+ * unbounded time and before unregistering from RCU, else the queued objects
+ * are not reclaimed.
+ */
+void lttng_rcu_batch_call(struct rcu_head *head,
+		void (*func)(struct rcu_head *head));
+void lttng_rcu_batch_flush(void);
+
+#endif /* _LTT_RCU_BATCH_H */
@@ -499,14 +499,12 @@ unsigned long hash_key_str(void *key, unsigned long seed)
 }
 
 /*
- * Hash function for two uint64_t.
+ * Hash function for a buffer of the given length.
  */
 LTTNG_HIDDEN
-unsigned long hash_key_two_u64(void *key, unsigned long seed)
+unsigned long hash_key_buf(const void *key, size_t len, unsigned long seed)
 {
-	struct lttng_ht_two_u64 *k = (struct lttng_ht_two_u64 *) key;
-
-	return hash_key_u64(&k->key1, seed) ^ hash_key_u64(&k->key2, seed);
+	return hashlittle(key, len, seed);
 }
 
 /*
@@ -522,19 +520,6 @@ int hash_match_key_ulong(void *key1, void *key2)
 	return 0;
 }
 
-/*
- * Hash function compare for number value.
- */
-LTTNG_HIDDEN
-int hash_match_key_u64(void *key1, void *key2)
-{
-	if (*(uint64_t *) key1 == *(uint64_t *) key2) {
-		return 1;
-	}
-
-	return 0;
-}
-
 /*
  * Hash compare function for string.
  */
@@ -547,20 +532,3 @@ int hash_match_key_str(void *key1, void *key2)
 
 	return 0;
 }
-
-/*
- * Hash function compare two uint64_t.
- */
-LTTNG_HIDDEN
-int hash_match_key_two_u64(void *key1, void *key2)
-{
-	struct lttng_ht_two_u64 *k1 = (struct lttng_ht_two_u64 *) key1;
-	struct lttng_ht_two_u64 *k2 = (struct lttng_ht_two_u64 *) key2;
-
-	if (hash_match_key_u64(&k1->key1, &k2->key1) &&
-			hash_match_key_u64(&k1->key2, &k2->key2)) {
-		return 1;
-	}
-
-	return 0;
-}
@@ -43,6 +43,7 @@
 #include <common/consumer-stream.h>
 #include <common/index/index.h>
 #include <common/consumer-timer.h>
+#include <common/consumer-snapshot.h>
 
 #include "kernel-consumer.h"
 
@@ -109,217 +110,358 @@ int lttng_kconsumer_get_consumed_snapshot(struct lttng_consumer_stream *stream,
 	return ret;
 }
 
+static int get_index_values(struct ctf_packet_index *index, int infd);
+
 /*
- * Take a snapshot of all the stream of a channel
+ * Create the snapshot output of a stream, either a local tracefile or a
+ * relayd stream. For an incremental snapshot written locally, the index file
+ * of the stream is also created.
+ *
+ * The stream lock MUST be acquired.
  *
  * Returns 0 on success, < 0 on error
  */
-int lttng_kconsumer_snapshot_channel(uint64_t key, char *path,
-		uint64_t relayd_id, uint64_t max_stream_size,
+static int snapshot_stream_open_output(struct lttng_consumer_stream *stream,
+		char *path, uint64_t relayd_id, int incremental)
+{
+	int ret;
+
+	/*
+	 * Assign the received relayd ID so we can use it for streaming. The streams
+	 * are not visible to anyone so this is OK to change it.
+	 */
+	stream->net_seq_idx = relayd_id;
+	stream->chan->relayd_id = relayd_id;
+	if (relayd_id != (uint64_t) -1ULL) {
+		ret = consumer_send_relayd_stream(stream, path);
+		if (ret < 0) {
+			ERR("sending stream to relayd");
+			goto end;
+		}
+	} else {
+		ret = utils_create_stream_file(path, stream->name,
+				stream->chan->tracefile_size,
+				stream->tracefile_count_current,
+				stream->uid, stream->gid, NULL);
+		if (ret < 0) {
+			ERR("utils_create_stream_file");
+			goto end;
+		}
+
+		stream->out_fd = ret;
+		stream->tracefile_size_current = 0;
+		stream->out_fd_offset = 0;
+
+		if (incremental) {
+			ret = index_create_file(path, stream->name, stream->uid,
+					stream->gid, stream->chan->tracefile_size,
+					stream->tracefile_count_current);
+			if (ret < 0) {
+				ERR("index_create_file");
+				goto end;
+			}
+			stream->index_fd = ret;
+		}
+
+		DBG("Kernel consumer snapshot stream %s/%s (%" PRIu64 ")",
+				path, stream->name, stream->key);
+	}
+	ret = 0;
+
+end:
+	return ret;
+}
+
+/*
+ * Close the snapshot output of a stream so it can be reused by the next
+ * snapshot.
+ *
+ * The stream lock MUST be acquired.
+ *
+ * Returns 0 on success, < 0 on error
+ */
+static int snapshot_stream_close_output(struct lttng_consumer_stream *stream)
+{
+	int ret = 0;
+
+	if (stream->out_fd >= 0) {
+		ret = close(stream->out_fd);
+		if (ret < 0) {
+			PERROR("Kernel consumer snapshot close out_fd");
+		}
+		stream->out_fd = -1;
+	}
+	if (stream->index_fd >= 0) {
+		if (close(stream->index_fd) < 0) {
+			PERROR("Kernel consumer snapshot close index_fd");
+			ret = -1;
+		}
+		stream->index_fd = -1;
+	}
+	if (stream->sent_to_relayd) {
+		close_relayd_stream(stream);
+	}
+	stream->net_seq_idx = (uint64_t) -1ULL;
+
+	return ret;
+}
+
+/*
+ * Capture the content of a stream ring buffer in the snapshot staging area.
+ *
+ * The stream lock MUST be acquired and the staging area MUST be held. The
+ * stream lock is released while the staging area is drained if it becomes
+ * full.
+ *
+ * If incremental is set, only the packets produced since the previous
+ * snapshot of the stream to the same output are captured.
+ *
+ * Returns 0 on success, < 0 on error
+ */
+static int snapshot_stream_capture(struct lttng_consumer_stream *stream,
+		uint64_t max_stream_size, int incremental, uint64_t output_key,
 		struct lttng_consumer_local_data *ctx)
 {
 	int ret;
 	unsigned long consumed_pos, produced_pos;
-	struct lttng_consumer_channel *channel;
-	struct lttng_consumer_stream *stream;
 
-	DBG("Kernel consumer snapshot channel %" PRIu64, key);
+	ret = kernctl_buffer_flush(stream->wait_fd);
+	if (ret < 0) {
+		ERR("Failed to flush kernel stream");
+		ret = -errno;
+		goto end;
+	}
 
-	rcu_read_lock();
+	ret = lttng_kconsumer_take_snapshot(stream);
+	if (ret < 0) {
+		ERR("Taking kernel snapshot");
+		goto end;
+	}
 
-	channel = consumer_find_channel(key);
-	if (!channel) {
-		ERR("No channel found for key %" PRIu64, key);
-		ret = -1;
+	ret = lttng_kconsumer_get_produced_snapshot(stream, &produced_pos);
+	if (ret < 0) {
+		ERR("Produced kernel snapshot position");
 		goto end;
 	}
 
-	/* Splice is not supported yet for channel snapshot. */
-	if (channel->output != CONSUMER_CHANNEL_MMAP) {
-		ERR("Unsupported output %d", channel->output);
-		ret = -1;
+	ret = lttng_kconsumer_get_consumed_snapshot(stream, &consumed_pos);
+	if (ret < 0) {
+		ERR("Consumerd kernel snapshot position");
 		goto end;
 	}
 
-	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+	if (stream->max_sb_size == 0) {
+		ret = kernctl_get_max_subbuf_size(stream->wait_fd,
+				&stream->max_sb_size);
+		if (ret < 0) {
+			ERR("Getting kernel max_sb_size");
+			ret = -errno;
+			goto end;
+		}
+	}
 
-		health_code_update();
+	/*
+	 * The original value is sent back if max stream size is larger than
+	 * the possible size of the snapshot. Also, we asume that the session
+	 * daemon should never send a maximum stream size that is lower than
+	 * subbuffer size.
+	 */
+	consumed_pos = consumer_get_consumed_maxsize(consumed_pos,
+			produced_pos, max_stream_size);
+	consumed_pos = consumer_snapshot_get_start_pos(stream, consumed_pos,
+			produced_pos, incremental, output_key);
 
-		/*
-		 * Lock stream because we are about to change its state.
-		 */
-		pthread_mutex_lock(&stream->lock);
+	while (consumed_pos < produced_pos) {
+		unsigned long len, padded_len;
+		struct ctf_packet_index index, *indexp = NULL;
 
-		/*
-		 * Assign the received relayd ID so we can use it for streaming. The streams
-		 * are not visible to anyone so this is OK to change it.
-		 */
-		stream->net_seq_idx = relayd_id;
-		channel->relayd_id = relayd_id;
-		if (relayd_id != (uint64_t) -1ULL) {
-			ret = consumer_send_relayd_stream(stream, path);
-			if (ret < 0) {
-				ERR("sending stream to relayd");
-				goto end_unlock;
-			}
-		} else {
-			ret = utils_create_stream_file(path, stream->name,
-					stream->chan->tracefile_size,
-					stream->tracefile_count_current,
-					stream->uid, stream->gid, NULL);
-			if (ret < 0) {
-				ERR("utils_create_stream_file");
-				goto end_unlock;
-			}
+		health_code_update();
 
-			stream->out_fd = ret;
-			stream->tracefile_size_current = 0;
+		DBG("Kernel consumer taking snapshot at pos %lu", consumed_pos);
 
-			DBG("Kernel consumer snapshot stream %s/%s (%" PRIu64 ")",
-					path, stream->name, stream->key);
-		}
-		if (relayd_id != -1ULL) {
-			ret = consumer_send_relayd_streams_sent(relayd_id);
-			if (ret < 0) {
-				ERR("sending streams sent to relayd");
-				goto end_unlock;
+		ret = kernctl_get_subbuf(stream->wait_fd, &consumed_pos);
+		if (ret < 0) {
+			if (errno != EAGAIN) {
+				PERROR("kernctl_get_subbuf snapshot");
+				ret = -errno;
+				goto end;
 			}
+			DBG("Kernel consumer get subbuf failed. Skipping it.");
+			consumed_pos += stream->max_sb_size;
+			continue;
 		}
 
-		ret = kernctl_buffer_flush(stream->wait_fd);
+		ret = kernctl_get_subbuf_size(stream->wait_fd, &len);
 		if (ret < 0) {
-			ERR("Failed to flush kernel stream");
+			ERR("Snapshot kernctl_get_subbuf_size");
 			ret = -errno;
-			goto end_unlock;
-		}
-
-		ret = lttng_kconsumer_take_snapshot(stream);
-		if (ret < 0) {
-			ERR("Taking kernel snapshot");
-			goto end_unlock;
+			goto error_put_subbuf;
 		}
 
-		ret = lttng_kconsumer_get_produced_snapshot(stream, &produced_pos);
+		ret = kernctl_get_padded_subbuf_size(stream->wait_fd, &padded_len);
 		if (ret < 0) {
-			ERR("Produced kernel snapshot position");
-			goto end_unlock;
+			ERR("Snapshot kernctl_get_padded_subbuf_size");
+			ret = -errno;
+			goto error_put_subbuf;
 		}
 
-		ret = lttng_kconsumer_get_consumed_snapshot(stream, &consumed_pos);
-		if (ret < 0) {
-			ERR("Consumerd kernel snapshot position");
-			goto end_unlock;
+		if (stream->index_fd >= 0) {
+			ret = get_index_values(&index, stream->wait_fd);
+			if (ret < 0) {
+				goto error_put_subbuf;
+			}
+			indexp = &index;
 		}
 
-		if (stream->max_sb_size == 0) {
-			ret = kernctl_get_max_subbuf_size(stream->wait_fd,
-					&stream->max_sb_size);
+		ret = consumer_snapshot_stage_subbuffer(ctx, stream, len,
+				padded_len - len, indexp);
+		if (ret == -ENOSPC) {
+			/*
+			 * Staging area is full. Release the sub-buffer, write out what
+			 * was staged so far and retry at the same position.
+			 */
+			ret = kernctl_put_subbuf(stream->wait_fd);
 			if (ret < 0) {
-				ERR("Getting kernel max_sb_size");
+				ERR("Snapshot kernctl_put_subbuf");
 				ret = -errno;
-				goto end_unlock;
+				goto end;
 			}
+			pthread_mutex_unlock(&stream->lock);
+			ret = consumer_snapshot_staging_drain(ctx);
+			pthread_mutex_lock(&stream->lock);
+			if (ret < 0) {
+				goto end;
+			}
+			continue;
+		} else if (ret < 0) {
+			/*
+			 * Display the error but continue processing to try to release
+			 * the subbuffer.
+			 */
+			ERR("Snapshot of kernel stream %s sub-buffer at pos %lu",
+					stream->name, consumed_pos);
 		}
 
-		/*
-		 * The original value is sent back if max stream size is larger than
-		 * the possible size of the snapshot. Also, we asume that the session
-		 * daemon should never send a maximum stream size that is lower than
-		 * subbuffer size.
-		 */
-		consumed_pos = consumer_get_consumed_maxsize(consumed_pos,
-				produced_pos, max_stream_size);
+		ret = kernctl_put_subbuf(stream->wait_fd);
+		if (ret < 0) {
+			ERR("Snapshot kernctl_put_subbuf");
+			ret = -errno;
+			goto end;
+		}
+		consumed_pos += stream->max_sb_size;
+	}
 
-		while (consumed_pos < produced_pos) {
-			ssize_t read_len;
-			unsigned long len, padded_len;
+	consumer_snapshot_set_captured(stream, produced_pos, output_key);
+	ret = 0;
+	goto end;
 
-			health_code_update();
+error_put_subbuf:
+	if (kernctl_put_subbuf(stream->wait_fd) < 0) {
+		ERR("Snapshot kernctl_put_subbuf error path");
+	}
+end:
+	return ret;
+}
 
-			DBG("Kernel consumer taking snapshot at pos %lu", consumed_pos);
+/*
+ * Take a snapshot of all the stream of a channel
+ *
+ * The outputs of all the streams are created first. The ring buffers are
+ * then captured one after the other in the snapshot staging area, so that
+ * the snapshot window of the channel is not stretched by I/O, and finally
+ * written out.
+ *
+ * An incremental snapshot only records the packets produced since the
+ * previous snapshot of the channel to the output identified by output_key.
+ *
+ * Returns 0 on success, < 0 on error
+ */
+int lttng_kconsumer_snapshot_channel(uint64_t key, char *path,
+		uint64_t relayd_id, uint64_t max_stream_size, int incremental,
+		uint64_t output_key, struct lttng_consumer_local_data *ctx)
+{
+	int ret;
+	struct lttng_consumer_channel *channel;
+	struct lttng_consumer_stream *stream;
 
-			ret = kernctl_get_subbuf(stream->wait_fd, &consumed_pos);
-			if (ret < 0) {
-				if (errno != EAGAIN) {
-					PERROR("kernctl_get_subbuf snapshot");
-					ret = -errno;
-					goto end_unlock;
-				}
-				DBG("Kernel consumer get subbuf failed. Skipping it.");
-				consumed_pos += stream->max_sb_size;
-				continue;
-			}
+	DBG("Kernel consumer snapshot channel %" PRIu64, key);
 
-			ret = kernctl_get_subbuf_size(stream->wait_fd, &len);
-			if (ret < 0) {
-				ERR("Snapshot kernctl_get_subbuf_size");
-				ret = -errno;
-				goto error_put_subbuf;
-			}
+	rcu_read_lock();
 
-			ret = kernctl_get_padded_subbuf_size(stream->wait_fd, &padded_len);
-			if (ret < 0) {
-				ERR("Snapshot kernctl_get_padded_subbuf_size");
-				ret = -errno;
-				goto error_put_subbuf;
-			}
+	channel = consumer_find_channel(key);
+	if (!channel) {
+		ERR("No channel found for key %" PRIu64, key);
+		ret = -1;
+		goto end;
+	}
 
-			read_len = lttng_consumer_on_read_subbuffer_mmap(ctx, stream, len,
-					padded_len - len, NULL);
-			/*
-			 * We write the padded len in local tracefiles but the data len
-			 * when using a relay. Display the error but continue processing
-			 * to try to release the subbuffer.
-			 */
-			if (relayd_id != (uint64_t) -1ULL) {
-				if (read_len != len) {
-					ERR("Error sending to the relay (ret: %zd != len: %lu)",
-							read_len, len);
-				}
-			} else {
-				if (read_len != padded_len) {
-					ERR("Error writing to tracefile (ret: %zd != len: %lu)",
-							read_len, padded_len);
-				}
-			}
+	/* Splice is not supported yet for channel snapshot. */
+	if (channel->output != CONSUMER_CHANNEL_MMAP) {
+		ERR("Unsupported output %d", channel->output);
+		ret = -1;
+		goto end;
+	}
 
-			ret = kernctl_put_subbuf(stream->wait_fd);
-			if (ret < 0) {
-				ERR("Snapshot kernctl_put_subbuf");
-				ret = -errno;
-				goto end_unlock;
-			}
-			consumed_pos += stream->max_sb_size;
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		health_code_update();
+
+		/*
+		 * Lock stream because we are about to change its state.
+		 */
+		pthread_mutex_lock(&stream->lock);
+		ret = snapshot_stream_open_output(stream, path, relayd_id,
+				incremental);
+		pthread_mutex_unlock(&stream->lock);
+		if (ret < 0) {
+			goto error_close_streams;
+		}
+	}
+	if (relayd_id != (uint64_t) -1ULL) {
+		ret = consumer_send_relayd_streams_sent(relayd_id);
+		if (ret < 0) {
+			ERR("sending streams sent to relayd");
+			goto error_close_streams;
 		}
+	}
 
-		if (relayd_id == (uint64_t) -1ULL) {
-			if (stream->out_fd >= 0) {
-				ret = close(stream->out_fd);
-				if (ret < 0) {
-					PERROR("Kernel consumer snapshot close out_fd");
-					goto end_unlock;
-				}
-				stream->out_fd = -1;
-			}
-		} else {
-			close_relayd_stream(stream);
-			stream->net_seq_idx = (uint64_t) -1ULL;
+	consumer_snapshot_staging_begin();
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		pthread_mutex_lock(&stream->lock);
+		ret = snapshot_stream_capture(stream, max_stream_size, incremental,
+				output_key, ctx);
+		pthread_mutex_unlock(&stream->lock);
+		if (ret < 0) {
+			consumer_snapshot_staging_end();
+			goto error_close_streams;
 		}
+	}
+	ret = consumer_snapshot_staging_drain(ctx);
+	consumer_snapshot_staging_end();
+	if (ret < 0) {
+		goto error_close_streams;
+	}
+
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		pthread_mutex_lock(&stream->lock);
+		ret = snapshot_stream_close_output(stream);
 		pthread_mutex_unlock(&stream->lock);
+		if (ret < 0) {
+			goto error_close_streams;
+		}
 	}
 
 	/* All good! */
 	ret = 0;
 	goto end;
 
-error_put_subbuf:
-	ret = kernctl_put_subbuf(stream->wait_fd);
-	if (ret < 0) {
-		ret = -errno;
-		ERR("Snapshot kernctl_put_subbuf error path");
+error_close_streams:
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		pthread_mutex_lock(&stream->lock);
+		(void) snapshot_stream_close_output(stream);
+		/* Nothing was recorded, the next snapshot must be complete. */
+		stream->snapshot_pos_valid = 0;
+		pthread_mutex_unlock(&stream->lock);
 	}
-end_unlock:
-	pthread_mutex_unlock(&stream->lock);
 end:
 	rcu_read_unlock();
 	return ret;
@@ -887,6 +1029,8 @@ int lttng_kconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 					msg.u.snapshot_channel.pathname,
 					msg.u.snapshot_channel.relayd_id,
 					msg.u.snapshot_channel.max_stream_size,
+					msg.u.snapshot_channel.incremental,
+					msg.u.snapshot_channel.output_key,
 					ctx);
 			if (ret < 0) {
 				ERR("Snapshot channel failed");
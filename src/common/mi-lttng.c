@@ -67,6 +67,12 @@ const char * const mi_lttng_element_version_web = "url";
 const char * const mi_lttng_element_event_field = "event_field";
 const char * const mi_lttng_element_event_fields = "event_fields";
 
+/* Strings related to the filter cost estimate of a lttng_event */
+const char * const mi_lttng_element_filter_cost = "filter_cost";
+const char * const mi_lttng_element_filter_cost_insns = "instructions";
+const char * const mi_lttng_element_filter_cost_string_compares = "string_compares";
+const char * const mi_lttng_element_filter_cost_field_loads = "field_loads";
+
 /* String related to lttng_event_context */
 const char * const mi_lttng_context_type_perf_counter = "PERF_COUNTER";
 const char * const mi_lttng_context_type_perf_cpu_counter = "PERF_CPU_COUNTER";
@@ -911,6 +917,45 @@ end:
 
 }
 
+LTTNG_HIDDEN
+int mi_lttng_filter_cost(struct mi_writer *writer,
+		const struct lttng_event_filter_cost *cost)
+{
+	int ret;
+
+	/* Open filter cost element */
+	ret = mi_lttng_writer_open_element(writer, mi_lttng_element_filter_cost);
+	if (ret) {
+		goto end;
+	}
+
+	ret = mi_lttng_writer_write_element_unsigned_int(writer,
+			mi_lttng_element_filter_cost_insns, cost->nr_insns);
+	if (ret) {
+		goto end;
+	}
+
+	ret = mi_lttng_writer_write_element_unsigned_int(writer,
+			mi_lttng_element_filter_cost_string_compares,
+			cost->nr_string_compares);
+	if (ret) {
+		goto end;
+	}
+
+	ret = mi_lttng_writer_write_element_unsigned_int(writer,
+			mi_lttng_element_filter_cost_field_loads,
+			cost->nr_field_loads);
+	if (ret) {
+		goto end;
+	}
+
+	/* Close filter cost element */
+	ret = mi_lttng_writer_close_element(writer);
+
+end:
+	return ret;
+}
+
 LTTNG_HIDDEN
 int mi_lttng_event_common_attributes(struct mi_writer *writer,
 		struct lttng_event *event)
@@ -947,6 +992,14 @@ int mi_lttng_event_common_attributes(struct mi_writer *writer,
 	/* Event filter enabled? */
 	ret = mi_lttng_writer_write_element_bool(writer,
 			config_element_filter, event->filter);
+	if (ret) {
+		goto end;
+	}
+
+	/* Filter cost estimate, none from older session daemons. */
+	if (event->filter && event->filter_cost.nr_insns) {
+		ret = mi_lttng_filter_cost(writer, &event->filter_cost);
+	}
 
 end:
 	return ret;
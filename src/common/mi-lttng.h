@@ -90,6 +90,12 @@ const char * const mi_lttng_element_version_web;
 const char * const mi_lttng_element_event_field;
 const char * const mi_lttng_element_event_fields;
 
+/* Strings related to the filter cost estimate of a lttng_event */
+const char * const mi_lttng_element_filter_cost;
+const char * const mi_lttng_element_filter_cost_insns;
+const char * const mi_lttng_element_filter_cost_string_compares;
+const char * const mi_lttng_element_filter_cost_field_loads;
+
 /* String related to lttng_event_context */
 const char * const mi_lttng_context_type_perf_counter;
 const char * const mi_lttng_context_type_perf_cpu_counter;
@@ -430,6 +436,18 @@ int mi_lttng_channel(struct mi_writer *writer,
 int mi_lttng_channel_attr(struct mi_writer *writer,
 		struct lttng_channel_attr *attr);
 
+/*
+ * Machine interface: write the filter cost estimate of an event.
+ *
+ * writer An instance of a machine interface writer.
+ * cost The filter cost estimate.
+ *
+ * Returns zero if the element's value could be written.
+ * Negative values indicate an error.
+ */
+int mi_lttng_filter_cost(struct mi_writer *writer,
+		const struct lttng_event_filter_cost *cost);
+
 /*
 * Machine interface for event common attributes.
 *
@@ -442,6 +460,7 @@ int mi_lttng_channel_attr(struct mi_writer *writer,
 * - event type
 * - enabled tag
 * - event filter
+* - filter cost estimate, if known
 *
 * Returns zero if the element's value could be written.
 * Negative values indicate an error.
@@ -794,6 +794,42 @@ error:
 	return ret;
 }
 
+/*
+ * Send a RELAYD_SEND_INDEX command and wait for the reply.
+ */
+static int send_index(struct lttcomm_relayd_sock *rsock,
+		struct lttcomm_relayd_index *msg)
+{
+	int ret;
+	struct lttcomm_relayd_generic_reply reply;
+
+	/* Send command */
+	ret = send_command(rsock, RELAYD_SEND_INDEX, msg, sizeof(*msg), 0);
+	if (ret < 0) {
+		goto error;
+	}
+
+	/* Receive response */
+	ret = recv_reply(rsock, (void *) &reply, sizeof(reply));
+	if (ret < 0) {
+		goto error;
+	}
+
+	reply.ret_code = be32toh(reply.ret_code);
+
+	/* Return session id or negative ret code. */
+	if (reply.ret_code != LTTNG_OK) {
+		ret = -1;
+		ERR("Relayd send index replied error %d", reply.ret_code);
+	} else {
+		/* Success */
+		ret = 0;
+	}
+
+error:
+	return ret;
+}
+
 /*
  * Send index to the relayd.
  */
@@ -801,17 +837,14 @@ int relayd_send_index(struct lttcomm_relayd_sock *rsock,
 		struct ctf_packet_index *index, uint64_t relay_stream_id,
 		uint64_t net_seq_num)
 {
-	int ret;
 	struct lttcomm_relayd_index msg;
-	struct lttcomm_relayd_generic_reply reply;
 
 	/* Code flow error. Safety net. */
 	assert(rsock);
 
 	if (rsock->minor < 4) {
 		DBG("Not sending indexes before protocol 2.4");
-		ret = 0;
-		goto error;
+		return 0;
 	}
 
 	DBG("Relayd sending index for stream ID %" PRIu64, relay_stream_id);
@@ -828,29 +861,89 @@ int relayd_send_index(struct lttcomm_relayd_sock *rsock,
 	msg.events_discarded = index->events_discarded;
 	msg.stream_id = index->stream_id;
 
-	/* Send command */
-	ret = send_command(rsock, RELAYD_SEND_INDEX, &msg, sizeof(msg), 0);
-	if (ret < 0) {
-		goto error;
+	return send_index(rsock, &msg);
+}
+
+/*
+ * Send many indexes to the relayd in as few commands as possible. The
+ * messages must already be in big endian.
+ *
+ * Relayd not accepting RELAYD_SEND_INDEX_BATCH get one RELAYD_SEND_INDEX
+ * command per index.
+ *
+ * Return 0 on success else a negative value.
+ */
+int relayd_send_index_batch(struct lttcomm_relayd_sock *rsock,
+		struct lttcomm_relayd_index *indexes, uint32_t count)
+{
+	int ret = 0;
+	uint32_t i, nb;
+	char *buf = NULL;
+	struct lttcomm_relayd_index_batch *batch;
+	struct lttcomm_relayd_generic_reply reply;
+
+	/* Code flow error. Safety net. */
+	assert(rsock);
+	assert(indexes || count == 0);
+
+	if (rsock->minor < 4) {
+		DBG("Not sending indexes before protocol 2.4");
+		goto end;
 	}
 
-	/* Receive response */
-	ret = recv_reply(rsock, (void *) &reply, sizeof(reply));
-	if (ret < 0) {
-		goto error;
+	if (rsock->minor < RELAYD_VERSION_COMM_MINOR_INDEX_BATCH) {
+		for (i = 0; i < count; i++) {
+			ret = send_index(rsock, &indexes[i]);
+			if (ret < 0) {
+				goto end;
+			}
+		}
+		goto end;
 	}
 
-	reply.ret_code = be32toh(reply.ret_code);
+	for (i = 0; i < count; i += nb) {
+		size_t size;
 
-	/* Return session id or negative ret code. */
-	if (reply.ret_code != LTTNG_OK) {
-		ret = -1;
-		ERR("Relayd send index replied error %d", reply.ret_code);
-	} else {
-		/* Success */
+		nb = count - i;
+		if (nb > LTTCOMM_RELAYD_INDEX_BATCH_MAX) {
+			nb = LTTCOMM_RELAYD_INDEX_BATCH_MAX;
+		}
+		size = sizeof(*batch) + nb * sizeof(*indexes);
+
+		DBG("Relayd sending batch of %" PRIu32 " indexes", nb);
+
+		buf = zmalloc(size);
+		if (!buf) {
+			PERROR("zmalloc relayd index batch");
+			ret = -ENOMEM;
+			goto end;
+		}
+		batch = (struct lttcomm_relayd_index_batch *) buf;
+		batch->count = htobe32(nb);
+		memcpy(buf + sizeof(*batch), &indexes[i], nb * sizeof(*indexes));
+
+		ret = send_command(rsock, RELAYD_SEND_INDEX_BATCH, buf, size, 0);
+		free(buf);
+		buf = NULL;
+		if (ret < 0) {
+			goto end;
+		}
+
+		ret = recv_reply(rsock, (void *) &reply, sizeof(reply));
+		if (ret < 0) {
+			goto end;
+		}
+
+		reply.ret_code = be32toh(reply.ret_code);
+		if (reply.ret_code != LTTNG_OK) {
+			ERR("Relayd send index batch replied error %d",
+					reply.ret_code);
+			ret = -1;
+			goto end;
+		}
 		ret = 0;
 	}
 
-error:
+end:
 	return ret;
 }
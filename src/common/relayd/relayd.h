@@ -49,5 +49,7 @@ int relayd_end_data_pending(struct lttcomm_relayd_sock *sock, uint64_t id,
 int relayd_send_index(struct lttcomm_relayd_sock *rsock,
 		struct ctf_packet_index *index, uint64_t relay_stream_id,
 		uint64_t net_seq_num);
+int relayd_send_index_batch(struct lttcomm_relayd_sock *rsock,
+		struct lttcomm_relayd_index *indexes, uint32_t count);
 
 #endif /* _RELAYD_H */
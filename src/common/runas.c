@@ -18,6 +18,7 @@
 
 #define _GNU_SOURCE
 #define _LGPL_SOURCE
+#include <assert.h>
 #include <errno.h>
 #include <limits.h>
 #include <stdio.h>
@@ -25,46 +26,25 @@
 #include <string.h>
 #include <sys/wait.h>
 #include <sys/types.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <sched.h>
-#include <sys/signal.h>
+#include <signal.h>
+#include <urcu/list.h>
 
 #include <common/common.h>
 #include <common/utils.h>
-#include <common/compat/mman.h>
-#include <common/compat/clone.h>
 
 #include "runas.h"
 
-#define RUNAS_CHILD_STACK_SIZE	10485760
+/* Highest fd closed by a new worker when the limit can't be queried. */
+#define RUN_AS_WORKER_FALLBACK_MAX_FD	1024
 
-#ifndef MAP_STACK
-#define MAP_STACK		0
-#endif
-
-#ifdef __FreeBSD__
-/* FreeBSD MAP_STACK always return -ENOMEM */
-#define LTTNG_MAP_STACK		0
-#else
-#define LTTNG_MAP_STACK		MAP_STACK
-#endif
-
-#ifndef MAP_GROWSDOWN
-#define MAP_GROWSDOWN		0
-#endif
-
-#ifndef MAP_ANONYMOUS
-#define MAP_ANONYMOUS		MAP_ANON
-#endif
-
-struct run_as_data {
-	int (*cmd)(void *data);
-	void *data;
-	uid_t uid;
-	gid_t gid;
-	int retval_pipe;
+enum run_as_cmd {
+	RUN_AS_MKDIR,
+	RUN_AS_MKDIR_RECURSIVE,
+	RUN_AS_OPEN,
 };
 
 struct run_as_mkdir_data {
@@ -78,6 +58,45 @@ struct run_as_open_data {
 	mode_t mode;
 };
 
+/*
+ * Command sent to a run as worker.
+ */
+struct run_as_worker_request {
+	enum run_as_cmd cmd;
+	int flags;
+	mode_t mode;
+	char path[PATH_MAX];
+};
+
+/*
+ * Reply of a run as worker. For an open command, the file descriptor is
+ * passed along the reply with SCM_RIGHTS when ret is not negative.
+ */
+struct run_as_worker_reply {
+	int ret;
+};
+
+/*
+ * Long lived process running the commands of a given uid/gid. It is forked
+ * on the first command for that uid/gid and reached over a socket pair so
+ * the hot paths (stream files, tracefile rotation, indexes) don't create a
+ * process per file operation.
+ */
+struct run_as_worker {
+	uid_t uid;
+	gid_t gid;
+	pid_t pid;
+	/* Our end of the socket pair. */
+	int sock;
+	struct cds_list_head node;
+};
+
+/*
+ * List of running workers. Protected by lttng_libc_state_lock which also
+ * serializes the commands.
+ */
+static CDS_LIST_HEAD(run_as_workers);
+
 #ifdef VALGRIND
 static
 int use_clone(void)
@@ -129,65 +148,340 @@ int _open(void *_data)
 	return open(data->path, data->flags, data->mode);
 }
 
+/*
+ * Send the reply of a command, along with fd if it is not negative.
+ *
+ * Return 0 on success or else a negative value.
+ */
 static
-int child_run_as(void *_data)
+int worker_send_reply(int sock, struct run_as_worker_reply *reply, int fd)
 {
-	int ret;
-	struct run_as_data *data = _data;
-	ssize_t writelen;
-	int sendret;
+	ssize_t ret;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char cmsg_buf[CMSG_SPACE(sizeof(int))];
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = reply;
+	iov.iov_len = sizeof(*reply);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (fd >= 0) {
+		memset(cmsg_buf, 0, sizeof(cmsg_buf));
+		msg.msg_control = cmsg_buf;
+		msg.msg_controllen = sizeof(cmsg_buf);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
 
-	/*
-	 * Child: it is safe to drop egid and euid while sharing the
-	 * file descriptors with the parent process, since we do not
-	 * drop "uid": therefore, the user we are dropping egid/euid to
-	 * cannot attach to this process with, e.g. ptrace, nor map this
-	 * process memory.
-	 */
-	if (data->gid != getegid()) {
-		ret = setegid(data->gid);
+	do {
+		ret = sendmsg(sock, &msg, 0);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < (ssize_t) sizeof(*reply)) {
+		PERROR("run as worker sendmsg");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Receive the reply of a command. For a successful open, the received file
+ * descriptor is returned in fd.
+ *
+ * Return 0 on success or else a negative value.
+ */
+static
+int worker_recv_reply(int sock, struct run_as_worker_reply *reply, int *fd)
+{
+	ssize_t ret;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char cmsg_buf[CMSG_SPACE(sizeof(int))];
+
+	*fd = -1;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = reply;
+	iov.iov_len = sizeof(*reply);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsg_buf;
+	msg.msg_controllen = sizeof(cmsg_buf);
+
+	do {
+		ret = recvmsg(sock, &msg, 0);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < (ssize_t) sizeof(*reply)) {
 		if (ret < 0) {
-			PERROR("setegid");
-			sendret = -1;
-			goto write_return;
+			PERROR("run as worker recvmsg");
+		}
+		return -1;
+	}
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg && cmsg->cmsg_level == SOL_SOCKET &&
+			cmsg->cmsg_type == SCM_RIGHTS &&
+			cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+		memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+
+	return 0;
+}
+
+/*
+ * Main loop of a worker process. Runs commands until the parent closes its
+ * end of the socket pair.
+ */
+static
+void worker_loop(int sock)
+{
+	for (;;) {
+		ssize_t readlen;
+		int fd = -1;
+		struct run_as_worker_request req;
+		struct run_as_worker_reply reply;
+
+		readlen = lttng_read(sock, &req, sizeof(req));
+		if (readlen < (ssize_t) sizeof(req)) {
+			/* Parent is gone or closed the socket. */
+			break;
+		}
+		req.path[sizeof(req.path) - 1] = '\0';
+
+		switch (req.cmd) {
+		case RUN_AS_MKDIR:
+		{
+			struct run_as_mkdir_data data = {
+				.path = req.path,
+				.mode = req.mode,
+			};
+
+			reply.ret = _mkdir(&data);
+			break;
+		}
+		case RUN_AS_MKDIR_RECURSIVE:
+		{
+			struct run_as_mkdir_data data = {
+				.path = req.path,
+				.mode = req.mode,
+			};
+
+			reply.ret = _mkdir_recursive(&data);
+			break;
+		}
+		case RUN_AS_OPEN:
+		{
+			struct run_as_open_data data = {
+				.path = req.path,
+				.flags = req.flags,
+				.mode = req.mode,
+			};
+
+			reply.ret = fd = _open(&data);
+			break;
+		}
+		default:
+			reply.ret = -EINVAL;
+			break;
+		}
+
+		if (worker_send_reply(sock, &reply, fd) < 0) {
+			break;
+		}
+		if (fd >= 0) {
+			(void) close(fd);
+		}
+	}
+}
+
+/*
+ * Close every file descriptor of a freshly forked worker except the standard
+ * streams and its end of the socket pair, so it does not hold on to the
+ * sockets, pipes and trace files the other threads of the parent had opened.
+ *
+ * Only async-signal-safe calls are made since the parent is multithreaded.
+ */
+static
+void worker_close_fds(int keep)
+{
+	long fd, max_fd;
+
+	max_fd = sysconf(_SC_OPEN_MAX);
+	if (max_fd < 0) {
+		max_fd = RUN_AS_WORKER_FALLBACK_MAX_FD;
+	}
+	for (fd = 3; fd < max_fd; fd++) {
+		if (fd != keep) {
+			(void) close(fd);
 		}
 	}
-	if (data->uid != geteuid()) {
-		ret = seteuid(data->uid);
+}
+
+/*
+ * Fork a worker for the given uid/gid.
+ *
+ * Called with lttng_libc_state_lock held.
+ *
+ * Return the worker or NULL on error.
+ */
+static
+struct run_as_worker *worker_create(uid_t uid, gid_t gid)
+{
+	int ret, i;
+	int sv[2];
+	pid_t pid;
+	struct run_as_worker *worker;
+
+	worker = zmalloc(sizeof(*worker));
+	if (!worker) {
+		PERROR("zmalloc run as worker");
+		goto error;
+	}
+
+	ret = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+	if (ret < 0) {
+		PERROR("socketpair");
+		goto error_free;
+	}
+	/* Don't leak the sockets in the processes we exec (e.g. consumerd). */
+	for (i = 0; i < 2; i++) {
+		ret = fcntl(sv[i], F_SETFD, FD_CLOEXEC);
 		if (ret < 0) {
-			PERROR("seteuid");
-			sendret = -1;
-			goto write_return;
+			PERROR("fcntl run as worker socket");
+			goto error_close;
 		}
 	}
-	/*
-	 * Also set umask to 0 for mkdir executable bit.
-	 */
-	umask(0);
-	sendret = (*data->cmd)(data->data);
-
-write_return:
-	/* send back return value */
-	writelen = lttng_write(data->retval_pipe, &sendret, sizeof(sendret));
-	if (writelen < sizeof(sendret)) {
-		PERROR("lttng_write error");
-		return EXIT_FAILURE;
-	} else {
-		return EXIT_SUCCESS;
+
+	pid = fork();
+	if (pid < 0) {
+		PERROR("fork");
+		goto error_close;
+	} else if (pid == 0) {
+		/*
+		 * Child. Nothing is logged until the worker loop: another thread
+		 * of the parent may have held the logging or allocator locks at
+		 * the time of the fork. Setup failures are reported by the exit
+		 * status, and the parent sees the socket close.
+		 */
+		worker_close_fds(sv[1]);
+		/* Leave the signals to the parent process. */
+		(void) signal(SIGINT, SIG_DFL);
+		(void) signal(SIGTERM, SIG_DFL);
+		(void) signal(SIGUSR1, SIG_DFL);
+		(void) signal(SIGPIPE, SIG_IGN);
+
+		/*
+		 * It is safe to drop egid and euid while holding file descriptors
+		 * of the parent process, since we do not drop "uid": therefore,
+		 * the user we are dropping egid/euid to cannot attach to this
+		 * process with, e.g. ptrace, nor map this process memory.
+		 */
+		if (gid != getegid()) {
+			ret = setegid(gid);
+			if (ret < 0) {
+				_exit(EXIT_FAILURE);
+			}
+		}
+		if (uid != geteuid()) {
+			ret = seteuid(uid);
+			if (ret < 0) {
+				_exit(EXIT_FAILURE);
+			}
+		}
+		/*
+		 * Also set umask to 0 for mkdir executable bit.
+		 */
+		umask(0);
+		worker_loop(sv[1]);
+		_exit(EXIT_SUCCESS);
 	}
+
+	/* Parent */
+	ret = close(sv[1]);
+	if (ret) {
+		PERROR("close");
+	}
+	worker->uid = uid;
+	worker->gid = gid;
+	worker->pid = pid;
+	worker->sock = sv[0];
+	cds_list_add(&worker->node, &run_as_workers);
+	DBG("Run as worker %d created for uid %d and gid %d", pid, uid, gid);
+
+	return worker;
+
+error_close:
+	(void) close(sv[0]);
+	(void) close(sv[1]);
+error_free:
+	free(worker);
+error:
+	return NULL;
 }
 
+/*
+ * Stop a worker and reap it.
+ *
+ * Called with lttng_libc_state_lock held.
+ */
 static
-int run_as_clone(int (*cmd)(void *data), void *data, uid_t uid, gid_t gid)
+void worker_destroy(struct run_as_worker *worker)
 {
-	struct run_as_data run_as_data;
-	int ret = 0;
-	ssize_t readlen;
-	int status;
+	int ret, status;
 	pid_t pid;
-	int retval_pipe[2];
-	void *child_stack;
-	int retval;
+
+	cds_list_del(&worker->node);
+
+	/* The worker exits on EOF. */
+	ret = close(worker->sock);
+	if (ret) {
+		PERROR("close");
+	}
+	do {
+		pid = waitpid(worker->pid, &status, 0);
+	} while (pid < 0 && errno == EINTR);
+	if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		DBG("Run as worker %d did not exit cleanly", worker->pid);
+	}
+	free(worker);
+}
+
+/*
+ * Send a command to a worker and wait for its reply.
+ *
+ * Return 0 on success, the command result being set in reply and fd, or
+ * else a negative value if the worker is not usable.
+ */
+static
+int worker_cmd(struct run_as_worker *worker,
+		struct run_as_worker_request *req,
+		struct run_as_worker_reply *reply, int *fd)
+{
+	ssize_t writelen;
+
+	writelen = lttng_write(worker->sock, req, sizeof(*req));
+	if (writelen < (ssize_t) sizeof(*req)) {
+		return -1;
+	}
+
+	return worker_recv_reply(worker->sock, reply, fd);
+}
+
+static
+int run_as_worker(enum run_as_cmd cmd, const char *path, int flags,
+		mode_t mode, uid_t uid, gid_t gid)
+{
+	int ret, fd = -1, retry;
+	struct run_as_worker_request req;
+	struct run_as_worker_reply reply;
+	struct run_as_worker *worker = NULL, *iter;
 
 	/*
 	 * If we are non-root, we can only deal with our own uid.
@@ -200,69 +494,57 @@ int run_as_clone(int (*cmd)(void *data), void *data, uid_t uid, gid_t gid)
 		}
 	}
 
-	ret = pipe(retval_pipe);
-	if (ret < 0) {
-		PERROR("pipe");
-		retval = ret;
-		goto end;
-	}
-	run_as_data.data = data;
-	run_as_data.cmd = cmd;
-	run_as_data.uid = uid;
-	run_as_data.gid = gid;
-	run_as_data.retval_pipe = retval_pipe[1];	/* write end */
-	child_stack = mmap(NULL, RUNAS_CHILD_STACK_SIZE,
-		PROT_WRITE | PROT_READ,
-		MAP_PRIVATE | MAP_GROWSDOWN | MAP_ANONYMOUS | LTTNG_MAP_STACK,
-		-1, 0);
-	if (child_stack == MAP_FAILED) {
-		PERROR("mmap");
-		retval = -ENOMEM;
-		goto close_pipe;
-	}
-	/*
-	 * Pointing to the middle of the stack to support architectures
-	 * where the stack grows up (HPPA).
-	 */
-	pid = lttng_clone_files(child_run_as, child_stack + (RUNAS_CHILD_STACK_SIZE / 2),
-		&run_as_data);
-	if (pid < 0) {
-		PERROR("clone");
-		retval = pid;
-		goto unmap_stack;
-	}
-	/* receive return value */
-	readlen = lttng_read(retval_pipe[0], &retval, sizeof(retval));
-	if (readlen < sizeof(retval)) {
-		ret = -1;
+	memset(&req, 0, sizeof(req));
+	req.cmd = cmd;
+	req.flags = flags;
+	req.mode = mode;
+	if (strlen(path) >= sizeof(req.path)) {
+		return -ENAMETOOLONG;
 	}
+	strcpy(req.path, path);
 
-	/*
-	 * Parent: wait for child to return, in which case the
-	 * shared memory map will have been created.
-	 */
-	pid = waitpid(pid, &status, 0);
-	if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
-		PERROR("wait");
-		retval = -1;
+	cds_list_for_each_entry(iter, &run_as_workers, node) {
+		if (iter->uid == uid && iter->gid == gid) {
+			worker = iter;
+			break;
+		}
 	}
-unmap_stack:
-	ret = munmap(child_stack, RUNAS_CHILD_STACK_SIZE);
-	if (ret < 0) {
-		PERROR("munmap");
-		retval = ret;
+
+	/* Respawn the worker once if it died. */
+	for (retry = 0; retry < 2; retry++) {
+		if (!worker) {
+			worker = worker_create(uid, gid);
+			if (!worker) {
+				return -1;
+			}
+		}
+
+		ret = worker_cmd(worker, &req, &reply, &fd);
+		if (!ret) {
+			break;
+		}
+		ERR("Run as worker %d for uid %d and gid %d is not responding",
+				worker->pid, uid, gid);
+		worker_destroy(worker);
+		worker = NULL;
 	}
-close_pipe:
-	ret = close(retval_pipe[0]);
 	if (ret) {
-		PERROR("close");
+		return -1;
 	}
-	ret = close(retval_pipe[1]);
-	if (ret) {
-		PERROR("close");
+
+	if (cmd == RUN_AS_OPEN && reply.ret >= 0) {
+		if (fd < 0) {
+			ERR("Run as worker open of %s returned no file descriptor",
+					path);
+			return -1;
+		}
+		return fd;
 	}
-end:
-	return retval;
+	if (fd >= 0) {
+		(void) close(fd);
+	}
+
+	return reply.ret;
 }
 
 /*
@@ -284,20 +566,37 @@ int run_as_noclone(int (*cmd)(void *data), void *data, uid_t uid, gid_t gid)
 }
 
 static
-int run_as(int (*cmd)(void *data), void *data, uid_t uid, gid_t gid)
+int run_as(enum run_as_cmd cmd, int (*fct)(void *data), void *data,
+		const char *path, int flags, mode_t mode, uid_t uid, gid_t gid)
 {
 	if (use_clone()) {
 		int ret;
 
-		DBG("Using run_as_clone");
+		DBG("Using run_as_worker");
 		pthread_mutex_lock(&lttng_libc_state_lock);
-		ret = run_as_clone(cmd, data, uid, gid);
+		ret = run_as_worker(cmd, path, flags, mode, uid, gid);
 		pthread_mutex_unlock(&lttng_libc_state_lock);
 		return ret;
 	} else {
 		DBG("Using run_as_noclone");
-		return run_as_noclone(cmd, data, uid, gid);
+		return run_as_noclone(fct, data, uid, gid);
+	}
+}
+
+/*
+ * Stop every run as worker. Only needed for a clean teardown since the
+ * workers also exit when this process dies.
+ */
+LTTNG_HIDDEN
+void run_as_destroy_workers(void)
+{
+	struct run_as_worker *worker, *tmp;
+
+	pthread_mutex_lock(&lttng_libc_state_lock);
+	cds_list_for_each_entry_safe(worker, tmp, &run_as_workers, node) {
+		worker_destroy(worker);
 	}
+	pthread_mutex_unlock(&lttng_libc_state_lock);
 }
 
 LTTNG_HIDDEN
@@ -309,7 +608,8 @@ int run_as_mkdir_recursive(const char *path, mode_t mode, uid_t uid, gid_t gid)
 			path, mode, uid, gid);
 	data.path = path;
 	data.mode = mode;
-	return run_as(_mkdir_recursive, &data, uid, gid);
+	return run_as(RUN_AS_MKDIR_RECURSIVE, _mkdir_recursive, &data, path, 0,
+			mode, uid, gid);
 }
 
 LTTNG_HIDDEN
@@ -321,12 +621,12 @@ int run_as_mkdir(const char *path, mode_t mode, uid_t uid, gid_t gid)
 			path, mode, uid, gid);
 	data.path = path;
 	data.mode = mode;
-	return run_as(_mkdir, &data, uid, gid);
+	return run_as(RUN_AS_MKDIR, _mkdir, &data, path, 0, mode, uid, gid);
 }
 
 /*
- * Note: open_run_as is currently not working. We'd need to pass the fd
- * opened in the child to the parent.
+ * The file is opened by the worker and its file descriptor passed back to
+ * the caller.
  */
 LTTNG_HIDDEN
 int run_as_open(const char *path, int flags, mode_t mode, uid_t uid, gid_t gid)
@@ -338,5 +638,6 @@ int run_as_open(const char *path, int flags, mode_t mode, uid_t uid, gid_t gid)
 	data.path = path;
 	data.flags = flags;
 	data.mode = mode;
-	return run_as(_open, &data, uid, gid);
+	return run_as(RUN_AS_OPEN, _open, &data, path, flags, mode, uid,
+			gid);
 }
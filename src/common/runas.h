@@ -25,10 +25,11 @@
 int run_as_mkdir_recursive(const char *path, mode_t mode, uid_t uid, gid_t gid);
 int run_as_mkdir(const char *path, mode_t mode, uid_t uid, gid_t gid);
 int run_as_open(const char *path, int flags, mode_t mode, uid_t uid, gid_t gid);
+void run_as_destroy_workers(void);
 
 /*
  * We need to lock pthread exit, which deadlocks __nptl_setxid in the
- * clone.
+ * clone. Also serializes the run as worker commands.
  */
 extern pthread_mutex_t lttng_libc_state_lock;
 
@@ -31,6 +31,9 @@ enum lttcomm_agent_command {
 	AGENT_CMD_ENABLE     = 2,
 	AGENT_CMD_DISABLE    = 3,
 	AGENT_CMD_REG_DONE   = 4,	/* End registration process. */
+	/* Batched commands, starting with protocol version 1.1. */
+	AGENT_CMD_ENABLE_BATCH  = 5,
+	AGENT_CMD_DISABLE_BATCH = 6,
 };
 
 /*
@@ -67,6 +70,14 @@ struct lttcomm_agent_disable {
 	char name[LTTNG_SYMBOL_NAME_LEN];
 } LTTNG_PACKED;
 
+/*
+ * Batched enable and disable commands payload header. It is followed by
+ * nb_event struct lttcomm_agent_enable or struct lttcomm_agent_disable.
+ */
+struct lttcomm_agent_batch {
+	uint32_t nb_event;
+} LTTNG_PACKED;
+
 /*
  * Generic reply coming from the Java Agent.
  */
@@ -74,6 +85,15 @@ struct lttcomm_agent_generic_reply {
 	uint32_t ret_code;
 } LTTNG_PACKED;
 
+/*
+ * Batched enable and disable commands reply header. On success, it is followed
+ * by nb_event uint32_t return codes, one per event of the command in order.
+ */
+struct lttcomm_agent_batch_reply_hdr {
+	uint32_t ret_code;
+	uint32_t nb_event;
+} LTTNG_PACKED;
+
 /*
  * List command reply header.
  */
@@ -30,7 +30,16 @@
 #include <config.h>
 
 #define RELAYD_VERSION_COMM_MAJOR             VERSION_MAJOR
-#define RELAYD_VERSION_COMM_MINOR             VERSION_MINOR
+/*
+ * Bumped past the release minor for RELAYD_SEND_INDEX_BATCH, which a stock
+ * 2.6 relayd, announcing minor 6, does not know.
+ */
+#define RELAYD_VERSION_COMM_MINOR             7
+/* Live viewer protocol, unaffected by the data protocol extensions. */
+#define RELAYD_LIVE_VERSION_COMM_MINOR        VERSION_MINOR
+
+/* First data protocol minor accepting RELAYD_SEND_INDEX_BATCH. */
+#define RELAYD_VERSION_COMM_MINOR_INDEX_BATCH 7
 
 /*
  * lttng-relayd communication header.
@@ -164,6 +173,17 @@ struct lttcomm_relayd_index {
 	uint64_t stream_id;
 } LTTNG_PACKED;
 
+/* Maximum number of indexes in a RELAYD_SEND_INDEX_BATCH command. */
+#define LTTCOMM_RELAYD_INDEX_BATCH_MAX		4096
+
+/*
+ * Header of a RELAYD_SEND_INDEX_BATCH command, followed by count
+ * lttcomm_relayd_index.
+ */
+struct lttcomm_relayd_index_batch {
+	uint32_t count;
+} LTTNG_PACKED;
+
 /*
  * Create session in 2.4 adds additionnal parameters for live reading.
  */
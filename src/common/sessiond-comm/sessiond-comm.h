@@ -91,6 +91,8 @@ enum lttcomm_sessiond_command {
 	LTTNG_CREATE_SESSION_SNAPSHOT       = 29,
 	LTTNG_CREATE_SESSION_LIVE           = 30,
 	LTTNG_SAVE_SESSION                  = 31,
+	LTTNG_ENABLE_EVENTS                 = 32,
+	LTTNG_DISABLE_EVENTS                = 33,
 };
 
 enum lttcomm_relayd_command {
@@ -112,6 +114,8 @@ enum lttcomm_relayd_command {
 	RELAYD_LIST_SESSIONS                = 15,
 	/* All streams of the channel have been sent to the relayd (2.4+). */
 	RELAYD_STREAMS_SENT                 = 16,
+	/* Many indexes in one command (protocol 2.7+). */
+	RELAYD_SEND_INDEX_BATCH             = 17,
 };
 
 /*
@@ -219,6 +223,13 @@ struct lttcomm_proto_ops {
 			int flags);
 };
 
+/*
+ * Flag of the wait field of a LTTNG_SNAPSHOT_RECORD command: only record what
+ * the previous snapshot did not capture. Older session daemons ignore it and
+ * record a complete snapshot.
+ */
+#define LTTNG_SNAPSHOT_RECORD_INCREMENTAL	(1U << 31)
+
 /*
  * Data structure received from lttng client to session daemon.
  */
@@ -259,6 +270,18 @@ struct lttcomm_session_msg {
 			 * - unsigned char filter_bytecode[bytecode_len]
 			 */
 		} LTTNG_PACKED disable;
+		/* Bulk event enable and disable. */
+		struct {
+			char channel_name[LTTNG_SYMBOL_NAME_LEN];
+			/* Number of events in the payload. */
+			uint32_t count;
+			/* Length of the following payload. */
+			uint32_t payload_len;
+			/*
+			 * After this structure, count lttcomm_event_batch_entry are
+			 * transmitted, each followed by its variable-length items.
+			 */
+		} LTTNG_PACKED events;
 		/* Create channel */
 		struct {
 			struct lttng_channel chan LTTNG_PACKED;
@@ -286,6 +309,7 @@ struct lttcomm_session_msg {
 			struct lttng_snapshot_output output LTTNG_PACKED;
 		} LTTNG_PACKED snapshot_output;
 		struct {
+			/* Ignored, except for the LTTNG_SNAPSHOT_RECORD_* flags. */
 			uint32_t wait;
 			struct lttng_snapshot_output output LTTNG_PACKED;
 		} LTTNG_PACKED snapshot_record;
@@ -301,6 +325,25 @@ struct lttcomm_session_msg {
 
 #define LTTNG_FILTER_MAX_LEN	65536
 
+/*
+ * Event of a LTTNG_ENABLE_EVENTS or LTTNG_DISABLE_EVENTS command. The
+ * variable-length items follow in the same order as for LTTNG_ENABLE_EVENT:
+ * - char exclusion_names[LTTNG_SYMBOL_NAME_LEN][exclusion_count]
+ * - unsigned char filter_expression[expression_len]
+ * - unsigned char filter_bytecode[bytecode_len]
+ *
+ * Only the event is meaningful when disabling, the lengths must be zero.
+ */
+struct lttcomm_event_batch_entry {
+	struct lttng_event event;
+	uint32_t exclusion_count;
+	uint32_t expression_len;
+	uint32_t bytecode_len;
+} LTTNG_PACKED;
+
+/* Maximum payload length of a bulk event command. */
+#define LTTNG_EVENT_BATCH_MAX_LEN	(64 * 1024 * 1024)
+
 /*
  * Filter bytecode data. The reloc table is located at the end of the
  * bytecode. It is made of tuples: (uint16_t, var. len. string). It
@@ -453,6 +496,10 @@ struct lttcomm_consumer_msg {
 			uint64_t relayd_id;		/* Relayd id if apply. */
 			uint64_t key;
 			uint64_t max_stream_size;
+			/* Only capture packets not captured by the previous snapshot. */
+			uint32_t incremental;
+			/* Identifies the snapshot output among all the session daemon's. */
+			uint64_t output_key;
 		} LTTNG_PACKED snapshot_channel;
 		struct {
 			uint64_t channel_key;
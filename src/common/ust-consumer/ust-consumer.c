@@ -42,6 +42,7 @@
 #include <common/consumer-metadata-cache.h>
 #include <common/consumer-stream.h>
 #include <common/consumer-timer.h>
+#include <common/consumer-snapshot.h>
 #include <common/utils.h>
 #include <common/index/index.h>
 
@@ -854,155 +855,267 @@ error:
 	return ret;
 }
 
+static int get_index_values(struct ctf_packet_index *index,
+		struct ustctl_consumer_stream *ustream);
+
 /*
- * Take a snapshot of all the stream of a channel.
+ * Create the snapshot output of a stream, either a local tracefile or a
+ * relayd stream. For an incremental snapshot written locally, the index file
+ * of the stream is also created.
+ *
+ * The stream lock MUST be acquired.
  *
  * Returns 0 on success, < 0 on error
  */
-static int snapshot_channel(uint64_t key, char *path, uint64_t relayd_id,
-		uint64_t max_stream_size, struct lttng_consumer_local_data *ctx)
+static int snapshot_stream_open_output(struct lttng_consumer_stream *stream,
+		char *path, uint64_t relayd_id, int incremental)
+{
+	int ret;
+
+	stream->net_seq_idx = relayd_id;
+
+	if (relayd_id != (uint64_t) -1ULL) {
+		ret = consumer_send_relayd_stream(stream, path);
+		if (ret < 0) {
+			goto end;
+		}
+	} else {
+		ret = utils_create_stream_file(path, stream->name,
+				stream->chan->tracefile_size,
+				stream->tracefile_count_current,
+				stream->uid, stream->gid, NULL);
+		if (ret < 0) {
+			goto end;
+		}
+		stream->out_fd = ret;
+		stream->tracefile_size_current = 0;
+		stream->out_fd_offset = 0;
+
+		if (incremental) {
+			ret = index_create_file(path, stream->name, stream->uid,
+					stream->gid, stream->chan->tracefile_size,
+					stream->tracefile_count_current);
+			if (ret < 0) {
+				goto end;
+			}
+			stream->index_fd = ret;
+		}
+
+		DBG("UST consumer snapshot stream %s/%s (%" PRIu64 ")", path,
+				stream->name, stream->key);
+	}
+	ret = 0;
+
+end:
+	return ret;
+}
+
+/*
+ * Capture the content of a stream ring buffer in the snapshot staging area.
+ *
+ * The stream lock MUST be acquired and the staging area MUST be held. The
+ * stream lock is released while the staging area is drained if it becomes
+ * full.
+ *
+ * If incremental is set, only the packets produced since the previous
+ * snapshot of the stream to the same output are captured.
+ *
+ * Returns 0 on success, < 0 on error
+ */
+static int snapshot_stream_capture(struct lttng_consumer_stream *stream,
+		uint64_t max_stream_size, int incremental, uint64_t output_key,
+		struct lttng_consumer_local_data *ctx)
 {
 	int ret;
-	unsigned use_relayd = 0;
 	unsigned long consumed_pos, produced_pos;
-	struct lttng_consumer_channel *channel;
-	struct lttng_consumer_stream *stream;
 
-	assert(path);
-	assert(ctx);
+	ustctl_flush_buffer(stream->ustream, 1);
 
-	rcu_read_lock();
+	ret = lttng_ustconsumer_take_snapshot(stream);
+	if (ret < 0) {
+		ERR("Taking UST snapshot");
+		goto end;
+	}
 
-	if (relayd_id != (uint64_t) -1ULL) {
-		use_relayd = 1;
+	ret = lttng_ustconsumer_get_produced_snapshot(stream, &produced_pos);
+	if (ret < 0) {
+		ERR("Produced UST snapshot position");
+		goto end;
 	}
 
-	channel = consumer_find_channel(key);
-	if (!channel) {
-		ERR("UST snapshot channel not found for key %" PRIu64, key);
-		ret = -1;
-		goto error;
+	ret = lttng_ustconsumer_get_consumed_snapshot(stream, &consumed_pos);
+	if (ret < 0) {
+		ERR("Consumerd UST snapshot position");
+		goto end;
 	}
-	assert(!channel->monitor);
-	DBG("UST consumer snapshot channel %" PRIu64, key);
 
-	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+	/*
+	 * The original value is sent back if max stream size is larger than
+	 * the possible size of the snapshot. Also, we asume that the session
+	 * daemon should never send a maximum stream size that is lower than
+	 * subbuffer size.
+	 */
+	consumed_pos = consumer_get_consumed_maxsize(consumed_pos,
+			produced_pos, max_stream_size);
+	consumed_pos = consumer_snapshot_get_start_pos(stream, consumed_pos,
+			produced_pos, incremental, output_key);
 
-		health_code_update();
+	while (consumed_pos < produced_pos) {
+		unsigned long len, padded_len;
+		struct ctf_packet_index index, *indexp = NULL;
 
-		/* Lock stream because we are about to change its state. */
-		pthread_mutex_lock(&stream->lock);
-		stream->net_seq_idx = relayd_id;
+		health_code_update();
 
-		if (use_relayd) {
-			ret = consumer_send_relayd_stream(stream, path);
-			if (ret < 0) {
-				goto error_unlock;
-			}
-		} else {
-			ret = utils_create_stream_file(path, stream->name,
-					stream->chan->tracefile_size,
-					stream->tracefile_count_current,
-					stream->uid, stream->gid, NULL);
-			if (ret < 0) {
-				goto error_unlock;
-			}
-			stream->out_fd = ret;
-			stream->tracefile_size_current = 0;
+		DBG("UST consumer taking snapshot at pos %lu", consumed_pos);
 
-			DBG("UST consumer snapshot stream %s/%s (%" PRIu64 ")", path,
-					stream->name, stream->key);
-		}
-		if (relayd_id != -1ULL) {
-			ret = consumer_send_relayd_streams_sent(relayd_id);
-			if (ret < 0) {
-				goto error_unlock;
+		ret = ustctl_get_subbuf(stream->ustream, &consumed_pos);
+		if (ret < 0) {
+			if (ret != -EAGAIN) {
+				PERROR("ustctl_get_subbuf snapshot");
+				goto end;
 			}
+			DBG("UST consumer get subbuf failed. Skipping it.");
+			consumed_pos += stream->max_sb_size;
+			continue;
 		}
 
-		ustctl_flush_buffer(stream->ustream, 1);
-
-		ret = lttng_ustconsumer_take_snapshot(stream);
+		ret = ustctl_get_subbuf_size(stream->ustream, &len);
 		if (ret < 0) {
-			ERR("Taking UST snapshot");
-			goto error_unlock;
+			ERR("Snapshot ustctl_get_subbuf_size");
+			goto error_put_subbuf;
 		}
 
-		ret = lttng_ustconsumer_get_produced_snapshot(stream, &produced_pos);
+		ret = ustctl_get_padded_subbuf_size(stream->ustream, &padded_len);
 		if (ret < 0) {
-			ERR("Produced UST snapshot position");
-			goto error_unlock;
+			ERR("Snapshot ustctl_get_padded_subbuf_size");
+			goto error_put_subbuf;
+		}
+
+		if (stream->index_fd >= 0) {
+			ret = get_index_values(&index, stream->ustream);
+			if (ret < 0) {
+				goto error_put_subbuf;
+			}
+			indexp = &index;
+		}
+
+		ret = consumer_snapshot_stage_subbuffer(ctx, stream, len,
+				padded_len - len, indexp);
+		if (ret == -ENOSPC) {
+			/*
+			 * Staging area is full. Release the sub-buffer, write out what
+			 * was staged so far and retry at the same position.
+			 */
+			ret = ustctl_put_subbuf(stream->ustream);
+			if (ret < 0) {
+				ERR("Snapshot ustctl_put_subbuf");
+				goto end;
+			}
+			pthread_mutex_unlock(&stream->lock);
+			ret = consumer_snapshot_staging_drain(ctx);
+			pthread_mutex_lock(&stream->lock);
+			if (ret < 0) {
+				goto end;
+			}
+			continue;
+		} else if (ret < 0) {
+			goto error_put_subbuf;
 		}
 
-		ret = lttng_ustconsumer_get_consumed_snapshot(stream, &consumed_pos);
+		ret = ustctl_put_subbuf(stream->ustream);
 		if (ret < 0) {
-			ERR("Consumerd UST snapshot position");
-			goto error_unlock;
+			ERR("Snapshot ustctl_put_subbuf");
+			goto end;
 		}
+		consumed_pos += stream->max_sb_size;
+	}
 
-		/*
-		 * The original value is sent back if max stream size is larger than
-		 * the possible size of the snapshot. Also, we asume that the session
-		 * daemon should never send a maximum stream size that is lower than
-		 * subbuffer size.
-		 */
-		consumed_pos = consumer_get_consumed_maxsize(consumed_pos,
-				produced_pos, max_stream_size);
+	consumer_snapshot_set_captured(stream, produced_pos, output_key);
+	ret = 0;
+	goto end;
 
-		while (consumed_pos < produced_pos) {
-			ssize_t read_len;
-			unsigned long len, padded_len;
+error_put_subbuf:
+	if (ustctl_put_subbuf(stream->ustream) < 0) {
+		ERR("Snapshot ustctl_put_subbuf");
+	}
+end:
+	return ret;
+}
 
-			health_code_update();
+/*
+ * Take a snapshot of all the stream of a channel.
+ *
+ * The outputs of all the streams are created first. The ring buffers are
+ * then captured one after the other in the snapshot staging area, so that
+ * the snapshot window of the channel is not stretched by I/O, and finally
+ * written out.
+ *
+ * An incremental snapshot only records the packets produced since the
+ * previous snapshot of the channel to the output identified by output_key.
+ *
+ * Returns 0 on success, < 0 on error
+ */
+static int snapshot_channel(uint64_t key, char *path, uint64_t relayd_id,
+		uint64_t max_stream_size, int incremental, uint64_t output_key,
+		struct lttng_consumer_local_data *ctx)
+{
+	int ret;
+	struct lttng_consumer_channel *channel;
+	struct lttng_consumer_stream *stream;
 
-			DBG("UST consumer taking snapshot at pos %lu", consumed_pos);
+	assert(path);
+	assert(ctx);
 
-			ret = ustctl_get_subbuf(stream->ustream, &consumed_pos);
-			if (ret < 0) {
-				if (ret != -EAGAIN) {
-					PERROR("ustctl_get_subbuf snapshot");
-					goto error_close_stream;
-				}
-				DBG("UST consumer get subbuf failed. Skipping it.");
-				consumed_pos += stream->max_sb_size;
-				continue;
-			}
+	rcu_read_lock();
 
-			ret = ustctl_get_subbuf_size(stream->ustream, &len);
-			if (ret < 0) {
-				ERR("Snapshot ustctl_get_subbuf_size");
-				goto error_put_subbuf;
-			}
+	channel = consumer_find_channel(key);
+	if (!channel) {
+		ERR("UST snapshot channel not found for key %" PRIu64, key);
+		ret = -1;
+		goto error;
+	}
+	assert(!channel->monitor);
+	DBG("UST consumer snapshot channel %" PRIu64, key);
 
-			ret = ustctl_get_padded_subbuf_size(stream->ustream, &padded_len);
-			if (ret < 0) {
-				ERR("Snapshot ustctl_get_padded_subbuf_size");
-				goto error_put_subbuf;
-			}
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		health_code_update();
 
-			read_len = lttng_consumer_on_read_subbuffer_mmap(ctx, stream, len,
-					padded_len - len, NULL);
-			if (use_relayd) {
-				if (read_len != len) {
-					ret = -EPERM;
-					goto error_put_subbuf;
-				}
-			} else {
-				if (read_len != padded_len) {
-					ret = -EPERM;
-					goto error_put_subbuf;
-				}
-			}
+		/* Lock stream because we are about to change its state. */
+		pthread_mutex_lock(&stream->lock);
+		ret = snapshot_stream_open_output(stream, path, relayd_id,
+				incremental);
+		pthread_mutex_unlock(&stream->lock);
+		if (ret < 0) {
+			goto error_close_streams;
+		}
+	}
+	if (relayd_id != (uint64_t) -1ULL) {
+		ret = consumer_send_relayd_streams_sent(relayd_id);
+		if (ret < 0) {
+			goto error_close_streams;
+		}
+	}
 
-			ret = ustctl_put_subbuf(stream->ustream);
-			if (ret < 0) {
-				ERR("Snapshot ustctl_put_subbuf");
-				goto error_close_stream;
-			}
-			consumed_pos += stream->max_sb_size;
+	consumer_snapshot_staging_begin();
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		pthread_mutex_lock(&stream->lock);
+		ret = snapshot_stream_capture(stream, max_stream_size, incremental,
+				output_key, ctx);
+		pthread_mutex_unlock(&stream->lock);
+		if (ret < 0) {
+			consumer_snapshot_staging_end();
+			goto error_close_streams;
 		}
+	}
+	ret = consumer_snapshot_staging_drain(ctx);
+	consumer_snapshot_staging_end();
+	if (ret < 0) {
+		goto error_close_streams;
+	}
 
-		/* Simply close the stream so we can use it on the next snapshot. */
+	/* Simply close the streams so we can use them on the next snapshot. */
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		pthread_mutex_lock(&stream->lock);
 		consumer_stream_close(stream);
 		pthread_mutex_unlock(&stream->lock);
 	}
@@ -1010,14 +1123,17 @@ static int snapshot_channel(uint64_t key, char *path, uint64_t relayd_id,
 	rcu_read_unlock();
 	return 0;
 
-error_put_subbuf:
-	if (ustctl_put_subbuf(stream->ustream) < 0) {
-		ERR("Snapshot ustctl_put_subbuf");
+error_close_streams:
+	cds_list_for_each_entry(stream, &channel->streams.head, send_node) {
+		pthread_mutex_lock(&stream->lock);
+		/* Only close the outputs that were actually created. */
+		if (stream->out_fd >= 0 || stream->sent_to_relayd) {
+			consumer_stream_close(stream);
+		}
+		/* Nothing was recorded, the next snapshot must be complete. */
+		stream->snapshot_pos_valid = 0;
+		pthread_mutex_unlock(&stream->lock);
 	}
-error_close_stream:
-	consumer_stream_close(stream);
-error_unlock:
-	pthread_mutex_unlock(&stream->lock);
 error:
 	rcu_read_unlock();
 	return ret;
@@ -1035,27 +1151,36 @@ int lttng_ustconsumer_recv_metadata(int sock, uint64_t key, uint64_t offset,
 
 	DBG("UST consumer push metadata key %" PRIu64 " of len %" PRIu64, key, len);
 
-	metadata_str = zmalloc(len * sizeof(char));
+	health_code_update();
+
+	/*
+	 * Receive the metadata string straight in the cache. The lock is not
+	 * held during the transfer so the timer and flush paths are not blocked
+	 * on the session daemon; the reserved range is only visible once
+	 * committed.
+	 */
+	pthread_mutex_lock(&channel->metadata_cache->lock);
+	metadata_str = consumer_metadata_cache_reserve(channel, offset, len);
+	pthread_mutex_unlock(&channel->metadata_cache->lock);
 	if (!metadata_str) {
-		PERROR("zmalloc metadata string");
 		ret_code = LTTCOMM_CONSUMERD_ENOMEM;
 		goto end;
 	}
 
-	health_code_update();
-
-	/* Receive metadata string. */
 	ret = lttcomm_recv_unix_sock(sock, metadata_str, len);
+
+	pthread_mutex_lock(&channel->metadata_cache->lock);
 	if (ret < 0) {
 		/* Session daemon is dead so return gracefully. */
+		consumer_metadata_cache_cancel(channel);
+		pthread_mutex_unlock(&channel->metadata_cache->lock);
 		ret_code = ret;
-		goto end_free;
+		goto end;
 	}
 
 	health_code_update();
 
-	pthread_mutex_lock(&channel->metadata_cache->lock);
-	ret = consumer_metadata_cache_write(channel, offset, len, metadata_str);
+	ret = consumer_metadata_cache_commit(channel, offset, len);
 	if (ret < 0) {
 		/* Unable to handle metadata. Notify session daemon. */
 		ret_code = LTTCOMM_CONSUMERD_ERROR_METADATA;
@@ -1065,12 +1190,12 @@ int lttng_ustconsumer_recv_metadata(int sock, uint64_t key, uint64_t offset,
 		 * waiting for the metadata cache to be flushed.
 		 */
 		pthread_mutex_unlock(&channel->metadata_cache->lock);
-		goto end_free;
+		goto end;
 	}
 	pthread_mutex_unlock(&channel->metadata_cache->lock);
 
 	if (!wait) {
-		goto end_free;
+		goto end;
 	}
 	while (consumer_metadata_cache_flushed(channel, offset + len, timer)) {
 		DBG("Waiting for metadata to be flushed");
@@ -1080,8 +1205,6 @@ int lttng_ustconsumer_recv_metadata(int sock, uint64_t key, uint64_t offset,
 		usleep(DEFAULT_METADATA_AVAILABILITY_WAIT_TIME);
 	}
 
-end_free:
-	free(metadata_str);
 end:
 	return ret_code;
 }
@@ -1491,6 +1614,8 @@ int lttng_ustconsumer_recv_cmd(struct lttng_consumer_local_data *ctx,
 					msg.u.snapshot_channel.pathname,
 					msg.u.snapshot_channel.relayd_id,
 					msg.u.snapshot_channel.max_stream_size,
+					msg.u.snapshot_channel.incremental,
+					msg.u.snapshot_channel.output_key,
 					ctx);
 			if (ret < 0) {
 				ERR("Snapshot channel failed");
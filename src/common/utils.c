@@ -592,57 +592,68 @@ error:
 }
 
 /*
- * Create the stream tracefile on disk.
+ * Format the path of a stream tracefile in dst of size len. The count is
+ * appended to the name if the trace is split in many files, followed by the
+ * optional suffix.
  *
  * Return 0 on success or else a negative value.
  */
 LTTNG_HIDDEN
-int utils_create_stream_file(const char *path_name, char *file_name, uint64_t size,
-		uint64_t count, int uid, int gid, char *suffix)
+int utils_stream_file_path(const char *path_name, const char *file_name,
+		uint64_t size, uint64_t count, const char *suffix, char *dst,
+		size_t len)
 {
-	int ret, out_fd, flags, mode;
-	char full_path[PATH_MAX], *path_name_suffix = NULL, *path;
-	char *extra = NULL;
+	int ret;
 
 	assert(path_name);
 	assert(file_name);
+	assert(dst);
 
-	ret = snprintf(full_path, sizeof(full_path), "%s/%s",
-			path_name, file_name);
+	/*
+	 * If we split the trace in multiple files, we have to add the count at the
+	 * end of the tracefile name
+	 */
+	if (size > 0) {
+		ret = snprintf(dst, len, "%s/%s_%" PRIu64 "%s", path_name,
+				file_name, count, suffix ? suffix : "");
+	} else {
+		ret = snprintf(dst, len, "%s/%s%s", path_name, file_name,
+				suffix ? suffix : "");
+	}
 	if (ret < 0) {
-		PERROR("snprintf create output file");
+		PERROR("snprintf stream file path");
+		goto error;
+	} else if (ret >= len) {
+		ERR("Stream file path too long: %s/%s", path_name, file_name);
+		ret = -ENAMETOOLONG;
 		goto error;
 	}
+	ret = 0;
 
-	/* Setup extra string if suffix or/and a count is needed. */
-	if (size > 0 && suffix) {
-		ret = asprintf(&extra, "_%" PRIu64 "%s", count, suffix);
-	} else if (size > 0) {
-		ret = asprintf(&extra, "_%" PRIu64, count);
-	} else if (suffix) {
-		ret = asprintf(&extra, "%s", suffix);
-	}
+error:
+	return ret;
+}
+
+/*
+ * Open the stream tracefile on disk with the given open flags, as the given
+ * user if uid and gid are set.
+ *
+ * Return the fd on success or else a negative value.
+ */
+LTTNG_HIDDEN
+int utils_open_stream_file(const char *path_name, char *file_name,
+		uint64_t size, uint64_t count, int uid, int gid, char *suffix,
+		int flags)
+{
+	int ret, out_fd, mode;
+	char path[PATH_MAX];
+
+	ret = utils_stream_file_path(path_name, file_name, size, count, suffix,
+			path, sizeof(path));
 	if (ret < 0) {
-		PERROR("Allocating extra string to name");
 		goto error;
 	}
 
-	/*
-	 * If we split the trace in multiple files, we have to add the count at the
-	 * end of the tracefile name
-	 */
-	if (extra) {
-		ret = asprintf(&path_name_suffix, "%s%s", full_path, extra);
-		if (ret < 0) {
-			PERROR("Allocating path name with extra string");
-			goto error_free_suffix;
-		}
-		path = path_name_suffix;
-	} else {
-		path = full_path;
-	}
-
-	flags = O_WRONLY | O_CREAT | O_TRUNC;
 	/* Open with 660 mode */
 	mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP;
 
@@ -653,18 +664,28 @@ int utils_create_stream_file(const char *path_name, char *file_name, uint64_t si
 	}
 	if (out_fd < 0) {
 		PERROR("open stream path %s", path);
-		goto error_open;
+		ret = out_fd;
+		goto error;
 	}
 	ret = out_fd;
 
-error_open:
-	free(path_name_suffix);
-error_free_suffix:
-	free(extra);
 error:
 	return ret;
 }
 
+/*
+ * Create the stream tracefile on disk.
+ *
+ * Return the fd on success or else a negative value.
+ */
+LTTNG_HIDDEN
+int utils_create_stream_file(const char *path_name, char *file_name, uint64_t size,
+		uint64_t count, int uid, int gid, char *suffix)
+{
+	return utils_open_stream_file(path_name, file_name, size, count, uid,
+			gid, suffix, O_WRONLY | O_CREAT | O_TRUNC);
+}
+
 /*
  * Change the output tracefile according to the given size and count The
  * new_count pointer is set during this operation.
@@ -56,6 +56,7 @@ enum node_type {
 	NODE_EXPRESSION,
 	NODE_OP,
 	NODE_UNARY_OP,
+	NODE_SET,
 
 	NR_NODE_TYPES,
 };
@@ -81,6 +82,8 @@ enum op_type {
 	AST_OP_LT,
 	AST_OP_GE,
 	AST_OP_LE,
+
+	AST_OP_IN,
 };
 
 enum unary_op_type {
@@ -103,6 +106,8 @@ struct filter_node {
 	 */
 	struct filter_node *parent;
 	struct cds_list_head gc;
+	/* Link in the element list of a set. */
+	struct cds_list_head siblings;
 
 	enum node_type type;
 	union {
@@ -146,6 +151,10 @@ struct filter_node {
 			enum unary_op_type type;
 			struct filter_node *child;
 		} unary_op;
+		struct {
+			/* Elements of the set, linked by their siblings. */
+			struct cds_list_head elements;
+		} set;
 	} u;
 };
 
@@ -187,5 +196,6 @@ void filter_bytecode_free(struct filter_parser_ctx *ctx);
 int filter_visitor_ir_check_binary_op_nesting(struct filter_parser_ctx *ctx);
 int filter_visitor_ir_check_binary_comparator(struct filter_parser_ctx *ctx);
 int filter_visitor_ir_validate_string(struct filter_parser_ctx *ctx);
+int filter_visitor_ir_optimize(struct filter_parser_ctx *ctx);
 
 #endif /* _FILTER_AST_H */
@@ -0,0 +1,348 @@
+/*
+ * filter-bytecode.c
+ *
+ * LTTng filter bytecode helpers
+ *
+ * Copyright 2015 - EfficiOS Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License, version 2.1 only,
+ * as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "filter-bytecode.h"
+
+#include <common/macros.h>
+
+LTTNG_HIDDEN
+int filter_bytecode_insn_len(const char *data, uint32_t pc, uint32_t len)
+{
+	uint32_t ilen;
+
+	if (pc >= len) {
+		return -EINVAL;
+	}
+
+	switch ((filter_opcode_t) data[pc]) {
+	case FILTER_OP_RETURN:
+		ilen = sizeof(struct return_op);
+		break;
+
+	case FILTER_OP_MUL:
+	case FILTER_OP_DIV:
+	case FILTER_OP_MOD:
+	case FILTER_OP_PLUS:
+	case FILTER_OP_MINUS:
+	case FILTER_OP_RSHIFT:
+	case FILTER_OP_LSHIFT:
+	case FILTER_OP_BIN_AND:
+	case FILTER_OP_BIN_OR:
+	case FILTER_OP_BIN_XOR:
+	case FILTER_OP_EQ:
+	case FILTER_OP_NE:
+	case FILTER_OP_GT:
+	case FILTER_OP_LT:
+	case FILTER_OP_GE:
+	case FILTER_OP_LE:
+	case FILTER_OP_EQ_STRING:
+	case FILTER_OP_NE_STRING:
+	case FILTER_OP_GT_STRING:
+	case FILTER_OP_LT_STRING:
+	case FILTER_OP_GE_STRING:
+	case FILTER_OP_LE_STRING:
+	case FILTER_OP_EQ_S64:
+	case FILTER_OP_NE_S64:
+	case FILTER_OP_GT_S64:
+	case FILTER_OP_LT_S64:
+	case FILTER_OP_GE_S64:
+	case FILTER_OP_LE_S64:
+	case FILTER_OP_EQ_DOUBLE:
+	case FILTER_OP_NE_DOUBLE:
+	case FILTER_OP_GT_DOUBLE:
+	case FILTER_OP_LT_DOUBLE:
+	case FILTER_OP_GE_DOUBLE:
+	case FILTER_OP_LE_DOUBLE:
+	case FILTER_OP_EQ_DOUBLE_S64:
+	case FILTER_OP_NE_DOUBLE_S64:
+	case FILTER_OP_GT_DOUBLE_S64:
+	case FILTER_OP_LT_DOUBLE_S64:
+	case FILTER_OP_GE_DOUBLE_S64:
+	case FILTER_OP_LE_DOUBLE_S64:
+	case FILTER_OP_EQ_S64_DOUBLE:
+	case FILTER_OP_NE_S64_DOUBLE:
+	case FILTER_OP_GT_S64_DOUBLE:
+	case FILTER_OP_LT_S64_DOUBLE:
+	case FILTER_OP_GE_S64_DOUBLE:
+	case FILTER_OP_LE_S64_DOUBLE:
+		ilen = sizeof(struct binary_op);
+		break;
+
+	case FILTER_OP_UNARY_PLUS:
+	case FILTER_OP_UNARY_MINUS:
+	case FILTER_OP_UNARY_NOT:
+	case FILTER_OP_UNARY_PLUS_S64:
+	case FILTER_OP_UNARY_MINUS_S64:
+	case FILTER_OP_UNARY_NOT_S64:
+	case FILTER_OP_UNARY_PLUS_DOUBLE:
+	case FILTER_OP_UNARY_MINUS_DOUBLE:
+	case FILTER_OP_UNARY_NOT_DOUBLE:
+		ilen = sizeof(struct unary_op);
+		break;
+
+	case FILTER_OP_AND:
+	case FILTER_OP_OR:
+		ilen = sizeof(struct logical_op);
+		break;
+
+	case FILTER_OP_LOAD_FIELD_REF:
+	case FILTER_OP_LOAD_FIELD_REF_STRING:
+	case FILTER_OP_LOAD_FIELD_REF_SEQUENCE:
+	case FILTER_OP_LOAD_FIELD_REF_S64:
+	case FILTER_OP_LOAD_FIELD_REF_DOUBLE:
+	case FILTER_OP_GET_CONTEXT_REF:
+	case FILTER_OP_GET_CONTEXT_REF_STRING:
+	case FILTER_OP_GET_CONTEXT_REF_S64:
+	case FILTER_OP_GET_CONTEXT_REF_DOUBLE:
+		ilen = sizeof(struct load_op) + sizeof(struct field_ref);
+		break;
+
+	case FILTER_OP_LOAD_STRING:
+	{
+		const char *str = data + pc + sizeof(struct load_op);
+
+		if (len - pc <= sizeof(struct load_op) ||
+				!memchr(str, '\0', len - pc - sizeof(struct load_op))) {
+			return -EINVAL;
+		}
+		ilen = sizeof(struct load_op) + strlen(str) + 1;
+		break;
+	}
+	case FILTER_OP_LOAD_S64:
+		ilen = sizeof(struct load_op) + sizeof(struct literal_numeric);
+		break;
+	case FILTER_OP_LOAD_DOUBLE:
+		ilen = sizeof(struct load_op) + sizeof(struct literal_double);
+		break;
+
+	case FILTER_OP_CAST_TO_S64:
+	case FILTER_OP_CAST_DOUBLE_TO_S64:
+	case FILTER_OP_CAST_NOP:
+		ilen = sizeof(struct cast_op);
+		break;
+
+	default:
+		return -EINVAL;
+	}
+
+	if (ilen > len - pc) {
+		return -EINVAL;
+	}
+	return ilen;
+}
+
+/* Operand types known before the tracer specializes the bytecode. */
+enum cost_operand {
+	COST_OPERAND_NUMERIC,
+	COST_OPERAND_STRING,
+	/* Untyped field or context reference, which may be a string. */
+	COST_OPERAND_UNKNOWN,
+};
+
+/* Depth of the filter stack of the tracers. */
+#define COST_STACK_LEN	10
+
+/*
+ * Push an operand on the cost estimation stack.
+ *
+ * Return insn_len on success or else -EINVAL if the stack is full.
+ */
+static
+int push_operand(enum cost_operand *stack, int *top, enum cost_operand operand,
+		int insn_len)
+{
+	if (*top + 1 >= COST_STACK_LEN) {
+		return -EINVAL;
+	}
+	stack[++*top] = operand;
+	return insn_len;
+}
+
+/*
+ * Estimate the worst-case cost of an evaluation of the bytecode: every
+ * instruction is executed, as if no logical operator short-circuited, and
+ * the comparisons of untyped references with anything but a number are
+ * string comparisons. A set lookup compares at most one string.
+ *
+ * Return 0 and fill cost on success, or else a negative errno value if the
+ * bytecode is invalid, leaving cost untouched.
+ */
+LTTNG_HIDDEN
+int filter_bytecode_cost(const struct lttng_filter_bytecode *bytecode,
+		struct lttng_event_filter_cost *cost)
+{
+	int ret, top = -1;
+	uint32_t pc, len = bytecode->reloc_table_offset;
+	enum cost_operand stack[COST_STACK_LEN];
+	struct lttng_event_filter_cost estimate;
+
+	if (len > bytecode->len || bytecode->len > LTTNG_FILTER_MAX_LEN) {
+		return -EINVAL;
+	}
+	memset(&estimate, 0, sizeof(estimate));
+
+	for (pc = 0; pc < len; pc += ret) {
+		filter_opcode_t op = bytecode->data[pc];
+
+		ret = filter_bytecode_insn_len(bytecode->data, pc, len);
+		if (ret < 0) {
+			return ret;
+		}
+		/* Saturate, the code may be one byte longer than UINT16_MAX. */
+		if (estimate.nr_insns < UINT16_MAX) {
+			estimate.nr_insns++;
+		}
+
+		switch (op) {
+		case FILTER_OP_RETURN:
+			*cost = estimate;
+			return 0;
+
+		case FILTER_OP_EQ:
+		case FILTER_OP_NE:
+		case FILTER_OP_GT:
+		case FILTER_OP_LT:
+		case FILTER_OP_GE:
+		case FILTER_OP_LE:
+			if (top < 1) {
+				return -EINVAL;
+			}
+			if (stack[top] != COST_OPERAND_NUMERIC &&
+					stack[top - 1] != COST_OPERAND_NUMERIC) {
+				estimate.nr_string_compares++;
+			}
+			stack[--top] = COST_OPERAND_NUMERIC;
+			break;
+
+		case FILTER_OP_EQ_STRING:
+		case FILTER_OP_NE_STRING:
+		case FILTER_OP_GT_STRING:
+		case FILTER_OP_LT_STRING:
+		case FILTER_OP_GE_STRING:
+		case FILTER_OP_LE_STRING:
+			estimate.nr_string_compares++;
+			/* Fall-through. */
+		case FILTER_OP_MUL:
+		case FILTER_OP_DIV:
+		case FILTER_OP_MOD:
+		case FILTER_OP_PLUS:
+		case FILTER_OP_MINUS:
+		case FILTER_OP_RSHIFT:
+		case FILTER_OP_LSHIFT:
+		case FILTER_OP_BIN_AND:
+		case FILTER_OP_BIN_OR:
+		case FILTER_OP_BIN_XOR:
+		case FILTER_OP_EQ_S64:
+		case FILTER_OP_NE_S64:
+		case FILTER_OP_GT_S64:
+		case FILTER_OP_LT_S64:
+		case FILTER_OP_GE_S64:
+		case FILTER_OP_LE_S64:
+		case FILTER_OP_EQ_DOUBLE:
+		case FILTER_OP_NE_DOUBLE:
+		case FILTER_OP_GT_DOUBLE:
+		case FILTER_OP_LT_DOUBLE:
+		case FILTER_OP_GE_DOUBLE:
+		case FILTER_OP_LE_DOUBLE:
+		case FILTER_OP_EQ_DOUBLE_S64:
+		case FILTER_OP_NE_DOUBLE_S64:
+		case FILTER_OP_GT_DOUBLE_S64:
+		case FILTER_OP_LT_DOUBLE_S64:
+		case FILTER_OP_GE_DOUBLE_S64:
+		case FILTER_OP_LE_DOUBLE_S64:
+		case FILTER_OP_EQ_S64_DOUBLE:
+		case FILTER_OP_NE_S64_DOUBLE:
+		case FILTER_OP_GT_S64_DOUBLE:
+		case FILTER_OP_LT_S64_DOUBLE:
+		case FILTER_OP_GE_S64_DOUBLE:
+		case FILTER_OP_LE_S64_DOUBLE:
+			if (top < 1) {
+				return -EINVAL;
+			}
+			stack[--top] = COST_OPERAND_NUMERIC;
+			break;
+
+		case FILTER_OP_UNARY_PLUS:
+		case FILTER_OP_UNARY_MINUS:
+		case FILTER_OP_UNARY_NOT:
+		case FILTER_OP_UNARY_PLUS_S64:
+		case FILTER_OP_UNARY_MINUS_S64:
+		case FILTER_OP_UNARY_NOT_S64:
+		case FILTER_OP_UNARY_PLUS_DOUBLE:
+		case FILTER_OP_UNARY_MINUS_DOUBLE:
+		case FILTER_OP_UNARY_NOT_DOUBLE:
+		case FILTER_OP_CAST_TO_S64:
+		case FILTER_OP_CAST_DOUBLE_TO_S64:
+		case FILTER_OP_CAST_NOP:
+			if (top < 0) {
+				return -EINVAL;
+			}
+			stack[top] = COST_OPERAND_NUMERIC;
+			break;
+
+		case FILTER_OP_AND:
+		case FILTER_OP_OR:
+			/* The second operand replaces the first one. */
+			if (top < 0) {
+				return -EINVAL;
+			}
+			top--;
+			break;
+
+		case FILTER_OP_LOAD_FIELD_REF:
+		case FILTER_OP_GET_CONTEXT_REF:
+			estimate.nr_field_loads++;
+			ret = push_operand(stack, &top, COST_OPERAND_UNKNOWN, ret);
+			break;
+		case FILTER_OP_LOAD_FIELD_REF_STRING:
+		case FILTER_OP_LOAD_FIELD_REF_SEQUENCE:
+		case FILTER_OP_GET_CONTEXT_REF_STRING:
+			estimate.nr_field_loads++;
+			/* Fall-through. */
+		case FILTER_OP_LOAD_STRING:
+			ret = push_operand(stack, &top, COST_OPERAND_STRING, ret);
+			break;
+		case FILTER_OP_LOAD_FIELD_REF_S64:
+		case FILTER_OP_LOAD_FIELD_REF_DOUBLE:
+		case FILTER_OP_GET_CONTEXT_REF_S64:
+		case FILTER_OP_GET_CONTEXT_REF_DOUBLE:
+			estimate.nr_field_loads++;
+			/* Fall-through. */
+		case FILTER_OP_LOAD_S64:
+		case FILTER_OP_LOAD_DOUBLE:
+			ret = push_operand(stack, &top, COST_OPERAND_NUMERIC, ret);
+			break;
+
+		default:
+			return -EINVAL;
+		}
+		if (ret < 0) {
+			return ret;
+		}
+	}
+	/* Missing return instruction. */
+	return -EINVAL;
+}
@@ -193,4 +193,8 @@ unsigned int bytecode_get_len(struct lttng_filter_bytecode *bytecode)
 	return bytecode->len;
 }
 
+int filter_bytecode_insn_len(const char *data, uint32_t pc, uint32_t len);
+int filter_bytecode_cost(const struct lttng_filter_bytecode *bytecode,
+		struct lttng_event_filter_cost *cost);
+
 #endif /* _FILTER_BYTECODE_H */
@@ -0,0 +1,827 @@
+/*
+ * filter-interpreter.c
+ *
+ * LTTng filter bytecode host-side interpreter
+ *
+ * Copyright 2015 - EfficiOS Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License, version 2.1 only,
+ * as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The bytecode is validated and linked against the fields of an event
+ * payload the way the tracers do it: the field references of the relocation
+ * table are resolved to typed loads of the payload fields. Running the
+ * linked program evaluates the filter with the tracer semantic:
+ *
+ * - Comparators between numbers compare integers if both operands are
+ *   integers and doubles otherwise.
+ * - Comparators between strings honor the '*' wildcard and the '\'
+ *   escapes of string literals.
+ * - Logical operators short-circuit and expect an integer operand.
+ * - Arithmetic operators are rejected, as the tracers do.
+ * - Any runtime error (e.g. comparing a string and a number) discards the
+ *   event in the tracer. It is reported as an error here.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <common/error.h>
+
+#include "filter-ast.h"
+#include "filter-parser.h"
+#include "filter-bytecode.h"
+#include "filter-interpreter.h"
+#include "memstream.h"
+
+#include <common/macros.h>
+
+/* Same stack depth as the tracers. */
+#define FILTER_STACK_LEN	10
+
+enum reg_type {
+	REG_S64,
+	REG_DOUBLE,
+	REG_STRING,
+};
+
+struct reg {
+	enum reg_type type;
+	union {
+		int64_t v;
+		double d;
+		struct {
+			const char *str;
+			size_t len;
+			/* String literal, may contain wildcards and escapes. */
+			int literal;
+		} s;
+	} u;
+};
+
+struct filter_interpreter_program {
+	/* Length of the instructions, without the relocation table. */
+	uint32_t len;
+	char data[0];
+};
+
+/*
+ * Return the length of the instruction at pc or a negative value if it is
+ * invalid, unsupported or overflows the end of the instructions.
+ */
+static
+int insn_len(const char *data, uint32_t pc, uint32_t len)
+{
+	int ret;
+	filter_opcode_t op = data[pc];
+
+	/*
+	 * Arithmetic operators are not supported by the tracers. Typed loads
+	 * are only produced by the linker.
+	 */
+	if ((op >= FILTER_OP_MUL && op <= FILTER_OP_BIN_XOR) ||
+			(op >= FILTER_OP_LOAD_FIELD_REF_STRING &&
+			op <= FILTER_OP_LOAD_FIELD_REF_DOUBLE) ||
+			(op >= FILTER_OP_GET_CONTEXT_REF_STRING &&
+			op <= FILTER_OP_GET_CONTEXT_REF_DOUBLE)) {
+		fprintf(stderr, "[error] Unsupported bytecode op %u at offset %u\n",
+			(unsigned int) op, pc);
+		return -EINVAL;
+	}
+	ret = filter_bytecode_insn_len(data, pc, len);
+	if (ret < 0) {
+		fprintf(stderr, "[error] Invalid bytecode op %u at offset %u\n",
+			(unsigned int) op, pc);
+	}
+	return ret;
+}
+
+/*
+ * Validate the instructions: every instruction must be known and the logical
+ * operators must jump forward to the start of an instruction, which
+ * guarantees that the evaluation ends. The last instruction must be a
+ * return.
+ *
+ * Return 0 on success and set nr_refs to the number of field references to
+ * link, else a negative value.
+ */
+static
+int validate_insns(const char *data, uint32_t len, unsigned int *nr_refs)
+{
+	int ret;
+	uint32_t pc = 0, last = 0;
+	char *starts;
+
+	if (len == 0) {
+		return -EINVAL;
+	}
+	starts = calloc(len, 1);
+	if (!starts) {
+		return -ENOMEM;
+	}
+
+	while (pc < len) {
+		ret = insn_len(data, pc, len);
+		if (ret < 0) {
+			goto end;
+		}
+		starts[pc] = 1;
+		if ((filter_opcode_t) data[pc] == FILTER_OP_LOAD_FIELD_REF ||
+				(filter_opcode_t) data[pc] == FILTER_OP_GET_CONTEXT_REF) {
+			(*nr_refs)++;
+		}
+		last = pc;
+		pc += ret;
+	}
+	if ((filter_opcode_t) data[last] != FILTER_OP_RETURN) {
+		fprintf(stderr, "[error] Bytecode does not end with a return\n");
+		ret = -EINVAL;
+		goto end;
+	}
+
+	for (pc = 0; pc < len; pc += insn_len(data, pc, len)) {
+		struct logical_op insn;
+
+		if ((filter_opcode_t) data[pc] != FILTER_OP_AND &&
+				(filter_opcode_t) data[pc] != FILTER_OP_OR) {
+			continue;
+		}
+		memcpy(&insn, data + pc, sizeof(insn));
+		if (insn.skip_offset <= pc || insn.skip_offset >= len ||
+				!starts[insn.skip_offset]) {
+			fprintf(stderr, "[error] Invalid skip offset %u at offset %u\n",
+				insn.skip_offset, pc);
+			ret = -EINVAL;
+			goto end;
+		}
+	}
+	ret = 0;
+
+end:
+	free(starts);
+	return ret;
+}
+
+static
+int find_field(const struct filter_interpreter_field *fields,
+		unsigned int nr_fields, const char *name, int context)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_fields; i++) {
+		if (!!fields[i].context == !!context &&
+				!strcmp(fields[i].name, name)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Resolve the field reference of the load instruction at offset to a typed
+ * load of the given field.
+ */
+static
+int link_field_ref(struct filter_interpreter_program *program,
+		uint16_t offset, const char *name,
+		const struct filter_interpreter_field *fields,
+		unsigned int nr_fields)
+{
+	int index, context;
+	struct load_op *op;
+	struct field_ref ref;
+
+	op = (struct load_op *) &program->data[offset];
+	switch (op->op) {
+	case FILTER_OP_LOAD_FIELD_REF:
+		context = 0;
+		break;
+	case FILTER_OP_GET_CONTEXT_REF:
+		context = 1;
+		break;
+	default:
+		fprintf(stderr, "[error] Relocation at offset %u is not a field reference\n",
+			offset);
+		return -EINVAL;
+	}
+
+	index = find_field(fields, nr_fields, name, context);
+	if (index < 0) {
+		fprintf(stderr, "[error] Unknown %s \"%s\"\n",
+			context ? "context" : "field", name);
+		return -ENOENT;
+	}
+
+	switch (fields[index].type) {
+	case FILTER_INTERPRETER_FIELD_S64:
+		op->op = context ? FILTER_OP_GET_CONTEXT_REF_S64 :
+			FILTER_OP_LOAD_FIELD_REF_S64;
+		break;
+	case FILTER_INTERPRETER_FIELD_DOUBLE:
+		op->op = context ? FILTER_OP_GET_CONTEXT_REF_DOUBLE :
+			FILTER_OP_LOAD_FIELD_REF_DOUBLE;
+		break;
+	case FILTER_INTERPRETER_FIELD_STRING:
+		op->op = context ? FILTER_OP_GET_CONTEXT_REF_STRING :
+			FILTER_OP_LOAD_FIELD_REF_STRING;
+		break;
+	case FILTER_INTERPRETER_FIELD_SEQUENCE:
+		if (context) {
+			return -EINVAL;
+		}
+		op->op = FILTER_OP_LOAD_FIELD_REF_SEQUENCE;
+		break;
+	default:
+		return -EINVAL;
+	}
+	ref.offset = (uint16_t) index;
+	memcpy(op->data, &ref, sizeof(ref));
+	return 0;
+}
+
+/*
+ * Validate the bytecode and link it against the given event payload layout.
+ * The fields passed to filter_interpreter_run() must have the same layout.
+ *
+ * Return 0 on success and set program, else a negative errno value.
+ */
+LTTNG_HIDDEN
+int filter_interpreter_link(const struct lttng_filter_bytecode *bytecode,
+		const struct filter_interpreter_field *fields,
+		unsigned int nr_fields,
+		struct filter_interpreter_program **program)
+{
+	int ret;
+	uint32_t pc, len, reloc_offset;
+	unsigned int nr_refs = 0, nr_linked = 0;
+	struct filter_interpreter_program *p;
+
+	if (!bytecode || !program || (nr_fields && !fields) ||
+			nr_fields > UINT16_MAX) {
+		return -EINVAL;
+	}
+	len = bytecode->len;
+	reloc_offset = bytecode->reloc_table_offset;
+	if (len > LTTNG_FILTER_MAX_LEN || reloc_offset > len) {
+		return -EINVAL;
+	}
+
+	p = calloc(1, sizeof(*p) + reloc_offset);
+	if (!p) {
+		return -ENOMEM;
+	}
+	p->len = reloc_offset;
+	memcpy(p->data, bytecode->data, reloc_offset);
+
+	ret = validate_insns(p->data, p->len, &nr_refs);
+	if (ret) {
+		goto error;
+	}
+
+	/* Relocation table: (uint16_t offset, null-terminated name) pairs. */
+	pc = reloc_offset;
+	while (pc < len) {
+		uint16_t offset;
+		const char *name;
+
+		if (len - pc <= sizeof(offset)) {
+			ret = -EINVAL;
+			goto error;
+		}
+		memcpy(&offset, &bytecode->data[pc], sizeof(offset));
+		name = &bytecode->data[pc + sizeof(offset)];
+		if (!memchr(name, '\0', len - pc - sizeof(offset))) {
+			ret = -EINVAL;
+			goto error;
+		}
+		if (offset >= p->len) {
+			ret = -EINVAL;
+			goto error;
+		}
+		ret = link_field_ref(p, offset, name, fields, nr_fields);
+		if (ret) {
+			goto error;
+		}
+		pc += sizeof(offset) + strlen(name) + 1;
+		nr_linked++;
+	}
+
+	/*
+	 * A field reference can only be linked once, every one of them must
+	 * have been linked.
+	 */
+	if (nr_linked != nr_refs) {
+		fprintf(stderr, "[error] %u of %u field references linked\n",
+			nr_linked, nr_refs);
+		ret = -EINVAL;
+		goto error;
+	}
+
+	*program = p;
+	return 0;
+
+error:
+	free(p);
+	return ret;
+}
+
+LTTNG_HIDDEN
+void filter_interpreter_destroy(struct filter_interpreter_program *program)
+{
+	free(program);
+}
+
+enum str_char {
+	STR_CHAR,
+	STR_END,
+	STR_STAR,
+};
+
+/*
+ * Read the next character of a string register. The unescaped '*' of a
+ * literal matches the rest of the other string.
+ */
+static
+enum str_char str_next(const struct reg *r, size_t *pos, int *c)
+{
+	const char *str = r->u.s.str;
+
+	if (*pos >= r->u.s.len || str[*pos] == '\0') {
+		return STR_END;
+	}
+	if (r->u.s.literal) {
+		if (str[*pos] == '*') {
+			return STR_STAR;
+		}
+		if (str[*pos] == '\\' && *pos + 1 < r->u.s.len &&
+				(str[*pos + 1] == '*' || str[*pos + 1] == '\\')) {
+			(*pos)++;
+		}
+	}
+	*c = (unsigned char) str[(*pos)++];
+	return STR_CHAR;
+}
+
+/*
+ * Compare two string registers, strcmp style.
+ */
+static
+int str_compare(const struct reg *a, const struct reg *b)
+{
+	size_t pa = 0, pb = 0;
+	int ca = 0, cb = 0;
+
+	for (;;) {
+		enum str_char ra, rb;
+
+		ra = str_next(a, &pa, &ca);
+		rb = str_next(b, &pb, &cb);
+		if (ra == STR_STAR || rb == STR_STAR) {
+			return 0;
+		}
+		if (ra == STR_END) {
+			return rb == STR_END ? 0 : -1;
+		}
+		if (rb == STR_END) {
+			return 1;
+		}
+		if (ca != cb) {
+			return ca - cb;
+		}
+	}
+}
+
+/*
+ * Compare the two registers of a binary comparator.
+ *
+ * Return 0 on success and set cmp, else -EINVAL on type mismatch.
+ */
+static
+int reg_compare(const struct reg *a, const struct reg *b, int *cmp)
+{
+	if (a->type == REG_STRING || b->type == REG_STRING) {
+		if (a->type != b->type) {
+			return -EINVAL;
+		}
+		*cmp = str_compare(a, b);
+	} else if (a->type == REG_S64 && b->type == REG_S64) {
+		*cmp = (a->u.v > b->u.v) - (a->u.v < b->u.v);
+	} else {
+		double da, db;
+
+		da = a->type == REG_S64 ? (double) a->u.v : a->u.d;
+		db = b->type == REG_S64 ? (double) b->u.v : b->u.d;
+		*cmp = (da > db) - (da < db);
+		/* NaN compares unequal to anything. */
+		if (da != db && !*cmp) {
+			*cmp = 2;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Check the register types expected by a specialized comparator.
+ */
+static
+int compare_types_valid(filter_opcode_t op, const struct reg *a,
+		const struct reg *b)
+{
+	if (op >= FILTER_OP_EQ_STRING && op <= FILTER_OP_LE_STRING) {
+		return a->type == REG_STRING && b->type == REG_STRING;
+	} else if (op >= FILTER_OP_EQ_S64 && op <= FILTER_OP_LE_S64) {
+		return a->type == REG_S64 && b->type == REG_S64;
+	} else if (op >= FILTER_OP_EQ_DOUBLE && op <= FILTER_OP_LE_DOUBLE) {
+		return a->type == REG_DOUBLE && b->type == REG_DOUBLE;
+	} else if (op >= FILTER_OP_EQ_DOUBLE_S64 &&
+			op <= FILTER_OP_LE_DOUBLE_S64) {
+		return a->type == REG_DOUBLE && b->type == REG_S64;
+	} else if (op >= FILTER_OP_EQ_S64_DOUBLE &&
+			op <= FILTER_OP_LE_S64_DOUBLE) {
+		return a->type == REG_S64 && b->type == REG_DOUBLE;
+	}
+	return 1;
+}
+
+/*
+ * Return the result of a comparator given the comparison of its operands.
+ * The opcodes of every comparator family follow the EQ, NE, GT, LT, GE, LE
+ * order.
+ */
+static
+int compare_result(filter_opcode_t op, int cmp)
+{
+	int nan = cmp == 2;
+
+	switch ((op - FILTER_OP_EQ) % 6) {
+	case 0:
+		return cmp == 0;
+	case 1:
+		return cmp != 0;
+	case 2:
+		return !nan && cmp > 0;
+	case 3:
+		return cmp < 0;
+	case 4:
+		return !nan && cmp >= 0;
+	case 5:
+	default:
+		return cmp <= 0;
+	}
+}
+
+/*
+ * Execute a binary comparator, replacing its two operands by its result.
+ */
+static
+int exec_compare(struct reg *stack, int *top, filter_opcode_t op)
+{
+	int ret, cmp;
+	struct reg *a, *b;
+
+	if (*top < 1) {
+		return -EINVAL;
+	}
+	a = &stack[*top - 1];
+	b = &stack[*top];
+	if (!compare_types_valid(op, a, b)) {
+		return -EINVAL;
+	}
+	ret = reg_compare(a, b, &cmp);
+	if (ret) {
+		return ret;
+	}
+	(*top)--;
+	a->type = REG_S64;
+	a->u.v = compare_result(op, cmp);
+	return 0;
+}
+
+/*
+ * Execute a unary operator on the top of the stack. The opcodes of every
+ * unary operator family follow the PLUS, MINUS, NOT order.
+ */
+static
+int exec_unary(struct reg *stack, int top, filter_opcode_t op)
+{
+	struct reg *r;
+
+	if (top < 0) {
+		return -EINVAL;
+	}
+	r = &stack[top];
+	if (r->type == REG_STRING ||
+			(op >= FILTER_OP_UNARY_PLUS_S64 &&
+			op <= FILTER_OP_UNARY_NOT_S64 &&
+			r->type != REG_S64) ||
+			(op >= FILTER_OP_UNARY_PLUS_DOUBLE &&
+			r->type != REG_DOUBLE)) {
+		return -EINVAL;
+	}
+	switch ((op - FILTER_OP_UNARY_PLUS) % 3) {
+	case 0:
+		break;
+	case 1:
+		if (r->type == REG_S64) {
+			r->u.v = -(uint64_t) r->u.v;
+		} else {
+			r->u.d = -r->u.d;
+		}
+		break;
+	case 2:
+		if (r->type == REG_S64) {
+			r->u.v = !r->u.v;
+		} else {
+			r->u.d = !r->u.d;
+		}
+		break;
+	}
+	return 0;
+}
+
+static
+void load_field(struct reg *r, const struct filter_interpreter_field *field)
+{
+	switch (field->type) {
+	case FILTER_INTERPRETER_FIELD_S64:
+		r->type = REG_S64;
+		r->u.v = field->u.v;
+		break;
+	case FILTER_INTERPRETER_FIELD_DOUBLE:
+		r->type = REG_DOUBLE;
+		r->u.d = field->u.d;
+		break;
+	case FILTER_INTERPRETER_FIELD_STRING:
+		r->type = REG_STRING;
+		r->u.s.str = field->u.s.str;
+		r->u.s.len = SIZE_MAX;
+		r->u.s.literal = 0;
+		break;
+	case FILTER_INTERPRETER_FIELD_SEQUENCE:
+		r->type = REG_STRING;
+		r->u.s.str = field->u.s.str;
+		r->u.s.len = field->u.s.len;
+		r->u.s.literal = 0;
+		break;
+	}
+}
+
+/*
+ * Evaluate a linked program against an event payload.
+ *
+ * Return 1 if the event is recorded, 0 if it is discarded, or else a
+ * negative errno value on runtime error, which discards the event in the
+ * tracers.
+ */
+LTTNG_HIDDEN
+int filter_interpreter_run(const struct filter_interpreter_program *program,
+		const struct filter_interpreter_field *fields)
+{
+	struct reg stack[FILTER_STACK_LEN];
+	int top = -1;
+	uint32_t pc = 0;
+	const char *data = program->data;
+
+	for (;;) {
+		filter_opcode_t op = data[pc];
+
+		switch (op) {
+		case FILTER_OP_RETURN:
+			if (top != 0) {
+				return -EINVAL;
+			}
+			switch (stack[top].type) {
+			case REG_S64:
+				return !!stack[top].u.v;
+			case REG_DOUBLE:
+				return !!stack[top].u.d;
+			case REG_STRING:
+			default:
+				/* The tracers test the string pointer. */
+				return 1;
+			}
+
+		case FILTER_OP_AND:
+		case FILTER_OP_OR:
+		{
+			struct logical_op insn;
+			int skip;
+
+			if (top < 0 || stack[top].type != REG_S64) {
+				return -EINVAL;
+			}
+			memcpy(&insn, data + pc, sizeof(insn));
+			if (op == FILTER_OP_AND) {
+				skip = stack[top].u.v == 0;
+			} else {
+				skip = stack[top].u.v != 0;
+			}
+			if (skip) {
+				/* Evaluate to 0 for AND, 1 for OR. */
+				stack[top].u.v = op == FILTER_OP_OR;
+				pc = insn.skip_offset;
+			} else {
+				top--;
+				pc += sizeof(insn);
+			}
+			break;
+		}
+
+		case FILTER_OP_LOAD_FIELD_REF_STRING:
+		case FILTER_OP_LOAD_FIELD_REF_SEQUENCE:
+		case FILTER_OP_LOAD_FIELD_REF_S64:
+		case FILTER_OP_LOAD_FIELD_REF_DOUBLE:
+		case FILTER_OP_GET_CONTEXT_REF_STRING:
+		case FILTER_OP_GET_CONTEXT_REF_S64:
+		case FILTER_OP_GET_CONTEXT_REF_DOUBLE:
+		{
+			struct field_ref ref;
+
+			if (top + 1 >= FILTER_STACK_LEN) {
+				return -EINVAL;
+			}
+			memcpy(&ref, data + pc + sizeof(struct load_op),
+				sizeof(ref));
+			load_field(&stack[++top], &fields[ref.offset]);
+			pc += sizeof(struct load_op) + sizeof(ref);
+			break;
+		}
+
+		case FILTER_OP_LOAD_STRING:
+		{
+			const char *str = data + pc + sizeof(struct load_op);
+
+			if (top + 1 >= FILTER_STACK_LEN) {
+				return -EINVAL;
+			}
+			top++;
+			stack[top].type = REG_STRING;
+			stack[top].u.s.str = str;
+			stack[top].u.s.len = SIZE_MAX;
+			stack[top].u.s.literal = 1;
+			pc += sizeof(struct load_op) + strlen(str) + 1;
+			break;
+		}
+		case FILTER_OP_LOAD_S64:
+		{
+			struct literal_numeric lit;
+
+			if (top + 1 >= FILTER_STACK_LEN) {
+				return -EINVAL;
+			}
+			memcpy(&lit, data + pc + sizeof(struct load_op),
+				sizeof(lit));
+			top++;
+			stack[top].type = REG_S64;
+			stack[top].u.v = lit.v;
+			pc += sizeof(struct load_op) + sizeof(lit);
+			break;
+		}
+		case FILTER_OP_LOAD_DOUBLE:
+		{
+			struct literal_double lit;
+
+			if (top + 1 >= FILTER_STACK_LEN) {
+				return -EINVAL;
+			}
+			memcpy(&lit, data + pc + sizeof(struct load_op),
+				sizeof(lit));
+			top++;
+			stack[top].type = REG_DOUBLE;
+			stack[top].u.d = lit.v;
+			pc += sizeof(struct load_op) + sizeof(lit);
+			break;
+		}
+
+		case FILTER_OP_CAST_TO_S64:
+		case FILTER_OP_CAST_DOUBLE_TO_S64:
+			if (top < 0 || stack[top].type == REG_STRING ||
+					(op == FILTER_OP_CAST_DOUBLE_TO_S64 &&
+					stack[top].type != REG_DOUBLE)) {
+				return -EINVAL;
+			}
+			if (stack[top].type == REG_DOUBLE) {
+				stack[top].type = REG_S64;
+				stack[top].u.v = (int64_t) stack[top].u.d;
+			}
+			pc += sizeof(struct cast_op);
+			break;
+		case FILTER_OP_CAST_NOP:
+			pc += sizeof(struct cast_op);
+			break;
+
+		default:
+		{
+			int ret;
+
+			if (op >= FILTER_OP_EQ && op <= FILTER_OP_LE_S64_DOUBLE) {
+				ret = exec_compare(stack, &top, op);
+				pc += sizeof(struct binary_op);
+			} else if (op >= FILTER_OP_UNARY_PLUS &&
+					op <= FILTER_OP_UNARY_NOT_DOUBLE) {
+				ret = exec_unary(stack, top, op);
+				pc += sizeof(struct unary_op);
+			} else {
+				/* Rejected by the validation. */
+				ret = -EINVAL;
+			}
+			if (ret) {
+				return ret;
+			}
+			break;
+		}
+		}
+	}
+}
+
+/*
+ * Compile a filter expression the way lttng-ctl does before sending it to
+ * the session daemon.
+ *
+ * Return 0 on success and set bytecode, which must be freed by the caller,
+ * else a negative value.
+ */
+LTTNG_HIDDEN
+int filter_interpreter_compile(const char *expression,
+		struct lttng_filter_bytecode **bytecode)
+{
+	int ret;
+	size_t len;
+	FILE *fmem;
+	struct filter_parser_ctx *ctx;
+
+	fmem = lttng_fmemopen((void *) expression, strlen(expression), "r");
+	if (!fmem) {
+		return -ENOMEM;
+	}
+	ctx = filter_parser_ctx_alloc(fmem);
+	if (!ctx) {
+		ret = -ENOMEM;
+		goto end;
+	}
+
+	ret = filter_parser_ctx_append_ast(ctx);
+	if (ret) {
+		ret = -EINVAL;
+		goto free_ctx;
+	}
+	ret = filter_visitor_set_parent(ctx);
+	if (ret) {
+		goto free_ctx;
+	}
+	ret = filter_visitor_ir_generate(ctx);
+	if (ret) {
+		goto free_ctx;
+	}
+	ret = filter_visitor_ir_check_binary_op_nesting(ctx);
+	if (ret) {
+		goto free_ir;
+	}
+	ret = filter_visitor_ir_validate_string(ctx);
+	if (ret) {
+		goto free_ir;
+	}
+	ret = filter_visitor_ir_optimize(ctx);
+	if (ret) {
+		goto free_ir;
+	}
+	ret = filter_visitor_bytecode_generate(ctx);
+	if (ret) {
+		goto free_ir;
+	}
+
+	len = sizeof(ctx->bytecode->b) + bytecode_get_len(&ctx->bytecode->b);
+	*bytecode = malloc(len);
+	if (!*bytecode) {
+		ret = -ENOMEM;
+	} else {
+		memcpy(*bytecode, &ctx->bytecode->b, len);
+	}
+	filter_bytecode_free(ctx);
+
+free_ir:
+	filter_ir_free(ctx);
+free_ctx:
+	filter_parser_ctx_free(ctx);
+end:
+	if (fclose(fmem) != 0) {
+		PERROR("fclose");
+	}
+	/* The filter visitors return positive or negative errors. */
+	return ret > 0 ? -ret : ret;
+}
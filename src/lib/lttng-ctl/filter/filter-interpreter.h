@@ -0,0 +1,75 @@
+#ifndef _FILTER_INTERPRETER_H
+#define _FILTER_INTERPRETER_H
+
+/*
+ * filter-interpreter.h
+ *
+ * LTTng filter bytecode host-side interpreter
+ *
+ * Copyright 2015 - EfficiOS Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License, version 2.1 only,
+ * as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <common/sessiond-comm/sessiond-comm.h>
+
+/*
+ * Reference interpreter of the filter bytecode following the semantic of the
+ * tracers. It is used to test and measure compiled filters without a tracer.
+ */
+
+enum filter_interpreter_field_type {
+	FILTER_INTERPRETER_FIELD_S64,
+	FILTER_INTERPRETER_FIELD_DOUBLE,
+	FILTER_INTERPRETER_FIELD_STRING,
+	FILTER_INTERPRETER_FIELD_SEQUENCE,
+};
+
+/*
+ * Field of an event payload. The name, context flag and type are resolved
+ * when the bytecode is linked. Only the value can change between the
+ * evaluations of a linked program.
+ */
+struct filter_interpreter_field {
+	const char *name;
+	/* Context field, referenced as $ctx.name by the filter. */
+	unsigned int context:1;
+	enum filter_interpreter_field_type type;
+	union {
+		int64_t v;
+		double d;
+		struct {
+			const char *str;
+			/* Length of a sequence, ignored for strings. */
+			size_t len;
+		} s;
+	} u;
+};
+
+struct filter_interpreter_program;
+
+int filter_interpreter_compile(const char *expression,
+		struct lttng_filter_bytecode **bytecode);
+int filter_interpreter_link(const struct lttng_filter_bytecode *bytecode,
+		const struct filter_interpreter_field *fields,
+		unsigned int nr_fields,
+		struct filter_interpreter_program **program);
+int filter_interpreter_run(const struct filter_interpreter_program *program,
+		const struct filter_interpreter_field *fields);
+void filter_interpreter_destroy(struct filter_interpreter_program *program);
+
+#endif /* _FILTER_INTERPRETER_H */
@@ -165,6 +165,9 @@ static struct filter_node *make_node(struct filter_parser_ctx *scanner,
 		break;
 	case NODE_UNARY_OP:
 		break;
+	case NODE_SET:
+		CDS_INIT_LIST_HEAD(&node->u.set.elements);
+		break;
 
 	case NODE_UNKNOWN:
 	default:
@@ -343,6 +346,7 @@ void filter_parser_ctx_free(struct filter_parser_ctx *parser_ctx)
 %type <n> additive_expression
 %type <n> shift_expression
 %type <n> relational_expression
+%type <n> set_element_list
 %type <n> equality_expression
 %type <n> and_expression
 %type <n> exclusive_or_expression
@@ -565,9 +569,30 @@ shift_expression
 		}
 	;
 
+set_element_list
+	: unary_expression
+		{
+			$$ = make_node(parser_ctx, NODE_SET);
+			cds_list_add_tail(&($1)->siblings, &($$)->u.set.elements);
+		}
+	| set_element_list COMMA unary_expression
+		{
+			$$ = $1;
+			cds_list_add_tail(&($3)->siblings, &($$)->u.set.elements);
+		}
+	;
+
 relational_expression
 	: shift_expression
 		{	$$ = $1;					}
+	/* "in" is not reserved, fields may still be named so. */
+	| relational_expression IDENTIFIER LBRAC set_element_list RBRAC
+		{
+			if (strcmp($2->s, "in") != 0) {
+				parse_error(parser_ctx, "expecting \"in\" before set");
+			}
+			$$ = make_op_node(parser_ctx, AST_OP_IN, $1, $4);
+		}
 	| relational_expression LT_OP shift_expression
 		{
 			$$ = make_op_node(parser_ctx, AST_OP_LT, $1, $3);
@@ -478,7 +478,7 @@ struct ir_op *make_op_binary_logical_or(struct ir_op *left, struct ir_op *right,
 	return make_op_binary_logical(AST_OP_OR, "||", left, right, side);
 }
 
-static
+LTTNG_HIDDEN
 void filter_free_ir_recursive(struct ir_op *op)
 {
 	if (!op)
@@ -585,6 +585,274 @@ struct ir_op *make_expression(struct filter_parser_ctx *ctx,
 	}
 }
 
+/*
+ * Get the value of an integer constant, which may be signed, e.g. "-4".
+ *
+ * Return 1 if the node is an integer constant, else 0.
+ */
+static
+int get_constant_numeric(struct ir_op *op, int64_t *v)
+{
+	if (op->op == IR_OP_LOAD && op->data_type == IR_DATA_NUMERIC) {
+		*v = op->u.load.u.num;
+		return 1;
+	}
+	if (op->op != IR_OP_UNARY ||
+			(op->u.unary.type != AST_UNARY_MINUS &&
+			op->u.unary.type != AST_UNARY_PLUS) ||
+			!get_constant_numeric(op->u.unary.child, v)) {
+		return 0;
+	}
+	if (op->u.unary.type == AST_UNARY_MINUS)
+		*v = (int64_t) -(uint64_t) *v;
+	return 1;
+}
+
+/*
+ * Fold an arithmetic or bitwise binary operation between two integer
+ * constants, which may be signed, e.g. "2 * -4". Any other operand is not
+ * supported.
+ */
+static
+struct ir_op *make_op_constant_arith(struct filter_parser_ctx *ctx,
+		struct filter_node *node, enum ir_side side)
+{
+	struct ir_op *op = NULL, *lchild = NULL, *rchild = NULL;
+	const char *op_str = "?";
+	int64_t l, r, v;
+
+	switch (node->u.op.type) {
+	case AST_OP_MUL:
+		op_str = "*";
+		break;
+	case AST_OP_DIV:
+		op_str = "/";
+		break;
+	case AST_OP_MOD:
+		op_str = "%";
+		break;
+	case AST_OP_PLUS:
+		op_str = "+";
+		break;
+	case AST_OP_MINUS:
+		op_str = "-";
+		break;
+	case AST_OP_RSHIFT:
+		op_str = ">>";
+		break;
+	case AST_OP_LSHIFT:
+		op_str = "<<";
+		break;
+	case AST_OP_BIN_AND:
+		op_str = "&";
+		break;
+	case AST_OP_BIN_OR:
+		op_str = "|";
+		break;
+	case AST_OP_BIN_XOR:
+		op_str = "^";
+		break;
+	default:
+		break;
+	}
+
+	lchild = generate_ir_recursive(ctx, node->u.op.lchild, IR_LEFT);
+	if (!lchild)
+		return NULL;
+	rchild = generate_ir_recursive(ctx, node->u.op.rchild, IR_RIGHT);
+	if (!rchild)
+		goto error;
+	if (!get_constant_numeric(lchild, &l)
+			|| !get_constant_numeric(rchild, &r))
+		goto error_not_supported;
+
+	/* Wrap around like the unsigned arithmetic of the tracer. */
+	switch (node->u.op.type) {
+	case AST_OP_MUL:
+		v = (int64_t) ((uint64_t) l * (uint64_t) r);
+		break;
+	case AST_OP_DIV:
+	case AST_OP_MOD:
+		if (r == 0 || (l == INT64_MIN && r == -1)) {
+			fprintf(stderr, "[error] %s: invalid constant division\n",
+				__func__);
+			goto error;
+		}
+		v = node->u.op.type == AST_OP_DIV ? l / r : l % r;
+		break;
+	case AST_OP_PLUS:
+		v = (int64_t) ((uint64_t) l + (uint64_t) r);
+		break;
+	case AST_OP_MINUS:
+		v = (int64_t) ((uint64_t) l - (uint64_t) r);
+		break;
+	case AST_OP_RSHIFT:
+	case AST_OP_LSHIFT:
+		if (r < 0 || r > 63) {
+			fprintf(stderr, "[error] %s: invalid constant shift\n",
+				__func__);
+			goto error;
+		}
+		if (node->u.op.type == AST_OP_RSHIFT)
+			v = l >> r;
+		else
+			v = (int64_t) ((uint64_t) l << r);
+		break;
+	case AST_OP_BIN_AND:
+		v = l & r;
+		break;
+	case AST_OP_BIN_OR:
+		v = l | r;
+		break;
+	case AST_OP_BIN_XOR:
+		v = l ^ r;
+		break;
+	default:
+		goto error_not_supported;
+	}
+
+	op = make_op_load_numeric(v, side);
+	filter_free_ir_recursive(rchild);
+	filter_free_ir_recursive(lchild);
+	return op;
+
+error_not_supported:
+	fprintf(stderr, "[error] %s: binary operation '%s' not supported\n",
+		__func__, op_str);
+error:
+	filter_free_ir_recursive(rchild);
+	filter_free_ir_recursive(lchild);
+	return NULL;
+}
+
+/*
+ * Return 1 if a string literal has a wildcard which is not escaped, else 0.
+ */
+static
+int has_wildcard(const char *str)
+{
+	for (; *str; str++) {
+		if (*str == '*')
+			return 1;
+		if (*str == '\\' && !*++str)
+			break;
+	}
+	return 0;
+}
+
+/*
+ * Comparison of a copy of the field or context reference of a set
+ * membership test with one of the set elements. The element is freed.
+ */
+static
+struct ir_op *make_set_element_eq(struct ir_op *ref, struct ir_op *element,
+		enum ir_data_type *element_type, enum ir_side side)
+{
+	struct ir_op *left = NULL, *right = NULL, *op;
+	int64_t v;
+
+	if (get_constant_numeric(element, &v)) {
+		right = make_op_load_numeric(v, IR_RIGHT);
+		filter_free_ir_recursive(element);
+		element = NULL;
+		if (!right)
+			goto error;
+	} else if (element->op == IR_OP_LOAD &&
+			element->data_type == IR_DATA_STRING) {
+		if (has_wildcard(element->u.load.u.string)) {
+			fprintf(stderr, "Wildcards are not allowed in the strings of a set in a filter.\n");
+			goto error;
+		}
+		right = element;
+		right->side = IR_RIGHT;
+		element = NULL;
+	} else {
+		fprintf(stderr, "[error] Set elements must be integer or string constants\n");
+		goto error;
+	}
+	if (*element_type == IR_DATA_UNKNOWN) {
+		*element_type = right->data_type;
+	} else if (*element_type != right->data_type) {
+		fprintf(stderr, "[error] Set elements must all be integers or all be strings\n");
+		goto error;
+	}
+
+	if (ref->data_type == IR_DATA_FIELD_REF)
+		left = make_op_load_field_ref(ref->u.load.u.ref, IR_LEFT);
+	else
+		left = make_op_load_get_context_ref(ref->u.load.u.ref, IR_LEFT);
+	if (!left)
+		goto error;
+	op = make_op_binary_eq(left, right, side);
+	if (!op)
+		goto error;
+	return op;
+
+error:
+	filter_free_ir_recursive(left);
+	filter_free_ir_recursive(right);
+	filter_free_ir_recursive(element);
+	return NULL;
+}
+
+/*
+ * Membership test of a field or context reference in a set of constants,
+ * e.g. "pid in { 12, 57 }". It is lowered to the chain of equality
+ * comparisons joined by logical or which it stands for, e.g.
+ * "pid == 12 || pid == 57", which every tracer can evaluate.
+ */
+static
+struct ir_op *make_op_set(struct filter_parser_ctx *ctx,
+		struct filter_node *node, enum ir_side side)
+{
+	struct ir_op *op = NULL, *ref, *element, *eq, *chain;
+	enum ir_data_type element_type = IR_DATA_UNKNOWN;
+	struct filter_node *iter;
+
+	ref = generate_ir_recursive(ctx, node->u.op.lchild, IR_LEFT);
+	if (!ref)
+		return NULL;
+	if (ref->op != IR_OP_LOAD ||
+			(ref->data_type != IR_DATA_FIELD_REF &&
+			ref->data_type != IR_DATA_GET_CONTEXT_REF)) {
+		fprintf(stderr, "[error] Only a field or a context can be tested for set membership\n");
+		goto error;
+	}
+
+	cds_list_for_each_entry(iter, &node->u.op.rchild->u.set.elements,
+			siblings) {
+		element = generate_ir_recursive(ctx, iter, IR_RIGHT);
+		if (!element)
+			goto error;
+		eq = make_set_element_eq(ref, element, &element_type,
+				op ? IR_RIGHT : IR_LEFT);
+		if (!eq)
+			goto error;
+		if (!op) {
+			op = eq;
+			continue;
+		}
+		chain = make_op_binary_logical_or(op, eq, IR_LEFT);
+		if (!chain) {
+			filter_free_ir_recursive(eq);
+			goto error;
+		}
+		op = chain;
+	}
+	if (!op) {
+		fprintf(stderr, "[error] Empty set in a membership test\n");
+		goto error;
+	}
+	op->side = side;
+	filter_free_ir_recursive(ref);
+	return op;
+
+error:
+	filter_free_ir_recursive(op);
+	filter_free_ir_recursive(ref);
+	return NULL;
+}
+
 static
 struct ir_op *make_op(struct filter_parser_ctx *ctx,
 		struct filter_node *node, enum ir_side side)
@@ -600,40 +868,25 @@ struct ir_op *make_op(struct filter_parser_ctx *ctx,
 
 	/*
 	 * Binary operators other than comparators and logical and/or
-	 * are not supported. If we ever want to support those, we will
+	 * are not supported, except between integer constants where
+	 * they are folded. If we ever want to support those, we will
 	 * need a stack for the general case rather than just 2
 	 * registers (see bytecode).
 	 */
 	case AST_OP_MUL:
-		op_str = "*";
-		goto error_not_supported;
 	case AST_OP_DIV:
-		op_str = "/";
-		goto error_not_supported;
 	case AST_OP_MOD:
-		op_str = "%";
-		goto error_not_supported;
 	case AST_OP_PLUS:
-		op_str = "+";
-		goto error_not_supported;
 	case AST_OP_MINUS:
-		op_str = "-";
-		goto error_not_supported;
 	case AST_OP_RSHIFT:
-		op_str = ">>";
-		goto error_not_supported;
 	case AST_OP_LSHIFT:
-		op_str = "<<";
-		goto error_not_supported;
 	case AST_OP_BIN_AND:
-		op_str = "&";
-		goto error_not_supported;
 	case AST_OP_BIN_OR:
-		op_str = "|";
-		goto error_not_supported;
 	case AST_OP_BIN_XOR:
-		op_str = "^";
-		goto error_not_supported;
+		return make_op_constant_arith(ctx, node, side);
+
+	case AST_OP_IN:
+		return make_op_set(ctx, node, side);
 
 	case AST_OP_EQ:
 	case AST_OP_NE:
@@ -810,6 +1063,9 @@ struct ir_op *generate_ir_recursive(struct filter_parser_ctx *ctx,
 		return make_op(ctx, node, side);
 	case NODE_UNARY_OP:
 		return make_unary_op(ctx, node, side);
+	case NODE_SET:
+		fprintf(stderr, "[error] %s: set outside of a membership test\n", __func__);
+		return NULL;
 	}
 	return 0;
 }
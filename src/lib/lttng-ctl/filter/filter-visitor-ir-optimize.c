@@ -0,0 +1,503 @@
+/*
+ * filter-visitor-ir-optimize.c
+ *
+ * LTTng filter IR optimization
+ *
+ * Copyright 2015 - EfficiOS Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License, version 2.1 only,
+ * as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The filter is evaluated by the tracer on every hit of the event, so the
+ * IR is simplified before the bytecode is generated:
+ *
+ * - Constant operands of unary operators, comparators and logical
+ *   operators are folded, which also removes the branches of logical
+ *   operators that can never be evaluated.
+ * - Duplicated operands of a chain of logical operators are removed.
+ *
+ * Operands are never reordered, and an operand is only dropped if it would
+ * not be evaluated or if an identical one is evaluated before it. Evaluating
+ * an operand might fail at runtime (e.g. a type mismatch between a field and
+ * a literal, the field types being only known by the tracer), which discards
+ * the event: moving an operand that fails ahead of one that short-circuits,
+ * or dropping it, would change the outcome of the filter.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "filter-ast.h"
+#include "filter-parser.h"
+#include "filter-ir.h"
+
+#include <common/macros.h>
+
+static
+struct ir_op *optimize_recursive(struct ir_op *node);
+
+static
+int is_constant(struct ir_op *node)
+{
+	return node->op == IR_OP_LOAD &&
+		(node->data_type == IR_DATA_NUMERIC ||
+			node->data_type == IR_DATA_FLOAT);
+}
+
+/*
+ * Return 1 if the node evaluates to 0 or 1, in which case it can replace a
+ * logical operator.
+ */
+static
+int is_boolean(struct ir_op *node)
+{
+	switch (node->op) {
+	case IR_OP_BINARY:
+	case IR_OP_LOGICAL:
+		return 1;
+	case IR_OP_UNARY:
+		return node->u.unary.type == AST_UNARY_NOT;
+	case IR_OP_LOAD:
+		return node->data_type == IR_DATA_NUMERIC &&
+			(node->u.load.u.num == 0 || node->u.load.u.num == 1);
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Truth value of a constant operand of a logical operator. Floating point
+ * operands are cast to s64 by the bytecode.
+ */
+static
+int logical_truth(struct ir_op *node)
+{
+	if (node->data_type == IR_DATA_FLOAT) {
+		return (int64_t) node->u.load.u.flt != 0;
+	}
+	return node->u.load.u.num != 0;
+}
+
+static
+int ir_equal(struct ir_op *a, struct ir_op *b)
+{
+	if (a->op != b->op || a->data_type != b->data_type) {
+		return 0;
+	}
+
+	switch (a->op) {
+	case IR_OP_LOAD:
+		switch (a->data_type) {
+		case IR_DATA_STRING:
+			return !strcmp(a->u.load.u.string, b->u.load.u.string);
+		case IR_DATA_NUMERIC:
+			return a->u.load.u.num == b->u.load.u.num;
+		case IR_DATA_FLOAT:
+			return !memcmp(&a->u.load.u.flt, &b->u.load.u.flt,
+					sizeof(a->u.load.u.flt));
+		case IR_DATA_FIELD_REF:
+		case IR_DATA_GET_CONTEXT_REF:
+			return !strcmp(a->u.load.u.ref, b->u.load.u.ref);
+		default:
+			return 0;
+		}
+	case IR_OP_UNARY:
+		return a->u.unary.type == b->u.unary.type &&
+			ir_equal(a->u.unary.child, b->u.unary.child);
+	case IR_OP_BINARY:
+		return a->u.binary.type == b->u.binary.type &&
+			ir_equal(a->u.binary.left, b->u.binary.left) &&
+			ir_equal(a->u.binary.right, b->u.binary.right);
+	case IR_OP_LOGICAL:
+		return a->u.logical.type == b->u.logical.type &&
+			ir_equal(a->u.logical.left, b->u.logical.left) &&
+			ir_equal(a->u.logical.right, b->u.logical.right);
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Turn the node into a numeric constant, freeing its children.
+ */
+static
+struct ir_op *set_numeric(struct ir_op *node, int64_t v)
+{
+	switch (node->op) {
+	case IR_OP_UNARY:
+		filter_free_ir_recursive(node->u.unary.child);
+		break;
+	case IR_OP_BINARY:
+		filter_free_ir_recursive(node->u.binary.left);
+		filter_free_ir_recursive(node->u.binary.right);
+		break;
+	case IR_OP_LOGICAL:
+		filter_free_ir_recursive(node->u.logical.left);
+		filter_free_ir_recursive(node->u.logical.right);
+		break;
+	default:
+		/* Only operators are folded. */
+		assert(0);
+	}
+	node->op = IR_OP_LOAD;
+	node->data_type = IR_DATA_NUMERIC;
+	node->signedness = IR_SIGNED;
+	node->u.load.u.num = v;
+	return node;
+}
+
+/*
+ * Replace the node by one of its children, freeing the other one.
+ */
+static
+struct ir_op *replace_by_child(struct ir_op *node, struct ir_op *child,
+		struct ir_op *other)
+{
+	child->side = node->side;
+	filter_free_ir_recursive(other);
+	free(node);
+	return child;
+}
+
+static
+struct ir_op *optimize_unary(struct ir_op *node)
+{
+	struct ir_op *child;
+
+	node->u.unary.child = optimize_recursive(node->u.unary.child);
+	child = node->u.unary.child;
+
+	switch (node->u.unary.type) {
+	case AST_UNARY_PLUS:
+		/* Generates no instruction, only keep the child. */
+		return replace_by_child(node, child, NULL);
+	case AST_UNARY_MINUS:
+		if (!is_constant(child)) {
+			break;
+		}
+		if (child->data_type == IR_DATA_FLOAT) {
+			child->u.load.u.flt = -child->u.load.u.flt;
+		} else {
+			child->u.load.u.num =
+				(int64_t) -(uint64_t) child->u.load.u.num;
+		}
+		return replace_by_child(node, child, NULL);
+	case AST_UNARY_NOT:
+		if (is_constant(child)) {
+			int64_t v;
+
+			if (child->data_type == IR_DATA_FLOAT) {
+				v = child->u.load.u.flt == 0.0;
+			} else {
+				v = child->u.load.u.num == 0;
+			}
+			return set_numeric(node, v);
+		}
+		/* !!x is x for a boolean x. */
+		if (child->op == IR_OP_UNARY &&
+				child->u.unary.type == AST_UNARY_NOT &&
+				is_boolean(child->u.unary.child)) {
+			struct ir_op *grandchild = child->u.unary.child;
+
+			free(child);
+			return replace_by_child(node, grandchild, NULL);
+		}
+		break;
+	default:
+		break;
+	}
+	return node;
+}
+
+static
+int compare_constants(enum op_type type, struct ir_op *left,
+		struct ir_op *right)
+{
+	if (left->data_type == IR_DATA_NUMERIC &&
+			right->data_type == IR_DATA_NUMERIC) {
+		int64_t l = left->u.load.u.num, r = right->u.load.u.num;
+
+		switch (type) {
+		case AST_OP_EQ:
+			return l == r;
+		case AST_OP_NE:
+			return l != r;
+		case AST_OP_GT:
+			return l > r;
+		case AST_OP_LT:
+			return l < r;
+		case AST_OP_GE:
+			return l >= r;
+		case AST_OP_LE:
+			return l <= r;
+		default:
+			assert(0);
+		}
+	} else {
+		/* Mixed comparisons are done as double, like the tracer. */
+		double l, r;
+
+		l = left->data_type == IR_DATA_FLOAT ? left->u.load.u.flt :
+			(double) left->u.load.u.num;
+		r = right->data_type == IR_DATA_FLOAT ? right->u.load.u.flt :
+			(double) right->u.load.u.num;
+
+		switch (type) {
+		case AST_OP_EQ:
+			return l == r;
+		case AST_OP_NE:
+			return l != r;
+		case AST_OP_GT:
+			return l > r;
+		case AST_OP_LT:
+			return l < r;
+		case AST_OP_GE:
+			return l >= r;
+		case AST_OP_LE:
+			return l <= r;
+		default:
+			assert(0);
+		}
+	}
+	return 0;
+}
+
+static
+struct ir_op *optimize_binary(struct ir_op *node)
+{
+	node->u.binary.left = optimize_recursive(node->u.binary.left);
+	node->u.binary.right = optimize_recursive(node->u.binary.right);
+
+	/*
+	 * String comparisons are left to the tracer which handles the
+	 * wildcards and escape sequences.
+	 */
+	if (is_constant(node->u.binary.left) &&
+			is_constant(node->u.binary.right)) {
+		return set_numeric(node, compare_constants(node->u.binary.type,
+				node->u.binary.left, node->u.binary.right));
+	}
+	return node;
+}
+
+/*
+ * Fold a logical operator having a constant operand. An operand that is not
+ * evaluated anymore is dropped.
+ *
+ * Return the folded node or NULL if nothing could be folded.
+ */
+static
+struct ir_op *fold_logical(struct ir_op *node)
+{
+	struct ir_op *left = node->u.logical.left;
+	struct ir_op *right = node->u.logical.right;
+	struct ir_op *constant, *other;
+	/* Value of the operator when the constant operand decides. */
+	int decisive = node->u.logical.type == AST_OP_OR;
+
+	if (is_constant(left)) {
+		constant = left;
+		other = right;
+	} else if (is_constant(right)) {
+		constant = right;
+		other = left;
+	} else {
+		return NULL;
+	}
+
+	/*
+	 * false && x, true || x. The other operand is never evaluated, which
+	 * only holds if it comes after the constant: "x && false" still fails
+	 * if x does.
+	 */
+	if (logical_truth(constant) == decisive) {
+		if (constant != left && !is_constant(other)) {
+			return NULL;
+		}
+		return set_numeric(node, decisive);
+	}
+
+	/* true && x, false || x */
+	if (is_constant(other)) {
+		return set_numeric(node, logical_truth(other));
+	}
+	if (is_boolean(other)) {
+		return replace_by_child(node, other, constant);
+	}
+	return NULL;
+}
+
+static
+unsigned int count_chain_operands(struct ir_op *node, enum op_type type)
+{
+	if (node->op != IR_OP_LOGICAL || node->u.logical.type != type) {
+		return 1;
+	}
+	return count_chain_operands(node->u.logical.left, type) +
+		count_chain_operands(node->u.logical.right, type);
+}
+
+/*
+ * Collect the operands and the operator nodes of a chain of logical
+ * operators of the same type, in evaluation order.
+ */
+static
+void collect_chain(struct ir_op *node, enum op_type type,
+		struct ir_op **operands, unsigned int *nr_operands,
+		struct ir_op **ops, unsigned int *nr_ops)
+{
+	if (node->op != IR_OP_LOGICAL || node->u.logical.type != type) {
+		operands[(*nr_operands)++] = node;
+		return;
+	}
+	ops[(*nr_ops)++] = node;
+	collect_chain(node->u.logical.left, type, operands, nr_operands,
+			ops, nr_ops);
+	collect_chain(node->u.logical.right, type, operands, nr_operands,
+			ops, nr_ops);
+}
+
+/*
+ * Remove the duplicated boolean operands of a chain, keeping the first one
+ * which is evaluated before the others, then rebuild the chain from its
+ * operator nodes. The order of the remaining operands is unchanged. The
+ * first operator node stays on top so the parent link is unchanged.
+ *
+ * The chain is left untouched if memory is lacking.
+ */
+static
+struct ir_op *dedup_chain(struct ir_op *node)
+{
+	enum op_type type = node->u.logical.type;
+	enum ir_side side = node->side;
+	unsigned int nr, nr_operands = 0, nr_ops = 0, i, j;
+	struct ir_op **operands = NULL, **ops = NULL;
+	struct ir_op *top;
+
+	nr = count_chain_operands(node, type);
+	operands = calloc(nr, sizeof(*operands));
+	ops = calloc(nr, sizeof(*ops));
+	if (!operands || !ops) {
+		top = node;
+		goto end;
+	}
+	collect_chain(node, type, operands, &nr_operands, ops, &nr_ops);
+	assert(nr_operands == nr && nr_ops == nr - 1);
+
+	/* x && x is x for a boolean x. */
+	for (i = 0; i < nr_operands; i++) {
+		for (j = i + 1; j < nr_operands;) {
+			if (is_boolean(operands[j]) &&
+					ir_equal(operands[i], operands[j])) {
+				filter_free_ir_recursive(operands[j]);
+				memmove(&operands[j], &operands[j + 1],
+					(nr_operands - j - 1) * sizeof(*operands));
+				nr_operands--;
+			} else {
+				j++;
+			}
+		}
+	}
+
+	if (nr_operands == 1) {
+		/* Only a duplicated boolean operand was left. */
+		top = operands[0];
+		top->side = side;
+		for (i = 0; i < nr_ops; i++) {
+			free(ops[i]);
+		}
+		goto end;
+	}
+
+	/* Both children of a logical operator populate R0. */
+	for (i = 0; i < nr_operands; i++) {
+		operands[i]->side = IR_LEFT;
+	}
+
+	/* Left-deep chain: ops[0] is on top, ops[k] applies to operands[k + 1]. */
+	for (i = nr_operands - 1; i < nr_ops; i++) {
+		free(ops[i]);
+	}
+	nr_ops = nr_operands - 1;
+	for (i = 0; i < nr_ops; i++) {
+		struct ir_op *op = ops[i];
+
+		op->u.logical.right = operands[nr_ops - i];
+		if (i == nr_ops - 1) {
+			op->u.logical.left = operands[0];
+		} else {
+			op->u.logical.left = ops[i + 1];
+		}
+		op->side = IR_LEFT;
+	}
+	top = ops[0];
+	top->side = side;
+
+end:
+	free(ops);
+	free(operands);
+	return top;
+}
+
+static
+struct ir_op *optimize_logical(struct ir_op *node)
+{
+	struct ir_op *folded;
+
+	node->u.logical.left = optimize_recursive(node->u.logical.left);
+	node->u.logical.right = optimize_recursive(node->u.logical.right);
+
+	folded = fold_logical(node);
+	if (folded) {
+		return folded;
+	}
+	return dedup_chain(node);
+}
+
+/*
+ * Return the optimized node, which may replace the given one.
+ */
+static
+struct ir_op *optimize_recursive(struct ir_op *node)
+{
+	switch (node->op) {
+	case IR_OP_ROOT:
+		node->u.root.child = optimize_recursive(node->u.root.child);
+		return node;
+	case IR_OP_UNARY:
+		return optimize_unary(node);
+	case IR_OP_BINARY:
+		return optimize_binary(node);
+	case IR_OP_LOGICAL:
+		return optimize_logical(node);
+	case IR_OP_LOAD:
+	default:
+		return node;
+	}
+}
+
+LTTNG_HIDDEN
+int filter_visitor_ir_optimize(struct filter_parser_ctx *ctx)
+{
+	if (!ctx->ir_root) {
+		return -EINVAL;
+	}
+	ctx->ir_root = optimize_recursive(ctx->ir_root);
+	return 0;
+}
@@ -62,6 +62,9 @@ int update_child(struct filter_node *parent,
 		assert(parent->u.unary_op.child == old_child);
 		parent->u.unary_op.child = new_child;
 		break;
+	case NODE_SET:
+		cds_list_replace(&old_child->siblings, &new_child->siblings);
+		break;
 	}
 	return 0;
 }
@@ -133,6 +136,19 @@ int recursive_visit_set_parent(struct filter_node *node,
 		return recursive_visit_set_parent(node->u.op.rchild, node);
 	case NODE_UNARY_OP:
 		return recursive_visit_set_parent(node->u.unary_op.child, node);
+	case NODE_SET:
+	{
+		struct filter_node *iter, *tmp;
+
+		/* An element chain may be replaced by its first identifier. */
+		cds_list_for_each_entry_safe(iter, tmp, &node->u.set.elements,
+				siblings) {
+			ret = recursive_visit_set_parent(iter, node);
+			if (ret)
+				return ret;
+		}
+		break;
+	}
 	}
 	return 0;
 }
@@ -210,6 +210,9 @@ int recursive_visit_print(struct filter_node *node, FILE *stream, int indent)
 		case AST_OP_LE:
 			fprintf(stream, "\"<=\"");
 			break;
+		case AST_OP_IN:
+			fprintf(stream, "\"in\"");
+			break;
 		}
 		fprintf(stream, ">\n");
 		ret = recursive_visit_print(node->u.op.lchild,
@@ -250,6 +253,21 @@ int recursive_visit_print(struct filter_node *node, FILE *stream, int indent)
 		print_tabs(stream, indent);
 		fprintf(stream, "</unary_op>\n");
 		return ret;
+	case NODE_SET:
+	{
+		struct filter_node *iter;
+
+		print_tabs(stream, indent);
+		fprintf(stream, "<set>\n");
+		cds_list_for_each_entry(iter, &node->u.set.elements, siblings) {
+			ret = recursive_visit_print(iter, stream, indent + 1);
+			if (ret)
+				return ret;
+		}
+		print_tabs(stream, indent);
+		fprintf(stream, "</set>\n");
+		return 0;
+	}
 	}
 	return 0;
 }
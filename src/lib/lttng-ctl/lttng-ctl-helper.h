@@ -45,6 +45,9 @@ void lttng_ctl_copy_lttng_domain(struct lttng_domain *dst,
 int lttng_ctl_ask_sessiond_varlen(struct lttcomm_session_msg *lsm,
 		void *vardata, size_t varlen, void **buf);
 
+/* Number of compiled filter expressions kept by the filter cache. */
+#define LTTNG_CTL_FILTER_CACHE_SIZE	16
+
 /*
  * Use this if no variable length data needs to be sent.
  */
@@ -24,6 +24,8 @@
 #include <assert.h>
 #include <grp.h>
 #include <errno.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,6 +33,7 @@
 
 #include <common/common.h>
 #include <common/defaults.h>
+#include <common/hashtable/utils.h>
 #include <common/sessiond-comm/sessiond-comm.h>
 #include <common/uri.h>
 #include <common/utils.h>
@@ -65,6 +68,26 @@ static char sessiond_sock_path[PATH_MAX];
 /* Variables */
 static char *tracing_group;
 static int connected;
+/* Keep the connection to the session daemon open across calls. */
+static int persistent_connection;
+/* Process that opened the connection. A forked child must not share it. */
+static pid_t connection_pid;
+
+/*
+ * Bytecode of the last filter expressions compiled, so applying the same
+ * filter to many events parses and compiles it once.
+ */
+struct filter_cache_entry {
+	char *expression;
+	unsigned long hash;
+	struct lttng_filter_bytecode *bytecode;
+	/* Value of filter_cache_clock at the last use, 0 if the slot is free. */
+	uint64_t last_use;
+};
+
+static struct filter_cache_entry filter_cache[LTTNG_CTL_FILTER_CACHE_SIZE];
+static uint64_t filter_cache_clock;
+static pthread_mutex_t filter_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /* Global */
 
@@ -338,6 +361,31 @@ error:
 	return -1;
 }
 
+static int disconnect_sessiond(void);
+
+/*
+ * Check that an idle persistent connection is still usable. The session
+ * daemon never sends anything unsolicited so any event on the socket means it
+ * was closed on the other end.
+ *
+ * Return 1 if usable, else 0.
+ */
+static int connection_alive(void)
+{
+	int ret;
+	struct pollfd pfd;
+
+	pfd.fd = sessiond_socket;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	do {
+		ret = poll(&pfd, 1, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret == 0;
+}
+
 /*
  *  Connect to the LTTng session daemon.
  *
@@ -349,7 +397,20 @@ static int connect_sessiond(void)
 
 	/* Don't try to connect if already connected. */
 	if (connected) {
-		return 0;
+		if (connection_pid != getpid()) {
+			/*
+			 * Inherited from our parent which still uses it, only close
+			 * our copy.
+			 */
+			(void) close(sessiond_socket);
+			sessiond_socket = 0;
+			connected = 0;
+		} else if (!persistent_connection || connection_alive()) {
+			return 0;
+		} else {
+			/* The session daemon closed the connection, reconnect. */
+			disconnect_sessiond();
+		}
 	}
 
 	ret = set_session_daemon_path();
@@ -365,6 +426,7 @@ static int connect_sessiond(void)
 
 	sessiond_socket = ret;
 	connected = 1;
+	connection_pid = getpid();
 
 	return 0;
 
@@ -390,25 +452,14 @@ static int disconnect_sessiond(void)
 }
 
 /*
- * Ask the session daemon a specific command and put the data into buf.
- * Takes extra var. len. data as input to send to the session daemon.
+ * Send a command and its var. len. data to the session daemon.
  *
- * Return size of data (only payload, not header) or a negative error code.
+ * Return 0 on success or else a negative lttng error code.
  */
-LTTNG_HIDDEN
-int lttng_ctl_ask_sessiond_varlen(struct lttcomm_session_msg *lsm,
-		void *vardata, size_t varlen, void **buf)
+static int send_request(struct lttcomm_session_msg *lsm, void *vardata,
+		size_t varlen)
 {
 	int ret;
-	size_t size;
-	void *data = NULL;
-	struct lttcomm_lttng_msg llm;
-
-	ret = connect_sessiond();
-	if (ret < 0) {
-		ret = -LTTNG_ERR_NO_SESSIOND;
-		goto end;
-	}
 
 	/* Send command to session daemon */
 	ret = send_session_msg(lsm);
@@ -422,22 +473,47 @@ int lttng_ctl_ask_sessiond_varlen(struct lttcomm_session_msg *lsm,
 		/* Ret value is a valid lttng error code. */
 		goto end;
 	}
+	ret = 0;
+
+end:
+	return ret;
+}
+
+/*
+ * Receive the reply of a command and put its payload into buf.
+ *
+ * Return size of data (only payload, not header) or a negative error code.
+ * comm_error is set if the connection is not usable anymore.
+ */
+static int recv_reply(void **buf, int *comm_error)
+{
+	int ret;
+	size_t size;
+	void *data = NULL;
+	struct lttcomm_lttng_msg llm;
+
+	*comm_error = 1;
 
 	/* Get header from data transmission */
 	ret = recv_data_sessiond(&llm, sizeof(llm));
-	if (ret < 0) {
+	if (ret <= 0) {
 		/* Ret value is a valid lttng error code. */
+		if (ret == 0) {
+			ret = -LTTNG_ERR_NO_SESSIOND;
+		}
 		goto end;
 	}
 
 	/* Check error code if OK */
 	if (llm.ret_code != LTTNG_OK) {
+		*comm_error = 0;
 		ret = -llm.ret_code;
 		goto end;
 	}
 
 	size = llm.data_size;
 	if (size == 0) {
+		*comm_error = 0;
 		/* If client free with size 0 */
 		if (buf != NULL) {
 			*buf = NULL;
@@ -458,6 +534,7 @@ int lttng_ctl_ask_sessiond_varlen(struct lttcomm_session_msg *lsm,
 		free(data);
 		goto end;
 	}
+	*comm_error = 0;
 
 	/*
 	 * Extra protection not to dereference a NULL pointer. If buf is NULL at
@@ -473,7 +550,38 @@ int lttng_ctl_ask_sessiond_varlen(struct lttcomm_session_msg *lsm,
 	ret = size;
 
 end:
-	disconnect_sessiond();
+	return ret;
+}
+
+/*
+ * Ask the session daemon a specific command and put the data into buf.
+ * Takes extra var. len. data as input to send to the session daemon.
+ *
+ * Return size of data (only payload, not header) or a negative error code.
+ */
+LTTNG_HIDDEN
+int lttng_ctl_ask_sessiond_varlen(struct lttcomm_session_msg *lsm,
+		void *vardata, size_t varlen, void **buf)
+{
+	int ret, comm_error = 1;
+
+	ret = connect_sessiond();
+	if (ret < 0) {
+		ret = -LTTNG_ERR_NO_SESSIOND;
+		goto end;
+	}
+
+	ret = send_request(lsm, vardata, varlen);
+	if (ret < 0) {
+		goto end;
+	}
+
+	ret = recv_reply(buf, &comm_error);
+
+end:
+	if (!persistent_connection || comm_error) {
+		disconnect_sessiond();
+	}
 	return ret;
 }
 
@@ -759,21 +867,19 @@ error:
 }
 
 /*
- * Generate the filter bytecode from a give filter expression string. Put the
- * newly allocated parser context in ctxp and populate the lsm object with the
- * expression len.
+ * Compile the filter bytecode of a given filter expression string. Put the
+ * newly allocated parser context in ctxp.
  *
  * Return 0 on success else a LTTNG_ERR_* code and ctxp is untouched.
  */
-static int generate_filter(char *filter_expression,
-		struct lttcomm_session_msg *lsm, struct filter_parser_ctx **ctxp)
+static int compile_filter(char *filter_expression,
+		struct filter_parser_ctx **ctxp)
 {
 	int ret;
 	struct filter_parser_ctx *ctx = NULL;
 	FILE *fmem = NULL;
 
 	assert(filter_expression);
-	assert(lsm);
 	assert(ctxp);
 
 	/*
@@ -840,6 +946,15 @@ static int generate_filter(char *filter_expression,
 	}
 	dbg_printf("done\n");
 
+	dbg_printf("Optimizing IR... ");
+	fflush(stdout);
+	ret = filter_visitor_ir_optimize(ctx);
+	if (ret) {
+		ret = -LTTNG_ERR_FILTER_INVAL;
+		goto parse_error;
+	}
+	dbg_printf("done\n");
+
 	dbg_printf("Generating bytecode... ");
 	fflush(stdout);
 	ret = filter_visitor_bytecode_generate(ctx);
@@ -852,10 +967,6 @@ static int generate_filter(char *filter_expression,
 	dbg_printf("Size of bytecode generated: %u bytes.\n",
 			bytecode_get_len(&ctx->bytecode->b));
 
-	lsm->u.enable.bytecode_len = sizeof(ctx->bytecode->b)
-		+ bytecode_get_len(&ctx->bytecode->b);
-	lsm->u.enable.expression_len = strlen(filter_expression) + 1;
-
 	/* No need to keep the memory stream. */
 	if (fclose(fmem) != 0) {
 		PERROR("fclose");
@@ -875,6 +986,129 @@ error:
 	return ret;
 }
 
+/*
+ * Look up the filter cache for the bytecode of the expression.
+ *
+ * Called with the filter cache lock held.
+ */
+static struct filter_cache_entry *filter_cache_lookup(const char *expression,
+		unsigned long hash)
+{
+	int i;
+
+	for (i = 0; i < LTTNG_CTL_FILTER_CACHE_SIZE; i++) {
+		struct filter_cache_entry *entry = &filter_cache[i];
+
+		if (entry->last_use && entry->hash == hash &&
+				!strcmp(entry->expression, expression)) {
+			entry->last_use = ++filter_cache_clock;
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Add the bytecode of the expression to the filter cache, replacing the
+ * least recently used entry.
+ *
+ * Called with the filter cache lock held. Return the entry or NULL on error.
+ */
+static struct filter_cache_entry *filter_cache_add(const char *expression,
+		unsigned long hash, const struct lttng_filter_bytecode *bytecode)
+{
+	int i;
+	char *expression_copy;
+	struct lttng_filter_bytecode *bytecode_copy;
+	struct filter_cache_entry *entry = &filter_cache[0];
+
+	for (i = 1; i < LTTNG_CTL_FILTER_CACHE_SIZE; i++) {
+		if (filter_cache[i].last_use < entry->last_use) {
+			entry = &filter_cache[i];
+		}
+	}
+
+	expression_copy = strdup(expression);
+	bytecode_copy = malloc(sizeof(*bytecode) + bytecode->len);
+	if (!expression_copy || !bytecode_copy) {
+		free(expression_copy);
+		free(bytecode_copy);
+		return NULL;
+	}
+	memcpy(bytecode_copy, bytecode, sizeof(*bytecode) + bytecode->len);
+
+	free(entry->expression);
+	free(entry->bytecode);
+	entry->expression = expression_copy;
+	entry->hash = hash;
+	entry->bytecode = bytecode_copy;
+	entry->last_use = ++filter_cache_clock;
+	return entry;
+}
+
+/*
+ * Generate the filter bytecode from a given filter expression string, or get
+ * it from the filter cache if it was already compiled. Put a newly allocated
+ * copy of the bytecode in bytecodep and populate the lsm object with the
+ * expression and bytecode len.
+ *
+ * Return 0 on success else a LTTNG_ERR_* code and bytecodep is untouched.
+ */
+static int generate_filter(char *filter_expression,
+		struct lttcomm_session_msg *lsm,
+		struct lttng_filter_bytecode **bytecodep)
+{
+	int ret = 0;
+	unsigned long hash;
+	size_t len;
+	struct filter_parser_ctx *ctx = NULL;
+	struct filter_cache_entry *entry;
+	struct lttng_filter_bytecode *bytecode;
+
+	assert(filter_expression);
+	assert(lsm);
+	assert(bytecodep);
+
+	hash = hash_key_str(filter_expression, 0);
+
+	pthread_mutex_lock(&filter_cache_lock);
+	entry = filter_cache_lookup(filter_expression, hash);
+	if (!entry) {
+		ret = compile_filter(filter_expression, &ctx);
+		if (ret) {
+			goto end;
+		}
+		entry = filter_cache_add(filter_expression, hash,
+				&ctx->bytecode->b);
+		filter_bytecode_free(ctx);
+		filter_ir_free(ctx);
+		filter_parser_ctx_free(ctx);
+		if (!entry) {
+			ret = -LTTNG_ERR_FILTER_NOMEM;
+			goto end;
+		}
+	} else {
+		dbg_printf("Using cached bytecode of filter %s\n",
+				filter_expression);
+	}
+
+	len = sizeof(*entry->bytecode) + entry->bytecode->len;
+	bytecode = malloc(len);
+	if (!bytecode) {
+		ret = -LTTNG_ERR_FILTER_NOMEM;
+		goto end;
+	}
+	memcpy(bytecode, entry->bytecode, len);
+
+	lsm->u.enable.bytecode_len = len;
+	lsm->u.enable.expression_len = strlen(filter_expression) + 1;
+	*bytecodep = bytecode;
+
+end:
+	pthread_mutex_unlock(&filter_cache_lock);
+	return ret;
+}
+
 /*
  * Enable event(s) for a channel, possibly with exclusions and a filter.
  * If no event name is specified, all events are enabled.
@@ -892,7 +1126,7 @@ int lttng_enable_event_with_exclusions(struct lttng_handle *handle,
 	char *varlen_data;
 	int ret = 0;
 	unsigned int free_filter_expression = 0;
-	struct filter_parser_ctx *ctx = NULL;
+	struct lttng_filter_bytecode *bytecode = NULL;
 	/*
 	 * Cast as non-const since we may replace the filter expression
 	 * by a dynamically allocated string. Otherwise, the original
@@ -983,7 +1217,7 @@ int lttng_enable_event_with_exclusions(struct lttng_handle *handle,
 			}
 		}
 
-		ret = generate_filter(filter_expression, &lsm, &ctx);
+		ret = generate_filter(filter_expression, &lsm, &bytecode);
 		if (ret) {
 			goto filter_error;
 		}
@@ -1010,11 +1244,11 @@ int lttng_enable_event_with_exclusions(struct lttng_handle *handle,
 			lsm.u.enable.expression_len);
 	}
 	/* Add filter bytecode next */
-	if (ctx && lsm.u.enable.bytecode_len != 0) {
+	if (bytecode && lsm.u.enable.bytecode_len != 0) {
 		memcpy(varlen_data
 			+ LTTNG_SYMBOL_NAME_LEN * lsm.u.enable.exclusion_count
 			+ lsm.u.enable.expression_len,
-			&ctx->bytecode->b,
+			bytecode,
 			lsm.u.enable.bytecode_len);
 	}
 
@@ -1024,11 +1258,7 @@ int lttng_enable_event_with_exclusions(struct lttng_handle *handle,
 	free(varlen_data);
 
 mem_error:
-	if (filter_expression && ctx) {
-		filter_bytecode_free(ctx);
-		filter_ir_free(ctx);
-		filter_parser_ctx_free(ctx);
-	}
+	free(bytecode);
 filter_error:
 	if (free_filter_expression) {
 		/*
@@ -1057,7 +1287,7 @@ int lttng_disable_event_ext(struct lttng_handle *handle,
 	char *varlen_data;
 	int ret = 0;
 	unsigned int free_filter_expression = 0;
-	struct filter_parser_ctx *ctx = NULL;
+	struct lttng_filter_bytecode *bytecode = NULL;
 	/*
 	 * Cast as non-const since we may replace the filter expression
 	 * by a dynamically allocated string. Otherwise, the original
@@ -1147,7 +1377,7 @@ int lttng_disable_event_ext(struct lttng_handle *handle,
 			}
 		}
 
-		ret = generate_filter(filter_expression, &lsm, &ctx);
+		ret = generate_filter(filter_expression, &lsm, &bytecode);
 		if (ret) {
 			goto filter_error;
 		}
@@ -1167,10 +1397,10 @@ int lttng_disable_event_ext(struct lttng_handle *handle,
 			lsm.u.disable.expression_len);
 	}
 	/* Add filter bytecode next */
-	if (ctx && lsm.u.disable.bytecode_len != 0) {
+	if (bytecode && lsm.u.disable.bytecode_len != 0) {
 		memcpy(varlen_data
 			+ lsm.u.disable.expression_len,
-			&ctx->bytecode->b,
+			bytecode,
 			lsm.u.disable.bytecode_len);
 	}
 
@@ -1179,11 +1409,7 @@ int lttng_disable_event_ext(struct lttng_handle *handle,
 	free(varlen_data);
 
 mem_error:
-	if (filter_expression && ctx) {
-		filter_bytecode_free(ctx);
-		filter_ir_free(ctx);
-		filter_parser_ctx_free(ctx);
-	}
+	free(bytecode);
 filter_error:
 	if (free_filter_expression) {
 		/*
@@ -1222,6 +1448,260 @@ int lttng_disable_event(struct lttng_handle *handle, const char *name,
 	return lttng_disable_event_ext(handle, &ev, channel_name, NULL);
 }
 
+/*
+ * Append the entry of an event to the payload of a bulk event command,
+ * generating its filter bytecode if needed. The payload is grown as needed.
+ *
+ * Return 0 on success else a negative LTTng error code.
+ */
+static int append_event_batch_entry(struct lttng_handle *handle,
+		struct lttng_event *ev, const char *original_filter_expression,
+		int exclusion_count, char **exclusion_list,
+		char **payload, size_t *payload_len)
+{
+	int ret = 0, i;
+	unsigned int free_filter_expression = 0;
+	struct lttng_filter_bytecode *bytecode = NULL;
+	struct lttcomm_session_msg filter_lsm;
+	struct lttcomm_event_batch_entry hdr;
+	char *filter_expression = (char *) original_filter_expression;
+	char *new_payload, *p;
+	size_t entry_len;
+
+	/* Same as a single enable, an empty filter is always rejected. */
+	if ((filter_expression && filter_expression[0] == '\0') ||
+			exclusion_count < 0) {
+		ret = -LTTNG_ERR_INVALID;
+		goto error;
+	}
+
+	if (ev->name[0] == '\0') {
+		/* Enable all events */
+		lttng_ctl_copy_string(ev->name, "*", sizeof(ev->name));
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	/* FIXME: copying non-packed struct to packed struct. */
+	memcpy(&hdr.event, ev, sizeof(hdr.event));
+	hdr.exclusion_count = exclusion_count;
+
+	/* Agent domains enforce a filter, see lttng_enable_event_with_exclusions. */
+	if (handle->domain.type == LTTNG_DOMAIN_JUL ||
+			handle->domain.type == LTTNG_DOMAIN_LOG4J ||
+			handle->domain.type == LTTNG_DOMAIN_PYTHON) {
+		char *agent_filter;
+
+		agent_filter = set_agent_filter(filter_expression, ev);
+		if (agent_filter) {
+			filter_expression = agent_filter;
+			free_filter_expression = 1;
+		}
+	}
+
+	if (filter_expression) {
+		memset(&filter_lsm, 0, sizeof(filter_lsm));
+		ret = generate_filter(filter_expression, &filter_lsm, &bytecode);
+		if (ret) {
+			goto filter_error;
+		}
+		hdr.expression_len = filter_lsm.u.enable.expression_len;
+		hdr.bytecode_len = filter_lsm.u.enable.bytecode_len;
+	}
+
+	entry_len = sizeof(hdr) + LTTNG_SYMBOL_NAME_LEN * exclusion_count +
+		hdr.expression_len + hdr.bytecode_len;
+	new_payload = realloc(*payload, *payload_len + entry_len);
+	if (!new_payload) {
+		ret = -LTTNG_ERR_NOMEM;
+		goto mem_error;
+	}
+	*payload = new_payload;
+	p = new_payload + *payload_len;
+	*payload_len += entry_len;
+
+	/* Same layout as the variable-length data of a single enable. */
+	memcpy(p, &hdr, sizeof(hdr));
+	p += sizeof(hdr);
+	for (i = 0; i < exclusion_count; i++) {
+		strncpy(p, exclusion_list[i], LTTNG_SYMBOL_NAME_LEN);
+		p += LTTNG_SYMBOL_NAME_LEN;
+	}
+	if (hdr.expression_len != 0) {
+		memcpy(p, filter_expression, hdr.expression_len);
+		p += hdr.expression_len;
+	}
+	if (bytecode && hdr.bytecode_len != 0) {
+		memcpy(p, bytecode, hdr.bytecode_len);
+	}
+
+mem_error:
+	free(bytecode);
+filter_error:
+	if (free_filter_expression) {
+		free(filter_expression);
+	}
+error:
+	return ret;
+}
+
+/*
+ * Create or enable many events of a channel with a single command.
+ *
+ * Falls back on one command per event with a session daemon not supporting
+ * bulk commands.
+ *
+ * Return 0 on success else a negative LTTng error code.
+ */
+int lttng_enable_events(struct lttng_handle *handle,
+		struct lttng_event *events, unsigned int count,
+		const char *channel_name, const char **filter_expressions,
+		const int *exclusion_counts, char ***exclusion_names)
+{
+	int ret = 0;
+	unsigned int i;
+	size_t payload_len = 0;
+	char *payload = NULL;
+	struct lttcomm_session_msg lsm;
+
+	if (handle == NULL || events == NULL || count == 0 ||
+			(exclusion_counts && !exclusion_names)) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	for (i = 0; i < count; i++) {
+		ret = append_event_batch_entry(handle, &events[i],
+				filter_expressions ? filter_expressions[i] : NULL,
+				exclusion_counts ? exclusion_counts[i] : 0,
+				exclusion_counts ? exclusion_names[i] : NULL,
+				&payload, &payload_len);
+		if (ret < 0) {
+			goto end;
+		}
+	}
+
+	if (payload_len > LTTNG_EVENT_BATCH_MAX_LEN) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	memset(&lsm, 0, sizeof(lsm));
+	lsm.cmd_type = LTTNG_ENABLE_EVENTS;
+	/* If no channel name, send empty string. */
+	lttng_ctl_copy_string(lsm.u.events.channel_name,
+			channel_name ? channel_name : "",
+			sizeof(lsm.u.events.channel_name));
+	lttng_ctl_copy_lttng_domain(&lsm.domain, &handle->domain);
+	lttng_ctl_copy_string(lsm.session.name, handle->session_name,
+			sizeof(lsm.session.name));
+	lsm.u.events.count = count;
+	lsm.u.events.payload_len = payload_len;
+
+	ret = lttng_ctl_ask_sessiond_varlen(&lsm, payload, payload_len, NULL);
+	if (ret != -LTTNG_ERR_UND) {
+		goto end;
+	}
+
+	/* Older session daemon, enable the events one by one. */
+	ret = 0;
+	for (i = 0; i < count; i++) {
+		int event_ret;
+
+		event_ret = lttng_enable_event_with_exclusions(handle, &events[i],
+				channel_name,
+				filter_expressions ? filter_expressions[i] : NULL,
+				exclusion_counts ? exclusion_counts[i] : 0,
+				exclusion_counts ? exclusion_names[i] : NULL);
+		if (event_ret < 0 && event_ret != -LTTNG_ERR_UST_EVENT_ENABLED &&
+				event_ret != -LTTNG_ERR_KERN_EVENT_EXIST && ret == 0) {
+			ret = event_ret;
+		}
+	}
+
+end:
+	free(payload);
+	return ret < 0 ? ret : 0;
+}
+
+/*
+ * Disable many events of a channel, by name, with a single command.
+ *
+ * Falls back on one command per event with a session daemon not supporting
+ * bulk commands.
+ *
+ * Return 0 on success else a negative LTTng error code.
+ */
+int lttng_disable_events(struct lttng_handle *handle,
+		const char **names, unsigned int count, const char *channel_name)
+{
+	int ret;
+	unsigned int i;
+	size_t payload_len;
+	struct lttcomm_event_batch_entry *entries = NULL;
+	struct lttcomm_session_msg lsm;
+
+	if (handle == NULL || names == NULL || count == 0 ||
+			count > LTTNG_EVENT_BATCH_MAX_LEN / sizeof(*entries)) {
+		ret = -LTTNG_ERR_INVALID;
+		goto end;
+	}
+
+	payload_len = count * sizeof(*entries);
+	entries = zmalloc(payload_len);
+	if (!entries) {
+		ret = -LTTNG_ERR_NOMEM;
+		goto end;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct lttng_event ev;
+
+		memset(&ev, 0, sizeof(ev));
+		ev.loglevel = -1;
+		ev.type = LTTNG_EVENT_ALL;
+		if (names[i] == NULL || names[i][0] == '\0') {
+			/* Disable all events */
+			lttng_ctl_copy_string(ev.name, "*", sizeof(ev.name));
+		} else {
+			lttng_ctl_copy_string(ev.name, names[i], sizeof(ev.name));
+		}
+		/* FIXME: copying non-packed struct to packed struct. */
+		memcpy(&entries[i].event, &ev, sizeof(ev));
+	}
+
+	memset(&lsm, 0, sizeof(lsm));
+	lsm.cmd_type = LTTNG_DISABLE_EVENTS;
+	/* If no channel name, send empty string. */
+	lttng_ctl_copy_string(lsm.u.events.channel_name,
+			channel_name ? channel_name : "",
+			sizeof(lsm.u.events.channel_name));
+	lttng_ctl_copy_lttng_domain(&lsm.domain, &handle->domain);
+	lttng_ctl_copy_string(lsm.session.name, handle->session_name,
+			sizeof(lsm.session.name));
+	lsm.u.events.count = count;
+	lsm.u.events.payload_len = payload_len;
+
+	ret = lttng_ctl_ask_sessiond_varlen(&lsm, entries, payload_len, NULL);
+	if (ret != -LTTNG_ERR_UND) {
+		goto end;
+	}
+
+	/* Older session daemon, disable the events one by one. */
+	ret = 0;
+	for (i = 0; i < count; i++) {
+		int event_ret;
+
+		event_ret = lttng_disable_event(handle, names[i], channel_name);
+		if (event_ret < 0 && ret == 0) {
+			ret = event_ret;
+		}
+	}
+
+end:
+	free(entries);
+	return ret < 0 ? ret : 0;
+}
+
 /*
  *  Enable channel per domain
  *  Returns size of returned session payload data or a negative error code.
@@ -1565,6 +2045,19 @@ int lttng_set_tracing_group(const char *name)
 	return 0;
 }
 
+/*
+ * Keep or not the connection to the session daemon open across calls.
+ */
+int lttng_set_persistent_connection(int enable)
+{
+	persistent_connection = !!enable;
+	if (!persistent_connection) {
+		disconnect_sessiond();
+	}
+
+	return 0;
+}
+
 /*
  * Returns size of returned session payload data or a negative error code.
  */
@@ -1928,5 +2421,8 @@ static void __attribute__((constructor)) init()
  */
 static void __attribute__((destructor)) lttng_ctl_exit()
 {
+	if (connected && connection_pid == getpid()) {
+		disconnect_sessiond();
+	}
 	free(tracing_group);
 }
@@ -187,8 +187,9 @@ void lttng_snapshot_output_list_destroy(struct lttng_snapshot_output_list *list)
  *
  * Return 0 on success or else a negative LTTNG_ERR value.
  */
-int lttng_snapshot_record(const char *session_name,
-		struct lttng_snapshot_output *output, int wait)
+static int snapshot_record(const char *session_name,
+		struct lttng_snapshot_output *output, int wait,
+		unsigned int incremental)
 {
 	struct lttcomm_session_msg lsm;
 
@@ -214,9 +215,37 @@ int lttng_snapshot_record(const char *session_name,
 
 	/* The wait param is ignored. */
 
+	if (incremental) {
+		lsm.u.snapshot_record.wait |= LTTNG_SNAPSHOT_RECORD_INCREMENTAL;
+	}
+
 	return lttng_ctl_ask_sessiond(&lsm, NULL);
 }
 
+/*
+ * Ask the session daemon to record a snapshot of the given session. If the
+ * output is NULL, the outputs previously added to the session are used.
+ *
+ * Return 0 on success or else a negative LTTNG_ERR value.
+ */
+int lttng_snapshot_record(const char *session_name,
+		struct lttng_snapshot_output *output, int wait)
+{
+	return snapshot_record(session_name, output, wait, 0);
+}
+
+/*
+ * Ask the session daemon to record an incremental snapshot of the given
+ * session, meaning only the data produced since the previous snapshot.
+ *
+ * Return 0 on success or else a negative LTTNG_ERR value.
+ */
+int lttng_snapshot_record_incremental(const char *session_name,
+		struct lttng_snapshot_output *output, int wait)
+{
+	return snapshot_record(session_name, output, wait, 1);
+}
+
 /*
  * Return an newly allocated snapshot output object or NULL on error.
  */
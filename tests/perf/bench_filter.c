@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2015 - EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Benchmark of the evaluation of compiled filters against synthetic event
+ * payloads, using the host-side bytecode interpreter.
+ *
+ * Usage: bench_filter [NR_EVENTS [EXPRESSION]...]
+ */
+
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <common/common.h>
+#include <lib/lttng-ctl/filter/filter-interpreter.h>
+
+#define DEFAULT_NR_EVENTS	1000000
+#define NR_LOOPS		5
+/* Distinct payloads, evaluated in turn. */
+#define NR_PAYLOADS		1024
+#define NR_FIELDS		6
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+static const char *default_expressions[] = {
+	"intfield == 42",
+	"intfield > 10 && intfield < 20",
+	"(intfield == 1 || intfield == 2 || intfield == 3) && 2*4 > longfield",
+	"stringfield == \"payload-7\"",
+	"stringfield == \"payload-1*\"",
+	"stringfield == \"payload-1*\" && intfield == 42",
+	"floatfield > 0.5 || longfield < 0",
+	"$ctx.procname == \"bench*\" && $ctx.vtid != 0",
+};
+
+static const char *strings[] = {
+	"payload-1", "payload-7", "payload-12", "payload-100",
+};
+
+static struct filter_interpreter_field payloads[NR_PAYLOADS][NR_FIELDS];
+
+static void init_payloads(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < NR_PAYLOADS; i++) {
+		struct filter_interpreter_field *fields = payloads[i];
+
+		fields[0].name = "intfield";
+		fields[0].type = FILTER_INTERPRETER_FIELD_S64;
+		fields[0].u.v = i % 100;
+		fields[1].name = "longfield";
+		fields[1].type = FILTER_INTERPRETER_FIELD_S64;
+		fields[1].u.v = (int64_t) i * 7 - 1000;
+		fields[2].name = "floatfield";
+		fields[2].type = FILTER_INTERPRETER_FIELD_DOUBLE;
+		fields[2].u.d = (double) (i % 10) / 10.0;
+		fields[3].name = "stringfield";
+		fields[3].type = FILTER_INTERPRETER_FIELD_STRING;
+		fields[3].u.s.str = strings[i % 4];
+		fields[4].name = "procname";
+		fields[4].context = 1;
+		fields[4].type = FILTER_INTERPRETER_FIELD_STRING;
+		fields[4].u.s.str = i % 2 ? "bench_filter" : "other";
+		fields[5].name = "vtid";
+		fields[5].context = 1;
+		fields[5].type = FILTER_INTERPRETER_FIELD_S64;
+		fields[5].u.v = i % 3;
+	}
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*
+ * Compile and evaluate the expression over nr_events payloads NR_LOOPS
+ * times and report the best time.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int bench(const char *expression, unsigned long nr_events)
+{
+	int ret, loop;
+	unsigned long i, matched = 0;
+	uint64_t start, best = UINT64_MAX;
+	struct lttng_filter_bytecode *bytecode;
+	struct filter_interpreter_program *program;
+
+	ret = filter_interpreter_compile(expression, &bytecode);
+	if (ret) {
+		fprintf(stderr, "Filter compilation failed: %s\n", expression);
+		goto end;
+	}
+	ret = filter_interpreter_link(bytecode, payloads[0], NR_FIELDS,
+			&program);
+	if (ret) {
+		fprintf(stderr, "Filter link failed: %s\n", expression);
+		goto free_bytecode;
+	}
+
+	for (loop = 0; loop < NR_LOOPS; loop++) {
+		uint64_t duration;
+
+		matched = 0;
+		start = now_ns();
+		for (i = 0; i < nr_events; i++) {
+			ret = filter_interpreter_run(program,
+					payloads[i % NR_PAYLOADS]);
+			if (ret < 0) {
+				fprintf(stderr, "Filter evaluation failed: %s\n",
+						expression);
+				goto free_program;
+			}
+			matched += ret;
+		}
+		duration = now_ns() - start;
+		if (duration < best) {
+			best = duration;
+		}
+	}
+
+	printf("%s\n", expression);
+	printf("  bytecode: %u bytes, matched: %lu/%lu, best: %.1f ns/event\n",
+			bytecode->len, matched, nr_events,
+			(double) best / (double) nr_events);
+	ret = 0;
+
+free_program:
+	filter_interpreter_destroy(program);
+free_bytecode:
+	free(bytecode);
+end:
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int i, ret, status = EXIT_SUCCESS;
+	unsigned long nr_events = DEFAULT_NR_EVENTS;
+
+	if (argc > 1) {
+		nr_events = strtoul(argv[1], NULL, 10);
+	}
+	if (nr_events == 0) {
+		fprintf(stderr, "Usage: %s [NR_EVENTS [EXPRESSION]...]\n",
+				argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	init_payloads();
+
+	if (argc > 2) {
+		for (i = 2; i < argc; i++) {
+			ret = bench(argv[i], nr_events);
+			if (ret) {
+				status = EXIT_FAILURE;
+			}
+		}
+	} else {
+		for (i = 0; i < ARRAY_SIZE(default_expressions); i++) {
+			ret = bench(default_expressions[i], nr_events);
+			if (ret) {
+				status = EXIT_FAILURE;
+			}
+		}
+	}
+
+	return status;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2015 - EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Benchmark of the rate of lttng-ctl API calls against a running session
+ * daemon, connecting for each call and then over a persistent connection.
+ *
+ * Usage: bench_lttng_ctl [NR_CALLS]
+ */
+
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <lttng/lttng.h>
+
+#define DEFAULT_NR_CALLS	10000
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*
+ * Issue nr_calls session listings.
+ *
+ * Return the duration in nsec or 0 on error.
+ */
+static uint64_t run(unsigned long nr_calls)
+{
+	int ret;
+	unsigned long i;
+	uint64_t start;
+	struct lttng_session *sessions;
+
+	start = now_ns();
+	for (i = 0; i < nr_calls; i++) {
+		ret = lttng_list_sessions(&sessions);
+		if (ret < 0) {
+			fprintf(stderr, "List sessions failed: %s\n",
+					lttng_strerror(ret));
+			return 0;
+		}
+		free(sessions);
+	}
+	return now_ns() - start;
+}
+
+static void report(const char *mode, unsigned long nr_calls,
+		uint64_t duration)
+{
+	printf("%-12s %lu calls in %" PRIu64 " us: %.0f calls/s\n", mode,
+			nr_calls, duration / 1000,
+			(double) nr_calls * 1000000000.0 / (double) duration);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long nr_calls = DEFAULT_NR_CALLS;
+	uint64_t duration;
+
+	if (argc > 1) {
+		nr_calls = strtoul(argv[1], NULL, 10);
+	}
+	if (nr_calls == 0) {
+		fprintf(stderr, "Usage: %s [NR_CALLS]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (lttng_session_daemon_alive() != 1) {
+		fprintf(stderr, "No session daemon available\n");
+		return EXIT_FAILURE;
+	}
+
+	duration = run(nr_calls);
+	if (!duration) {
+		return EXIT_FAILURE;
+	}
+	report("per-call", nr_calls, duration);
+
+	lttng_set_persistent_connection(1);
+	duration = run(nr_calls);
+	lttng_set_persistent_connection(0);
+	if (!duration) {
+		return EXIT_FAILURE;
+	}
+	report("persistent", nr_calls, duration);
+
+	return EXIT_SUCCESS;
+}
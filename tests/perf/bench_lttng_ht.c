@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2015 - EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Benchmark of the lookups in the uint64_t and two uint64_t keyed hash
+ * tables, such as the stream, channel and relay index lookups done per packet
+ * by the relay and consumer daemons. The specialized lookup functions are
+ * compared with generic lookups going through the hash and match function
+ * pointers of the table with the Jenkins hash used before.
+ *
+ * Usage: bench_lttng_ht [NR_KEYS] [NR_LOOKUPS]
+ */
+
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <common/common.h>
+#include <common/hashtable/hashtable.h>
+#include <common/hashtable/utils.h>
+
+#define DEFAULT_NR_KEYS		10000
+#define DEFAULT_NR_LOOKUPS	10000000
+#define NR_LOOPS		5
+/* Streams of the relay indexes, keyed by stream id and sequence number. */
+#define NR_INDEX_STREAMS	16
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+enum bench_table {
+	BENCH_U64,
+	BENCH_TWO_U64,
+};
+
+static unsigned long nr_keys = DEFAULT_NR_KEYS;
+static unsigned long nr_lookups = DEFAULT_NR_LOOKUPS;
+/* Index of the key of each lookup, in a random order. */
+static unsigned long *lookup_order;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/* Hash of two uint64_t keys used before the specialized hash functions. */
+static unsigned long legacy_hash_two_u64(void *_key, unsigned long seed)
+{
+	struct lttng_ht_two_u64 *key = _key;
+
+	return hash_key_u64(&key->key1, seed) ^ hash_key_u64(&key->key2, seed);
+}
+
+static void index_key(unsigned long i, uint64_t *stream_id,
+		uint64_t *seq_num)
+{
+	*stream_id = i % NR_INDEX_STREAMS;
+	*seq_num = i / NR_INDEX_STREAMS;
+}
+
+/*
+ * Create a table holding the nr_keys nodes. A legacy table uses the Jenkins
+ * hash through the hash function pointer of the table.
+ *
+ * Return the table or NULL on error.
+ */
+static struct lttng_ht *create_table(enum bench_table type, int legacy,
+		void *nodes)
+{
+	unsigned long i;
+	struct lttng_ht *ht;
+
+	ht = lttng_ht_new(nr_keys, type == BENCH_U64 ? LTTNG_HT_TYPE_U64 :
+			LTTNG_HT_TYPE_TWO_U64);
+	if (!ht) {
+		return NULL;
+	}
+	if (legacy) {
+		ht->hash_fct = type == BENCH_U64 ? hash_key_u64 :
+			legacy_hash_two_u64;
+	}
+
+	rcu_read_lock();
+	for (i = 0; i < nr_keys; i++) {
+		if (type == BENCH_U64) {
+			struct lttng_ht_node_u64 *node =
+				&((struct lttng_ht_node_u64 *) nodes)[i];
+
+			lttng_ht_node_init_u64(node, i);
+			if (legacy) {
+				cds_lfht_add(ht->ht, ht->hash_fct(&node->key,
+						lttng_ht_seed), &node->node);
+			} else {
+				lttng_ht_add_unique_u64(ht, node);
+			}
+		} else {
+			struct lttng_ht_node_two_u64 *node =
+				&((struct lttng_ht_node_two_u64 *) nodes)[i];
+			uint64_t stream_id, seq_num;
+
+			index_key(i, &stream_id, &seq_num);
+			lttng_ht_node_init_two_u64(node, stream_id, seq_num);
+			if (legacy) {
+				cds_lfht_add(ht->ht, ht->hash_fct(&node->key,
+						lttng_ht_seed), &node->node);
+			} else {
+				lttng_ht_add_unique_two_u64(ht, node);
+			}
+		}
+	}
+	rcu_read_unlock();
+	return ht;
+}
+
+static void destroy_table(struct lttng_ht *ht)
+{
+	struct lttng_ht_iter iter;
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht->ht, &iter.iter, iter.iter.node) {
+		(void) lttng_ht_del(ht, &iter);
+	}
+	rcu_read_unlock();
+	lttng_ht_destroy(ht);
+	synchronize_rcu();
+}
+
+/*
+ * Look up every key in a random order nr_lookups times in total.
+ *
+ * Return the number of keys found.
+ */
+static unsigned long lookup_keys(struct lttng_ht *ht, enum bench_table type,
+		int legacy)
+{
+	unsigned long i, found = 0;
+	struct lttng_ht_iter iter;
+
+	rcu_read_lock();
+	for (i = 0; i < nr_lookups; i++) {
+		unsigned long k = lookup_order[i % nr_keys];
+
+		if (type == BENCH_U64) {
+			uint64_t key = k;
+
+			if (legacy) {
+				lttng_ht_lookup(ht, &key, &iter);
+			} else {
+				lttng_ht_lookup_u64(ht, key, &iter);
+			}
+		} else {
+			struct lttng_ht_two_u64 key;
+
+			index_key(k, &key.key1, &key.key2);
+			if (legacy) {
+				lttng_ht_lookup(ht, &key, &iter);
+			} else {
+				lttng_ht_lookup_two_u64(ht, key.key1, key.key2,
+						&iter);
+			}
+		}
+		found += cds_lfht_iter_get_node(&iter.iter) != NULL;
+	}
+	rcu_read_unlock();
+	return found;
+}
+
+/*
+ * Measure the lookups in a table and report the best time over NR_LOOPS.
+ *
+ * Return 0 on success else a negative value.
+ */
+static int measure(const char *label, enum bench_table type, int legacy)
+{
+	int ret = 0, loop;
+	unsigned long found = 0;
+	uint64_t start, best = UINT64_MAX;
+	struct lttng_ht *ht;
+	void *nodes;
+
+	nodes = calloc(nr_keys, type == BENCH_U64 ?
+			sizeof(struct lttng_ht_node_u64) :
+			sizeof(struct lttng_ht_node_two_u64));
+	if (!nodes) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	ht = create_table(type, legacy, nodes);
+	if (!ht) {
+		ret = -ENOMEM;
+		goto free_nodes;
+	}
+
+	for (loop = 0; loop < NR_LOOPS; loop++) {
+		uint64_t duration;
+
+		start = now_ns();
+		found = lookup_keys(ht, type, legacy);
+		duration = now_ns() - start;
+		if (duration < best) {
+			best = duration;
+		}
+	}
+	if (found != nr_lookups) {
+		fprintf(stderr, "%s: %lu of %lu keys found\n", label, found,
+				nr_lookups);
+		ret = -EINVAL;
+	}
+
+	printf("  %-24s best: %.1f ns/lookup\n", label,
+			(double) best / (double) nr_lookups);
+
+	destroy_table(ht);
+free_nodes:
+	free(nodes);
+end:
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int ret = 0;
+	unsigned long i;
+
+	if (argc > 1) {
+		nr_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		nr_lookups = strtoul(argv[2], NULL, 10);
+	}
+	if (nr_keys == 0 || nr_lookups == 0) {
+		fprintf(stderr, "Usage: %s [NR_KEYS] [NR_LOOKUPS]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	lookup_order = calloc(nr_keys, sizeof(*lookup_order));
+	if (!lookup_order) {
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < nr_keys; i++) {
+		lookup_order[i] = i;
+	}
+	srandom(42);
+	for (i = nr_keys - 1; i > 0; i--) {
+		unsigned long j = random() % (i + 1), tmp = lookup_order[i];
+
+		lookup_order[i] = lookup_order[j];
+		lookup_order[j] = tmp;
+	}
+
+	rcu_register_thread();
+
+	printf("%lu keys, %lu lookups\n", nr_keys, nr_lookups);
+	printf("uint64_t keys:\n");
+	ret |= measure("generic (Jenkins hash):", BENCH_U64, 1);
+	ret |= measure("lttng_ht_lookup_u64:", BENCH_U64, 0);
+	printf("two uint64_t keys (%d streams):\n", NR_INDEX_STREAMS);
+	ret |= measure("generic (Jenkins hash):", BENCH_TWO_U64, 1);
+	ret |= measure("lttng_ht_lookup_two_u64:", BENCH_TWO_U64, 0);
+
+	rcu_unregister_thread();
+	free(lookup_order);
+
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
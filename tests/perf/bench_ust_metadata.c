@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2015 - EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Benchmark of the UST metadata generation done by the session daemon when
+ * applications register their events.
+ *
+ * Usage: bench_ust_metadata [NR_EVENTS] [NR_LOOPS]
+ */
+
+#define _GNU_SOURCE
+#include <endian.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <common/common.h>
+#include <bin/lttng-sessiond/ust-registry.h>
+
+#define DEFAULT_NR_EVENTS	10000
+#define DEFAULT_NR_LOOPS	10
+#define NR_FIELDS		6
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+/*
+ * The rendered event metadata is not kept so every loop measures the
+ * rendering done by the first registry dumping an event.
+ */
+void ust_registry_event_decl_set_text(struct ust_registry_event_decl *decl,
+		const char *text, size_t len)
+{
+}
+
+static void init_integer(struct ustctl_integer_type *integer, uint32_t size,
+		uint32_t signedness, uint32_t base)
+{
+	integer->size = size;
+	integer->signedness = signedness;
+	integer->reverse_byte_order = 0;
+	integer->base = base;
+	integer->encoding = ustctl_encode_none;
+	integer->alignment = 8;
+}
+
+/*
+ * Fields typical of an instrumented application: integers of various sizes,
+ * a string, an array and a sequence.
+ */
+static void init_fields(struct ustctl_field *fields)
+{
+	memset(fields, 0, sizeof(*fields) * NR_FIELDS);
+
+	strcpy(fields[0].name, "id");
+	fields[0].type.atype = ustctl_atype_integer;
+	init_integer(&fields[0].type.u.basic.integer, 32, 1, 10);
+
+	strcpy(fields[1].name, "addr");
+	fields[1].type.atype = ustctl_atype_integer;
+	init_integer(&fields[1].type.u.basic.integer, 64, 0, 16);
+
+	strcpy(fields[2].name, "flags");
+	fields[2].type.atype = ustctl_atype_integer;
+	init_integer(&fields[2].type.u.basic.integer, 8, 0, 2);
+
+	strcpy(fields[3].name, "msg");
+	fields[3].type.atype = ustctl_atype_string;
+	fields[3].type.u.basic.string.encoding = ustctl_encode_UTF8;
+
+	strcpy(fields[4].name, "digest");
+	fields[4].type.atype = ustctl_atype_array;
+	fields[4].type.u.array.elem_type.atype = ustctl_atype_integer;
+	init_integer(&fields[4].type.u.array.elem_type.u.basic.integer,
+			8, 0, 16);
+	fields[4].type.u.array.length = 20;
+
+	strcpy(fields[5].name, "payload");
+	fields[5].type.atype = ustctl_atype_sequence;
+	fields[5].type.u.sequence.length_type.atype = ustctl_atype_integer;
+	init_integer(&fields[5].type.u.sequence.length_type.u.basic.integer,
+			32, 0, 10);
+	fields[5].type.u.sequence.elem_type.atype = ustctl_atype_integer;
+	init_integer(&fields[5].type.u.sequence.elem_type.u.basic.integer,
+			8, 0, 16);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	int ret, loop;
+	unsigned long i, nr_events = DEFAULT_NR_EVENTS;
+	int nr_loops = DEFAULT_NR_LOOPS;
+	uint64_t start, total = 0, best = UINT64_MAX;
+	size_t metadata_len = 0;
+	struct ustctl_field fields[NR_FIELDS];
+	struct ust_registry_channel chan;
+	struct ust_registry_event *events;
+	struct ust_registry_event_decl decl;
+
+	if (argc > 1) {
+		nr_events = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		nr_loops = atoi(argv[2]);
+	}
+	if (nr_events == 0 || nr_loops <= 0) {
+		fprintf(stderr, "Usage: %s [NR_EVENTS] [NR_LOOPS]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	init_fields(fields);
+
+	memset(&decl, 0, sizeof(decl));
+
+	memset(&chan, 0, sizeof(chan));
+	chan.chan_id = 0;
+
+	events = zmalloc(sizeof(*events) * nr_events);
+	if (!events) {
+		PERROR("zmalloc events");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < nr_events; i++) {
+		snprintf(events[i].name, sizeof(events[i].name),
+				"bench_provider:event_%lu", i);
+		events[i].id = i;
+		events[i].decl = &decl;
+		events[i].loglevel = 13;
+		events[i].nr_fields = NR_FIELDS;
+		events[i].fields = fields;
+	}
+
+	for (loop = 0; loop < nr_loops; loop++) {
+		struct ust_registry_session session;
+		uint64_t duration;
+
+		memset(&session, 0, sizeof(session));
+		session.byte_order = BYTE_ORDER;
+
+		start = now_ns();
+		for (i = 0; i < nr_events; i++) {
+			ret = ust_metadata_event_statedump(&session, &chan, &events[i]);
+			if (ret) {
+				fprintf(stderr, "Event metadata generation failed: %d\n",
+						ret);
+				free(session.metadata);
+				free(events);
+				return EXIT_FAILURE;
+			}
+		}
+		duration = now_ns() - start;
+
+		total += duration;
+		if (duration < best) {
+			best = duration;
+		}
+		metadata_len = session.metadata_len;
+		free(session.metadata);
+	}
+
+	printf("Events: %lu, fields per event: %d, metadata: %zu bytes\n",
+			nr_events, NR_FIELDS, metadata_len);
+	printf("Average: %" PRIu64 " us (%" PRIu64 " ns/event), best: %"
+			PRIu64 " us over %d loops\n", total / nr_loops / 1000,
+			total / nr_loops / nr_events, best / 1000, nr_loops);
+
+	free(events);
+	return EXIT_SUCCESS;
+}
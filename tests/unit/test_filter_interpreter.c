@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2015 - EfficiOS Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <tap/tap.h>
+
+#include <common/macros.h>
+#include <lib/lttng-ctl/filter/filter-bytecode.h>
+#include <lib/lttng-ctl/filter/filter-interpreter.h>
+
+/* For error.h */
+int lttng_opt_quiet = 1;
+int lttng_opt_verbose;
+int lttng_opt_mi;
+
+#define NR_FIELDS	5
+#define NR_PAYLOADS	4
+
+struct valid_test_input {
+	const char *expression;
+	/* Expected result for each payload. */
+	int expected[NR_PAYLOADS];
+};
+
+static struct valid_test_input valid_tests_inputs[] = {
+	{ "intfield", { 0, 1, 1, 1 } },
+	{ "intfield == 2", { 0, 0, 1, 0 } },
+	{ "intfield != 2", { 1, 1, 0, 1 } },
+	{ "intfield >= 2 && intfield < 3", { 0, 0, 1, 0 } },
+	{ "intfield < 1 || intfield > 2", { 1, 0, 0, 1 } },
+	{ "!(intfield == 1)", { 1, 0, 1, 1 } },
+	{ "-intfield < -1", { 0, 0, 1, 1 } },
+	{ "2 * 1 > intfield", { 1, 1, 0, 0 } },
+	{ "intfield > 3 + -2", { 0, 0, 1, 1 } },
+	{ "2 * -4 < intfield", { 1, 1, 1, 1 } },
+	{ "floatfield > 1.0", { 0, 0, 1, 1 } },
+	{ "floatfield == intfield", { 1, 0, 0, 0 } },
+	{ "floatfield && intfield", { 0, 0, 1, 1 } },
+	{ "stringfield == \"test\"", { 1, 0, 0, 0 } },
+	{ "stringfield == \"te*\"", { 1, 1, 0, 0 } },
+	{ "stringfield == \"te\\*\"", { 0, 1, 0, 0 } },
+	{ "stringfield != \"*\"", { 0, 0, 0, 0 } },
+	{ "stringfield > \"test\"", { 0, 0, 1, 0 } },
+	{ "seqfield == \"abc\"", { 0, 0, 0, 1 } },
+	{ "$ctx.procname == \"app*\" && intfield > 1", { 0, 0, 0, 1 } },
+	{ "0 && intfield", { 0, 0, 0, 0 } },
+	{ "1 || stringfield == \"nope\"", { 1, 1, 1, 1 } },
+	{ "seqfield == \"ab*\"", { 0, 0, 1, 1 } },
+	{ "intfield in { 3, 1 }", { 0, 1, 0, 1 } },
+	{ "intfield in { -1, 2, 2, 0x10 }", { 0, 0, 1, 0 } },
+	{ "!(intfield in { 0, 3 })", { 0, 1, 1, 0 } },
+	{ "floatfield in { 0, 3 }", { 1, 0, 0, 0 } },
+	{ "stringfield in { \"tf\", \"test\" }", { 1, 0, 1, 0 } },
+	{ "stringfield in { \"te\\*\", \"t\" }", { 0, 1, 0, 0 } },
+	{ "seqfield in { \"a\", \"abc\" }", { 0, 1, 0, 1 } },
+	{ "$ctx.procname in { \"app\" } && intfield in { 1, 2 }", { 0, 1, 0, 0 } },
+	{ "intfield == 0 || stringfield in { \"abcdef\" }", { 1, 0, 0, 1 } },
+};
+static const int num_valid_tests = ARRAY_SIZE(valid_tests_inputs);
+
+struct invalid_test_input {
+	const char *expression;
+	/* Test step expected to fail. */
+	enum {
+		FAIL_COMPILE,
+		FAIL_LINK,
+		FAIL_RUN,
+	} step;
+};
+
+static struct invalid_test_input invalid_tests_inputs[] = {
+	{ "intfield * 2 == 4", FAIL_COMPILE },
+	{ "intfield ==", FAIL_COMPILE },
+	{ "unknownfield == 1", FAIL_LINK },
+	{ "$ctx.intfield == 1", FAIL_LINK },
+	{ "stringfield == 1", FAIL_RUN },
+	{ "stringfield && intfield", FAIL_RUN },
+	{ "stringfield == 1 || intfield == 0", FAIL_RUN },
+	{ "stringfield == 1 || 1", FAIL_RUN },
+	{ "stringfield == \"*te*\"", FAIL_COMPILE },
+	{ "stringfield > \"*st\"", FAIL_COMPILE },
+	{ "\"*st\" == \"test\"", FAIL_COMPILE },
+	{ "intfield in { 1, \"one\" }", FAIL_COMPILE },
+	{ "intfield in { 1.5 }", FAIL_COMPILE },
+	{ "intfield in { otherfield }", FAIL_COMPILE },
+	{ "stringfield in { \"te*\" }", FAIL_COMPILE },
+	{ "2 in { 1, 2 }", FAIL_COMPILE },
+	{ "(intfield in { 1 }) == 1", FAIL_COMPILE },
+	{ "intfield within { 1 }", FAIL_COMPILE },
+	{ "stringfield in { 1, 2 }", FAIL_RUN },
+	{ "intfield in { \"1\" }", FAIL_RUN },
+};
+static const int num_invalid_tests = ARRAY_SIZE(invalid_tests_inputs);
+
+struct cost_test_input {
+	const char *expression;
+	struct lttng_event_filter_cost cost;
+};
+
+static struct cost_test_input cost_tests_inputs[] = {
+	{ "1", { 2, 0, 0 } },
+	{ "intfield == 1", { 4, 0, 1 } },
+	{ "stringfield == \"test\"", { 4, 1, 1 } },
+	{ "stringfield == seqfield", { 4, 1, 2 } },
+	{ "$ctx.procname == \"app*\" && (intfield > 1 || seqfield == \"abc\")",
+		{ 12, 2, 3 } },
+	{ "intfield in { 1, 2 }", { 8, 0, 2 } },
+	{ "stringfield in { \"a\", \"b\" }", { 8, 2, 2 } },
+};
+static const int num_cost_tests = ARRAY_SIZE(cost_tests_inputs);
+
+static struct filter_interpreter_field payloads[NR_PAYLOADS][NR_FIELDS];
+
+static void init_payloads(void)
+{
+	static const char *strings[NR_PAYLOADS] = {
+		"test", "te*", "tf", "abcdef",
+	};
+	int i;
+
+	for (i = 0; i < NR_PAYLOADS; i++) {
+		struct filter_interpreter_field *fields = payloads[i];
+
+		fields[0].name = "intfield";
+		fields[0].type = FILTER_INTERPRETER_FIELD_S64;
+		fields[0].u.v = i;
+		fields[1].name = "floatfield";
+		fields[1].type = FILTER_INTERPRETER_FIELD_DOUBLE;
+		fields[1].u.d = i * 0.75;
+		fields[2].name = "stringfield";
+		fields[2].type = FILTER_INTERPRETER_FIELD_STRING;
+		fields[2].u.s.str = strings[i];
+		fields[3].name = "seqfield";
+		fields[3].type = FILTER_INTERPRETER_FIELD_SEQUENCE;
+		fields[3].u.s.str = strings[3];
+		fields[3].u.s.len = i;
+		fields[4].name = "procname";
+		fields[4].context = 1;
+		fields[4].type = FILTER_INTERPRETER_FIELD_STRING;
+		fields[4].u.s.str = i % 2 ? "app" : "other";
+	}
+}
+
+/*
+ * Evaluate the bytecode against every payload.
+ *
+ * Return 1 if every result is the expected one, else 0.
+ */
+static int check_results(const struct lttng_filter_bytecode *bytecode,
+		const int *expected)
+{
+	int j, ret, success = 0;
+	struct filter_interpreter_program *program = NULL;
+
+	ret = filter_interpreter_link(bytecode, payloads[0], NR_FIELDS,
+			&program);
+	if (ret) {
+		goto end;
+	}
+	for (j = 0; j < NR_PAYLOADS; j++) {
+		ret = filter_interpreter_run(program, payloads[j]);
+		if (ret != expected[j]) {
+			diag("payload %d: got %d, expected %d", j, ret,
+					expected[j]);
+			goto end;
+		}
+	}
+	success = 1;
+end:
+	filter_interpreter_destroy(program);
+	return success;
+}
+
+static void test_valid_filters(void)
+{
+	int i, ret;
+
+	for (i = 0; i < num_valid_tests; i++) {
+		struct lttng_filter_bytecode *bytecode = NULL;
+		int success = 0;
+
+		ret = filter_interpreter_compile(valid_tests_inputs[i].expression,
+				&bytecode);
+		if (ret) {
+			goto end;
+		}
+		if (!check_results(bytecode, valid_tests_inputs[i].expected)) {
+			goto end;
+		}
+		success = 1;
+end:
+		ok(success, "valid filter: %s",
+				valid_tests_inputs[i].expression);
+		free(bytecode);
+	}
+}
+
+static void test_invalid_filters(void)
+{
+	int i, ret;
+
+	for (i = 0; i < num_invalid_tests; i++) {
+		struct lttng_filter_bytecode *bytecode = NULL;
+		struct filter_interpreter_program *program = NULL;
+		int failed_step = -1;
+
+		ret = filter_interpreter_compile(
+				invalid_tests_inputs[i].expression, &bytecode);
+		if (ret) {
+			failed_step = FAIL_COMPILE;
+			goto end;
+		}
+		ret = filter_interpreter_link(bytecode, payloads[0], NR_FIELDS,
+				&program);
+		if (ret) {
+			failed_step = FAIL_LINK;
+			goto end;
+		}
+		ret = filter_interpreter_run(program, payloads[0]);
+		if (ret < 0) {
+			failed_step = FAIL_RUN;
+		}
+end:
+		ok(failed_step == invalid_tests_inputs[i].step,
+				"invalid filter: %s",
+				invalid_tests_inputs[i].expression);
+		filter_interpreter_destroy(program);
+		free(bytecode);
+	}
+}
+
+static void test_cost(void)
+{
+	int i, ret;
+
+	for (i = 0; i < num_cost_tests; i++) {
+		const struct lttng_event_filter_cost *expected =
+			&cost_tests_inputs[i].cost;
+		struct lttng_filter_bytecode *bytecode = NULL;
+		struct lttng_event_filter_cost cost;
+		int success = 0;
+
+		ret = filter_interpreter_compile(cost_tests_inputs[i].expression,
+				&bytecode);
+		if (ret) {
+			goto end;
+		}
+		ret = filter_bytecode_cost(bytecode, &cost);
+		if (ret || cost.nr_insns != expected->nr_insns ||
+				cost.nr_string_compares !=
+					expected->nr_string_compares ||
+				cost.nr_field_loads != expected->nr_field_loads) {
+			goto end;
+		}
+		success = 1;
+end:
+		ok(success, "filter cost: %s", cost_tests_inputs[i].expression);
+		free(bytecode);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(num_valid_tests + num_invalid_tests + num_cost_tests);
+
+	diag("Filter bytecode interpreter tests");
+
+	init_payloads();
+
+	test_valid_filters();
+	test_invalid_filters();
+	test_cost();
+
+	return exit_status();
+}
@@ -39,7 +39,7 @@
 #define RANDOM_STRING_LEN	11
 
 /* Number of TAP tests in this file */
-#define NUM_TESTS 11
+#define NUM_TESTS 13
 
 /* For error.h */
 int lttng_opt_quiet = 1;
@@ -135,6 +135,8 @@ static void test_create_ust_event(void)
 	   event->attr.name[LTTNG_UST_SYM_NAME_LEN - 1] == '\0',
 	   "Validate UST event");
 
+	ok(event->tmpl == NULL, "No template for UST event without filter");
+
 	trace_ust_destroy_event(event);
 }
 
@@ -179,6 +181,12 @@ static void test_create_ust_event_exclusion(void)
 	   event->attr.name[LTTNG_UST_SYM_NAME_LEN - 1] == '\0',
 	   "Validate UST event and exclusion");
 
+	ok(event->tmpl != NULL &&
+	   event->tmpl->refcount == 1 &&
+	   event->tmpl->exclusion == event->exclusion &&
+	   event->tmpl->filter == NULL,
+	   "Validate UST event template");
+
 	trace_ust_destroy_event(event);
 }
 